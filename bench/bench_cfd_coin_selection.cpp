@@ -0,0 +1,342 @@
+// Copyright 2019 CryptoGarage
+/**
+ * @file bench_cfd_coin_selection.cpp
+ *
+ * @brief CoinSelectionのベンチマーク
+ */
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "bench_cfd_util.h"            // NOLINT
+#include "bench_cfd_utxo_generator.h"  // NOLINT
+#include "cfd/cfd_fee.h"
+#include "cfd/cfd_utxo.h"
+#include "cfdcore/cfdcore_amount.h"
+#include "cfdcore/cfdcore_exception.h"
+
+using cfd::AmountMap;
+using cfd::BnBSearchStatistics;
+using cfd::CoinSelection;
+using cfd::CoinSelectionFeeRateResult;
+using cfd::CoinSelectionOption;
+using cfd::CoinSelectionRandom;
+using cfd::FeeCalculator;
+using cfd::Utxo;
+using cfd::UtxoFilter;
+using cfd::UtxoPool;
+using cfd::bench::BenchMeasure;
+using cfd::bench::BenchUtxoGenerator;
+using cfd::bench::BenchWalletParameter;
+using cfd::core::Amount;
+#ifndef CFD_DISABLE_ELEMENTS
+using cfd::core::ConfidentialAssetId;
+#endif  // CFD_DISABLE_ELEMENTS
+
+//! 計測時のfee rate
+static constexpr double kBenchFeeRate = 20.0;
+//! TxIn以外のfee
+static constexpr int64_t kBenchTxFee = 1500;
+//! TxIn以外のtx size
+static constexpr uint32_t kBenchTxSize = 75;
+//! KnapsackSolverの最小お釣り額 (MIN_CHANGE)
+static constexpr uint64_t kBenchMinChange = 1000000;
+//! BnBの最大探索回数
+static constexpr uint64_t kBenchBnBMaxTries = 100000;
+//! 乱数seed
+static constexpr uint64_t kBenchRandomSeed = 1;
+//! TxIn数の上限 (上限付き計測用)
+static constexpr uint32_t kBenchMaxInputCount = 50;
+
+/**
+ * @brief 内部のCoinSelection処理を直接呼び出すためのクラス
+ */
+class BenchCoinSelection : public CoinSelection {
+ public:
+  BenchCoinSelection() : CoinSelection(true) {}
+  using CoinSelection::KnapsackSolver;
+  using CoinSelection::SelectCoinsBnB;
+};
+
+/**
+ * @brief CoinSelectionのオプションを取得する.
+ * @return オプション
+ */
+static CoinSelectionOption GetBenchOption() {
+  CoinSelectionOption option;
+  option.InitializeTxSizeInfo();
+  option.SetEffectiveFeeBaserate(kBenchFeeRate);
+  option.SetRandomSeed(kBenchRandomSeed);
+  return option;
+}
+
+/**
+ * @brief fee計算済みのUTXOプールを作成する.
+ * @details 有効額が正のUTXOのみを有効額の降順で格納する。
+ * @param[in] utxos     UTXO一覧
+ * @param[in] option    オプション
+ * @return UTXOプール
+ */
+static UtxoPool CreateFeePool(
+    const std::vector<Utxo>& utxos, const CoinSelectionOption& option) {
+  FeeCalculator effective_fee(option.GetEffectiveFeeBaserate());
+  FeeCalculator long_term_fee(option.GetLongTermFeeBaserate());
+  UtxoPool pool;
+  pool.Reserve(utxos.size());
+  for (const auto& utxo : utxos) {
+    uint64_t fee =
+        static_cast<uint64_t>(effective_fee.GetFee(utxo).GetSatoshiValue());
+    if (utxo.amount <= fee) continue;
+    pool.Add(
+        &utxo, utxo.amount - fee, fee,
+        static_cast<uint64_t>(long_term_fee.GetFee(utxo).GetSatoshiValue()));
+  }
+  return pool.GetSortedByEffectiveValue();
+}
+
+// SelectCoins(Single Asset) ===================================================
+static void BM_SelectCoins(benchmark::State& state) {  // NOLINT
+  BenchUtxoGenerator generator(
+      BenchUtxoGenerator::GetWalletParameter(state));
+  std::vector<Utxo> utxos = generator.GenerateUtxos();
+  CoinSelectionOption option = GetBenchOption();
+  UtxoFilter filter;
+  Amount target = Amount::CreateBySatoshiAmount(static_cast<int64_t>(
+      BenchUtxoGenerator::GetTotalAmount(utxos) / 10));
+  Amount tx_fee = Amount::CreateBySatoshiAmount(kBenchTxFee);
+  CoinSelection coin_select(true);
+
+  BenchMeasure measure(&state);
+  while (state.KeepRunning()) {
+    Amount select_value;
+    Amount utxo_fee;
+    measure.Start();
+    std::vector<Utxo> result = coin_select.SelectCoins(
+        target, utxos, filter, option, tx_fee, &select_value, &utxo_fee);
+    measure.Stop();
+    benchmark::DoNotOptimize(result.data());
+  }
+  measure.Report();
+}
+BENCHMARK(BM_SelectCoins)->Apply(BenchUtxoGenerator::SetWalletArguments);
+
+static void BM_SelectCoinsMaxInputCount(benchmark::State& state) {  // NOLINT
+  BenchUtxoGenerator generator(
+      BenchUtxoGenerator::GetWalletParameter(state));
+  std::vector<Utxo> utxos = generator.GenerateUtxos();
+  CoinSelectionOption option = GetBenchOption();
+  option.SetMaxInputCount(kBenchMaxInputCount);
+  UtxoFilter filter;
+  Amount target = Amount::CreateBySatoshiAmount(static_cast<int64_t>(
+      BenchUtxoGenerator::GetTotalAmount(utxos) / 10));
+  Amount tx_fee = Amount::CreateBySatoshiAmount(kBenchTxFee);
+  CoinSelection coin_select(true);
+
+  BenchMeasure measure(&state);
+  while (state.KeepRunning()) {
+    Amount select_value;
+    Amount utxo_fee;
+    measure.Start();
+    try {
+      std::vector<Utxo> result = coin_select.SelectCoins(
+          target, utxos, filter, option, tx_fee, &select_value, &utxo_fee);
+      benchmark::DoNotOptimize(result.data());
+    } catch (const cfd::core::CfdException&) {
+      // 上限内で収集額に達しない分布では、失敗までの時間を計測する
+    }
+    measure.Stop();
+  }
+  measure.Report();
+}
+BENCHMARK(BM_SelectCoinsMaxInputCount)
+    ->Apply(BenchUtxoGenerator::SetWalletArguments);
+
+// SelectCoinsByFeeRates =======================================================
+//! fee rate一覧 (sweep計測用)
+static const std::vector<double> kBenchFeeRates = {1, 2, 5, 10,
+                                                   20, 50, 100, 200};
+
+static void BM_SelectCoinsByFeeRates(benchmark::State& state) {  // NOLINT
+  BenchUtxoGenerator generator(
+      BenchUtxoGenerator::GetWalletParameter(state));
+  std::vector<Utxo> utxos = generator.GenerateUtxos();
+  CoinSelectionOption option = GetBenchOption();
+  UtxoFilter filter;
+  Amount target = Amount::CreateBySatoshiAmount(static_cast<int64_t>(
+      BenchUtxoGenerator::GetTotalAmount(utxos) / 10));
+  CoinSelection coin_select(true);
+
+  BenchMeasure measure(&state);
+  while (state.KeepRunning()) {
+    measure.Start();
+    std::vector<CoinSelectionFeeRateResult> results =
+        coin_select.SelectCoinsByFeeRates(
+            target, utxos, filter, option, kBenchTxSize, kBenchFeeRates);
+    measure.Stop();
+    benchmark::DoNotOptimize(results.data());
+  }
+  measure.Report(static_cast<int64_t>(kBenchFeeRates.size()));
+}
+BENCHMARK(BM_SelectCoinsByFeeRates)
+    ->Apply(BenchUtxoGenerator::SetWalletArguments);
+
+static void BM_SelectCoinsFeeRateLoop(benchmark::State& state) {  // NOLINT
+  BenchUtxoGenerator generator(
+      BenchUtxoGenerator::GetWalletParameter(state));
+  std::vector<Utxo> utxos = generator.GenerateUtxos();
+  CoinSelectionOption option = GetBenchOption();
+  UtxoFilter filter;
+  Amount target = Amount::CreateBySatoshiAmount(static_cast<int64_t>(
+      BenchUtxoGenerator::GetTotalAmount(utxos) / 10));
+  CoinSelection coin_select(true);
+
+  BenchMeasure measure(&state);
+  while (state.KeepRunning()) {
+    measure.Start();
+    for (double fee_rate : kBenchFeeRates) {
+      option.SetEffectiveFeeBaserate(fee_rate);
+      Amount tx_fee = FeeCalculator(option.GetEffectiveFeeBaserate())
+                          .GetFee(kBenchTxSize);
+      Amount select_value;
+      Amount utxo_fee;
+      try {
+        std::vector<Utxo> result = coin_select.SelectCoins(
+            target, utxos, filter, option, tx_fee, &select_value, &utxo_fee);
+        benchmark::DoNotOptimize(result.data());
+      } catch (const cfd::core::CfdException&) {
+        // SelectCoinsByFeeRatesと同様に、選択できないfee rateは無視する
+      }
+    }
+    measure.Stop();
+  }
+  measure.Report(static_cast<int64_t>(kBenchFeeRates.size()));
+}
+BENCHMARK(BM_SelectCoinsFeeRateLoop)
+    ->Apply(BenchUtxoGenerator::SetWalletArguments);
+
+// KnapsackSolver ==============================================================
+static void BM_KnapsackSolver(benchmark::State& state) {  // NOLINT
+  BenchUtxoGenerator generator(
+      BenchUtxoGenerator::GetWalletParameter(state));
+  std::vector<Utxo> utxos = generator.GenerateUtxos();
+  CoinSelectionOption option = GetBenchOption();
+  UtxoPool pool = CreateFeePool(utxos, option);
+  uint64_t total = 0;
+  for (uint64_t value : pool.GetEffectiveValues()) total += value;
+  Amount target = Amount::CreateBySatoshiAmount(static_cast<int64_t>(
+      total / 10));
+  BenchCoinSelection coin_select;
+  CoinSelectionRandom random(kBenchRandomSeed);
+
+  BenchMeasure measure(&state);
+  while (state.KeepRunning()) {
+    Amount select_value;
+    Amount utxo_fee;
+    measure.Start();
+    std::vector<size_t> result = coin_select.KnapsackSolver(
+        target, pool, kBenchMinChange, &random, &select_value, &utxo_fee);
+    measure.Stop();
+    benchmark::DoNotOptimize(result.data());
+  }
+  measure.Report();
+}
+BENCHMARK(BM_KnapsackSolver)->Apply(BenchUtxoGenerator::SetWalletArguments);
+
+// SelectCoinsBnB ==============================================================
+static void BM_SelectCoinsBnB(benchmark::State& state) {  // NOLINT
+  BenchUtxoGenerator generator(
+      BenchUtxoGenerator::GetWalletParameter(state));
+  std::vector<Utxo> utxos = generator.GenerateUtxos();
+  CoinSelectionOption option = GetBenchOption();
+  UtxoPool pool = CreateFeePool(utxos, option);
+  if (pool.IsEmpty()) {
+    state.SkipWithError("utxo pool is empty.");
+    return;
+  }
+  // 解が存在するよう、プール中の3件の有効額の合計を収集額とする
+  const std::vector<uint64_t>& values = pool.GetEffectiveValues();
+  uint64_t target_value = 0;
+  for (size_t index = 0; index < 3; ++index) {
+    target_value += values[(index * values.size()) / 3];
+  }
+  Amount target =
+      Amount::CreateBySatoshiAmount(static_cast<int64_t>(target_value));
+  FeeCalculator effective_fee(option.GetEffectiveFeeBaserate());
+  Amount cost_of_change =
+      effective_fee.GetFee(option.GetChangeOutputSize()) +
+      effective_fee.GetFee(option.GetChangeSpendSize());
+  Amount not_input_fees = Amount::CreateBySatoshiAmount(0);
+  BenchCoinSelection coin_select;
+
+  BenchMeasure measure(&state);
+  BnBSearchStatistics statistics;
+  while (state.KeepRunning()) {
+    Amount select_value;
+    Amount utxo_fee;
+    measure.Start();
+    std::vector<size_t> result = coin_select.SelectCoinsBnB(
+        target, pool, cost_of_change, not_input_fees, kBenchBnBMaxTries, 0,
+        &select_value, &utxo_fee, &statistics);
+    measure.Stop();
+    benchmark::DoNotOptimize(result.data());
+  }
+  measure.Report();
+  state.counters["tries"] = static_cast<double>(statistics.tries);
+}
+BENCHMARK(BM_SelectCoinsBnB)->Apply(BenchUtxoGenerator::SetWalletArguments);
+
+#ifndef CFD_DISABLE_ELEMENTS
+// SelectCoins(Multiple Asset) =================================================
+static void BM_SelectCoinsMultiAsset(benchmark::State& state) {  // NOLINT
+  BenchWalletParameter param;
+  param.utxo_count = static_cast<size_t>(state.range(0));
+  param.asset_count = static_cast<uint32_t>(state.range(1));
+  BenchUtxoGenerator generator(param);
+  std::vector<Utxo> utxos = generator.GenerateUtxos();
+
+  // asset毎の合計額の1割を収集額とする
+  AmountMap map_target;
+  for (uint32_t index = 0; index < param.asset_count; ++index) {
+    ConfidentialAssetId asset = BenchUtxoGenerator::GetAsset(index);
+    std::vector<uint8_t> asset_bytes = asset.GetData().GetBytes();
+    uint64_t total = 0;
+    for (const auto& utxo : utxos) {
+      if (std::equal(asset_bytes.begin(), asset_bytes.end(), utxo.asset)) {
+        total += utxo.amount;
+      }
+    }
+    map_target.emplace(
+        asset.GetHex(),
+        Amount::CreateBySatoshiAmount(static_cast<int64_t>(total / 10)));
+  }
+  CoinSelectionOption option;
+  option.InitializeConfidentialTxSizeInfo();
+  option.SetEffectiveFeeBaserate(kBenchFeeRate);
+  option.SetRandomSeed(kBenchRandomSeed);
+  option.SetFeeAsset(BenchUtxoGenerator::GetAsset(0));
+  UtxoFilter filter;
+  Amount tx_fee = Amount::CreateBySatoshiAmount(kBenchTxFee);
+  CoinSelection coin_select(true);
+
+  BenchMeasure measure(&state);
+  while (state.KeepRunning()) {
+    AmountMap map_select_value;
+    Amount utxo_fee;
+    measure.Start();
+    std::vector<Utxo> result = coin_select.SelectCoins(
+        map_target, utxos, filter, option, tx_fee, &map_select_value,
+        &utxo_fee);
+    measure.Stop();
+    benchmark::DoNotOptimize(result.data());
+  }
+  measure.Report();
+}
+BENCHMARK(BM_SelectCoinsMultiAsset)
+    ->ArgNames({"utxos", "assets"})
+    ->Args({1000, 2})
+    ->Args({1000, 4})
+    ->Args({10000, 2})
+    ->Args({10000, 4})
+    ->Args({10000, 16});
+#endif  // CFD_DISABLE_ELEMENTS
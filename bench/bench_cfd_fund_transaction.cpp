@@ -0,0 +1,229 @@
+// Copyright 2019 CryptoGarage
+/**
+ * @file bench_cfd_fund_transaction.cpp
+ *
+ * @brief FundRawTransactionのベンチマーク
+ */
+#include <map>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "bench_cfd_util.h"            // NOLINT
+#include "bench_cfd_utxo_generator.h"  // NOLINT
+#include "cfd/cfd_transaction.h"
+#include "cfd/cfd_utxo.h"
+#include "cfd/cfdapi_coin.h"
+#include "cfd/cfdapi_transaction.h"
+#include "cfdcore/cfdcore_address.h"
+#include "cfdcore/cfdcore_amount.h"
+
+#ifndef CFD_DISABLE_ELEMENTS
+#include "cfd/cfd_elements_transaction.h"
+#include "cfd/cfdapi_elements_transaction.h"
+#endif  // CFD_DISABLE_ELEMENTS
+
+using cfd::TransactionController;
+using cfd::UtxoIndex;
+using cfd::api::CoinApi;
+using cfd::api::TransactionApi;
+using cfd::api::UtxoData;
+using cfd::bench::BenchMeasure;
+using cfd::bench::BenchUtxoGenerator;
+using cfd::bench::BenchWalletParameter;
+using cfd::core::Address;
+using cfd::core::Amount;
+#ifndef CFD_DISABLE_ELEMENTS
+using cfd::ConfidentialTransactionController;
+using cfd::api::ElementsTransactionApi;
+using cfd::api::ElementsUtxoAndOption;
+using cfd::core::ConfidentialAssetId;
+#endif  // CFD_DISABLE_ELEMENTS
+
+//! 計測時のfee rate
+static constexpr double kBenchFeeRate = 20.0;
+//! 計測時のfee rate (elements)
+static constexpr double kBenchElementsFeeRate = 0.1;
+
+/**
+ * @brief 送金額をTxOutに設定したtxを作成する.
+ * @details UTXO合計額の1割を送金額とする。
+ * @param[in] utxos   UTXO一覧
+ * @return tx hex
+ */
+static std::string CreateFundTxHex(const std::vector<UtxoData>& utxos) {
+  int64_t total = 0;
+  for (const auto& utxo : utxos) {
+    total += utxo.amount.GetSatoshiValue();
+  }
+  TransactionController txc(2, 0);
+  txc.AddTxOut(
+      BenchUtxoGenerator::GetAddress(),
+      Amount::CreateBySatoshiAmount(total / 10));
+  return txc.GetHex();
+}
+
+// FundRawTransaction ==========================================================
+static void BM_FundRawTransaction(benchmark::State& state) {  // NOLINT
+  BenchUtxoGenerator generator(
+      BenchUtxoGenerator::GetWalletParameter(state));
+  std::vector<UtxoData> utxos = generator.GenerateUtxoData();
+  std::string tx_hex = CreateFundTxHex(utxos);
+  std::string reserve_address = BenchUtxoGenerator::GetAddress().GetAddress();
+  std::vector<UtxoData> selected_txin_utxos;
+  TransactionApi api;
+
+  BenchMeasure measure(&state);
+  while (state.KeepRunning()) {
+    Amount fee;
+    measure.Start();
+    TransactionController txc = api.FundRawTransaction(
+        tx_hex, utxos, Amount::CreateBySatoshiAmount(0), selected_txin_utxos,
+        reserve_address, kBenchFeeRate, &fee);
+    measure.Stop();
+    benchmark::DoNotOptimize(fee);
+  }
+  measure.Report();
+}
+BENCHMARK(BM_FundRawTransaction)
+    ->Apply(BenchUtxoGenerator::SetWalletArguments);
+
+static void BM_FundRawTransactionUtxoIndex(
+    benchmark::State& state) {  // NOLINT
+  BenchUtxoGenerator generator(
+      BenchUtxoGenerator::GetWalletParameter(state));
+  std::vector<UtxoData> utxos = generator.GenerateUtxoData();
+  std::string tx_hex = CreateFundTxHex(utxos);
+  std::string reserve_address = BenchUtxoGenerator::GetAddress().GetAddress();
+  std::vector<UtxoData> selected_txin_utxos;
+  TransactionApi api;
+  CoinApi coin_api;
+  UtxoIndex utxo_index;
+  for (const auto& utxo : coin_api.ConvertToUtxo(utxos)) {
+    utxo_index.Add(utxo);
+  }
+
+  BenchMeasure measure(&state);
+  while (state.KeepRunning()) {
+    Amount fee;
+    measure.Start();
+    TransactionController txc = api.FundRawTransaction(
+        tx_hex, &utxo_index, Amount::CreateBySatoshiAmount(0),
+        selected_txin_utxos, reserve_address, kBenchFeeRate, &fee);
+    measure.Stop();
+    benchmark::DoNotOptimize(fee);
+  }
+  measure.Report();
+}
+BENCHMARK(BM_FundRawTransactionUtxoIndex)
+    ->Apply(BenchUtxoGenerator::SetWalletArguments);
+
+#ifndef CFD_DISABLE_ELEMENTS
+/**
+ * @brief elementsのFundRawTransactionの計測条件
+ */
+struct BenchElementsFundData {
+  std::vector<UtxoData> utxos;  //!< UTXO一覧
+  std::string tx_hex;           //!< tx hex
+  //! お釣りaddress (key: asset)
+  std::map<std::string, std::string> reserve_address;
+  ConfidentialAssetId fee_asset;  //!< fee asset
+};
+
+/**
+ * @brief elementsのFundRawTransactionの計測条件を作成する.
+ * @details range(0)をUTXO数、range(1)をasset数として扱う。
+ *   asset毎にUTXO合計額の1割を送金額としてTxOutに設定する。
+ * @param[in] state   benchmark state
+ * @return 計測条件
+ */
+static BenchElementsFundData CreateElementsFundData(
+    const benchmark::State& state) {
+  BenchWalletParameter param;
+  param.utxo_count = static_cast<size_t>(state.range(0));
+  param.asset_count = static_cast<uint32_t>(state.range(1));
+  BenchUtxoGenerator generator(param);
+
+  BenchElementsFundData data;
+  data.utxos = generator.GenerateUtxoData();
+  data.fee_asset = BenchUtxoGenerator::GetAsset(0);
+  std::map<std::string, int64_t> total_map;
+  for (const auto& utxo : data.utxos) {
+    total_map[utxo.asset.GetHex()] += utxo.amount.GetSatoshiValue();
+  }
+  Address address = BenchUtxoGenerator::GetAddress(true);
+  ConfidentialTransactionController ctxc(2, 0);
+  for (uint32_t index = 0; index < param.asset_count; ++index) {
+    ConfidentialAssetId asset = BenchUtxoGenerator::GetAsset(index);
+    ctxc.AddTxOut(
+        address, Amount::CreateBySatoshiAmount(total_map[asset.GetHex()] / 10),
+        asset);
+    data.reserve_address.emplace(asset.GetHex(), address.GetAddress());
+  }
+  data.tx_hex = ctxc.GetHex();
+  return data;
+}
+
+/**
+ * @brief UTXO数とasset数の組み合わせをベンチマーク引数に設定する.
+ * @param[in,out] bench   benchmark
+ */
+static void SetElementsArguments(benchmark::internal::Benchmark* bench) {
+  bench->ArgNames({"utxos", "assets"});
+  for (int64_t count : {100, 1000, 10000}) {
+    for (int64_t asset_count : {1, 4}) {
+      bench->Args({count, asset_count});
+    }
+  }
+}
+
+static void BM_ElementsFundRawTransaction(
+    benchmark::State& state) {  // NOLINT
+  BenchElementsFundData data = CreateElementsFundData(state);
+  std::map<std::string, Amount> map_target_value;
+  std::vector<ElementsUtxoAndOption> selected_txin_utxos;
+  ElementsTransactionApi api;
+
+  BenchMeasure measure(&state);
+  while (state.KeepRunning()) {
+    Amount fee;
+    measure.Start();
+    ConfidentialTransactionController ctxc = api.FundRawTransaction(
+        data.tx_hex, data.utxos, map_target_value, selected_txin_utxos,
+        data.reserve_address, data.fee_asset, true, kBenchElementsFeeRate,
+        &fee);
+    measure.Stop();
+    benchmark::DoNotOptimize(fee);
+  }
+  measure.Report();
+}
+BENCHMARK(BM_ElementsFundRawTransaction)->Apply(SetElementsArguments);
+
+static void BM_ElementsFundRawTransactionUtxoIndex(
+    benchmark::State& state) {  // NOLINT
+  BenchElementsFundData data = CreateElementsFundData(state);
+  std::map<std::string, Amount> map_target_value;
+  std::vector<ElementsUtxoAndOption> selected_txin_utxos;
+  ElementsTransactionApi api;
+  CoinApi coin_api;
+  UtxoIndex utxo_index;
+  for (const auto& utxo : coin_api.ConvertToUtxo(data.utxos)) {
+    utxo_index.Add(utxo);
+  }
+
+  BenchMeasure measure(&state);
+  while (state.KeepRunning()) {
+    Amount fee;
+    measure.Start();
+    ConfidentialTransactionController ctxc = api.FundRawTransaction(
+        data.tx_hex, &utxo_index, map_target_value, selected_txin_utxos,
+        data.reserve_address, data.fee_asset, true, kBenchElementsFeeRate,
+        &fee);
+    measure.Stop();
+    benchmark::DoNotOptimize(fee);
+  }
+  measure.Report();
+}
+BENCHMARK(BM_ElementsFundRawTransactionUtxoIndex)
+    ->Apply(SetElementsArguments);
+#endif  // CFD_DISABLE_ELEMENTS
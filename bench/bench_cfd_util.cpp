@@ -0,0 +1,136 @@
+// Copyright 2019 CryptoGarage
+/**
+ * @file bench_cfd_util.cpp
+ *
+ * @brief ベンチマーク計測用の共通クラスの実装ファイル
+ */
+#include "bench_cfd_util.h"  // NOLINT
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+//! メモリ確保回数
+std::atomic<uint64_t> g_alloc_count(0);
+//! メモリ確保サイズ
+std::atomic<uint64_t> g_alloc_bytes(0);
+
+/**
+ * @brief 計数付きでメモリを確保する.
+ * @param[in] size    確保サイズ
+ * @return 確保領域。失敗時はnullptr。
+ */
+void* AllocateWithCount(size_t size) {
+  g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+  g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+  return std::malloc((size == 0) ? 1 : size);
+}
+}  // namespace
+
+void* operator new(size_t size) {
+  void* ptr = AllocateWithCount(size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  void* ptr = AllocateWithCount(size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return AllocateWithCount(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return AllocateWithCount(size);
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  std::free(ptr);
+}
+
+namespace cfd {
+namespace bench {
+
+// -----------------------------------------------------------------------------
+// BenchAllocationCounter
+// -----------------------------------------------------------------------------
+uint64_t BenchAllocationCounter::GetCount() {
+  return g_alloc_count.load(std::memory_order_relaxed);
+}
+
+uint64_t BenchAllocationCounter::GetBytes() {
+  return g_alloc_bytes.load(std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------
+// BenchMeasure
+// -----------------------------------------------------------------------------
+constexpr size_t BenchMeasure::kDefaultMaxSampleCount;
+
+BenchMeasure::BenchMeasure(benchmark::State* state, size_t max_sample_count)
+    : state_(state),
+      samples_(),
+      max_sample_count_((max_sample_count == 0) ? 1 : max_sample_count),
+      sample_count_(0),
+      start_alloc_count_(0),
+      start_alloc_bytes_(0),
+      start_time_() {
+  // 計測中の領域拡張を避けるため、先に確保してから計数を開始する
+  samples_.reserve(max_sample_count_);
+  start_alloc_count_ = BenchAllocationCounter::GetCount();
+  start_alloc_bytes_ = BenchAllocationCounter::GetBytes();
+}
+
+void BenchMeasure::Start() { start_time_ = std::chrono::steady_clock::now(); }
+
+void BenchMeasure::Stop() {
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start_time_;
+  if (samples_.size() < max_sample_count_) {
+    samples_.push_back(elapsed.count());
+  } else {
+    samples_[sample_count_ % max_sample_count_] = elapsed.count();
+  }
+  ++sample_count_;
+}
+
+void BenchMeasure::Report(int64_t items_per_iteration) {
+  uint64_t alloc_count =
+      BenchAllocationCounter::GetCount() - start_alloc_count_;
+  uint64_t alloc_bytes =
+      BenchAllocationCounter::GetBytes() - start_alloc_bytes_;
+  state_->SetItemsProcessed(state_->iterations() * items_per_iteration);
+  state_->counters["allocs"] = benchmark::Counter(
+      static_cast<double>(alloc_count), benchmark::Counter::kAvgIterations);
+  state_->counters["alloc_bytes"] = benchmark::Counter(
+      static_cast<double>(alloc_bytes), benchmark::Counter::kAvgIterations);
+  if (!samples_.empty()) {
+    state_->counters["p50_us"] = GetPercentile(&samples_, 50);
+    state_->counters["p90_us"] = GetPercentile(&samples_, 90);
+    state_->counters["p99_us"] = GetPercentile(&samples_, 99);
+  }
+}
+
+double BenchMeasure::GetPercentile(
+    std::vector<double>* samples, uint32_t percent) {
+  size_t index = (samples->size() - 1) * percent / 100;
+  std::nth_element(
+      samples->begin(), samples->begin() + index, samples->end());
+  return (*samples)[index];
+}
+
+}  // namespace bench
+}  // namespace cfd
@@ -0,0 +1,104 @@
+// Copyright 2019 CryptoGarage
+/**
+ * @file bench_cfd_util.h
+ *
+ * @brief ベンチマーク計測用の共通クラス定義
+ */
+#ifndef CFD_BENCH_BENCH_CFD_UTIL_H_
+#define CFD_BENCH_BENCH_CFD_UTIL_H_
+
+#include <chrono>  // NOLINT
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace cfd {
+namespace bench {
+
+/**
+ * @brief プロセス全体のメモリ確保回数を参照するクラス
+ * @details グローバルの operator new を置き換えて計数する。
+ *   計数は bench_cfd_util.cpp をリンクした場合のみ有効。
+ */
+class BenchAllocationCounter {
+ public:
+  /**
+   * @brief メモリ確保回数を取得する.
+   * @return 確保回数
+   */
+  static uint64_t GetCount();
+  /**
+   * @brief メモリ確保サイズの累計を取得する.
+   * @return 確保サイズ(byte)
+   */
+  static uint64_t GetBytes();
+
+ private:
+  /**
+   * @brief コンストラクタ (インスタンス化禁止)
+   */
+  BenchAllocationCounter();
+};
+
+/**
+ * @brief 1反復毎の処理時間およびメモリ確保回数を計測するクラス
+ * @details benchmark::State の反復ループ内で Start() / Stop() を呼び出し、
+ *   ループ終了後に Report() で以下のカウンタを設定する。
+ *   - items_per_second: 処理件数のスループット
+ *   - p50_us / p90_us / p99_us: 1反復の処理時間のパーセンタイル(usec)
+ *   - allocs / alloc_bytes: 1反復あたりのメモリ確保回数・サイズ
+ *
+ *   処理時間は最大 max_sample_count 件まで保持し、超過分は古い順に上書きする。
+ */
+class BenchMeasure {
+ public:
+  //! 処理時間の最大保持件数(default)
+  static constexpr size_t kDefaultMaxSampleCount = 65536;
+
+  /**
+   * @brief コンストラクタ
+   * @param[in,out] state             benchmark state
+   * @param[in] max_sample_count      処理時間の最大保持件数
+   */
+  explicit BenchMeasure(
+      benchmark::State* state,
+      size_t max_sample_count = kDefaultMaxSampleCount);
+
+  /**
+   * @brief 1反復の計測を開始する.
+   */
+  void Start();
+  /**
+   * @brief 1反復の計測を終了する.
+   */
+  void Stop();
+  /**
+   * @brief 計測結果をカウンタに設定する.
+   * @param[in] items_per_iteration   1反復あたりの処理件数
+   */
+  void Report(int64_t items_per_iteration = 1);
+
+ private:
+  benchmark::State* state_;          //!< benchmark state
+  std::vector<double> samples_;      //!< 処理時間(usec)
+  size_t max_sample_count_;          //!< 処理時間の最大保持件数
+  uint64_t sample_count_;            //!< 計測回数
+  uint64_t start_alloc_count_;       //!< 計測開始時のメモリ確保回数
+  uint64_t start_alloc_bytes_;       //!< 計測開始時のメモリ確保サイズ
+  std::chrono::steady_clock::time_point start_time_;  //!< 反復開始時刻
+
+  /**
+   * @brief パーセンタイル値を取得する.
+   * @param[in,out] samples   処理時間一覧 (並び替えを行う)
+   * @param[in] percent       パーセント (0-100)
+   * @return パーセンタイル値
+   */
+  static double GetPercentile(std::vector<double>* samples, uint32_t percent);
+};
+
+}  // namespace bench
+}  // namespace cfd
+
+#endif  // CFD_BENCH_BENCH_CFD_UTIL_H_
@@ -0,0 +1,236 @@
+// Copyright 2019 CryptoGarage
+/**
+ * @file bench_cfd_utxo_generator.cpp
+ *
+ * @brief ベンチマーク用の疑似ウォレット(UTXO)生成クラスの実装ファイル
+ */
+#include "bench_cfd_utxo_generator.h"  // NOLINT
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "cfd/cfd_address.h"
+#include "cfd/cfd_fee.h"
+#include "cfd/cfdapi_coin.h"
+#include "cfdcore/cfdcore_bytedata.h"
+#include "cfdcore/cfdcore_key.h"
+#include "cfdcore/cfdcore_transaction_common.h"
+
+#ifndef CFD_DISABLE_ELEMENTS
+#include "cfd/cfd_elements_address.h"
+#endif  // CFD_DISABLE_ELEMENTS
+
+namespace cfd {
+namespace bench {
+
+using cfd::AddressFactory;
+using cfd::DescriptorTxInSizeData;
+using cfd::TxInSizeTable;
+using cfd::api::CoinApi;
+using cfd::core::Amount;
+using cfd::core::BlockHash;
+using cfd::core::ByteData;
+using cfd::core::ByteData256;
+using cfd::core::NetType;
+using cfd::core::Pubkey;
+using cfd::core::Txid;
+#ifndef CFD_DISABLE_ELEMENTS
+using cfd::ElementsAddressFactory;
+#endif  // CFD_DISABLE_ELEMENTS
+
+//! 生成に利用する公開鍵1
+static const char* const kBenchPubkey1 =
+    "0214156e4ae9168289b4d0c034da94025121d33ad8643663454885032d77640e3d";
+//! 生成に利用する公開鍵2
+static const char* const kBenchPubkey2 =
+    "022c2409fbf657ba25d97bb3dab5426d20677b774d4fc7bd3bfac27ff96ada3dd1";
+//! 生成に利用する公開鍵3
+static const char* const kBenchPubkey3 =
+    "0231c043ae680664a2c5df38cf0d8eab29f1b61ce93855040c613b2f41f7c036af";
+//! べき分布の指数 (パレート分布の形状母数)
+static constexpr double kBenchPowerLawAlpha = 1.2;
+//! dust近傍の金額を生成する割合(%)
+static constexpr uint64_t kBenchDustRate = 70;
+
+constexpr uint64_t BenchUtxoGenerator::kDustAmountMax;
+constexpr uint64_t BenchUtxoGenerator::kDustAmountMin;
+
+BenchUtxoGenerator::BenchUtxoGenerator(const BenchWalletParameter& param)
+    : param_(param), random_(param.seed) {
+  if (param_.max_amount < param_.min_amount) {
+    param_.max_amount = param_.min_amount;
+  }
+  if ((param_.p2wpkh_weight + param_.p2pkh_weight +
+       param_.p2sh_p2wpkh_weight + param_.p2wsh_weight) == 0) {
+    param_.p2wpkh_weight = 1;
+  }
+}
+
+std::vector<UtxoData> BenchUtxoGenerator::GenerateUtxoData() {
+  std::vector<UtxoData> result;
+  result.reserve(param_.utxo_count);
+  std::vector<uint8_t> txid_bytes(32);
+  for (size_t index = 0; index < param_.utxo_count; ++index) {
+    for (size_t offset = 0; offset < txid_bytes.size(); offset += 8) {
+      uint64_t value = random_.GetRandom();
+      for (size_t byte = 0; byte < 8; ++byte) {
+        txid_bytes[offset + byte] = static_cast<uint8_t>(value >> (byte * 8));
+      }
+    }
+
+    UtxoData utxo;
+    utxo.block_height = 0;
+    utxo.block_hash = BlockHash();
+    utxo.txid = Txid(ByteData256(txid_bytes));
+    utxo.vout = static_cast<uint32_t>(index % 4);
+    utxo.descriptor = GetDescriptor(GenerateAddressType());
+    utxo.amount = Amount::CreateBySatoshiAmount(
+        static_cast<int64_t>(GenerateAmount()));
+    utxo.binary_data = nullptr;
+    DescriptorTxInSizeData size_data;
+    if (TxInSizeTable::GetDescriptorTxInSizeData(
+            utxo.descriptor, &size_data)) {
+      utxo.locking_script = size_data.locking_script;
+    }
+#ifndef CFD_DISABLE_ELEMENTS
+    if (param_.asset_count != 0) {
+      utxo.asset = GetAsset(
+          static_cast<uint32_t>(random_.GetRandom() % param_.asset_count));
+    }
+#endif  // CFD_DISABLE_ELEMENTS
+    result.push_back(utxo);
+  }
+  return result;
+}
+
+std::vector<Utxo> BenchUtxoGenerator::GenerateUtxos() {
+  CoinApi api;
+  return api.ConvertToUtxo(GenerateUtxoData());
+}
+
+const BenchWalletParameter& BenchUtxoGenerator::GetParameter() const {
+  return param_;
+}
+
+BenchWalletParameter BenchUtxoGenerator::GetWalletParameter(
+    const benchmark::State& state) {
+  BenchWalletParameter param;
+  param.utxo_count = static_cast<size_t>(state.range(0));
+  param.distribution = static_cast<BenchValueDistribution>(state.range(1));
+  param.p2wpkh_weight = 6;
+  param.p2pkh_weight = 1;
+  param.p2sh_p2wpkh_weight = 2;
+  param.p2wsh_weight = 1;
+  return param;
+}
+
+void BenchUtxoGenerator::SetWalletArguments(
+    benchmark::internal::Benchmark* bench) {
+  bench->ArgNames({"utxos", "distribution"});
+  for (int64_t count : {100, 1000, 10000}) {
+    for (int64_t distribution = 0; distribution < 3; ++distribution) {
+      bench->Args({count, distribution});
+    }
+  }
+}
+
+uint64_t BenchUtxoGenerator::GetTotalAmount(const std::vector<Utxo>& utxos) {
+  uint64_t total = 0;
+  for (const auto& utxo : utxos) {
+    total += utxo.amount;
+  }
+  return total;
+}
+
+std::string BenchUtxoGenerator::GetDescriptor(AddressType address_type) {
+  const std::string key1(kBenchPubkey1);
+  switch (address_type) {
+    case AddressType::kP2pkhAddress:
+      return "pkh(" + key1 + ")";
+    case AddressType::kP2shP2wpkhAddress:
+      return "sh(wpkh(" + key1 + "))";
+    case AddressType::kP2wshAddress:
+      return "wsh(multi(2," + key1 + "," + std::string(kBenchPubkey2) + "," +
+             std::string(kBenchPubkey3) + "))";
+    case AddressType::kP2wpkhAddress:
+    default:
+      return "wpkh(" + key1 + ")";
+  }
+}
+
+Address BenchUtxoGenerator::GetAddress(bool is_elements) {
+  Pubkey pubkey(kBenchPubkey2);
+#ifndef CFD_DISABLE_ELEMENTS
+  if (is_elements) {
+    return ElementsAddressFactory(NetType::kLiquidV1)
+        .CreateP2wpkhAddress(pubkey);
+  }
+#endif  // CFD_DISABLE_ELEMENTS
+  (void)is_elements;
+  return AddressFactory(NetType::kMainnet).CreateP2wpkhAddress(pubkey);
+}
+
+#ifndef CFD_DISABLE_ELEMENTS
+ConfidentialAssetId BenchUtxoGenerator::GetAsset(uint32_t index) {
+  std::vector<uint8_t> asset_bytes(32);
+  asset_bytes[0] = 0xa0;
+  asset_bytes[30] = static_cast<uint8_t>(index >> 8);
+  asset_bytes[31] = static_cast<uint8_t>(index);
+  return ConfidentialAssetId(ByteData(asset_bytes));
+}
+#endif  // CFD_DISABLE_ELEMENTS
+
+uint64_t BenchUtxoGenerator::GenerateAmount() {
+  const uint64_t min_amount = param_.min_amount;
+  const uint64_t max_amount = param_.max_amount;
+  uint64_t amount = min_amount;
+  switch (param_.distribution) {
+    case BenchValueDistribution::kPowerLaw: {
+      // パレート分布: x = min / u^(1/alpha)
+      double rate = 1.0 - GetRandomRate();  // (0, 1]
+      double value = static_cast<double>((min_amount == 0) ? 1 : min_amount) /
+                     std::pow(rate, 1.0 / kBenchPowerLawAlpha);
+      amount = (value >= static_cast<double>(max_amount))
+                   ? max_amount
+                   : static_cast<uint64_t>(value);
+      break;
+    }
+    case BenchValueDistribution::kDustHeavy:
+      if ((random_.GetRandom() % 100) < kBenchDustRate) {
+        amount = kDustAmountMin +
+                 random_.GetRandom() % (kDustAmountMax - kDustAmountMin + 1);
+        break;
+      }
+      // fall through
+    case BenchValueDistribution::kUniform:
+    default:
+      amount = min_amount + random_.GetRandom() % (max_amount - min_amount + 1);
+      break;
+  }
+  return amount;
+}
+
+AddressType BenchUtxoGenerator::GenerateAddressType() {
+  uint64_t total_weight = static_cast<uint64_t>(param_.p2wpkh_weight) +
+                          param_.p2pkh_weight + param_.p2sh_p2wpkh_weight +
+                          param_.p2wsh_weight;
+  uint64_t value = random_.GetRandom() % total_weight;
+  if (value < param_.p2wpkh_weight) return AddressType::kP2wpkhAddress;
+  value -= param_.p2wpkh_weight;
+  if (value < param_.p2pkh_weight) return AddressType::kP2pkhAddress;
+  value -= param_.p2pkh_weight;
+  if (value < param_.p2sh_p2wpkh_weight) {
+    return AddressType::kP2shP2wpkhAddress;
+  }
+  return AddressType::kP2wshAddress;
+}
+
+double BenchUtxoGenerator::GetRandomRate() {
+  // 上位53bitを利用して[0, 1)の倍精度値を生成する
+  return static_cast<double>(random_.GetRandom() >> 11) *
+         (1.0 / 9007199254740992.0);
+}
+
+}  // namespace bench
+}  // namespace cfd
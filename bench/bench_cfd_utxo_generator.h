@@ -0,0 +1,159 @@
+// Copyright 2019 CryptoGarage
+/**
+ * @file bench_cfd_utxo_generator.h
+ *
+ * @brief ベンチマーク用の疑似ウォレット(UTXO)生成クラス定義
+ */
+#ifndef CFD_BENCH_BENCH_CFD_UTXO_GENERATOR_H_
+#define CFD_BENCH_BENCH_CFD_UTXO_GENERATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "cfd/cfd_utxo.h"
+#include "cfd/cfdapi_coin.h"
+#include "cfdcore/cfdcore_address.h"
+#include "cfdcore/cfdcore_amount.h"
+
+namespace cfd {
+namespace bench {
+
+using cfd::CoinSelectionRandom;
+using cfd::Utxo;
+using cfd::api::UtxoData;
+using cfd::core::Address;
+using cfd::core::AddressType;
+#ifndef CFD_DISABLE_ELEMENTS
+using cfd::core::ConfidentialAssetId;
+#endif  // CFD_DISABLE_ELEMENTS
+
+/**
+ * @brief UTXO金額の分布
+ */
+enum class BenchValueDistribution {
+  kUniform = 0,  //!< 一様分布
+  kPowerLaw,     //!< べき分布 (少額が多く、高額が少ない)
+  kDustHeavy,    //!< dust近傍の少額UTXOが大半を占める分布
+};
+
+/**
+ * @brief 疑似ウォレットの生成条件
+ * @details address種別は重みの比率で割り当てる。
+ */
+struct BenchWalletParameter {
+  size_t utxo_count = 1000;  //!< UTXO数
+  //! 金額の分布
+  BenchValueDistribution distribution = BenchValueDistribution::kUniform;
+  uint64_t min_amount = 1000;       //!< 最小金額(satoshi)
+  uint64_t max_amount = 100000000;  //!< 最大金額(satoshi)
+  uint32_t p2wpkh_weight = 1;       //!< p2wpkhの重み
+  uint32_t p2pkh_weight = 0;        //!< p2pkhの重み
+  uint32_t p2sh_p2wpkh_weight = 0;  //!< p2sh-p2wpkhの重み
+  uint32_t p2wsh_weight = 0;        //!< p2wsh(2-of-3 multisig)の重み
+  uint32_t asset_count = 0;  //!< asset数 (0はbitcoin)
+  uint64_t seed = 1;         //!< 乱数seed
+};
+
+/**
+ * @brief ベンチマーク用の疑似ウォレットを生成するクラス
+ * @details 同一の生成条件からは同一のUTXO一覧を生成する。
+ */
+class BenchUtxoGenerator {
+ public:
+  //! dust近傍として扱う金額の上限
+  static constexpr uint64_t kDustAmountMax = 2000;
+  //! dust近傍として扱う金額の下限
+  static constexpr uint64_t kDustAmountMin = 546;
+
+  /**
+   * @brief コンストラクタ
+   * @param[in] param   生成条件
+   */
+  explicit BenchUtxoGenerator(const BenchWalletParameter& param);
+
+  /**
+   * @brief API向けのUTXO一覧を生成する.
+   * @return UTXO一覧
+   */
+  std::vector<UtxoData> GenerateUtxoData();
+  /**
+   * @brief CoinSelection向けのUTXO一覧を生成する.
+   * @return UTXO一覧
+   */
+  std::vector<Utxo> GenerateUtxos();
+
+  /**
+   * @brief 生成条件を取得する.
+   * @return 生成条件
+   */
+  const BenchWalletParameter& GetParameter() const;
+
+  /**
+   * @brief ベンチマーク引数から生成条件を作成する.
+   * @details range(0)をUTXO数、range(1)を金額の分布として扱う。
+   *   address種別はp2wpkh中心の混在とする。
+   * @param[in] state   benchmark state
+   * @return 生成条件
+   */
+  static BenchWalletParameter GetWalletParameter(
+      const benchmark::State& state);
+  /**
+   * @brief UTXO数と金額分布の組み合わせをベンチマーク引数に設定する.
+   * @param[in,out] bench   benchmark
+   */
+  static void SetWalletArguments(benchmark::internal::Benchmark* bench);
+  /**
+   * @brief UTXO一覧の合計金額を取得する.
+   * @param[in] utxos   UTXO一覧
+   * @return 合計金額(satoshi)
+   */
+  static uint64_t GetTotalAmount(const std::vector<Utxo>& utxos);
+  /**
+   * @brief address種別に応じたoutput descriptorを取得する.
+   * @param[in] address_type    address種別
+   * @return output descriptor
+   */
+  static std::string GetDescriptor(AddressType address_type);
+  /**
+   * @brief 送金先・お釣り用のaddressを取得する.
+   * @param[in] is_elements   elements用のaddressを取得するかどうか
+   * @return address
+   */
+  static Address GetAddress(bool is_elements = false);
+#ifndef CFD_DISABLE_ELEMENTS
+  /**
+   * @brief 生成に利用するassetを取得する.
+   * @param[in] index   asset index
+   * @return asset
+   */
+  static ConfidentialAssetId GetAsset(uint32_t index);
+#endif  // CFD_DISABLE_ELEMENTS
+
+ private:
+  BenchWalletParameter param_;  //!< 生成条件
+  CoinSelectionRandom random_;  //!< 乱数生成器
+
+  /**
+   * @brief 分布に従って金額を生成する.
+   * @return 金額(satoshi)
+   */
+  uint64_t GenerateAmount();
+  /**
+   * @brief 重みに従ってaddress種別を選択する.
+   * @return address種別
+   */
+  AddressType GenerateAddressType();
+  /**
+   * @brief [0, 1)の乱数を取得する.
+   * @return 乱数
+   */
+  double GetRandomRate();
+};
+
+}  // namespace bench
+}  // namespace cfd
+
+#endif  // CFD_BENCH_BENCH_CFD_UTXO_GENERATOR_H_
@@ -12,11 +12,18 @@
 
 #include "cfd/cfd_common.h"
 #include "cfd/cfd_utxo.h"
+#include "cfdcore/cfdcore_address.h"
 #include "cfdcore/cfdcore_amount.h"
 
 namespace cfd {
 
+using cfd::core::AddressType;
 using cfd::core::Amount;
+using cfd::core::Script;
+using cfd::core::TxOutReference;
+#ifndef CFD_DISABLE_ELEMENTS
+using cfd::core::ConfidentialTxOutReference;
+#endif  // CFD_DISABLE_ELEMENTS
 
 /**
  * @brief Fee計算を行うクラス
@@ -77,10 +84,307 @@ class CFD_EXPORT FeeCalculator {
    */
   Amount GetFee(const Utxo& utxo) const;
 
+  /**
+   * @brief 複数のsizeのFeeを一括で計算する.
+   * @details GetFee(size) と同じ計算を連続した配列に対して行う。
+   * @param[in] sizes   size一覧
+   * @param[in] count   件数
+   * @param[out] fees   fee一覧 (count件の領域)
+   */
+  void GetFees(const uint32_t* sizes, size_t count, uint64_t* fees) const;
+
+  /**
+   * @brief UTXOをTxInとした場合のvsizeを取得する.
+   * @param[in] utxo    unused transaction output
+   * @return vsize
+   */
+  static uint32_t GetTxInVsize(const Utxo& utxo);
+  /**
+   * @brief UTXOをTxInとした場合のweightを取得する.
+   * @param[in] utxo    unused transaction output
+   * @return weight
+   */
+  static uint32_t GetTxInWeight(const Utxo& utxo);
+
  private:
   uint32_t baserate_;  //!< ベースレート
 };
 
+/**
+ * @brief Output Descriptorから算出したTxIn推定サイズ情報
+ */
+struct DescriptorTxInSizeData {
+  AddressType address_type;        //!< address type
+  Script locking_script;           //!< locking script (引数なしの場合のみ)
+  uint32_t unlocking_script_size;  //!< unlocking script size
+  uint32_t witness_size;           //!< witness stack size
+};
+
+/**
+ * @brief アドレス種別ごとのTxIn推定サイズ参照テーブル
+ * @details redeem script未指定時のTxIn推定サイズを、初回参照時に種別ごとに
+ *   一度だけ算出して保持する。以降はテーブル参照のみで取得できる。
+ *   pegin等、種別以外に依存するサイズはテーブル化の対象外とする。
+ */
+class CFD_EXPORT TxInSizeTable {
+ public:
+  /**
+   * @brief p2sh-p2wpkhのunlocking scriptサイズ
+   * @details redeem script(22byte)とそのpush opcodeを含むサイズ。
+   */
+  static constexpr const uint32_t kP2shP2wpkhUnlockingScriptSize = 1 + 22;
+  /**
+   * @brief p2sh-p2wshのunlocking scriptサイズ
+   * @details redeem script(34byte)とそのpush opcodeを含むサイズ。
+   */
+  static constexpr const uint32_t kP2shP2wshUnlockingScriptSize = 1 + 34;
+
+  /**
+   * @brief TxInの推定サイズを取得する.
+   * @details TxIn::EstimateTxInSize(addr_type, Script()) と同値を返却する。
+   * @param[in] addr_type       address type
+   * @param[out] witness_size   witness area size
+   * @return txin size (witness領域を含む)
+   */
+  static uint32_t GetTxInSize(
+      AddressType addr_type, uint32_t* witness_size = nullptr);
+#ifndef CFD_DISABLE_ELEMENTS
+  /**
+   * @brief Confidential TxInの推定サイズを取得する.
+   * @details ConfidentialTxIn::EstimateTxInSize をpegin無し・redeem script
+   *   無しで呼び出した場合と同値を返却する。
+   * @param[in] addr_type           address type
+   * @param[in] is_issuance         issuance有無
+   * @param[in] is_blind_issuance   blind issuance有無
+   * @param[out] witness_size       witness area size
+   * @return txin size (witness領域を含む)
+   */
+  static uint32_t GetConfidentialTxInSize(
+      AddressType addr_type, bool is_issuance, bool is_blind_issuance,
+      uint32_t* witness_size = nullptr);
+#endif  // CFD_DISABLE_ELEMENTS
+
+  /**
+   * @brief Output DescriptorからTxIn推定サイズ情報を取得する.
+   * @details multisig(m-of-n)の署名数を含めてサイズを算出する。
+   *   解析結果はdescriptor文字列単位でキャッシュし、再解析を行わない。
+   * @param[in] descriptor    output descriptor
+   * @param[out] data         txin size data
+   * @retval true   取得成功
+   * @retval false  解析不可、もしくはサイズ算出対象外のdescriptor
+   */
+  static bool GetDescriptorTxInSizeData(
+      const std::string& descriptor, DescriptorTxInSizeData* data);
+  /**
+   * @brief Output DescriptorからTxInの推定サイズを取得する.
+   * @param[in] descriptor      output descriptor
+   * @param[out] size           txin size (witness領域を含む)
+   * @param[out] witness_size   witness area size
+   * @retval true   取得成功
+   * @retval false  解析不可、もしくはサイズ算出対象外のdescriptor
+   */
+  static bool GetDescriptorTxInSize(
+      const std::string& descriptor, uint32_t* size,
+      uint32_t* witness_size = nullptr);
+#ifndef CFD_DISABLE_ELEMENTS
+  /**
+   * @brief Output DescriptorからConfidential TxInの推定サイズを取得する.
+   * @param[in] descriptor          output descriptor
+   * @param[in] is_issuance         issuance有無
+   * @param[in] is_blind_issuance   blind issuance有無
+   * @param[out] size               txin size (witness領域を含む)
+   * @param[out] witness_size       witness area size
+   * @retval true   取得成功
+   * @retval false  解析不可、もしくはサイズ算出対象外のdescriptor
+   */
+  static bool GetConfidentialDescriptorTxInSize(
+      const std::string& descriptor, bool is_issuance, bool is_blind_issuance,
+      uint32_t* size, uint32_t* witness_size = nullptr);
+#endif  // CFD_DISABLE_ELEMENTS
+  /**
+   * @brief Output Descriptorの解析キャッシュを破棄する.
+   */
+  static void ClearDescriptorCache();
+
+ private:
+  /**
+   * @brief constructor. (static class)
+   */
+  TxInSizeTable();
+};
+
+/**
+ * @brief Transactionサイズの差分更新モデル
+ * @details TxIn/TxOutを1件追加・削除するごとにサイズ差分(件数のvarint含む)
+ *   のみを反映する。Transactionの再シリアライズを行わずにvsizeを取得できる。
+ *   サイズはwitness領域を含む全体サイズで扱う。
+ *   bitcoinではwitnessを持つTxInが存在する間、segwit marker/flag(2byte)と
+ *   witnessを持たないTxInの空witness(1byte)をwitness領域に加算する。
+ *   elementsではflagは基本領域に含まれ、TxIn/TxOutのwitness領域は
+ *   各推定サイズに含まれるため加算しない。
+ */
+class CFD_EXPORT TxSizeModel {
+ public:
+  /**
+   * @brief constructor.
+   * @details 空のTransaction(version/locktime/件数のみ)として初期化する。
+   * @param[in] is_elements   elements transactionとして扱うかどうか
+   */
+  explicit TxSizeModel(bool is_elements = false);
+
+  /**
+   * @brief constructor.
+   * @details bitcoinでwitness_sizeを指定した場合、segwit marker/flag及び
+   *   TxInの空witnessを含むサイズとして扱う。
+   * @param[in] size          transaction size (witness領域を含む)
+   * @param[in] witness_size  witness area size
+   * @param[in] txin_count    txin count
+   * @param[in] txout_count   txout count
+   * @param[in] is_elements   elements transactionとして扱うかどうか
+   */
+  TxSizeModel(
+      uint32_t size, uint32_t witness_size, uint32_t txin_count,
+      uint32_t txout_count, bool is_elements = false);
+
+  /**
+   * @brief TxInを追加する.
+   * @param[in] size          txin size (witness領域を含む)
+   * @param[in] witness_size  txin witness size
+   */
+  void AddTxIn(uint32_t size, uint32_t witness_size = 0);
+  /**
+   * @brief UTXOのTxInを追加する.
+   * @details UTXOの推定サイズ(unlocking script/witnessの最大値)を使用する。
+   * @param[in] utxo  utxo
+   */
+  void AddTxIn(const Utxo& utxo);
+  /**
+   * @brief TxInを削除する.
+   * @param[in] size          txin size (witness領域を含む)
+   * @param[in] witness_size  txin witness size
+   */
+  void RemoveTxIn(uint32_t size, uint32_t witness_size = 0);
+  /**
+   * @brief UTXOのTxInを削除する.
+   * @param[in] utxo  utxo
+   */
+  void RemoveTxIn(const Utxo& utxo);
+#ifndef CFD_DISABLE_ELEMENTS
+  /**
+   * @brief UTXOのConfidential TxInを追加する.
+   * @details UTXOの推定サイズ(elementsのtxin形式)にissuanceの推定サイズを
+   *   加算する。
+   * @param[in] utxo                utxo
+   * @param[in] is_issuance         issuance有無
+   * @param[in] is_blind_issuance   blind issuance有無
+   */
+  void AddTxIn(const Utxo& utxo, bool is_issuance, bool is_blind_issuance);
+  /**
+   * @brief UTXOのConfidential TxInを削除する.
+   * @param[in] utxo                utxo
+   * @param[in] is_issuance         issuance有無
+   * @param[in] is_blind_issuance   blind issuance有無
+   */
+  void RemoveTxIn(const Utxo& utxo, bool is_issuance, bool is_blind_issuance);
+#endif  // CFD_DISABLE_ELEMENTS
+
+  /**
+   * @brief TxOutを追加する.
+   * @param[in] size          txout size (witness領域を含む)
+   * @param[in] witness_size  txout witness size
+   */
+  void AddTxOut(uint32_t size, uint32_t witness_size = 0);
+  /**
+   * @brief TxOutを追加する.
+   * @param[in] txout   txout
+   */
+  void AddTxOut(const TxOutReference& txout);
+  /**
+   * @brief TxOutを削除する.
+   * @param[in] size          txout size (witness領域を含む)
+   * @param[in] witness_size  txout witness size
+   */
+  void RemoveTxOut(uint32_t size, uint32_t witness_size = 0);
+  /**
+   * @brief TxOutを削除する.
+   * @param[in] txout   txout
+   */
+  void RemoveTxOut(const TxOutReference& txout);
+#ifndef CFD_DISABLE_ELEMENTS
+  /**
+   * @brief Confidential TxOutを追加する.
+   * @details blind時はcommitment及びrangeproof/surjectionproofの推定サイズを
+   *   含める。
+   * @param[in] txout       txout
+   * @param[in] is_blinded  blind想定でサイズを算出するかどうか
+   */
+  void AddTxOut(const ConfidentialTxOutReference& txout, bool is_blinded);
+  /**
+   * @brief Confidential TxOutを削除する.
+   * @param[in] txout       txout
+   * @param[in] is_blinded  blind想定でサイズを算出するかどうか
+   */
+  void RemoveTxOut(const ConfidentialTxOutReference& txout, bool is_blinded);
+#endif  // CFD_DISABLE_ELEMENTS
+
+  /**
+   * @brief Transactionサイズを取得する.
+   * @return transaction size (witness領域を含む)
+   */
+  uint32_t GetSize() const;
+  /**
+   * @brief witness領域のサイズを取得する.
+   * @return witness area size
+   */
+  uint32_t GetWitnessSize() const;
+  /**
+   * @brief vsizeを取得する.
+   * @return transaction virtual size
+   */
+  uint32_t GetVsize() const;
+  /**
+   * @brief TxIn件数を取得する.
+   * @return txin count
+   */
+  uint32_t GetTxInCount() const;
+  /**
+   * @brief TxOut件数を取得する.
+   * @return txout count
+   */
+  uint32_t GetTxOutCount() const;
+
+ private:
+  uint32_t size_;          //!< witness領域を含むサイズ
+  uint32_t witness_size_;  //!< witness領域のサイズ
+  uint32_t txin_count_;    //!< txin件数
+  uint32_t txout_count_;   //!< txout件数
+  uint32_t witness_txin_count_;  //!< witnessを持つtxin件数
+  bool is_elements_;             //!< elements transactionかどうか
+  bool is_segwit_base_;  //!< 初期サイズがsegwit marker/flagを含むかどうか
+
+  /**
+   * @brief サイズ差分を反映する.
+   * @param[in] size          size (witness領域を含む)
+   * @param[in] witness_size  witness size
+   * @param[in] is_add        追加時はtrue、削除時はfalse
+   * @param[in,out] count     対象の件数
+   */
+  void UpdateSize(
+      uint32_t size, uint32_t witness_size, bool is_add, uint32_t* count);
+  /**
+   * @brief segwit marker/flag及び空witnessのサイズ差分を反映する.
+   * @param[in] has_witness   追加・削除したTxInがwitnessを持つかどうか
+   * @param[in] is_add        追加時はtrue、削除時はfalse
+   */
+  void UpdateSegwitSize(bool has_witness, bool is_add);
+  /**
+   * @brief segwit形式でシリアライズされるかどうか.
+   * @retval true   segwit形式
+   * @retval false  非segwit形式
+   */
+  bool IsSegwit() const;
+};
+
 }  // namespace cfd
 
 #endif  // CFD_INCLUDE_CFD_CFD_FEE_H_
@@ -7,10 +7,22 @@
 #ifndef CFD_INCLUDE_CFD_CFD_UTXO_H_
 #define CFD_INCLUDE_CFD_CFD_UTXO_H_
 
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
 #include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>  // NOLINT
 #include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "cfd/cfd_common.h"
@@ -74,12 +86,760 @@ struct Utxo {
   uint64_t long_term_fee;    //!< 長期間後のfee
 };
 
+/**
+ * @brief CoinSelectionの探索で参照する値のみを配列で保持するUTXOプール。
+ * @details 探索処理では Utxo のうち effective_value / amount / fee /
+ *   long_term_fee のみを参照するため、これらを個別の配列として保持する。
+ *   各配列は同じindexで同一のUTXOを示し、元のUtxoへの参照も保持する。
+ */
+class CFD_EXPORT UtxoPool {
+ public:
+  /**
+   * @brief コンストラクタ
+   */
+  UtxoPool();
+
+  /**
+   * @brief 領域を事前に確保する.
+   * @param[in] size    確保するUTXO数
+   */
+  void Reserve(size_t size);
+  /**
+   * @brief 保持しているUTXOをすべて削除する.
+   */
+  void Clear();
+  /**
+   * @brief UTXOを追加する.
+   * @param[in] utxo              元のUTXO
+   * @param[in] effective_value   amountからfeeを除外した有効額
+   * @param[in] fee               fee
+   * @param[in] long_term_fee     長期間後のfee
+   */
+  void Add(
+      const Utxo* utxo, uint64_t effective_value, uint64_t fee,
+      uint64_t long_term_fee);
+  /**
+   * @brief amountを指定してUTXOを追加する.
+   * @details 複数UTXOをまとめた候補など、amountが元のUTXOと異なる場合に利用する。
+   * @param[in] utxo              代表となるUTXO
+   * @param[in] amount            amount
+   * @param[in] effective_value   amountからfeeを除外した有効額
+   * @param[in] fee               fee
+   * @param[in] long_term_fee     長期間後のfee
+   */
+  void Add(
+      const Utxo* utxo, uint64_t amount, uint64_t effective_value,
+      uint64_t fee, uint64_t long_term_fee);
+  /**
+   * @brief amountとTxInのweight・件数を指定してUTXOを追加する.
+   * @details 複数UTXOをまとめた候補など、TxInが複数となる場合に利用する。
+   * @param[in] utxo              代表となるUTXO
+   * @param[in] amount            amount
+   * @param[in] effective_value   amountからfeeを除外した有効額
+   * @param[in] fee               fee
+   * @param[in] long_term_fee     長期間後のfee
+   * @param[in] weight            TxInのweight
+   * @param[in] input_count       TxIn数
+   */
+  void Add(
+      const Utxo* utxo, uint64_t amount, uint64_t effective_value,
+      uint64_t fee, uint64_t long_term_fee, uint64_t weight,
+      uint32_t input_count);
+
+  /**
+   * @brief 保持しているUTXO数を取得する.
+   * @return UTXO数
+   */
+  size_t GetSize() const;
+  /**
+   * @brief UTXOを保持していないかどうかを取得する.
+   * @retval true   空
+   * @retval false  UTXOあり
+   */
+  bool IsEmpty() const;
+  /**
+   * @brief 有効額の一覧を取得する.
+   * @return effective value list
+   */
+  const std::vector<uint64_t>& GetEffectiveValues() const;
+  /**
+   * @brief amountの一覧を取得する.
+   * @return amount list
+   */
+  const std::vector<uint64_t>& GetAmounts() const;
+  /**
+   * @brief feeの一覧を取得する.
+   * @return fee list
+   */
+  const std::vector<uint64_t>& GetFees() const;
+  /**
+   * @brief 長期間後のfeeの一覧を取得する.
+   * @return long term fee list
+   */
+  const std::vector<uint64_t>& GetLongTermFees() const;
+  /**
+   * @brief TxInのweightの一覧を取得する.
+   * @return weight list
+   */
+  const std::vector<uint64_t>& GetWeights() const;
+  /**
+   * @brief TxIn数の一覧を取得する.
+   * @details 複数UTXOをまとめた候補以外は1となる。
+   * @return input count list
+   */
+  const std::vector<uint32_t>& GetInputCounts() const;
+  /**
+   * @brief 元のUTXOを取得する.
+   * @param[in] index   index
+   * @return 元のUTXO
+   */
+  const Utxo* GetUtxo(size_t index) const;
+  /**
+   * @brief 計算結果(effective_value, fee, long_term_fee)を反映したUTXOを取得する.
+   * @param[in] index   index
+   * @return UTXO
+   */
+  Utxo CopyUtxo(size_t index) const;
+  /**
+   * @brief 有効額の降順に並べ替えたプールを取得する.
+   * @param[out] source_indexes   並べ替え後の各UTXOの並べ替え前index一覧
+   * @return 並べ替え後のUTXOプール
+   */
+  UtxoPool GetSortedByEffectiveValue(
+      std::vector<size_t>* source_indexes = nullptr) const;
+
+ private:
+  friend class UtxoIndex;
+
+  std::vector<uint64_t> effective_values_;  //!< effective value list
+  std::vector<uint64_t> amounts_;           //!< amount list
+  std::vector<uint64_t> fees_;              //!< fee list
+  std::vector<uint64_t> long_term_fees_;    //!< long term fee list
+  std::vector<uint64_t> weights_;           //!< txin weight list
+  std::vector<uint32_t> input_counts_;      //!< txin count list
+  std::vector<const Utxo*> utxos_;          //!< original utxo list
+};
+
+/**
+ * @brief UTXOのOutPoint(txid, vout)を示すキー構造体。
+ */
+struct UtxoOutPoint {
+  uint8_t txid[32];  //!< txid
+  uint32_t vout;     //!< vout
+
+  /**
+   * @brief OutPointを作成する.
+   * @param[in] txid    txid
+   * @param[in] vout    vout
+   * @return outpoint
+   */
+  static UtxoOutPoint Create(const Txid& txid, uint32_t vout);
+  /**
+   * @brief UTXOのOutPointを作成する.
+   * @param[in] utxo    UTXO
+   * @return outpoint
+   */
+  static UtxoOutPoint Create(const Utxo& utxo);
+};
+
+/**
+ * @brief UtxoOutPointのハッシュ関数オブジェクト。
+ */
+struct UtxoOutPointHash {
+  /**
+   * @brief ハッシュ値を算出する.
+   * @param[in] outpoint    outpoint
+   * @return ハッシュ値
+   */
+  size_t operator()(const UtxoOutPoint& outpoint) const;
+};
+
+/**
+ * @brief UtxoOutPointの比較関数オブジェクト。
+ */
+struct UtxoOutPointEqual {
+  /**
+   * @brief 一致判定を行う.
+   * @param[in] lhs   比較元
+   * @param[in] rhs   比較先
+   * @retval true   一致
+   * @retval false  不一致
+   */
+  bool operator()(const UtxoOutPoint& lhs, const UtxoOutPoint& rhs) const;
+};
+
+//! OutPointの集合
+using UtxoOutPointSet =
+    std::unordered_set<UtxoOutPoint, UtxoOutPointHash, UtxoOutPointEqual>;
+//! OutPointとindexの対応表
+using UtxoOutPointIndexMap = std::unordered_map<
+    UtxoOutPoint, size_t, UtxoOutPointHash, UtxoOutPointEqual>;
+
+/**
+ * @brief UTXO一覧のOutPoint索引を作成する.
+ * @details txid(Txid)とvoutを持つUTXO情報の一覧を対象とする。
+ *   同一のOutPointが複数ある場合は先頭のindexを保持する。
+ * @param[in] utxos   utxo list
+ * @return outpoint -> utxos index
+ */
+template <typename UtxoDataType>
+UtxoOutPointIndexMap CreateOutPointIndexMap(
+    const std::vector<UtxoDataType>& utxos) {
+  UtxoOutPointIndexMap positions;
+  positions.reserve(utxos.size());
+  for (size_t index = 0; index < utxos.size(); ++index) {
+    positions.emplace(
+        UtxoOutPoint::Create(utxos[index].txid, utxos[index].vout), index);
+  }
+  return positions;
+}
+
+/**
+ * @brief ウォレット単位で長期間保持するUTXOインデックス。
+ * @details 変換済みのUtxoを保持し、UTXOの追加・消費・更新を差分で反映する。
+ *   fee rate毎のfee計算結果をUtxoPoolとしてキャッシュするため、
+ *   CoinSelection毎のUtxo変換およびfee計算を省略できる。
+ *   キャッシュは追加・消費・更新時に該当UTXOのみ再計算する。
+ *   本クラスはスレッドセーフではない。
+ */
+class CFD_EXPORT UtxoIndex {
+ public:
+  /**
+   * @brief コンストラクタ
+   */
+  UtxoIndex();
+  /**
+   * @brief コピーコンストラクタ (キャッシュが内部領域を参照するため禁止)
+   */
+  UtxoIndex(const UtxoIndex&) = delete;
+  /**
+   * @brief コピー代入演算子 (キャッシュが内部領域を参照するため禁止)
+   * @return 自身
+   */
+  UtxoIndex& operator=(const UtxoIndex&) = delete;
+
+  /**
+   * @brief UTXOを追加する.
+   * @details 同一のOutPointが登録済みの場合は例外となる。
+   * @param[in] utxo    UTXO
+   */
+  void Add(const Utxo& utxo);
+  /**
+   * @brief 登録済みUTXOの内容を更新する.
+   * @details 未登録のOutPointの場合は例外となる。
+   * @param[in] utxo    UTXO
+   */
+  void Update(const Utxo& utxo);
+  /**
+   * @brief UTXOを消費済みとして削除する.
+   * @details 登録順は保持しない。
+   * @param[in] txid    txid
+   * @param[in] vout    vout
+   * @retval true   削除
+   * @retval false  未登録
+   */
+  bool Spend(const Txid& txid, uint32_t vout);
+  /**
+   * @brief 登録済みのUTXOを検索する.
+   * @param[in] txid    txid
+   * @param[in] vout    vout
+   * @return UTXO。未登録の場合はnullptr。
+   */
+  const Utxo* Find(const Txid& txid, uint32_t vout) const;
+  /**
+   * @brief 保持しているUTXOをすべて削除する.
+   */
+  void Clear();
+
+  /**
+   * @brief 保持しているUTXO数を取得する.
+   * @return UTXO数
+   */
+  size_t GetSize() const;
+  /**
+   * @brief UTXOを取得する.
+   * @param[in] index   index
+   * @return UTXO
+   */
+  const Utxo* GetUtxo(size_t index) const;
+  /**
+   * @brief fee rate毎のfee計算済みUTXOプールを取得する.
+   * @details effective_valueにはamountを、feeおよびlong_term_feeには
+   *   各fee rateでの計算値を格納する。indexは GetUtxo() と一致する。
+   *   fee rate毎のプールは最大8件までキャッシュし、上限を超える場合は
+   *   最も長く取得されていないプールを1件破棄する。
+   *   返却値は当該プールが破棄されるまで有効であり、UTXOの追加・消費・更新
+   *   時は内容が更新される。
+   * @param[in] effective_fee_baserate  effective fee rate (x1000)
+   * @param[in] long_term_fee_baserate  long term fee rate (x1000)
+   * @return UTXOプール
+   */
+  const UtxoPool& GetFeePool(
+      uint64_t effective_fee_baserate, uint64_t long_term_fee_baserate);
+
+ private:
+  //! fee rate key (effective fee rate, long term fee rate)
+  using FeeRateKey = std::pair<uint64_t, uint64_t>;
+
+  std::deque<Utxo> utxos_;  //!< utxo list
+  UtxoOutPointIndexMap positions_;  //!< outpoint -> utxos_ index
+  std::map<FeeRateKey, UtxoPool> fee_pools_;  //!< fee rate pool cache
+  //! fee rate pool last access sequence
+  std::map<FeeRateKey, uint64_t> fee_pool_access_;
+  uint64_t fee_pool_access_count_ = 0;  //!< fee rate pool access sequence
+};
+
+/**
+ * @typedef UtxoReservationState
+ * @brief UTXOの予約状態
+ */
+enum UtxoReservationState {
+  kUtxoReservationFree = 0,  //!< 未予約
+  kUtxoReservationReserved,  //!< 予約済み
+  kUtxoReservationSpent,     //!< 消費済み
+};
+
+/**
+ * @brief UtxoReservationSetの予約情報を保持する。
+ */
+struct UtxoReservation {
+  uint64_t id = 0;              //!< 予約ID (0は未予約。再利用しない)
+  std::vector<size_t> indexes;  //!< 予約したUTXOのindex一覧
+};
+
+/**
+ * @brief 複数スレッドで共有するUTXOの予約管理クラス。
+ * @details UTXO毎の予約状態をatomic変数で保持し、compare-and-swapで
+ *   予約・解放・消費を行うため、ロックを取得せずに並行して利用できる。
+ *   予約には有効期限を設定でき、期限切れの予約は未予約として扱う。
+ *   予約IDはインスタンス内で一意とし、再利用しない。
+ *   UTXO一覧はコンストラクタで確定し、以降は追加・削除できない。
+ */
+class CFD_EXPORT UtxoReservationSet {
+ public:
+  /**
+   * @brief コンストラクタ
+   * @details 同一のOutPointが含まれる場合は例外となる。
+   * @param[in] utxos   UTXO一覧
+   */
+  explicit UtxoReservationSet(const std::vector<Utxo>& utxos);
+  /**
+   * @brief コピーコンストラクタ (予約状態を共有するため禁止)
+   */
+  UtxoReservationSet(const UtxoReservationSet&) = delete;
+  /**
+   * @brief コピー代入演算子 (予約状態を共有するため禁止)
+   * @return 自身
+   */
+  UtxoReservationSet& operator=(const UtxoReservationSet&) = delete;
+
+  /**
+   * @brief 保持しているUTXO数を取得する.
+   * @return UTXO数
+   */
+  size_t GetSize() const;
+  /**
+   * @brief UTXOを取得する.
+   * @param[in] index   index
+   * @return UTXO
+   */
+  const Utxo* GetUtxo(size_t index) const;
+  /**
+   * @brief UTXOのindexを検索する.
+   * @param[in] txid    txid
+   * @param[in] vout    vout
+   * @param[out] index  index
+   * @retval true   検出
+   * @retval false  未登録
+   */
+  bool Find(const Txid& txid, uint32_t vout, size_t* index) const;
+  /**
+   * @brief UTXOの予約状態を取得する.
+   * @param[in] index   index
+   * @return 予約状態。期限切れの予約は未予約となる。
+   */
+  UtxoReservationState GetState(size_t index) const;
+  /**
+   * @brief 未予約UTXOのfee計算済みプールを取得する.
+   * @details fee計算結果はfee rate毎にキャッシュし、再取得時は再計算しない。
+   *   予約状態は取得時点の時刻で一括して判定する。
+   *   プールのUTXOは GetUtxo() の領域を参照する。
+   * @param[in] effective_fee_baserate  effective fee rate (x1000)
+   * @param[in] long_term_fee_baserate  long term fee rate (x1000)
+   * @param[out] fee_pool               UTXOプール
+   */
+  void GetFreeFeePool(
+      uint64_t effective_fee_baserate, uint64_t long_term_fee_baserate,
+      UtxoPool* fee_pool);
+
+  /**
+   * @brief UTXOを予約する.
+   * @details いずれかのUTXOが予約済み・消費済みの場合は、
+   *   予約済みとしたUTXOを元に戻して失敗とする。
+   *   重複したindexは1件として扱う。
+   * @param[in] indexes       予約するUTXOのindex一覧
+   * @param[in] timeout_msec  予約の有効期間(ミリ秒)。0は無期限。
+   * @param[out] reservation  予約情報
+   * @retval true   予約成功
+   * @retval false  予約失敗
+   */
+  bool Reserve(
+      const std::vector<size_t>& indexes, uint64_t timeout_msec,
+      UtxoReservation* reservation);
+  /**
+   * @brief 予約を解放する.
+   * @details 期限切れで他の予約に移ったUTXOは対象外とする。
+   * @param[in] reservation   予約情報
+   * @return 解放したUTXO数
+   */
+  size_t Release(const UtxoReservation& reservation);
+  /**
+   * @brief 予約したUTXOを消費済みにする.
+   * @details 全UTXOの予約が有効な場合のみ消費済みとする。
+   *   予約を失ったUTXOがある場合は、いずれのUTXOも変更しない。
+   * @param[in] reservation   予約情報
+   * @retval true   全UTXOを消費済みに変更
+   * @retval false  期限切れで予約を失ったUTXOあり (状態変更なし)
+   */
+  bool Commit(const UtxoReservation& reservation);
+  /**
+   * @brief UTXOを予約状態に関わらず消費済みにする.
+   * @param[in] txid    txid
+   * @param[in] vout    vout
+   * @retval true   変更
+   * @retval false  未登録
+   */
+  bool MarkSpent(const Txid& txid, uint32_t vout);
+
+ private:
+  std::vector<Utxo> utxos_;         //!< utxo list
+  UtxoOutPointIndexMap positions_;  //!< outpoint -> utxos_ index
+  //! reservation state list (0: free, other: reservation id or spent)
+  std::unique_ptr<std::atomic<uint64_t>[]> states_;
+  //! reservation deadline list (elapsed time from base_time_)
+  std::unique_ptr<std::atomic<uint64_t>[]> deadlines_;
+  std::atomic<uint64_t> sequence_;  //!< reservation id sequence
+  //! base time of reservation timeout
+  std::chrono::steady_clock::time_point base_time_;
+  UtxoIndex fee_index_;         //!< fee rate pool cache (same order as utxos_)
+  std::mutex fee_index_mutex_;  //!< mutex of fee_index_
+
+  /**
+   * @brief 基準時刻からの経過時間を取得する.
+   * @return 経過時間(ミリ秒)
+   */
+  uint64_t GetElapsedTime() const;
+  /**
+   * @brief 予約状態が未予約または期限切れの予約かどうかを判定する.
+   * @param[in] index         index
+   * @param[in] state         予約状態
+   * @param[in] elapsed_time  基準時刻からの経過時間(ミリ秒)
+   * @retval true   未予約または期限切れ
+   * @retval false  予約済み・消費済み、もしくは判定中に予約状態が変更された
+   */
+  bool IsReservationAvailable(
+      size_t index, uint64_t state, uint64_t elapsed_time) const;
+};
+
 /**
  * @brief UTXOのフィルタリング条件を指定する。
- *   utxoのamount上限などの指定に利用することを想定
+ * @details CoinSelectionの探索前に適用し、条件外のUTXOを候補から除外する。
+ *   確認数は tip_block_height を指定した場合のみ判定する。
+ *   block_heightが0またはtip_block_heightより大きいUTXOは未承認(確認数0)とする。
  */
 struct UtxoFilter {
-  uint32_t reserved;  //!< 予約領域
+  uint32_t reserved = 0;           //!< 予約領域
+  uint64_t tip_block_height = 0;   //!< tip block高 (0は確認数判定なし)
+  uint32_t min_confirmations = 0;  //!< 最小確認数
+  uint32_t max_confirmations = 0;  //!< 最大確認数 (0は上限なし)
+  uint64_t min_amount = 0;         //!< 最小amount
+  uint64_t max_amount = 0;         //!< 最大amount (0は上限なし)
+  UtxoOutPointSet excluded_outpoints;  //!< 除外するOutPoint一覧
+  //! 許可するaddress type一覧 (cfd::core::AddressType, 空は全許可)
+  std::vector<uint16_t> address_types;
+};
+
+/**
+ * @brief BnB探索の統計情報を保持する。
+ */
+struct BnBSearchStatistics {
+  uint64_t tries = 0;         //!< 探索回数
+  uint64_t backtracks = 0;    //!< バックトラック回数
+  int64_t best_waste = -1;    //!< 最良のwaste (未検出時は-1)
+  bool is_exhausted = false;  //!< 探索回数上限到達フラグ
+  bool is_timeout = false;    //!< 探索時間上限到達フラグ
+};
+
+/**
+ * @brief CoinSelectionで利用する疑似乱数生成クラス (xoshiro256**)
+ * @details 探索の偏りを避けるための高速な乱数であり、暗号用途には利用しない。
+ *   同一のseedからは同一の乱数列を生成する。
+ */
+class CFD_EXPORT CoinSelectionRandom {
+ public:
+  /**
+   * @brief コンストラクタ
+   * @param[in] seed    seed値
+   */
+  explicit CoinSelectionRandom(uint64_t seed);
+
+  /**
+   * @brief 64bitの乱数を取得する.
+   * @return 乱数
+   */
+  uint64_t GetRandom();
+  /**
+   * @brief 乱数による真偽値を取得する.
+   * @details 1回の乱数生成で64回分の真偽値を生成する。
+   * @return 真偽値
+   */
+  bool GetRandomBool();
+  /**
+   * @brief 乱数による真偽値を複数まとめて取得する.
+   * @details GetRandomBoolをcount回呼び出した結果を下位bitから順に格納する。
+   * @param[in] count   取得数 (最大64)
+   * @return 真偽値のbit列
+   */
+  uint64_t GetRandomBits(uint32_t count);
+
+  /**
+   * @brief seed値を生成する.
+   * @details スレッド毎の乱数生成器を利用するため、排他制御は不要。
+   * @return seed値
+   */
+  static uint64_t GenerateSeed();
+
+ private:
+  uint64_t state_[4];          //!< 内部状態
+  uint64_t bool_cache_;        //!< 真偽値用の乱数
+  uint32_t bool_cache_count_;  //!< 真偽値用の乱数の残りbit数
+};
+
+/**
+ * @brief CoinSelectionの並列実行に利用するスレッドプール
+ * @details ワーカースレッドはコンストラクタで生成し、Run呼び出し間で
+ *   再利用する。スレッド生成に失敗した場合は生成済みのスレッドのみで動作し、
+ *   1件も生成できない場合は呼び出し元スレッドで逐次実行する。
+ *   実行中のRunと並行して呼び出されたRunは、呼び出し元スレッドで逐次実行する。
+ */
+class CFD_EXPORT CoinSelectionThreadPool {
+ public:
+  /**
+   * @brief コンストラクタ
+   * @param[in] thread_count    ワーカースレッド数
+   */
+  explicit CoinSelectionThreadPool(size_t thread_count);
+  /**
+   * @brief デストラクタ
+   * @details 全ワーカースレッドの終了を待機する。
+   */
+  ~CoinSelectionThreadPool();
+  /**
+   * @brief コピーコンストラクタ (スレッドを共有するため禁止)
+   */
+  CoinSelectionThreadPool(const CoinSelectionThreadPool&) = delete;
+  /**
+   * @brief コピー代入演算子 (スレッドを共有するため禁止)
+   * @return 自身
+   */
+  CoinSelectionThreadPool& operator=(const CoinSelectionThreadPool&) = delete;
+
+  /**
+   * @brief ワーカースレッド数を取得する.
+   * @return ワーカースレッド数
+   */
+  size_t GetThreadCount() const;
+  /**
+   * @brief タスクを並列に実行する.
+   * @details 呼び出し元スレッドも実行に参加し、全タスクの完了まで待機する。
+   *   タスクが例外を送出した場合は、全タスクの完了後に
+   *   最初に捕捉した例外を再送出する。
+   * @param[in] task_count    タスク数
+   * @param[in] task          タスク (引数はタスクindex)
+   * @param[in] max_parallel  最大並列数 (呼び出し元スレッドを含む。0は無制限)
+   */
+  void Run(
+      size_t task_count, const std::function<void(size_t)>& task,
+      size_t max_parallel = 0);
+
+  /**
+   * @brief 既定のスレッドプールを取得する.
+   * @details 初回呼び出し時にハードウェアスレッド数-1のワーカーで生成する。
+   * @return スレッドプール
+   */
+  static CoinSelectionThreadPool* GetDefault();
+
+ private:
+  std::vector<std::thread> threads_;    //!< ワーカースレッド一覧
+  std::mutex run_mutex_;                //!< Run実行中の排他
+  std::mutex mutex_;                    //!< 実行状態の排他
+  std::condition_variable start_cond_;  //!< 実行開始の通知
+  std::condition_variable done_cond_;   //!< 実行完了の通知
+  const std::function<void(size_t)>* task_ = nullptr;  //!< 実行中のタスク
+  size_t task_count_ = 0;                //!< 実行中のタスク数
+  std::atomic<size_t> next_index_;       //!< 次に実行するタスクindex
+  size_t worker_slots_ = 0;              //!< 参加可能なワーカー数
+  size_t running_count_ = 0;             //!< 実行中のワーカー数
+  uint64_t generation_ = 0;              //!< Run呼び出しの世代
+  bool is_stop_ = false;                 //!< 停止フラグ
+  std::exception_ptr error_;             //!< タスクの例外
+
+  /**
+   * @brief ワーカースレッドの処理.
+   */
+  void WorkerMain();
+  /**
+   * @brief 未実行のタスクがなくなるまで実行する.
+   */
+  void RunTasks();
+};
+
+/**
+ * @typedef CoinSelectionAlgorithm
+ * @brief CoinSelectionのアルゴリズム種別
+ */
+enum CoinSelectionAlgorithm {
+  kCoinSelectionDefault = 0,       //!< BnB -> KnapsackSolver
+  kCoinSelectionKnapsack,          //!< KnapsackSolver
+  kCoinSelectionSingleRandomDraw,  //!< Single Random Draw
+  kCoinSelectionLargestFirst,      //!< 有効額の大きい順
+  kCoinSelectionSmallestFirst,     //!< 有効額の小さい順
+  kCoinSelectionLowestWaste,       //!< 全アルゴリズムでwasteが最小の結果
+};
+
+/**
+ * @typedef CoinSelectionSolver
+ * @brief 選択結果を決定したアルゴリズム種別
+ */
+enum CoinSelectionSolver {
+  kCoinSelectionSolverNone = 0,         //!< 未選択
+  kCoinSelectionSolverBnB,              //!< BnB
+  kCoinSelectionSolverKnapsack,         //!< KnapsackSolver
+  kCoinSelectionSolverSingleRandomDraw,  //!< Single Random Draw
+  kCoinSelectionSolverLargestFirst,     //!< 有効額の大きい順
+  kCoinSelectionSolverSmallestFirst,    //!< 有効額の小さい順
+  kCoinSelectionSolverStrategy,         //!< CoinSelectionStrategy
+};
+
+/**
+ * @brief CoinSelectionの選択結果の評価情報を保持する。
+ * @details 各値は有効額(amountからfeeを除外した額)を基準とする。
+ *   wasteは選択したUTXO毎の(fee - long_term_fee)の合計に、
+ *   お釣りを作成する場合はお釣りのコストを、作成しない場合は超過額を加算した値。
+ */
+struct CoinSelectionReport {
+  //! 選択結果を決定したアルゴリズム
+  CoinSelectionSolver solver = kCoinSelectionSolverNone;
+  int64_t waste = 0;            //!< waste
+  uint32_t input_count = 0;     //!< 選択したUTXO数
+  uint64_t target_value = 0;    //!< 収集額 (TxIn以外のfeeを含む有効額)
+  uint64_t selected_value = 0;  //!< 選択したUTXOの有効額の合計
+  uint64_t input_fee = 0;       //!< 選択したUTXOのfeeの合計
+  uint64_t cost_of_change = 0;  //!< お釣り出力のコスト
+  bool has_change = false;      //!< お釣りを作成するかどうか
+  uint64_t change_value = 0;  //!< お釣り額 (お釣り出力のfee控除後)
+  BnBSearchStatistics bnb_statistics;  //!< BnB探索の統計情報
+};
+
+/**
+ * @brief fee rate毎のCoinSelection結果を保持する。
+ */
+struct CoinSelectionFeeRateResult {
+  double fee_rate = 0;          //!< fee rate
+  bool is_success = false;      //!< 選択成功フラグ
+  std::vector<size_t> indexes;  //!< 選択したUTXOのutxos上のindex一覧
+  Amount select_value;          //!< 合計収集額
+  Amount utxo_fee;              //!< utxo分のfee金額
+  Amount tx_fee;                //!< TxIn以外のfee
+  CoinSelectionReport report;   //!< 選択結果の評価情報
+};
+
+/**
+ * @brief CoinSelectionStrategyに渡す選択条件
+ */
+struct CoinSelectionParameter {
+  uint64_t target_value;     //!< 収集額 (TxIn以外のfeeを含む有効額)
+  uint64_t cost_of_change;   //!< お釣り出力のコスト
+  uint64_t min_change;       //!< お釣りを作成する場合の最小額
+  uint32_t max_input_count;  //!< TxIn数の上限 (0は無制限)
+  uint64_t max_weight;       //!< TxIn weight合計の上限 (0は無制限)
+};
+
+/**
+ * @brief CoinSelectionのアルゴリズムを実装する基底クラス
+ * @details utxo_poolの有効額を対象に収集額以上となるUTXOを選択する。
+ *   複数スレッドから同時に呼び出される可能性があるため、状態を持たないこと。
+ */
+class CFD_EXPORT CoinSelectionStrategy {
+ public:
+  /**
+   * @brief デストラクタ.
+   */
+  virtual ~CoinSelectionStrategy() {
+    // do nothing
+  }
+
+  /**
+   * @brief UTXOを選択する.
+   * @param[in] parameter     選択条件
+   * @param[in] utxo_pool     検索対象UTXOプール
+   * @param[in,out] random    乱数生成器
+   * @return 選択したUTXOのutxo_pool上のindex一覧。空の場合は未検出。
+   */
+  virtual std::vector<size_t> Select(
+      const CoinSelectionParameter& parameter, const UtxoPool& utxo_pool,
+      CoinSelectionRandom* random) const = 0;
+};
+
+/**
+ * @brief ランダムな順序でUTXOを選択するクラス (Single Random Draw)
+ */
+class CFD_EXPORT SingleRandomDrawStrategy : public CoinSelectionStrategy {
+ public:
+  /**
+   * @brief UTXOを選択する.
+   * @param[in] parameter     選択条件
+   * @param[in] utxo_pool     検索対象UTXOプール
+   * @param[in,out] random    乱数生成器
+   * @return 選択したUTXOのutxo_pool上のindex一覧。空の場合は未検出。
+   */
+  std::vector<size_t> Select(
+      const CoinSelectionParameter& parameter, const UtxoPool& utxo_pool,
+      CoinSelectionRandom* random) const override;
+};
+
+/**
+ * @brief 有効額の大きい順にUTXOを選択するクラス
+ */
+class CFD_EXPORT LargestFirstStrategy : public CoinSelectionStrategy {
+ public:
+  /**
+   * @brief UTXOを選択する.
+   * @param[in] parameter     選択条件
+   * @param[in] utxo_pool     検索対象UTXOプール
+   * @param[in,out] random    乱数生成器 (未使用)
+   * @return 選択したUTXOのutxo_pool上のindex一覧。空の場合は未検出。
+   */
+  std::vector<size_t> Select(
+      const CoinSelectionParameter& parameter, const UtxoPool& utxo_pool,
+      CoinSelectionRandom* random) const override;
+};
+
+/**
+ * @brief 有効額の小さい順にUTXOを選択するクラス
+ */
+class CFD_EXPORT SmallestFirstStrategy : public CoinSelectionStrategy {
+ public:
+  /**
+   * @brief UTXOを選択する.
+   * @param[in] parameter     選択条件
+   * @param[in] utxo_pool     検索対象UTXOプール
+   * @param[in,out] random    乱数生成器 (未使用)
+   * @return 選択したUTXOのutxo_pool上のindex一覧。空の場合は未検出。
+   */
+  std::vector<size_t> Select(
+      const CoinSelectionParameter& parameter, const UtxoPool& utxo_pool,
+      CoinSelectionRandom* random) const override;
 };
 
 /**
@@ -98,6 +858,12 @@ class CFD_EXPORT CoinSelectionOption {
    * @retval false BnB未使用
    */
   bool IsUseBnB() const;
+  /**
+   * @brief OutputGroup使用フラグを取得します.
+   * @retval true OutputGroup使用
+   * @retval false OutputGroup未使用
+   */
+  bool IsUseOutputGroup() const;
   /**
    * @brief 出力変更サイズを取得します.
    * @return 出力変更サイズ
@@ -123,6 +889,47 @@ class CFD_EXPORT CoinSelectionOption {
    * @return knapsack minimum change
    */
   int64_t GetKnapsackMinimumChange() const;
+  /**
+   * @brief 乱数のseed値が設定されているかを取得します.
+   * @retval true   seed値設定済み
+   * @retval false  seed値未設定
+   */
+  bool HasRandomSeed() const;
+  /**
+   * @brief BnBの最大探索回数を取得します.
+   * @return 最大探索回数
+   */
+  uint64_t GetBnBMaxTries() const;
+  /**
+   * @brief BnBの探索時間上限を取得します.
+   * @return 探索時間上限 (マイクロ秒, 0は無制限)
+   */
+  uint64_t GetBnBTimeLimit() const;
+  /**
+   * @brief 選択するTxIn数の上限を取得します.
+   * @return TxIn数の上限 (0は無制限)
+   */
+  uint32_t GetMaxInputCount() const;
+  /**
+   * @brief 選択するTxInのweight合計の上限を取得します.
+   * @return weightの上限 (0は無制限)
+   */
+  uint64_t GetMaxWeight() const;
+  /**
+   * @brief CoinSelectionのアルゴリズムを取得します.
+   * @return アルゴリズム種別
+   */
+  CoinSelectionAlgorithm GetAlgorithm() const;
+  /**
+   * @brief 独自のCoinSelectionアルゴリズムを取得します.
+   * @return アルゴリズム。未設定時はnullptr。
+   */
+  const CoinSelectionStrategy* GetStrategy() const;
+  /**
+   * @brief 乱数のseed値を取得します.
+   * @return seed値
+   */
+  uint64_t GetRandomSeed() const;
   /**
    * @brief DustとしてFeeに取り込まれる上限額を取得します.
    * @param[in] address     txout address
@@ -135,6 +942,14 @@ class CFD_EXPORT CoinSelectionOption {
    * @param[in] use_bnb   BnB 使用フラグ
    */
   void SetUseBnB(bool use_bnb);
+  /**
+   * @brief OutputGroup使用フラグを設定します.
+   * @details 有効時は同一locking scriptのUTXOを1つの候補にまとめて選択し、
+   *   選択した候補に含まれるUTXOをすべて返却する。
+   *   1候補にまとめるUTXO数には上限があり、超過分は別の候補とする。
+   * @param[in] use_output_group   OutputGroup使用フラグ
+   */
+  void SetUseOutputGroup(bool use_output_group);
   /**
    * @brief 出力変更サイズを設定します.
    * @param[in] size    サイズ
@@ -160,6 +975,57 @@ class CFD_EXPORT CoinSelectionOption {
    * @param[in] min_change    knapsack minimum change
    */
   void SetKnapsackMinimumChange(int64_t min_change);
+  /**
+   * @brief knapsack探索で利用する乱数のseed値を設定します.
+   * @details 同一のseed値・条件であれば同一のUTXOを選択する。
+   *   未設定の場合はスレッド毎の乱数生成器からseed値を生成する。
+   * @param[in] seed    seed値
+   */
+  void SetRandomSeed(uint64_t seed);
+  /**
+   * @brief BnBの最大探索回数を設定します.
+   * @details 上限に達した場合は、それまでの最良の結果を採用する。
+   *   結果が無い場合はKnapsackSolverで選択する。
+   * @param[in] max_tries   最大探索回数
+   */
+  void SetBnBMaxTries(uint64_t max_tries);
+  /**
+   * @brief BnBの探索時間上限を設定します.
+   * @details 上限に達した場合の動作は最大探索回数と同様。
+   * @param[in] time_limit  探索時間上限 (マイクロ秒, 0は無制限)
+   */
+  void SetBnBTimeLimit(uint64_t time_limit);
+  /**
+   * @brief 選択するTxIn数の上限を設定します.
+   * @details BnB・KnapsackSolver・各strategyの探索中に上限を超える選択を除外する。
+   *   上限内で収集額に達しない場合はエラーとなる。
+   * @param[in] max_input_count   TxIn数の上限 (0は無制限)
+   */
+  void SetMaxInputCount(uint32_t max_input_count);
+  /**
+   * @brief 選択するTxInのweight合計の上限を設定します.
+   * @details TxIn以外(TxOut等)のweightは含まない。
+   *   上限を超えた場合の動作はTxIn数の上限と同様。
+   * @param[in] max_weight    weightの上限 (0は無制限)
+   */
+  void SetMaxWeight(uint64_t max_weight);
+  /**
+   * @brief CoinSelectionのアルゴリズムを設定します.
+   * @details kCoinSelectionDefault以外では、BnBと同様に
+   *   fee考慮済みの有効額を持つUTXOプールを対象に選択する。
+   *   kCoinSelectionLowestWasteでは、BnB(利用時)・KnapsackSolver・
+   *   各strategyで選択し、wasteが最小の結果を採用する。
+   * @param[in] algorithm   アルゴリズム種別
+   */
+  void SetAlgorithm(CoinSelectionAlgorithm algorithm);
+  /**
+   * @brief 独自のCoinSelectionアルゴリズムを設定します.
+   * @details 設定時はアルゴリズム種別より優先して利用する。
+   *   ただしkCoinSelectionLowestWasteの場合は比較対象に追加する。
+   *   strategyは本オプションを利用する間、呼び出し元で保持すること。
+   * @param[in] strategy    アルゴリズム (nullptrで解除)
+   */
+  void SetStrategy(const CoinSelectionStrategy* strategy);
   /**
    * @brief DustとしてFeeに取り込まれる額のrateを設定します.
    * @param[in] baserate    fee baserate (for BTC/byte)
@@ -193,20 +1059,144 @@ class CFD_EXPORT CoinSelectionOption {
    * @brief ConfidentialTxベースでサイズ関連情報を初期化します。
    */
   void InitializeConfidentialTxSizeInfo();
+  /**
+   * @brief 複数asset指定時のasset毎のCoinSelection並列数を取得します.
+   * @return 並列数 (0,1は並列実行しない)
+   */
+  uint32_t GetAssetSelectionThreadCount() const;
+  /**
+   * @brief 複数asset指定時のasset毎のCoinSelection並列数を設定します.
+   * @details fee asset以外のassetをスレッドで並列に選択した後、
+   *   fee assetの選択を実施する。選択結果の並び順は逐次実行時と同一となる。
+   *   乱数のseed値を設定した場合、選択結果は並列数によらず同一となる。
+   * @param[in] thread_count    並列数 (0,1は並列実行しない)
+   */
+  void SetAssetSelectionThreadCount(uint32_t thread_count);
+  /**
+   * @brief 並列実行に利用するスレッドプールを取得します.
+   * @return スレッドプール。未設定時はnullptr。
+   */
+  CoinSelectionThreadPool* GetThreadPool() const;
+  /**
+   * @brief 並列実行に利用するスレッドプールを設定します.
+   * @details スレッドプールは呼び出し元で保持し、CoinSelection実行中は
+   *   破棄しないこと。未設定時は既定のスレッドプールを利用する。
+   * @param[in] thread_pool   スレッドプール
+   */
+  void SetThreadPool(CoinSelectionThreadPool* thread_pool);
 #endif  // CFD_DISABLE_ELEMENTS
 
  private:
   bool use_bnb_ = true;              //!< BnB 使用フラグ
+  bool use_output_group_ = false;    //!< OutputGroup 使用フラグ
   size_t change_output_size_ = 0;    //!< 出力変更サイズ
   size_t change_spend_size_ = 0;     //!< 受入変更サイズ
   uint64_t effective_fee_baserate_;  //!< fee baserate
   uint64_t long_term_fee_baserate_;  //!< longterm fee baserate
   int64_t knapsack_minimum_change_;  //!< knapsack min change
   int64_t dust_fee_rate_;            //!< dust fee rate
+  bool has_random_seed_ = false;     //!< 乱数seed設定フラグ
+  uint64_t random_seed_ = 0;         //!< 乱数seed
+  uint64_t bnb_max_tries_;           //!< BnB最大探索回数
+  uint64_t bnb_time_limit_ = 0;      //!< BnB探索時間上限(usec)
+  uint32_t max_input_count_ = 0;     //!< TxIn数の上限
+  uint64_t max_weight_ = 0;          //!< TxIn weight合計の上限
+  //! CoinSelection algorithm
+  CoinSelectionAlgorithm algorithm_ = kCoinSelectionDefault;
+  const CoinSelectionStrategy* strategy_ = nullptr;  //!< 独自アルゴリズム
 #ifndef CFD_DISABLE_ELEMENTS
   ConfidentialAssetId fee_asset_;  //!< feeとして利用するasset
-#endif                             // CFD_DISABLE_ELEMENTS
+  uint32_t asset_thread_count_ = 0;  //!< asset毎の選択並列数
+  //! 並列実行に利用するスレッドプール
+  CoinSelectionThreadPool* thread_pool_ = nullptr;
+#endif                               // CFD_DISABLE_ELEMENTS
+};
+
+#ifndef CFD_DISABLE_ELEMENTS
+/**
+ * @brief UTXOのasset(33byte)を示すキー構造体。
+ */
+struct UtxoAssetKey {
+  uint8_t asset[33];  //!< asset
+};
+
+/**
+ * @brief UtxoAssetKeyのハッシュ関数オブジェクト。
+ */
+struct UtxoAssetKeyHash {
+  /**
+   * @brief ハッシュ値を算出する.
+   * @param[in] key   asset key
+   * @return ハッシュ値
+   */
+  size_t operator()(const UtxoAssetKey& key) const;
+};
+
+/**
+ * @brief UtxoAssetKeyの比較関数オブジェクト。
+ */
+struct UtxoAssetKeyEqual {
+  /**
+   * @brief 一致判定を行う.
+   * @param[in] lhs   比較元
+   * @param[in] rhs   比較先
+   * @retval true   一致
+   * @retval false  不一致
+   */
+  bool operator()(const UtxoAssetKey& lhs, const UtxoAssetKey& rhs) const;
+};
+
+/**
+ * @brief asset毎にUTXOを分類したfee計算済みUTXOプールの集合。
+ * @details UTXOのassetを文字列変換せずに33byteのまま比較し、
+ *   1回の走査でasset毎のUtxoPoolへ振り分ける。
+ *   再構築時は確保済みの領域を再利用する。
+ */
+class CFD_EXPORT UtxoAssetBuckets {
+ public:
+  /**
+   * @brief コンストラクタ
+   */
+  UtxoAssetBuckets();
+
+  /**
+   * @brief fee計算済みUTXOプールをasset毎に分類する.
+   * @param[in] fee_pool    fee計算済みUTXOプール
+   */
+  void Build(const UtxoPool& fee_pool);
+  /**
+   * @brief UTXO配列のfeeを計算し、asset毎に分類する.
+   * @param[in] utxos           UTXO配列の先頭
+   * @param[in] utxo_count      UTXO数
+   * @param[in] option_params   オプション情報 (fee rateを参照)
+   */
+  void Build(
+      const Utxo* utxos, size_t utxo_count,
+      const CoinSelectionOption& option_params);
+  /**
+   * @brief 分類結果をすべて削除する.
+   */
+  void Clear();
+  /**
+   * @brief assetに該当するUTXOプールを取得する.
+   * @param[in] asset   asset
+   * @return UTXOプール。該当UTXOが無い場合はnullptr。
+   */
+  const UtxoPool* GetPool(const ConfidentialAssetId& asset) const;
+  /**
+   * @brief assetに該当するUTXOプールを取得する.
+   * @param[in] asset   asset (33byte)
+   * @return UTXOプール。該当UTXOが無い場合はnullptr。
+   */
+  const UtxoPool* GetPool(const uint8_t* asset) const;
+
+ private:
+  //! asset -> utxo pool
+  std::unordered_map<
+      UtxoAssetKey, UtxoPool, UtxoAssetKeyHash, UtxoAssetKeyEqual>
+      buckets_;
 };
+#endif  // CFD_DISABLE_ELEMENTS
 
 /**
  * @brief CoinSelection計算を行うクラス
@@ -234,14 +1224,112 @@ class CFD_EXPORT CoinSelection {
    * @param[out] select_value   UTXO収集成功時、合計収集額
    * @param[out] utxo_fee_value UTXO収集成功時、utxo分のfee金額
    * @param[out] searched_bnb   BnBで検索したかのフラグ
+   * @param[out] bnb_statistics BnB探索の統計情報
+   * @param[out] report         選択結果の評価情報
    * @return UTXO一覧。空の場合はエラー終了。
    */
   std::vector<Utxo> SelectCoins(
       const Amount& target_value, const std::vector<Utxo>& utxos,
       const UtxoFilter& filter, const CoinSelectionOption& option_params,
       const Amount& tx_fee_value, Amount* select_value,
+      Amount* utxo_fee_value = nullptr, bool* searched_bnb = nullptr,
+      BnBSearchStatistics* bnb_statistics = nullptr,
+      CoinSelectionReport* report = nullptr);
+
+  /**
+   * @brief 最小のCoinを選択する。(UTXO非コピー版)
+   * @details utxosの内容はコピー・変更せず、計算したfee等は utxo_pool に格納する。
+   *   utxo_pool は呼び出し元で保持して再利用することで領域確保を抑制できる。
+   * @param[in] target_value    収集額
+   * @param[in] utxos           検索対象UTXO配列の先頭
+   * @param[in] utxo_count      検索対象UTXO数
+   * @param[in] filter          UTXO収集フィルタ情報
+   * @param[in] option_params   オプション情報
+   * @param[in] tx_fee_value    transaction fee information
+   * @param[out] select_value   UTXO収集成功時、合計収集額
+   * @param[out] utxo_fee_value UTXO収集成功時、utxo分のfee金額
+   * @param[out] searched_bnb   BnBで検索したかのフラグ
+   * @param[out] utxo_pool      fee計算結果を格納するUTXOプール
+   * @param[out] bnb_statistics BnB探索の統計情報
+   * @param[out] report         選択結果の評価情報
+   * @return 選択したUTXOのutxos上のindex一覧。空の場合はエラー終了。
+   */
+  std::vector<size_t> SelectCoins(
+      const Amount& target_value, const Utxo* utxos, size_t utxo_count,
+      const UtxoFilter& filter, const CoinSelectionOption& option_params,
+      const Amount& tx_fee_value, Amount* select_value,
+      Amount* utxo_fee_value = nullptr, bool* searched_bnb = nullptr,
+      UtxoPool* utxo_pool = nullptr,
+      BnBSearchStatistics* bnb_statistics = nullptr,
+      CoinSelectionReport* report = nullptr);
+
+  /**
+   * @brief 最小のCoinを選択する。(UTXOインデックス版)
+   * @details utxo_index が保持するfee計算結果を利用し、
+   *   UTXOの変換およびfee計算を省略する。
+   * @param[in] target_value      収集額
+   * @param[in,out] utxo_index    検索対象UTXOインデックス
+   * @param[in] filter            UTXO収集フィルタ情報
+   * @param[in] option_params     オプション情報
+   * @param[in] tx_fee_value      transaction fee information
+   * @param[out] select_value     UTXO収集成功時、合計収集額
+   * @param[out] utxo_fee_value   UTXO収集成功時、utxo分のfee金額
+   * @param[out] searched_bnb     BnBで検索したかのフラグ
+   * @param[out] bnb_statistics   BnB探索の統計情報
+   * @param[out] report           選択結果の評価情報
+   * @return UTXO一覧。空の場合はエラー終了。
+   */
+  std::vector<Utxo> SelectCoins(
+      const Amount& target_value, UtxoIndex* utxo_index,
+      const UtxoFilter& filter, const CoinSelectionOption& option_params,
+      const Amount& tx_fee_value, Amount* select_value,
+      Amount* utxo_fee_value = nullptr, bool* searched_bnb = nullptr,
+      BnBSearchStatistics* bnb_statistics = nullptr,
+      CoinSelectionReport* report = nullptr);
+
+  /**
+   * @brief 最小のCoinを選択して予約する。(UTXO予約版)
+   * @details 未予約のUTXOから選択し、選択結果を予約する。
+   *   他のスレッドとの競合で予約に失敗した場合は、最新の予約状態で
+   *   選択をやり直す。
+   * @param[in] target_value      収集額
+   * @param[in,out] reservation_set UTXO予約管理
+   * @param[in] filter            UTXO収集フィルタ情報
+   * @param[in] option_params     オプション情報
+   * @param[in] tx_fee_value      TxIn以外のfee
+   * @param[in] timeout_msec      予約の有効期間(ミリ秒)。0は無期限。
+   * @param[out] select_value     UTXO収集成功時、合計収集額
+   * @param[out] reservation      予約情報
+   * @param[out] utxo_fee_value   UTXO収集成功時、utxo分のfee金額
+   * @param[out] searched_bnb     BnBで検索したかのフラグ
+   * @return UTXO一覧。空の場合はエラー終了。
+   */
+  std::vector<Utxo> SelectCoins(
+      const Amount& target_value, UtxoReservationSet* reservation_set,
+      const UtxoFilter& filter, const CoinSelectionOption& option_params,
+      const Amount& tx_fee_value, uint64_t timeout_msec,
+      Amount* select_value, UtxoReservation* reservation,
       Amount* utxo_fee_value = nullptr, bool* searched_bnb = nullptr);
 
+  /**
+   * @brief 複数のfee rateでCoinを選択する。
+   * @details UTXOのフィルタリング、TxInサイズおよびlong term feeの算出は
+   *   全fee rateで共有し、fee rate毎にはfeeの一括計算と選択のみを行う。
+   *   option_paramsのeffective fee rateは各fee rateで置き換える。
+   *   UTXO不足等で選択できないfee rateは is_success が false となる。
+   * @param[in] target_value    収集額
+   * @param[in] utxos           検索対象UTXO一覧
+   * @param[in] filter          UTXO収集フィルタ情報
+   * @param[in] option_params   オプション情報
+   * @param[in] tx_size         TxIn以外のtx size (vsize)
+   * @param[in] fee_rates       fee rate一覧
+   * @return fee rate毎の選択結果 (fee_ratesと同順)
+   */
+  std::vector<CoinSelectionFeeRateResult> SelectCoinsByFeeRates(
+      const Amount& target_value, const std::vector<Utxo>& utxos,
+      const UtxoFilter& filter, const CoinSelectionOption& option_params,
+      uint32_t tx_size, const std::vector<double>& fee_rates);
+
 #ifndef CFD_DISABLE_ELEMENTS
   /**
    * @brief 最小のCoinを選択する。(マルチアセット版)
@@ -259,6 +1347,7 @@ class CFD_EXPORT CoinSelection {
    * @param[out] utxo_fee_value   UTXO収集成功時、utxo分のfee金額
    * @param[out] map_searched_bnb asset毎にBnBで検索したかのフラグ
    *   map_target_valueで指定されたAsset毎に結果が格納される
+   * @param[out] map_report       asset毎の選択結果の評価情報
    * @return UTXO一覧。空の場合はエラー終了。
    */
   std::vector<Utxo> SelectCoins(
@@ -266,7 +1355,51 @@ class CFD_EXPORT CoinSelection {
       const UtxoFilter& filter, const CoinSelectionOption& option_params,
       const Amount& tx_fee_value, AmountMap* map_select_value,
       Amount* utxo_fee_value = nullptr,
-      std::map<std::string, bool>* map_searched_bnb = nullptr);
+      std::map<std::string, bool>* map_searched_bnb = nullptr,
+      std::map<std::string, CoinSelectionReport>* map_report = nullptr);
+
+  /**
+   * @brief 最小のCoinを選択する。(マルチアセット・UTXOインデックス版)
+   * @param[in] map_target_value  Asset毎の収集額map
+   * @param[in,out] utxo_index    検索対象UTXOインデックス
+   * @param[in] filter            UTXO収集フィルタ情報
+   * @param[in] option_params     オプション情報
+   * @param[in] tx_fee_value      transaction fee information
+   * @param[out] map_select_value UTXO収集成功時、Asset毎の合計収集額map
+   * @param[out] utxo_fee_value   UTXO収集成功時、utxo分のfee金額
+   * @param[out] map_searched_bnb asset毎にBnBで検索したかのフラグ
+   * @param[out] map_report       asset毎の選択結果の評価情報
+   * @return UTXO一覧。空の場合はエラー終了。
+   */
+  std::vector<Utxo> SelectCoins(
+      const AmountMap& map_target_value, UtxoIndex* utxo_index,
+      const UtxoFilter& filter, const CoinSelectionOption& option_params,
+      const Amount& tx_fee_value, AmountMap* map_select_value,
+      Amount* utxo_fee_value = nullptr,
+      std::map<std::string, bool>* map_searched_bnb = nullptr,
+      std::map<std::string, CoinSelectionReport>* map_report = nullptr);
+
+  /**
+   * @brief 最小のCoinを選択する。(マルチアセット・asset分類済み版)
+   * @details utxo_buckets は option_params と同じfee rateで構築すること。
+   * @param[in] map_target_value  Asset毎の収集額map
+   * @param[in] utxo_buckets      asset毎に分類した検索対象UTXO
+   * @param[in] filter            UTXO収集フィルタ情報
+   * @param[in] option_params     オプション情報
+   * @param[in] tx_fee_value      transaction fee information
+   * @param[out] map_select_value UTXO収集成功時、Asset毎の合計収集額map
+   * @param[out] utxo_fee_value   UTXO収集成功時、utxo分のfee金額
+   * @param[out] map_searched_bnb asset毎にBnBで検索したかのフラグ
+   * @param[out] map_report       asset毎の選択結果の評価情報
+   * @return UTXO一覧。空の場合はエラー終了。
+   */
+  std::vector<Utxo> SelectCoins(
+      const AmountMap& map_target_value, const UtxoAssetBuckets& utxo_buckets,
+      const UtxoFilter& filter, const CoinSelectionOption& option_params,
+      const Amount& tx_fee_value, AmountMap* map_select_value,
+      Amount* utxo_fee_value = nullptr,
+      std::map<std::string, bool>* map_searched_bnb = nullptr,
+      std::map<std::string, CoinSelectionReport>* map_report = nullptr);
 #endif  // CFD_DISABLE_ELEMENTS
 
   /**
@@ -330,69 +1463,172 @@ class CFD_EXPORT CoinSelection {
    *   想定していない。そのため、複数assetが混在したutxoが入力された場合
    *   返却されるutxoには複数のassetが混在する可能性がある。
    * @param[in] target_value     収集額
-   * @param[in,out] utxos        検索対象UTXO一覧
-   * @param[in] filter           UTXO収集フィルタ情報
+   * @param[in] source_fee_pool  検索対象UTXOプール
+   *   (effective_valueはamount、fee/long_term_feeはoption_paramsのrateで計算済み)
+   * @param[in] filter           UTXO収集フィルタ情報 (探索前に適用する)
    * @param[in] option_params    オプション情報
    * @param[in] tx_fee_value     transaction fee information
    * @param[in] consider_fee     feeを考慮したCoinSelectionの実施フラグ (default: true)
+   * @param[out] utxo_pool       fee計算結果を格納するUTXOプール
    * @param[out] select_value    UTXO収集成功時、合計収集額
    * @param[out] utxo_fee_value  UTXO収集成功時、utxo分のfee金額
    * @param[out] searched_bnb    BnBで検索できたかどうか
-   * @return UTXO一覧。空の場合はエラー終了。
+   * @param[out] bnb_statistics  BnB探索の統計情報
+   * @param[out] solver          選択結果を決定したアルゴリズム
+   * @return 選択したUTXOのutxo_pool上のindex一覧。空の場合はエラー終了。
    */
-  std::vector<Utxo> SelectCoinsMinConf(
-      const Amount& target_value, const std::vector<Utxo*>& utxos,
+  std::vector<size_t> SelectCoinsMinConf(
+      const Amount& target_value, const UtxoPool& source_fee_pool,
       const UtxoFilter& filter, const CoinSelectionOption& option_params,
       const Amount& tx_fee_value, const bool consider_fee,
-      Amount* select_value, Amount* utxo_fee_value = nullptr,
-      bool* searched_bnb = nullptr);
+      UtxoPool* utxo_pool, Amount* select_value,
+      Amount* utxo_fee_value = nullptr, bool* searched_bnb = nullptr,
+      BnBSearchStatistics* bnb_statistics = nullptr,
+      CoinSelectionSolver* solver = nullptr);
 
   /**
    * @brief CoinSelection(BnB)を実施する。
    * @param[in] target_value     収集額
-   * @param[in] utxos            検索対象UTXO一覧
+   * @param[in] utxo_pool        検索対象UTXOプール
    * @param[in] cost_of_change   コストの変更範囲。
    *              target_value+本値が収集上限値となる。
    * @param[in] not_input_fees   TxIn部を除いたfee額
    * @param[out] select_value    UTXO収集成功時、合計収集額
    * @param[out] utxo_fee_value  UTXO収集成功時、utxo分のfee金額
-   * @return UTXO一覧。空の場合はエラー終了。
+   * @return 選択したUTXOのutxo_pool上のindex一覧。空の場合は未検出。
    */
-  std::vector<Utxo> SelectCoinsBnB(
-      const Amount& target_value, const std::vector<Utxo*>& utxos,
+  std::vector<size_t> SelectCoinsBnB(
+      const Amount& target_value, const UtxoPool& utxo_pool,
       const Amount& cost_of_change, const Amount& not_input_fees,
       Amount* select_value, Amount* utxo_fee_value);
+  /**
+   * @brief CoinSelection(BnB)を実施する。
+   * @param[in] target_value     収集額
+   * @param[in] utxo_pool        検索対象UTXOプール
+   * @param[in] cost_of_change   コストの変更範囲。
+   *              target_value+本値が収集上限値となる。
+   * @param[in] not_input_fees   TxIn部を除いたfee額
+   * @param[in] max_tries        最大探索回数
+   * @param[in] time_limit       探索時間上限 (マイクロ秒, 0は無制限)
+   * @param[out] select_value    UTXO収集成功時、合計収集額
+   * @param[out] utxo_fee_value  UTXO収集成功時、utxo分のfee金額
+   * @param[out] statistics      探索の統計情報
+   * @param[in] max_input_count  選択するTxIn数の上限 (0は無制限)
+   * @param[in] max_weight       選択するTxInのweight合計の上限 (0は無制限)
+   * @return 選択したUTXOのutxo_pool上のindex一覧。空の場合は未検出。
+   */
+  std::vector<size_t> SelectCoinsBnB(
+      const Amount& target_value, const UtxoPool& utxo_pool,
+      const Amount& cost_of_change, const Amount& not_input_fees,
+      uint64_t max_tries, uint64_t time_limit, Amount* select_value,
+      Amount* utxo_fee_value, BnBSearchStatistics* statistics,
+      uint32_t max_input_count = 0, uint64_t max_weight = 0);
 
   /**
    * @brief CoinSelection(KnapsackSolver)を実施する。
    * @param[in] target_value     収集額
-   * @param[in] utxos            検索対象UTXO一覧
+   * @param[in] utxo_pool        検索対象UTXOプール
    * @param[in] min_change       最小の差額
    * @param[out] select_value    UTXO収集成功時、合計収集額
    * @param[out] utxo_fee_value  UTXO収集成功時、utxo分のfee金額
-   * @return UTXO一覧。空の場合はエラー終了。
+   * @return 選択したUTXOのutxo_pool上のindex一覧。
    */
-  std::vector<Utxo> KnapsackSolver(
-      const Amount& target_value, const std::vector<Utxo*>& utxos,
+  std::vector<size_t> KnapsackSolver(
+      const Amount& target_value, const UtxoPool& utxo_pool,
       uint64_t min_change, Amount* select_value, Amount* utxo_fee_value);
+  /**
+   * @brief CoinSelection(KnapsackSolver)を実施する。
+   * @param[in] target_value     収集額
+   * @param[in] utxo_pool        検索対象UTXOプール
+   * @param[in] min_change       最小の差額
+   * @param[in,out] random       乱数生成器
+   * @param[out] select_value    UTXO収集成功時、合計収集額
+   * @param[out] utxo_fee_value  UTXO収集成功時、utxo分のfee金額
+   * @param[in] max_input_count  選択するTxIn数の上限 (0は無制限)
+   * @param[in] max_weight       選択するTxInのweight合計の上限 (0は無制限)
+   * @return 選択したUTXOのutxo_pool上のindex一覧。
+   *   上限内で選択できない場合は空となる。
+   */
+  std::vector<size_t> KnapsackSolver(
+      const Amount& target_value, const UtxoPool& utxo_pool,
+      uint64_t min_change, CoinSelectionRandom* random, Amount* select_value,
+      Amount* utxo_fee_value, uint32_t max_input_count = 0,
+      uint64_t max_weight = 0);
 
  private:
-  bool use_bnb_;                       //!< BnB 利用フラグ
-  std::vector<bool> randomize_cache_;  //!< randomize cache
+  bool use_bnb_;  //!< BnB 利用フラグ
+
+  /**
+   * @brief 指定されたアルゴリズムでCoinSelectionを実施する。
+   * @param[in] target_value     収集額
+   * @param[in] fee_pool         fee計算済みのUTXOプール
+   * @param[in] option_params    オプション情報
+   * @param[in] tx_fee_value     transaction fee information
+   * @param[in] use_fee          feeを利用するかどうか
+   * @param[in] consider_fee     有効額からfeeを除外するかどうか
+   * @param[in] cost_of_change   お釣り出力のコスト
+   * @param[in] min_change       お釣りを作成する場合の最小額
+   * @param[out] utxo_pool       選択対象のUTXOプール
+   * @param[out] select_value    UTXO収集成功時、合計収集額
+   * @param[out] utxo_fee_value  UTXO収集成功時、utxo分のfee金額
+   * @param[out] searched_bnb    BnBの結果を採用したかどうか
+   * @param[out] bnb_statistics  BnB探索の統計情報
+   * @param[out] solver          選択結果を決定したアルゴリズム
+   * @return 選択したUTXOのutxo_pool上のindex一覧。
+   */
+  std::vector<size_t> SelectCoinsByStrategy(
+      const Amount& target_value, const UtxoPool& fee_pool,
+      const CoinSelectionOption& option_params, const Amount& tx_fee_value,
+      bool use_fee, bool consider_fee, const Amount& cost_of_change,
+      uint64_t min_change, UtxoPool* utxo_pool, Amount* select_value,
+      Amount* utxo_fee_value, bool* searched_bnb,
+      BnBSearchStatistics* bnb_statistics, CoinSelectionSolver* solver);
+
+  /**
+   * @brief 同一locking scriptのUTXOをまとめてCoinSelectionを実施する。
+   * @param[in] target_value     収集額
+   * @param[in] fee_pool         fee計算済みのUTXOプール
+   * @param[in] option_params    オプション情報
+   * @param[in] tx_fee_value     transaction fee information
+   * @param[in] consider_fee     有効額からfeeを除外するかどうか
+   * @param[out] utxo_pool       選択したUTXOを格納するUTXOプール
+   * @param[out] select_value    UTXO収集成功時、合計収集額
+   * @param[out] utxo_fee_value  UTXO収集成功時、utxo分のfee金額
+   * @param[out] searched_bnb    BnBの結果を採用したかどうか
+   * @param[out] bnb_statistics  BnB探索の統計情報
+   * @param[out] solver          選択結果を決定したアルゴリズム
+   * @return 選択したUTXOのutxo_pool上のindex一覧。
+   */
+  std::vector<size_t> SelectCoinsByOutputGroup(
+      const Amount& target_value, const UtxoPool& fee_pool,
+      const CoinSelectionOption& option_params, const Amount& tx_fee_value,
+      bool consider_fee, UtxoPool* utxo_pool, Amount* select_value,
+      Amount* utxo_fee_value, bool* searched_bnb,
+      BnBSearchStatistics* bnb_statistics, CoinSelectionSolver* solver);
 
   /**
    * 収集額に最も近い合計額となるUTXO一覧を決定する
-   * @param[in]  utxos          収集額より小さいUTXO一覧
+   * @details 上限を指定した場合、上限内で収集額に達しなければ
+   *   n_bestは最大値、vf_bestは全て未選択となる。
+   * @param[in]  values         収集額より小さいUTXOの有効額一覧
    * @param[in]  n_total_value  utxo一覧の合計額
    * @param[in]  n_target_value 収集額
    * @param[out] vf_best        収集対象フラグ一覧
    * @param[out] n_best         収集額に最も近い合計額
    * @param[in]  iterations     繰り返し数
+   * @param[in,out] random      乱数生成器
+   * @param[in]  weights        UTXOのweight一覧 (nullptrは上限なし)
+   * @param[in]  input_counts   UTXOのTxIn数一覧 (nullptrは上限なし)
+   * @param[in]  max_input_count  TxIn数の上限
+   * @param[in]  max_weight     weight合計の上限
    */
   void ApproximateBestSubset(
-      const std::vector<const Utxo*>& utxos, uint64_t n_total_value,
+      const std::vector<uint64_t>& values, uint64_t n_total_value,
       uint64_t n_target_value, std::vector<char>* vf_best, uint64_t* n_best,
-      int iterations);
+      int iterations, CoinSelectionRandom* random,
+      const std::vector<uint64_t>* weights = nullptr,
+      const std::vector<uint32_t>* input_counts = nullptr,
+      uint64_t max_input_count = 0, uint64_t max_weight = 0);
 };
 
 }  // namespace cfd
@@ -0,0 +1,161 @@
+// Copyright 2019 CryptoGarage
+/**
+ * @file cfd_utxo_consolidation.h
+ *
+ * @brief UTXO集約(consolidation)計画の関連クラス定義
+ */
+#ifndef CFD_INCLUDE_CFD_CFD_UTXO_CONSOLIDATION_H_
+#define CFD_INCLUDE_CFD_CFD_UTXO_CONSOLIDATION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cfd/cfd_common.h"
+#include "cfd/cfd_elements_transaction.h"
+#include "cfd/cfd_transaction.h"
+#include "cfd/cfd_utxo.h"
+#include "cfdcore/cfdcore_address.h"
+#include "cfdcore/cfdcore_amount.h"
+
+namespace cfd {
+
+using cfd::core::Address;
+using cfd::core::Amount;
+
+/**
+ * @brief 集約transaction 1件分の計画
+ */
+struct UtxoConsolidationTx {
+  std::vector<Utxo> utxos;  //!< TxInとするUTXO一覧
+  uint64_t input_amount;    //!< TxIn合計額
+  uint64_t fee;             //!< fee
+  uint64_t output_amount;   //!< 集約先TxOutの金額
+  uint32_t vsize;           //!< 推定vsize
+  uint64_t weight;          //!< 推定weight
+};
+
+/**
+ * @brief UTXO集約の計画
+ */
+struct UtxoConsolidationPlan {
+  std::vector<UtxoConsolidationTx> transactions;  //!< 集約transaction一覧
+  size_t removed_count;        //!< 集約により減少するUTXO数
+  uint64_t total_fee;          //!< fee合計
+  size_t remaining_pool_size;  //!< 集約後のUTXO数
+};
+
+/**
+ * @brief 集約transactionのTxInを選択するクラス
+ * @details weightの小さい順(同一weightでは少額順)に、TxIn数・weightの
+ *   上限までUTXOを選択する。TxInが2件未満の場合は未検出とする。
+ */
+class CFD_EXPORT UtxoConsolidationStrategy : public CoinSelectionStrategy {
+ public:
+  /**
+   * @brief UTXOを選択する.
+   * @param[in] parameter     選択条件
+   * @param[in] utxo_pool     検索対象UTXOプール
+   * @param[in,out] random    乱数生成器 (未使用)
+   * @return 選択したUTXOのutxo_pool上のindex一覧。空の場合は未検出。
+   */
+  std::vector<size_t> Select(
+      const CoinSelectionParameter& parameter, const UtxoPool& utxo_pool,
+      CoinSelectionRandom* random) const override;
+};
+
+/**
+ * @brief UTXO集約の計画・transaction作成を行うクラス
+ * @details 低いfee rateでUTXOをまとめ、UTXO数を目標値以下に減らす。
+ *   1件あたりのfeeが最小となるよう、CoinSelectionで
+ *   UtxoConsolidationStrategyを使用し、weightの小さいUTXOから順に
+ *   weight上限までTxInを詰めて集約transactionを作成する。
+ *   fee rate・TxOutサイズ・TxIn数上限・fee asset(elements)は
+ *   CoinSelectionOptionの設定値を使用する。
+ */
+class CFD_EXPORT UtxoConsolidationPlanner {
+ public:
+  /**
+   * @brief transaction weightの既定上限
+   * @see bitcoin: MAX_STANDARD_TX_WEIGHT
+   */
+  static constexpr const uint64_t kDefaultMaxTxWeight = 400000;
+
+  /**
+   * @brief コンストラクタ
+   * @param[in] option          fee rate等のオプション情報
+   * @param[in] max_tx_weight   transaction 1件あたりのweight上限
+   *     (0は既定値)
+   */
+  explicit UtxoConsolidationPlanner(
+      const CoinSelectionOption& option,
+      uint64_t max_tx_weight = kDefaultMaxTxWeight);
+
+  /**
+   * @brief UTXO集約を計画する.
+   * @details 消費するfeeを下回るUTXO、及びelementsではfee asset以外の
+   *   UTXOは集約対象外とする。対象UTXOが不足する場合や、fee及び
+   *   dust_amountを満たすTxInを選択できない場合は、可能な範囲で
+   *   集約した計画を返却する(未集約のUTXOはremaining_pool_sizeに含まれ、
+   *   目標値を超える)。
+   * @param[in] utxos             UTXO一覧
+   * @param[in] target_pool_size  集約後のUTXO数の目標値
+   * @param[in] dust_amount       集約先TxOutの最小金額
+   * @return 集約計画
+   */
+  UtxoConsolidationPlan Plan(
+      const std::vector<Utxo>& utxos, size_t target_pool_size,
+      const Amount& dust_amount = Amount()) const;
+
+  /**
+   * @brief 集約計画からtransactionを作成する.
+   * @param[in] plan      集約計画
+   * @param[in] address   集約先address
+   * @return transaction一覧 (未署名)
+   */
+  std::vector<TransactionController> CreateTransactions(
+      const UtxoConsolidationPlan& plan, const Address& address) const;
+  /**
+   * @brief UTXO集約を計画し、transactionを作成する.
+   * @param[in] utxos             UTXO一覧
+   * @param[in] target_pool_size  集約後のUTXO数の目標値
+   * @param[in] address           集約先address
+   * @param[out] plan             集約計画 (nullptr可)
+   * @return transaction一覧 (未署名)
+   */
+  std::vector<TransactionController> CreateTransactions(
+      const std::vector<Utxo>& utxos, size_t target_pool_size,
+      const Address& address, UtxoConsolidationPlan* plan = nullptr) const;
+#ifndef CFD_DISABLE_ELEMENTS
+  /**
+   * @brief 集約計画からConfidential Transactionを作成する.
+   * @details 集約先TxOut及びfee TxOutをfee assetで設定する。
+   * @param[in] plan      集約計画
+   * @param[in] address   集約先address (unblind)
+   * @return transaction一覧 (未署名)
+   */
+  std::vector<ConfidentialTransactionController>
+  CreateConfidentialTransactions(
+      const UtxoConsolidationPlan& plan, const Address& address) const;
+  /**
+   * @brief UTXO集約を計画し、Confidential Transactionを作成する.
+   * @param[in] utxos             UTXO一覧
+   * @param[in] target_pool_size  集約後のUTXO数の目標値
+   * @param[in] address           集約先address (unblind)
+   * @param[out] plan             集約計画 (nullptr可)
+   * @return transaction一覧 (未署名)
+   */
+  std::vector<ConfidentialTransactionController>
+  CreateConfidentialTransactions(
+      const std::vector<Utxo>& utxos, size_t target_pool_size,
+      const Address& address, UtxoConsolidationPlan* plan = nullptr) const;
+#endif  // CFD_DISABLE_ELEMENTS
+
+ private:
+  CoinSelectionOption option_;  //!< オプション情報
+  uint64_t max_tx_weight_;      //!< transaction weight上限
+};
+
+}  // namespace cfd
+
+#endif  // CFD_INCLUDE_CFD_CFD_UTXO_CONSOLIDATION_H_
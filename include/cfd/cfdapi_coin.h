@@ -78,6 +78,45 @@ class CFD_EXPORT CoinApi {
    * @param[out] utxo       utxo
    */
   void ConvertToUtxo(const UtxoData& utxo_data, Utxo* utxo) const;
+  /**
+   * @brief UTXOをTxInとした場合の推定サイズを取得する.
+   * @details 種別はdescriptor, address, locking scriptの順に判定する。
+   *   ConvertToUtxoで設定するサイズもこの推定値を使用する。
+   * @param[in] utxo_data       utxo data
+   * @param[out] witness_size   witness area size
+   * @return txin size (witness領域を含む)
+   */
+  uint32_t EstimateTxInSize(
+      const UtxoData& utxo_data, uint32_t* witness_size = nullptr) const;
+#ifndef CFD_DISABLE_ELEMENTS
+  /**
+   * @brief UTXOをConfidential TxInとした場合の推定サイズを取得する.
+   * @param[in] utxo_data           utxo data
+   * @param[in] is_issuance         issuance有無
+   * @param[in] is_blind_issuance   blind issuance有無
+   * @param[in] is_pegin            pegin有無
+   * @param[in] pegin_btc_tx_size   pegin対象のbitcoin txサイズ
+   * @param[in] fedpeg_script       fedpeg script
+   * @param[out] witness_size       witness area size
+   * @return txin size (witness領域を含む)
+   */
+  uint32_t EstimateConfidentialTxInSize(
+      const UtxoData& utxo_data, bool is_issuance, bool is_blind_issuance,
+      bool is_pegin, uint32_t pegin_btc_tx_size, const Script& fedpeg_script,
+      uint32_t* witness_size = nullptr) const;
+#endif  // CFD_DISABLE_ELEMENTS
+  /**
+   * @brief convert and add utxo to utxo index.
+   * @param[in] utxo_data       utxo data
+   * @param[in,out] utxo_index  utxo index
+   */
+  void AddUtxo(const UtxoData& utxo_data, UtxoIndex* utxo_index) const;
+  /**
+   * @brief convert and update utxo on utxo index.
+   * @param[in] utxo_data       utxo data
+   * @param[in,out] utxo_index  utxo index
+   */
+  void UpdateUtxo(const UtxoData& utxo_data, UtxoIndex* utxo_index) const;
 };
 
 }  // namespace api
@@ -491,6 +491,44 @@ class CFD_EXPORT ElementsTransactionApi {
       Amount* utxo_fee = nullptr, bool is_blind = true,
       uint64_t effective_fee_rate = 1000) const;
 
+  /**
+   * @brief estimate a fee amount from transaction. (using controller)
+   * @details fee出力が無い場合は、複製したtxにdummyのfee出力を追加して算出する。
+   * @param[in] txc                 transaction controller
+   * @param[in] utxos               using utxo data
+   * @param[in] fee_asset           using fee asset
+   * @param[in] tx_fee              tx fee amount (ignore utxo)
+   * @param[in] utxo_fee            utxo fee amount
+   * @param[in] is_blind            using tx blinding
+   * @param[in] effective_fee_rate  effective fee rate (minimum)
+   * @return tx fee (contains utxo)
+   */
+  Amount EstimateFee(
+      const ConfidentialTransactionController& txc,
+      const std::vector<ElementsUtxoAndOption>& utxos,
+      const ConfidentialAssetId& fee_asset, Amount* tx_fee = nullptr,
+      Amount* utxo_fee = nullptr, bool is_blind = true,
+      double effective_fee_rate = 1) const;
+
+  /**
+   * @brief estimate a fee amount from transaction. (using controller)
+   * @details fee出力が無い場合は、複製したtxにdummyのfee出力を追加して算出する。
+   * @param[in] txc                 transaction controller
+   * @param[in] utxos               using utxo data
+   * @param[in] fee_asset           using fee asset
+   * @param[in] tx_fee              tx fee amount (ignore utxo)
+   * @param[in] utxo_fee            utxo fee amount
+   * @param[in] is_blind            using tx blinding
+   * @param[in] effective_fee_rate  effective fee rate (minimum)
+   * @return tx fee (contains utxo)
+   */
+  Amount EstimateFee(
+      const ConfidentialTransactionController& txc,
+      const std::vector<ElementsUtxoAndOption>& utxos,
+      const ConfidentialAssetId& fee_asset, Amount* tx_fee = nullptr,
+      Amount* utxo_fee = nullptr, bool is_blind = true,
+      uint64_t effective_fee_rate = 1000) const;
+
   /**
    * @brief calculate fund transaction.
    * @param[in] tx_hex                   tx hex string
@@ -522,6 +560,102 @@ class CFD_EXPORT ElementsTransactionApi {
       NetType net_type = NetType::kLiquidV1,
       const std::vector<AddressFormatData>* prefix_list = nullptr) const;
 
+  /**
+   * @brief calculate fund transaction. (using utxo index)
+   * @details utxo_index に保持した変換済みUTXOとfee計算結果を利用する。
+   *   選択したUTXOのfeeは utxo_index 上のサイズ情報から算出する。
+   * @param[in] tx_hex                   tx hex string
+   * @param[in,out] utxo_index           utxo index
+   * @param[in] map_target_value         asset target value map
+   * @param[in] selected_txin_utxos      selected txin utxo
+   * @param[in] reserve_txout_address    reserved address
+   * @param[in] fee_asset                using fee asset
+   * @param[in] is_blind_estimate_fee    using tx blinding
+   * @param[in] effective_fee_rate       effective fee rate (minimum)
+   * @param[out] estimate_fee            estimate fee
+   * @param[in] filter                   utxo search filter
+   * @param[in] option_params            utxo search option
+   * @param[out] append_txout_addresses  used txout additional address
+   * @param[in] net_type                 network type
+   * @param[in] prefix_list              address prefix list
+   * @return tx controller
+   */
+  ConfidentialTransactionController FundRawTransaction(
+      const std::string& tx_hex, UtxoIndex* utxo_index,
+      const std::map<std::string, Amount>& map_target_value,
+      const std::vector<ElementsUtxoAndOption>& selected_txin_utxos,
+      const std::map<std::string, std::string>& reserve_txout_address,
+      const ConfidentialAssetId& fee_asset, bool is_blind_estimate_fee = true,
+      double effective_fee_rate = 1, Amount* estimate_fee = nullptr,
+      const UtxoFilter* filter = nullptr,
+      const CoinSelectionOption* option_params = nullptr,
+      std::vector<std::string>* append_txout_addresses = nullptr,
+      NetType net_type = NetType::kLiquidV1,
+      const std::vector<AddressFormatData>* prefix_list = nullptr) const;
+
+  /**
+   * @brief calculate fund transaction. (using controller)
+   * @details ctxc を直接更新し、hex文字列への変換を行わない。
+   * @param[in,out] ctxc                 transaction controller
+   * @param[in] utxos                    using utxo data
+   * @param[in] map_target_value         asset target value map
+   * @param[in] selected_txin_utxos      selected txin utxo
+   * @param[in] reserve_txout_address    reserved address
+   * @param[in] fee_asset                using fee asset
+   * @param[in] is_blind_estimate_fee    using tx blinding
+   * @param[in] effective_fee_rate       effective fee rate (minimum)
+   * @param[out] estimate_fee            estimate fee
+   * @param[in] filter                   utxo search filter
+   * @param[in] option_params            utxo search option
+   * @param[out] append_txout_addresses  used txout additional address
+   * @param[in] net_type                 network type
+   * @param[in] prefix_list              address prefix list
+   */
+  void FundRawTransaction(
+      ConfidentialTransactionController* ctxc,
+      const std::vector<UtxoData>& utxos,
+      const std::map<std::string, Amount>& map_target_value,
+      const std::vector<ElementsUtxoAndOption>& selected_txin_utxos,
+      const std::map<std::string, std::string>& reserve_txout_address,
+      const ConfidentialAssetId& fee_asset, bool is_blind_estimate_fee = true,
+      double effective_fee_rate = 1, Amount* estimate_fee = nullptr,
+      const UtxoFilter* filter = nullptr,
+      const CoinSelectionOption* option_params = nullptr,
+      std::vector<std::string>* append_txout_addresses = nullptr,
+      NetType net_type = NetType::kLiquidV1,
+      const std::vector<AddressFormatData>* prefix_list = nullptr) const;
+
+  /**
+   * @brief calculate fund transaction. (using controller and utxo index)
+   * @details ctxc を直接更新し、hex文字列への変換を行わない。
+   * @param[in,out] ctxc                 transaction controller
+   * @param[in,out] utxo_index           utxo index
+   * @param[in] map_target_value         asset target value map
+   * @param[in] selected_txin_utxos      selected txin utxo
+   * @param[in] reserve_txout_address    reserved address
+   * @param[in] fee_asset                using fee asset
+   * @param[in] is_blind_estimate_fee    using tx blinding
+   * @param[in] effective_fee_rate       effective fee rate (minimum)
+   * @param[out] estimate_fee            estimate fee
+   * @param[in] filter                   utxo search filter
+   * @param[in] option_params            utxo search option
+   * @param[out] append_txout_addresses  used txout additional address
+   * @param[in] net_type                 network type
+   * @param[in] prefix_list              address prefix list
+   */
+  void FundRawTransaction(
+      ConfidentialTransactionController* ctxc, UtxoIndex* utxo_index,
+      const std::map<std::string, Amount>& map_target_value,
+      const std::vector<ElementsUtxoAndOption>& selected_txin_utxos,
+      const std::map<std::string, std::string>& reserve_txout_address,
+      const ConfidentialAssetId& fee_asset, bool is_blind_estimate_fee = true,
+      double effective_fee_rate = 1, Amount* estimate_fee = nullptr,
+      const UtxoFilter* filter = nullptr,
+      const CoinSelectionOption* option_params = nullptr,
+      std::vector<std::string>* append_txout_addresses = nullptr,
+      NetType net_type = NetType::kLiquidV1,
+      const std::vector<AddressFormatData>* prefix_list = nullptr) const;
+
   // CreateDestroyAmountTransaction
   // see CreateRawTransaction and ConfidentialTxOut::CreateDestroyAmountTxOut
 };
@@ -216,6 +216,20 @@ class CFD_EXPORT TransactionApi {
       Amount* tx_fee = nullptr, Amount* utxo_fee = nullptr,
       double effective_fee_rate = 1) const;
 
+  /**
+   * @brief estimate a fee amount from transaction. (using controller)
+   * @param[in] txc                 transaction controller
+   * @param[in] utxos               using utxo data
+   * @param[in] tx_fee              tx fee amount (ignore utxo)
+   * @param[in] utxo_fee            utxo fee amount
+   * @param[in] effective_fee_rate  effective fee rate (minimum)
+   * @return tx fee (contains utxo)
+   */
+  Amount EstimateFee(
+      const TransactionController& txc, const std::vector<UtxoData>& utxos,
+      Amount* tx_fee = nullptr, Amount* utxo_fee = nullptr,
+      double effective_fee_rate = 1) const;
+
   /**
    * @brief calculate fund transaction.
    * @param[in] tx_hex                   tx hex string
@@ -243,6 +257,123 @@ class CFD_EXPORT TransactionApi {
       std::vector<std::string>* append_txout_addresses = nullptr,
       NetType net_type = NetType::kMainnet,
       const std::vector<AddressFormatData>* prefix_list = nullptr) const;
+
+  /**
+   * @brief calculate fund transaction. (using controller)
+   * @details txc を直接更新し、hex文字列への変換を行わない。
+   * @param[in,out] txc                  transaction controller
+   * @param[in] utxos                    using utxo data
+   * @param[in] target_value             target value
+   * @param[in] selected_txin_utxos      selected txin utxo
+   * @param[in] reserve_txout_address    reserved address
+   * @param[in] effective_fee_rate       effective fee rate (minimum)
+   * @param[out] estimate_fee            estimate fee
+   * @param[in] filter                   utxo search filter
+   * @param[in] option_params            utxo search option
+   * @param[out] append_txout_addresses  used txout additional address
+   * @param[in] net_type                 network type
+   * @param[in] prefix_list              address prefix list
+   */
+  void FundRawTransaction(
+      TransactionController* txc, const std::vector<UtxoData>& utxos,
+      const Amount& target_value,
+      const std::vector<UtxoData>& selected_txin_utxos,
+      const std::string& reserve_txout_address,
+      double effective_fee_rate = 20.0, Amount* estimate_fee = nullptr,
+      const UtxoFilter* filter = nullptr,
+      const CoinSelectionOption* option_params = nullptr,
+      std::vector<std::string>* append_txout_addresses = nullptr,
+      NetType net_type = NetType::kMainnet,
+      const std::vector<AddressFormatData>* prefix_list = nullptr) const;
+
+  /**
+   * @brief calculate fund transaction. (using utxo index)
+   * @details utxo_index に保持した変換済みUTXOとfee計算結果を利用する。
+   *   選択したUTXOのfeeは utxo_index 上のサイズ情報から算出する。
+   * @param[in] tx_hex                   tx hex string
+   * @param[in,out] utxo_index           utxo index
+   * @param[in] target_value             target value
+   * @param[in] selected_txin_utxos      selected txin utxo
+   * @param[in] reserve_txout_address    reserved address
+   * @param[in] effective_fee_rate       effective fee rate (minimum)
+   * @param[out] estimate_fee            estimate fee
+   * @param[in] filter                   utxo search filter
+   * @param[in] option_params            utxo search option
+   * @param[out] append_txout_addresses  used txout additional address
+   * @param[in] net_type                 network type
+   * @param[in] prefix_list              address prefix list
+   * @return tx controller
+   */
+  TransactionController FundRawTransaction(
+      const std::string& tx_hex, UtxoIndex* utxo_index,
+      const Amount& target_value,
+      const std::vector<UtxoData>& selected_txin_utxos,
+      const std::string& reserve_txout_address,
+      double effective_fee_rate = 20.0, Amount* estimate_fee = nullptr,
+      const UtxoFilter* filter = nullptr,
+      const CoinSelectionOption* option_params = nullptr,
+      std::vector<std::string>* append_txout_addresses = nullptr,
+      NetType net_type = NetType::kMainnet,
+      const std::vector<AddressFormatData>* prefix_list = nullptr) const;
+
+  /**
+   * @brief calculate fund transaction. (using controller and utxo index)
+   * @details txc を直接更新し、hex文字列への変換を行わない。
+   * @param[in,out] txc                  transaction controller
+   * @param[in,out] utxo_index           utxo index
+   * @param[in] target_value             target value
+   * @param[in] selected_txin_utxos      selected txin utxo
+   * @param[in] reserve_txout_address    reserved address
+   * @param[in] effective_fee_rate       effective fee rate (minimum)
+   * @param[out] estimate_fee            estimate fee
+   * @param[in] filter                   utxo search filter
+   * @param[in] option_params            utxo search option
+   * @param[out] append_txout_addresses  used txout additional address
+   * @param[in] net_type                 network type
+   * @param[in] prefix_list              address prefix list
+   */
+  void FundRawTransaction(
+      TransactionController* txc, UtxoIndex* utxo_index,
+      const Amount& target_value,
+      const std::vector<UtxoData>& selected_txin_utxos,
+      const std::string& reserve_txout_address,
+      double effective_fee_rate = 20.0, Amount* estimate_fee = nullptr,
+      const UtxoFilter* filter = nullptr,
+      const CoinSelectionOption* option_params = nullptr,
+      std::vector<std::string>* append_txout_addresses = nullptr,
+      NetType net_type = NetType::kMainnet,
+      const std::vector<AddressFormatData>* prefix_list = nullptr) const;
+
+  /**
+   * @brief calculate fund transaction. (multiple transactions)
+   * @details utxos は一度だけ変換し、fee計算結果を全txで共有する。
+   *   tx_hex_list の順に収集し、収集したUTXOは以降のtxの候補から除外するため、
+   *   同一のUTXOを複数のtxで利用しない。
+   *   txに設定済みのTxInが utxos に含まれる場合は、そのtxの設定済みUTXOとして扱う。
+   *   いずれかのtxで収集に失敗した場合は例外となる。
+   * @param[in] tx_hex_list              tx hex string list
+   * @param[in] utxos                    using utxo data (shared)
+   * @param[in] reserve_txout_address    reserved address
+   * @param[in] effective_fee_rate       effective fee rate (minimum)
+   * @param[out] estimate_fees           estimate fee list
+   * @param[in] filter                   utxo search filter
+   * @param[in] option_params            utxo search option
+   * @param[out] append_txout_addresses  used txout additional address list
+   * @param[in] net_type                 network type
+   * @param[in] prefix_list              address prefix list
+   * @return tx controller list
+   */
+  std::vector<TransactionController> FundRawTransactions(
+      const std::vector<std::string>& tx_hex_list,
+      const std::vector<UtxoData>& utxos,
+      const std::string& reserve_txout_address,
+      double effective_fee_rate = 20.0,
+      std::vector<Amount>* estimate_fees = nullptr,
+      const UtxoFilter* filter = nullptr,
+      const CoinSelectionOption* option_params = nullptr,
+      std::vector<std::vector<std::string>>* append_txout_addresses = nullptr,
+      NetType net_type = NetType::kMainnet,
+      const std::vector<AddressFormatData>* prefix_list = nullptr) const;
 };
 
 }  // namespace api
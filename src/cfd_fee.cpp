@@ -5,17 +5,40 @@
  * @brief Fee計算の関連クラスの実装ファイル
  */
 #include <algorithm>
+#include <mutex>  // NOLINT
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "cfd/cfd_fee.h"
+#include "cfdcore/cfdcore_address.h"
 #include "cfdcore/cfdcore_amount.h"
+#include "cfdcore/cfdcore_descriptor.h"
+#include "cfdcore/cfdcore_elements_transaction.h"
+#include "cfdcore/cfdcore_exception.h"
+#include "cfdcore/cfdcore_logger.h"
+#include "cfdcore/cfdcore_script.h"
+#include "cfdcore/cfdcore_transaction.h"
 #include "cfdcore/cfdcore_transaction_common.h"
 
 namespace cfd {
 
 using cfd::core::AbstractTransaction;
+using cfd::core::AddressType;
 using cfd::core::Amount;
+using cfd::core::CfdError;
+using cfd::core::CfdException;
+using cfd::core::Descriptor;
+using cfd::core::DescriptorScriptReference;
+using cfd::core::DescriptorScriptType;
+using cfd::core::Script;
+using cfd::core::TxIn;
+#ifndef CFD_DISABLE_ELEMENTS
+using cfd::core::ConfidentialTransaction;
+using cfd::core::ConfidentialTxIn;
+#endif  // CFD_DISABLE_ELEMENTS
+using cfd::core::logger::info;
+using cfd::core::logger::warn;
 
 // -----------------------------------------------------------------------------
 // ファイル内定数
@@ -23,6 +46,275 @@ using cfd::core::Amount;
 //! KB size
 static constexpr const uint64_t kKiloByteSize = 1000;
 
+//! segwit marker/flag size
+static constexpr const uint32_t kSegwitMarkerFlagSize = 2;
+//! witnessを持たないTxInの空witness(件数0)のサイズ
+static constexpr const uint32_t kEmptyWitnessSize = 1;
+
+//! TxInサイズテーブルの件数 (AddressTypeの値をindexとする)
+static constexpr const size_t kTxInSizeTableCount =
+    static_cast<size_t>(AddressType::kP2shP2wpkhAddress) + 1;
+
+/**
+ * @brief TxInサイズ情報
+ */
+struct TxInSizeData {
+  uint32_t size;          //!< txin size (witness領域を含む)
+  uint32_t witness_size;  //!< witness area size
+};
+
+/**
+ * @brief TxInサイズテーブルのindexを取得する.
+ * @param[in] addr_type   address type
+ * @param[out] index      table index
+ * @retval true   テーブル対象
+ * @retval false  テーブル対象外
+ */
+static bool GetTxInSizeTableIndex(AddressType addr_type, size_t* index) {
+  size_t type_value = static_cast<size_t>(addr_type);
+  if ((type_value == 0) || (type_value >= kTxInSizeTableCount)) {
+    return false;
+  }
+  *index = type_value;
+  return true;
+}
+
+/**
+ * @brief varintのサイズを取得する.
+ * @param[in] value   value
+ * @return varint size
+ */
+static uint32_t GetVarIntSize(uint64_t value) {
+  if (value < 0xfd) return 1;
+  if (value <= 0xffff) return 3;
+  if (value <= 0xffffffff) return 5;
+  return 9;
+}
+
+//! 署名の推定サイズ (DER署名 + sighash type)
+static constexpr const uint32_t kEstimateSignatureSize = 72;
+//! 圧縮公開鍵のサイズ
+static constexpr const uint32_t kEstimatePubkeySize = 33;
+//! descriptor解析キャッシュの最大件数
+static constexpr const size_t kDescriptorCacheMaxCount = 1000;
+//! witness scale factor (weight / vsize)
+static constexpr const uint32_t kWitnessScaleFactor = 4;
+
+/**
+ * @brief descriptor解析キャッシュの要素
+ */
+struct DescriptorSizeCacheEntry {
+  bool is_success;              //!< 算出可否
+  DescriptorTxInSizeData data;  //!< サイズ情報
+  uint64_t access;              //!< 最終参照順序
+};
+
+/**
+ * @brief descriptor解析キャッシュ
+ */
+struct DescriptorSizeCache {
+  std::mutex mutex;           //!< mutex
+  uint64_t access_count = 0;  //!< 参照順序
+  //! descriptor -> cache entry
+  std::unordered_map<std::string, DescriptorSizeCacheEntry> entries;
+};
+
+/**
+ * @brief descriptor解析キャッシュを取得する.
+ * @return descriptor cache
+ */
+static DescriptorSizeCache& GetDescriptorSizeCache() {
+  static DescriptorSizeCache cache;
+  return cache;
+}
+
+/**
+ * @brief script内のpush dataのサイズを取得する.
+ * @param[in] data_size   push対象のデータサイズ
+ * @return push opcodeを含むサイズ
+ */
+static uint32_t GetPushDataSize(uint32_t data_size) {
+  if (data_size < 0x4c) return 1 + data_size;     // 1-75 byte
+  if (data_size <= 0xff) return 2 + data_size;    // OP_PUSHDATA1
+  if (data_size <= 0xffff) return 3 + data_size;  // OP_PUSHDATA2
+  return 5 + data_size;                           // OP_PUSHDATA4
+}
+
+/**
+ * @brief multisig scriptの必要署名数を取得する.
+ * @param[in] script        script
+ * @param[out] require_num  require signature num
+ * @retval true   multisig script
+ * @retval false  multisig以外のscript
+ */
+static bool GetMultisigRequireNum(const Script& script, uint32_t* require_num) {
+  static constexpr const uint8_t kOpOne = 0x51;
+  static constexpr const uint8_t kOpSixteen = 0x60;
+  static constexpr const uint8_t kOpCheckMultisig = 0xae;
+  static constexpr const uint8_t kOpCheckMultisigVerify = 0xaf;
+  std::vector<uint8_t> bytes = script.GetData().GetBytes();
+  if (bytes.size() < 3) return false;
+  if ((bytes.back() != kOpCheckMultisig) &&
+      (bytes.back() != kOpCheckMultisigVerify)) {
+    return false;
+  }
+  if ((bytes[0] < kOpOne) || (bytes[0] > kOpSixteen)) return false;
+  *require_num = static_cast<uint32_t>(bytes[0] - kOpOne + 1);
+  return true;
+}
+
+/**
+ * @brief p2shのunlocking scriptの推定サイズを算出する.
+ * @details multisigの場合は必要署名数分、それ以外は1署名分で算出する。
+ *   pkhの場合は公開鍵のpushも加算する。
+ * @param[in] redeem_script   redeem script
+ * @return unlocking script size
+ */
+static uint32_t EstimateScriptSigSize(const Script& redeem_script) {
+  uint32_t require_num = 1;
+  uint32_t size = 0;
+  if (GetMultisigRequireNum(redeem_script, &require_num)) {
+    size += 1;  // OP_CHECKMULTISIGのdummy (OP_0)
+  } else if (redeem_script.IsP2pkhScript()) {
+    size += GetPushDataSize(kEstimatePubkeySize);
+  }
+  size += require_num * (1 + kEstimateSignatureSize);
+  size += GetPushDataSize(
+      static_cast<uint32_t>(redeem_script.GetData().GetDataSize()));
+  return size;
+}
+
+/**
+ * @brief p2wshのwitness stackの推定サイズを算出する.
+ * @details multisigの場合は必要署名数分、それ以外は1署名分で算出する。
+ *   pkhの場合は公開鍵のstackも加算する。
+ * @param[in] witness_script  witness script
+ * @return witness stack size
+ */
+static uint32_t EstimateWitnessStackSize(const Script& witness_script) {
+  uint32_t require_num = 1;
+  uint32_t stack_count = 2;
+  uint32_t size = 0;
+  if (GetMultisigRequireNum(witness_script, &require_num)) {
+    stack_count = require_num + 2;
+    size += 1;  // OP_CHECKMULTISIGのdummy (empty)
+  } else if (witness_script.IsP2pkhScript()) {
+    stack_count = 3;
+    size += GetVarIntSize(kEstimatePubkeySize) + kEstimatePubkeySize;
+  }
+  size += require_num * (1 + kEstimateSignatureSize);
+  uint32_t script_size =
+      static_cast<uint32_t>(witness_script.GetData().GetDataSize());
+  size += GetVarIntSize(script_size) + script_size;
+  return GetVarIntSize(stack_count) + size;
+}
+
+/**
+ * @brief TxIn推定サイズ情報からTxInサイズを算出する.
+ * @param[in] data            txin size data
+ * @param[out] witness_size   witness area size
+ * @return txin size (witness領域を含む)
+ */
+static uint32_t GetTxInSizeFromData(
+    const DescriptorTxInSizeData& data, uint32_t* witness_size) {
+  if (witness_size) *witness_size = data.witness_size;
+  return static_cast<uint32_t>(TxIn::kMinimumTxInSize) +
+         (GetVarIntSize(data.unlocking_script_size) - 1) +
+         data.unlocking_script_size + data.witness_size;
+}
+
+/**
+ * @brief 単一鍵のアドレス種別かどうか.
+ * @details 単一鍵の種別はscriptに依存しないため、テーブル値をそのまま使用する。
+ * @param[in] addr_type   address type
+ * @retval true   単一鍵の種別
+ * @retval false  script依存の種別
+ */
+static bool IsSingleKeyAddressType(AddressType addr_type) {
+  return (addr_type == AddressType::kP2pkhAddress) ||
+         (addr_type == AddressType::kP2wpkhAddress) ||
+         (addr_type == AddressType::kP2shP2wpkhAddress);
+}
+
+/**
+ * @brief Output Descriptorを解析し、TxIn推定サイズを算出する.
+ * @param[in] descriptor    output descriptor
+ * @param[out] data         txin size data
+ * @retval true   算出成功
+ * @retval false  サイズ算出対象外のdescriptor
+ */
+static bool ParseDescriptorTxInSize(
+    const std::string& descriptor, DescriptorTxInSizeData* data) {
+  // サイズ算出のみのため、引数(derive path)はダミー値で解析する
+  Descriptor desc = Descriptor::Parse(descriptor, nullptr);
+  uint32_t argument_num = desc.GetNeedArgumentNum();
+  std::vector<std::string> args(argument_num, "0");
+  std::vector<DescriptorScriptReference> script_refs =
+      desc.GetReferenceAll(&args);
+  if (script_refs.empty()) return false;
+
+  // 単一鍵の種別はテーブルの推定値を使用し、scriptはscriptから算出する
+  static constexpr const uint32_t kMinimumTxInSize =
+      static_cast<uint32_t>(TxIn::kMinimumTxInSize);
+  uint32_t wpkh_witness_size = 0;
+  TxInSizeTable::GetTxInSize(AddressType::kP2wpkhAddress, &wpkh_witness_size);
+  const DescriptorScriptReference& script_ref = script_refs[0];
+  data->unlocking_script_size = 0;
+  data->witness_size = 0;
+  switch (script_ref.GetScriptType()) {
+    case DescriptorScriptType::kDescriptorScriptPkh:
+      data->address_type = AddressType::kP2pkhAddress;
+      data->unlocking_script_size =
+          TxInSizeTable::GetTxInSize(AddressType::kP2pkhAddress) -
+          kMinimumTxInSize;
+      break;
+    case DescriptorScriptType::kDescriptorScriptWpkh:
+      data->address_type = AddressType::kP2wpkhAddress;
+      data->witness_size = wpkh_witness_size;
+      break;
+    case DescriptorScriptType::kDescriptorScriptWsh:
+      if (!script_ref.HasRedeemScript()) return false;
+      data->address_type = AddressType::kP2wshAddress;
+      data->witness_size =
+          EstimateWitnessStackSize(script_ref.GetRedeemScript());
+      break;
+    case DescriptorScriptType::kDescriptorScriptSh: {
+      if (!script_ref.HasRedeemScript()) return false;
+      const Script redeem_script = script_ref.GetRedeemScript();
+      DescriptorScriptType child_type =
+          DescriptorScriptType::kDescriptorScriptNull;
+      DescriptorScriptReference child;
+      if (script_ref.HasChild()) {
+        child = script_ref.GetChild();
+        child_type = child.GetScriptType();
+      }
+      if (child_type == DescriptorScriptType::kDescriptorScriptWpkh) {
+        data->address_type = AddressType::kP2shP2wpkhAddress;
+        data->unlocking_script_size =
+            TxInSizeTable::kP2shP2wpkhUnlockingScriptSize;
+        data->witness_size = wpkh_witness_size;
+      } else if (child_type == DescriptorScriptType::kDescriptorScriptWsh) {
+        if (!child.HasRedeemScript()) return false;
+        data->address_type = AddressType::kP2shP2wshAddress;
+        data->unlocking_script_size =
+            TxInSizeTable::kP2shP2wshUnlockingScriptSize;
+        data->witness_size = EstimateWitnessStackSize(child.GetRedeemScript());
+      } else {
+        data->address_type = AddressType::kP2shAddress;
+        data->unlocking_script_size = EstimateScriptSigSize(redeem_script);
+      }
+      break;
+    }
+    default:
+      // pk/combo/raw/addr はunlock条件が判別できないため対象外
+      return false;
+  }
+  if (argument_num == 0) {
+    data->locking_script = script_ref.GetLockingScript();
+  }
+  return true;
+}
+
 // -----------------------------------------------------------------------------
 // FeeCalculator
 // -----------------------------------------------------------------------------
@@ -56,11 +348,408 @@ Amount FeeCalculator::GetFee(size_t size) const {
 }
 
 Amount FeeCalculator::GetFee(const Utxo& utxo) const {
+  return GetFee(GetTxInVsize(utxo));
+}
+
+void FeeCalculator::GetFees(
+    const uint32_t* sizes, size_t count, uint64_t* fees) const {
+  // 分岐を減らしてループをベクトル化しやすくする
+  const uint64_t baserate = baserate_;
+  for (size_t index = 0; index < count; ++index) {
+    uint64_t fee = baserate * sizes[index] / 1000;
+    bool is_minimum = (fee == 0) && (sizes[index] != 0) && (baserate != 0);
+    fees[index] = (is_minimum) ? 1 : fee;
+  }
+}
+
+uint32_t FeeCalculator::GetTxInVsize(const Utxo& utxo) {
   uint32_t minimum_txin = static_cast<uint32_t>(TxIn::kMinimumTxInSize);
   uint32_t nowit_size = minimum_txin + utxo.uscript_size_max;
-  uint32_t vsize =
-      AbstractTransaction::GetVsizeFromSize(nowit_size, utxo.witness_size_max);
-  return GetFee(vsize);
+  return AbstractTransaction::GetVsizeFromSize(
+      nowit_size, utxo.witness_size_max);
+}
+
+uint32_t FeeCalculator::GetTxInWeight(const Utxo& utxo) {
+  uint32_t minimum_txin = static_cast<uint32_t>(TxIn::kMinimumTxInSize);
+  uint32_t nowit_size = minimum_txin + utxo.uscript_size_max;
+  return (nowit_size * kWitnessScaleFactor) + utxo.witness_size_max;
+}
+
+// -----------------------------------------------------------------------------
+// TxInSizeTable
+// -----------------------------------------------------------------------------
+constexpr const uint32_t TxInSizeTable::kP2shP2wpkhUnlockingScriptSize;
+constexpr const uint32_t TxInSizeTable::kP2shP2wshUnlockingScriptSize;
+
+uint32_t TxInSizeTable::GetTxInSize(
+    AddressType addr_type, uint32_t* witness_size) {
+  // 初回参照時に全種別を算出する (C++11以降、初期化はスレッドセーフ)
+  static const std::vector<TxInSizeData> kTable = []() {
+    std::vector<TxInSizeData> table(kTxInSizeTableCount);
+    for (size_t index = 1; index < kTxInSizeTableCount; ++index) {
+      TxInSizeData& data = table[index];
+      data.witness_size = 0;
+      data.size = TxIn::EstimateTxInSize(
+          static_cast<AddressType>(index), Script(), &data.witness_size);
+    }
+    return table;
+  }();
+
+  size_t index = 0;
+  if (!GetTxInSizeTableIndex(addr_type, &index)) {
+    return TxIn::EstimateTxInSize(addr_type, Script(), witness_size);
+  }
+  if (witness_size) *witness_size = kTable[index].witness_size;
+  return kTable[index].size;
+}
+
+#ifndef CFD_DISABLE_ELEMENTS
+uint32_t TxInSizeTable::GetConfidentialTxInSize(
+    AddressType addr_type, bool is_issuance, bool is_blind_issuance,
+    uint32_t* witness_size) {
+  // (address type, issuance, blind issuance) の組み合わせごとに保持する
+  static constexpr const size_t kIssuancePatternCount = 4;
+  static const std::vector<TxInSizeData> kTable = []() {
+    std::vector<TxInSizeData> table(
+        kTxInSizeTableCount * kIssuancePatternCount);
+    for (size_t index = 1; index < kTxInSizeTableCount; ++index) {
+      for (size_t pattern = 0; pattern < kIssuancePatternCount; ++pattern) {
+        TxInSizeData& data = table[index * kIssuancePatternCount + pattern];
+        data.witness_size = 0;
+        data.size = ConfidentialTxIn::EstimateTxInSize(
+            static_cast<AddressType>(index), Script(), 0, Script(),
+            (pattern & 0x01) != 0, (pattern & 0x02) != 0, &data.witness_size);
+      }
+    }
+    return table;
+  }();
+
+  size_t index = 0;
+  if (!GetTxInSizeTableIndex(addr_type, &index)) {
+    return ConfidentialTxIn::EstimateTxInSize(
+        addr_type, Script(), 0, Script(), is_issuance, is_blind_issuance,
+        witness_size);
+  }
+  size_t pattern = (is_issuance ? 0x01 : 0) | (is_blind_issuance ? 0x02 : 0);
+  const TxInSizeData& data = kTable[index * kIssuancePatternCount + pattern];
+  if (witness_size) *witness_size = data.witness_size;
+  return data.size;
+}
+#endif  // CFD_DISABLE_ELEMENTS
+
+bool TxInSizeTable::GetDescriptorTxInSizeData(
+    const std::string& descriptor, DescriptorTxInSizeData* data) {
+  if (descriptor.empty() || (data == nullptr)) return false;
+
+  DescriptorSizeCache& cache = GetDescriptorSizeCache();
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto iter = cache.entries.find(descriptor);
+    if (iter != cache.entries.end()) {
+      iter->second.access = ++cache.access_count;
+      if (iter->second.is_success) *data = iter->second.data;
+      return iter->second.is_success;
+    }
+  }
+
+  // 解析はロック外で行う (同一descriptorの同時解析は結果が同じため許容)
+  DescriptorTxInSizeData size_data = {};
+  bool is_success = false;
+  try {
+    is_success = ParseDescriptorTxInSize(descriptor, &size_data);
+  } catch (const CfdException& except) {
+    info(
+        CFD_LOG_SOURCE, "Failed to parse descriptor for size. {}",
+        except.what());
+    is_success = false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if ((cache.entries.size() >= kDescriptorCacheMaxCount) &&
+        (cache.entries.find(descriptor) == cache.entries.end())) {
+      // 最も長く参照されていないdescriptorのみを破棄する
+      auto oldest = cache.entries.begin();
+      for (auto entry = cache.entries.begin(); entry != cache.entries.end();
+           ++entry) {
+        if (entry->second.access < oldest->second.access) oldest = entry;
+      }
+      cache.entries.erase(oldest);
+    }
+    DescriptorSizeCacheEntry& entry = cache.entries[descriptor];
+    entry.is_success = is_success;
+    entry.data = size_data;
+    entry.access = ++cache.access_count;
+  }
+  if (is_success) *data = size_data;
+  return is_success;
+}
+
+bool TxInSizeTable::GetDescriptorTxInSize(
+    const std::string& descriptor, uint32_t* size, uint32_t* witness_size) {
+  DescriptorTxInSizeData data;
+  if ((size == nullptr) || (!GetDescriptorTxInSizeData(descriptor, &data))) {
+    return false;
+  }
+  if (IsSingleKeyAddressType(data.address_type)) {
+    *size = GetTxInSize(data.address_type, witness_size);
+  } else {
+    *size = GetTxInSizeFromData(data, witness_size);
+  }
+  return true;
+}
+
+#ifndef CFD_DISABLE_ELEMENTS
+bool TxInSizeTable::GetConfidentialDescriptorTxInSize(
+    const std::string& descriptor, bool is_issuance, bool is_blind_issuance,
+    uint32_t* size, uint32_t* witness_size) {
+  DescriptorTxInSizeData data;
+  if ((size == nullptr) || (!GetDescriptorTxInSizeData(descriptor, &data))) {
+    return false;
+  }
+  if (IsSingleKeyAddressType(data.address_type)) {
+    *size = GetConfidentialTxInSize(
+        data.address_type, is_issuance, is_blind_issuance, witness_size);
+    return true;
+  }
+  // elements固有の領域(issuance等)は同一種別のテーブル値との差分で加算する
+  uint32_t base_witness_size = 0;
+  uint32_t confidential_witness_size = 0;
+  uint32_t base_size = GetTxInSize(data.address_type, &base_witness_size);
+  uint32_t confidential_size = GetConfidentialTxInSize(
+      data.address_type, is_issuance, is_blind_issuance,
+      &confidential_witness_size);
+  uint32_t desc_witness_size = 0;
+  uint32_t desc_size = GetTxInSizeFromData(data, &desc_witness_size);
+  *size = desc_size + confidential_size - base_size;
+  if (witness_size) {
+    *witness_size =
+        desc_witness_size + confidential_witness_size - base_witness_size;
+  }
+  return true;
+}
+#endif  // CFD_DISABLE_ELEMENTS
+
+void TxInSizeTable::ClearDescriptorCache() {
+  DescriptorSizeCache& cache = GetDescriptorSizeCache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.entries.clear();
+}
+
+// -----------------------------------------------------------------------------
+// TxSizeModel
+// -----------------------------------------------------------------------------
+/**
+ * @brief 空のTransactionのサイズを取得する.
+ * @param[in] is_elements   elements transactionかどうか
+ * @return transaction size
+ */
+static uint32_t GetTransactionMinimumSize(bool is_elements) {
+#ifndef CFD_DISABLE_ELEMENTS
+  if (is_elements) {
+    return ConfidentialTransaction::kElementsTransactionMinimumSize;
+  }
+#endif  // CFD_DISABLE_ELEMENTS
+  return AbstractTransaction::kTransactionMinimumSize;
+}
+
+TxSizeModel::TxSizeModel(bool is_elements)
+    : TxSizeModel(
+          GetTransactionMinimumSize(is_elements), 0, 0, 0, is_elements) {}
+
+TxSizeModel::TxSizeModel(
+    uint32_t size, uint32_t witness_size, uint32_t txin_count,
+    uint32_t txout_count, bool is_elements)
+    : size_(size),
+      witness_size_(witness_size),
+      txin_count_(txin_count),
+      txout_count_(txout_count),
+      witness_txin_count_(0),
+      is_elements_(is_elements),
+      is_segwit_base_((!is_elements) && (witness_size != 0)) {
+  if (size < witness_size) {
+    warn(CFD_LOG_SOURCE, "Failed to TxSizeModel. invalid witness size.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError, "invalid witness size.");
+  }
+}
+
+void TxSizeModel::AddTxIn(uint32_t size, uint32_t witness_size) {
+  UpdateSize(size, witness_size, true, &txin_count_);
+  UpdateSegwitSize(witness_size != 0, true);
+}
+
+void TxSizeModel::AddTxIn(const Utxo& utxo) {
+  uint32_t nowit_size =
+      static_cast<uint32_t>(TxIn::kMinimumTxInSize) + utxo.uscript_size_max;
+  AddTxIn(nowit_size + utxo.witness_size_max, utxo.witness_size_max);
+}
+
+void TxSizeModel::RemoveTxIn(uint32_t size, uint32_t witness_size) {
+  UpdateSize(size, witness_size, false, &txin_count_);
+  UpdateSegwitSize(witness_size != 0, false);
+}
+
+void TxSizeModel::RemoveTxIn(const Utxo& utxo) {
+  uint32_t nowit_size =
+      static_cast<uint32_t>(TxIn::kMinimumTxInSize) + utxo.uscript_size_max;
+  RemoveTxIn(nowit_size + utxo.witness_size_max, utxo.witness_size_max);
+}
+
+#ifndef CFD_DISABLE_ELEMENTS
+/**
+ * @brief Confidential TxInのissuance分のサイズを取得する.
+ * @param[in] is_issuance         issuance有無
+ * @param[in] is_blind_issuance   blind issuance有無
+ * @param[out] witness_size       issuance分のwitness size
+ * @return issuance分のsize (witness領域を含む)
+ */
+static uint32_t GetIssuanceSize(
+    bool is_issuance, bool is_blind_issuance, uint32_t* witness_size) {
+  // issuanceはunlocking scriptの種別に依存しないため、差分のみ算出する
+  uint32_t base_witness_size = 0;
+  uint32_t base_size = TxInSizeTable::GetConfidentialTxInSize(
+      AddressType::kP2wpkhAddress, false, false, &base_witness_size);
+  uint32_t issuance_witness_size = 0;
+  uint32_t issuance_size = TxInSizeTable::GetConfidentialTxInSize(
+      AddressType::kP2wpkhAddress, is_issuance, is_blind_issuance,
+      &issuance_witness_size);
+  *witness_size = issuance_witness_size - base_witness_size;
+  return issuance_size - base_size;
+}
+
+void TxSizeModel::AddTxIn(
+    const Utxo& utxo, bool is_issuance, bool is_blind_issuance) {
+  uint32_t witness_size = 0;
+  uint32_t size =
+      GetIssuanceSize(is_issuance, is_blind_issuance, &witness_size);
+  uint32_t nowit_size =
+      static_cast<uint32_t>(TxIn::kMinimumTxInSize) + utxo.uscript_size_max;
+  witness_size += utxo.witness_size_max;
+  AddTxIn(size + nowit_size + utxo.witness_size_max, witness_size);
+}
+
+void TxSizeModel::RemoveTxIn(
+    const Utxo& utxo, bool is_issuance, bool is_blind_issuance) {
+  uint32_t witness_size = 0;
+  uint32_t size =
+      GetIssuanceSize(is_issuance, is_blind_issuance, &witness_size);
+  uint32_t nowit_size =
+      static_cast<uint32_t>(TxIn::kMinimumTxInSize) + utxo.uscript_size_max;
+  witness_size += utxo.witness_size_max;
+  RemoveTxIn(size + nowit_size + utxo.witness_size_max, witness_size);
+}
+#endif  // CFD_DISABLE_ELEMENTS
+
+void TxSizeModel::AddTxOut(uint32_t size, uint32_t witness_size) {
+  UpdateSize(size, witness_size, true, &txout_count_);
+}
+
+void TxSizeModel::AddTxOut(const TxOutReference& txout) {
+  AddTxOut(txout.GetSerializeSize());
+}
+
+void TxSizeModel::RemoveTxOut(uint32_t size, uint32_t witness_size) {
+  UpdateSize(size, witness_size, false, &txout_count_);
+}
+
+void TxSizeModel::RemoveTxOut(const TxOutReference& txout) {
+  RemoveTxOut(txout.GetSerializeSize());
+}
+
+#ifndef CFD_DISABLE_ELEMENTS
+void TxSizeModel::AddTxOut(
+    const ConfidentialTxOutReference& txout, bool is_blinded) {
+  uint32_t witness_size = 0;
+  uint32_t size = txout.GetSerializeSize(is_blinded, &witness_size);
+  AddTxOut(size, witness_size);
+}
+
+void TxSizeModel::RemoveTxOut(
+    const ConfidentialTxOutReference& txout, bool is_blinded) {
+  uint32_t witness_size = 0;
+  uint32_t size = txout.GetSerializeSize(is_blinded, &witness_size);
+  RemoveTxOut(size, witness_size);
+}
+#endif  // CFD_DISABLE_ELEMENTS
+
+uint32_t TxSizeModel::GetSize() const { return size_; }
+
+uint32_t TxSizeModel::GetWitnessSize() const { return witness_size_; }
+
+uint32_t TxSizeModel::GetVsize() const {
+  return AbstractTransaction::GetVsizeFromSize(
+      size_ - witness_size_, witness_size_);
+}
+
+uint32_t TxSizeModel::GetTxInCount() const { return txin_count_; }
+
+uint32_t TxSizeModel::GetTxOutCount() const { return txout_count_; }
+
+void TxSizeModel::UpdateSize(
+    uint32_t size, uint32_t witness_size, bool is_add, uint32_t* count) {
+  if (size < witness_size) {
+    warn(CFD_LOG_SOURCE, "Failed to TxSizeModel. invalid witness size.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError, "invalid witness size.");
+  }
+  if (is_add) {
+    // 件数のvarintが拡張される場合はその差分も加算
+    uint32_t count_size_diff =
+        GetVarIntSize(*count + 1) - GetVarIntSize(*count);
+    size_ += size + count_size_diff;
+    witness_size_ += witness_size;
+    ++(*count);
+  } else {
+    uint32_t count_size_diff =
+        (*count == 0) ? 0 : GetVarIntSize(*count) - GetVarIntSize(*count - 1);
+    if ((*count == 0) || (size_ < (size + count_size_diff)) ||
+        (witness_size_ < witness_size) ||
+        ((size_ - size - count_size_diff) <
+         (witness_size_ - witness_size))) {
+      warn(CFD_LOG_SOURCE, "Failed to TxSizeModel. remove target not found.");
+      throw CfdException(
+          CfdError::kCfdIllegalStateError, "remove target not found.");
+    }
+    size_ -= size + count_size_diff;
+    witness_size_ -= witness_size;
+    --(*count);
+  }
+}
+
+void TxSizeModel::UpdateSegwitSize(bool has_witness, bool is_add) {
+  // elementsはflagを基本領域に持ち、txinのwitness領域は推定サイズに含まれる
+  if (is_elements_) return;
+
+  bool is_segwit_before = IsSegwit();
+  if (has_witness) {
+    if (is_add) {
+      ++witness_txin_count_;
+    } else if (witness_txin_count_ != 0) {
+      --witness_txin_count_;
+    }
+  }
+  bool is_segwit_after = IsSegwit();
+
+  uint32_t diff = 0;
+  if (is_segwit_before != is_segwit_after) {
+    // marker/flagと、witnessを持たない全TxInの空witnessを増減する
+    diff = kSegwitMarkerFlagSize +
+           (txin_count_ - witness_txin_count_) * kEmptyWitnessSize;
+  } else if (is_segwit_after && (!has_witness)) {
+    diff = kEmptyWitnessSize;
+  }
+  if (is_add) {
+    size_ += diff;
+    witness_size_ += diff;
+  } else {
+    size_ -= diff;
+    witness_size_ -= diff;
+  }
+}
+
+bool TxSizeModel::IsSegwit() const {
+  return is_segwit_base_ || (witness_txin_count_ != 0);
 }
 
 }  // namespace cfd
@@ -5,11 +5,20 @@
  * @brief UTXO操作の関連クラスの実装ファイル
  */
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>  // NOLINT
 #include <cmath>
 #include <cstring>
+#include <exception>
+#include <functional>
+#include <limits>
 #include <map>
+#include <random>
 #include <string>
+#include <system_error>  // NOLINT
+#include <thread>  // NOLINT
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -37,13 +46,11 @@ using cfd::core::BlockHash;
 using cfd::core::CfdError;
 using cfd::core::CfdException;
 using cfd::core::kMaxAmount;
-using cfd::core::RandomNumberUtil;
 using cfd::core::Script;
 using cfd::core::Txid;
 using cfd::core::TxIn;
 #ifndef CFD_DISABLE_ELEMENTS
 using cfd::core::ConfidentialAssetId;
-using cfd::core::ConfidentialTxIn;
 using cfd::core::ConfidentialTxOut;
 using cfd::core::ConfidentialTxOutReference;
 using cfd::core::ConfidentialValue;
@@ -75,6 +82,821 @@ static constexpr const uint64_t kDefaultDiscardFee = 10000;
 //! WITNESS_SCALE_FACTOR
 static constexpr const uint32_t kWitnessScaleFactor = 4;
 
+//! UtxoIndexで保持するfee rate毎のキャッシュ上限数
+static constexpr const size_t kUtxoIndexFeePoolCacheMax = 8;
+
+//! OutputGroupにまとめるUTXOの上限数 (OUTPUT_GROUP_MAX_ENTRIES)
+static constexpr const size_t kOutputGroupMaxEntries = 100;
+
+//! 無期限の予約を示す有効期限
+static constexpr const uint64_t kReservationNoDeadline =
+    std::numeric_limits<uint64_t>::max();
+
+//! 未予約の予約状態
+static constexpr const uint64_t kReservationStateFree = 0;
+
+//! 消費済みの予約状態 (予約IDとしては生成しない)
+static constexpr const uint64_t kReservationStateSpent =
+    std::numeric_limits<uint64_t>::max();
+
+//! 消費確定中の予約状態 (予約IDとしては生成しない)
+static constexpr const uint64_t kReservationStateCommitting =
+    kReservationStateSpent - 1;
+
+//! 予約設定中の予約状態 (予約IDとしては生成しない)
+//! 以上の値は予約IDではない状態を示す
+static constexpr const uint64_t kReservationStateLocking =
+    kReservationStateSpent - 2;
+
+//! 予約競合時にCoinSelectionをやり直す上限回数
+//! (同一条件の選択は同じUTXOを選ぶため、並行数より十分大きくする)
+static constexpr const uint32_t kReservationMaxRetry = 128;
+
+/**
+ * @brief fee計算済みUTXOプールにUTXOを追加する.
+ * @details effective_valueにはamountを設定する。
+ * @param[in] utxo            UTXO
+ * @param[in] effective_fee   effective fee calculator
+ * @param[in] long_term_fee   long term fee calculator
+ * @param[out] fee_pool       UTXOプール
+ */
+static void AddFeePoolUtxo(
+    const Utxo* utxo, const FeeCalculator& effective_fee,
+    const FeeCalculator& long_term_fee, UtxoPool* fee_pool) {
+  fee_pool->Add(
+      utxo, utxo->amount,
+      static_cast<uint64_t>(effective_fee.GetFee(*utxo).GetSatoshiValue()),
+      static_cast<uint64_t>(long_term_fee.GetFee(*utxo).GetSatoshiValue()));
+}
+
+/**
+ * @brief UTXO配列からfee計算済みUTXOプールを作成する.
+ * @param[in] utxos           UTXO配列の先頭
+ * @param[in] utxo_count      UTXO数
+ * @param[in] option_params   オプション情報
+ * @param[out] fee_pool       UTXOプール
+ */
+static void CreateFeePool(
+    const Utxo* utxos, size_t utxo_count,
+    const CoinSelectionOption& option_params, UtxoPool* fee_pool) {
+  FeeCalculator effective_fee(option_params.GetEffectiveFeeBaserate());
+  FeeCalculator long_term_fee(option_params.GetLongTermFeeBaserate());
+  fee_pool->Clear();
+  fee_pool->Reserve(utxo_count);
+  for (size_t index = 0; index < utxo_count; ++index) {
+    AddFeePoolUtxo(&utxos[index], effective_fee, long_term_fee, fee_pool);
+  }
+}
+
+/**
+ * @brief UtxoFilterに判定条件が設定されているかを確認する.
+ * @param[in] filter    フィルタ条件
+ * @retval true   判定条件あり
+ * @retval false  判定条件なし
+ */
+static bool IsEnableUtxoFilter(const UtxoFilter& filter) {
+  return (filter.min_amount != 0) || (filter.max_amount != 0) ||
+         ((filter.tip_block_height != 0) &&
+          ((filter.min_confirmations != 0) ||
+           (filter.max_confirmations != 0))) ||
+         !filter.excluded_outpoints.empty() || !filter.address_types.empty();
+}
+
+/**
+ * @brief フィルタ条件に一致するUTXOのみのプールを作成する.
+ * @details amount範囲はamount配列のみで判定し、その他の条件は
+ *   amount範囲を満たしたUTXOに対してのみ判定する。
+ * @param[in] fee_pool        fee計算済みのUTXOプール
+ * @param[in] filter          フィルタ条件
+ * @param[out] utxo_pool      UTXOプール
+ */
+static void FilterUtxoPool(
+    const UtxoPool& fee_pool, const UtxoFilter& filter, UtxoPool* utxo_pool) {
+  const std::vector<uint64_t>& effective_values =
+      fee_pool.GetEffectiveValues();
+  const std::vector<uint64_t>& amounts = fee_pool.GetAmounts();
+  const std::vector<uint64_t>& fees = fee_pool.GetFees();
+  const std::vector<uint64_t>& long_term_fees = fee_pool.GetLongTermFees();
+  const std::vector<uint64_t>& weights = fee_pool.GetWeights();
+  const std::vector<uint32_t>& input_counts = fee_pool.GetInputCounts();
+  const size_t utxo_count = fee_pool.GetSize();
+  const uint64_t min_amount = filter.min_amount;
+  const uint64_t max_amount = (filter.max_amount == 0)
+                                  ? std::numeric_limits<uint64_t>::max()
+                                  : filter.max_amount;
+
+  // 分岐を含めずに判定し、連続領域のみを走査する
+  std::vector<uint8_t> matches(utxo_count);
+  for (size_t index = 0; index < utxo_count; ++index) {
+    matches[index] = static_cast<uint8_t>(
+        (amounts[index] >= min_amount) & (amounts[index] <= max_amount));
+  }
+
+  const uint64_t tip_height = filter.tip_block_height;
+  const bool check_confirmation =
+      (tip_height != 0) &&
+      ((filter.min_confirmations != 0) || (filter.max_confirmations != 0));
+  const uint64_t max_confirmations = (filter.max_confirmations == 0)
+                                         ? std::numeric_limits<uint64_t>::max()
+                                         : filter.max_confirmations;
+  const bool check_outpoint = !filter.excluded_outpoints.empty();
+  const bool check_address_type = !filter.address_types.empty();
+  if (check_confirmation || check_outpoint || check_address_type) {
+    for (size_t index = 0; index < utxo_count; ++index) {
+      if (matches[index] == 0) continue;
+      const Utxo* utxo = fee_pool.GetUtxo(index);
+      if (check_confirmation) {
+        uint64_t confirmations = 0;
+        if ((utxo->block_height != 0) && (utxo->block_height <= tip_height)) {
+          confirmations = tip_height - utxo->block_height + 1;
+        }
+        if ((confirmations < filter.min_confirmations) ||
+            (confirmations > max_confirmations)) {
+          matches[index] = 0;
+          continue;
+        }
+      }
+      if (check_address_type &&
+          (std::find(
+               filter.address_types.begin(), filter.address_types.end(),
+               utxo->address_type) == filter.address_types.end())) {
+        matches[index] = 0;
+        continue;
+      }
+      if (check_outpoint &&
+          (filter.excluded_outpoints.find(UtxoOutPoint::Create(*utxo)) !=
+           filter.excluded_outpoints.end())) {
+        matches[index] = 0;
+      }
+    }
+  }
+
+  utxo_pool->Clear();
+  utxo_pool->Reserve(utxo_count);
+  for (size_t index = 0; index < utxo_count; ++index) {
+    if (matches[index] != 0) {
+      utxo_pool->Add(
+          fee_pool.GetUtxo(index), amounts[index], effective_values[index],
+          fees[index], long_term_fees[index], weights[index],
+          input_counts[index]);
+    }
+  }
+}
+
+/**
+ * @brief UTXOプールに設定するlong term feeを取得する.
+ * @details wasteが負に偏らないよう、long term feeはfee以下に補正する。
+ * @param[in] fee             fee
+ * @param[in] long_term_fee   long term fee
+ * @return long term fee (fee以下)
+ */
+static uint64_t GetCappedLongTermFee(uint64_t fee, uint64_t long_term_fee) {
+  return (long_term_fee > fee) ? fee : long_term_fee;
+}
+
+/**
+ * @brief BnB向けのUTXOプールを作成する.
+ * @details 有効額が正のUTXOのみを対象とし、long_term_feeはfee以下に補正する。
+ * @param[in] fee_pool        fee計算済みのUTXOプール
+ * @param[in] use_fee         feeを利用するかどうか
+ * @param[in] consider_fee    有効額からfeeを除外するかどうか
+ * @param[out] utxo_pool      UTXOプール
+ */
+static void CreateBnBPool(
+    const UtxoPool& fee_pool, bool use_fee, bool consider_fee,
+    UtxoPool* utxo_pool) {
+  const std::vector<uint64_t>& amounts = fee_pool.GetAmounts();
+  const std::vector<uint64_t>& fees = fee_pool.GetFees();
+  const std::vector<uint64_t>& long_term_fees = fee_pool.GetLongTermFees();
+  const std::vector<uint64_t>& weights = fee_pool.GetWeights();
+  const std::vector<uint32_t>& input_counts = fee_pool.GetInputCounts();
+  const size_t utxo_count = fee_pool.GetSize();
+  utxo_pool->Clear();
+  utxo_pool->Reserve(utxo_count);
+  for (size_t index = 0; index < utxo_count; ++index) {
+    const Utxo* utxo = fee_pool.GetUtxo(index);
+
+    uint64_t fee = fees[index];
+    // Only include outputs that are positive effective value (i.e. not dust)
+    if (amounts[index] > fee) {
+      uint64_t effective_value = amounts[index];
+      uint64_t utxo_fee = 0;
+      uint64_t utxo_long_term_fee = 0;
+      if (use_fee) {
+        if (consider_fee) {
+          effective_value -= fee;
+        }
+        utxo_fee = fee;
+        utxo_long_term_fee = GetCappedLongTermFee(fee, long_term_fees[index]);
+      }
+#if 0
+      std::vector<uint8_t> txid_byte(sizeof(utxo->txid));
+      memcpy(txid_byte.data(), utxo->txid, txid_byte.size());
+      info(
+          CFD_LOG_SOURCE, "utxo({},{}) size={}/{} amount={}/{}/{}",
+          Txid(txid_byte).GetHex(), utxo->vout, utxo->uscript_size_max,
+          utxo->witness_size_max, utxo->amount, utxo_fee,
+          utxo_long_term_fee);
+#endif
+      utxo_pool->Add(
+          utxo, amounts[index], effective_value, utxo_fee,
+          utxo_long_term_fee, weights[index], input_counts[index]);
+    }
+  }
+}
+
+/**
+ * @brief お釣り出力のコストを取得する.
+ * @details お釣り出力の作成fee と、お釣りを後で利用する際のfeeの合計。
+ *   fee rateが未設定(0)の場合は0となる。
+ * @param[in] option_params   オプション情報
+ * @return お釣り出力のコスト
+ */
+static Amount GetCostOfChange(const CoinSelectionOption& option_params) {
+  // for btc default(DUST_RELAY_TX_FEE(3000)) -> DEFAULT_DISCARD_FEE(10000)
+  if (option_params.GetEffectiveFeeBaserate() == 0) {
+    return Amount::CreateBySatoshiAmount(0);
+  }
+  FeeCalculator effective_fee(option_params.GetEffectiveFeeBaserate());
+  FeeCalculator discard_fee(kDefaultDiscardFee);
+  return discard_fee.GetFee(option_params.GetChangeSpendSize()) +
+         effective_fee.GetFee(option_params.GetChangeOutputSize());
+}
+
+/**
+ * @brief KnapsackSolverの最小のお釣り額を取得する.
+ * @param[in] option_params   オプション情報
+ * @param[in] use_fee         feeを利用するかどうか
+ * @param[in] cost_of_change  お釣り出力のコスト
+ * @return 最小のお釣り額
+ */
+static uint64_t GetMinimumChange(
+    const CoinSelectionOption& option_params, bool use_fee,
+    const Amount& cost_of_change) {
+  // using minimum fee
+  uint64_t min_change = kMinChange;
+  int64_t opt_min_change = option_params.GetKnapsackMinimumChange();
+  if (opt_min_change >= 0) {
+    if ((!use_fee) || (opt_min_change > cost_of_change.GetSatoshiValue())) {
+      min_change = static_cast<uint64_t>(opt_min_change);
+    } else if (use_fee) {
+      min_change = static_cast<uint64_t>(cost_of_change.GetSatoshiValue());
+    }
+  }
+  return min_change;
+}
+
+/**
+ * @brief TxIn数・weightの上限値を取得する.
+ * @param[in] limit   上限値 (0は無制限)
+ * @return 上限値 (無制限の場合は最大値)
+ */
+static uint64_t GetInputLimit(uint64_t limit) {
+  return (limit == 0) ? std::numeric_limits<uint64_t>::max() : limit;
+}
+
+/**
+ * @brief 1件または2件のUTXOでお釣りなしとなる選択を探索する.
+ * @details 有効額の降順に並んだ配列を二分探索し、合計が
+ *   [target, upper_target] の範囲となる組み合わせのうち、
+ *   wasteが最小のものを取得する。評価回数がmax_countに達した場合は打ち切る。
+ *   TxIn数・weightの上限を超える組み合わせは除外する。
+ * @param[in] values          有効額一覧 (降順)
+ * @param[in] wastes          UTXO毎の(fee - long_term_fee)一覧
+ * @param[in] weights         UTXO毎のweight一覧
+ * @param[in] input_counts    UTXO毎のTxIn数一覧
+ * @param[in] max_input_count TxIn数の上限
+ * @param[in] max_weight      weight合計の上限
+ * @param[in] target          収集額
+ * @param[in] upper_target    収集額の上限 (お釣りのコストを加算した額)
+ * @param[in] max_count       評価回数の上限
+ * @param[out] selection      選択結果のindex一覧
+ * @param[out] best_waste     選択結果のwaste
+ * @param[out] is_completed   全組み合わせを評価したかどうか
+ * @retval true   検出
+ * @retval false  未検出
+ */
+static bool FindChangelessSelection(
+    const std::vector<uint64_t>& values, const std::vector<int64_t>& wastes,
+    const std::vector<uint64_t>& weights,
+    const std::vector<uint32_t>& input_counts, uint64_t max_input_count,
+    uint64_t max_weight, uint64_t target, uint64_t upper_target,
+    uint64_t max_count,
+    std::vector<size_t>* selection, int64_t* best_waste,
+    bool* is_completed) {
+  // [lower, upper] の範囲となるindexの範囲を取得する (降順配列)
+  auto get_range = [&values](
+                       uint64_t lower, uint64_t upper, size_t start,
+                       size_t* range_begin, size_t* range_end) {
+    auto begin = values.begin() + start;
+    *range_begin = static_cast<size_t>(
+        std::lower_bound(begin, values.end(), upper,
+                         std::greater<uint64_t>()) -
+        values.begin());
+    *range_end = static_cast<size_t>(
+        std::upper_bound(begin, values.end(), lower,
+                         std::greater<uint64_t>()) -
+        values.begin());
+  };
+
+  const size_t utxo_count = values.size();
+  uint64_t count = 0;
+  bool is_found = false;
+  auto apply = [&](size_t index1, size_t index2, uint64_t total) {
+    uint64_t input_count = input_counts[index1];
+    uint64_t weight = weights[index1];
+    int64_t waste = wastes[index1] + static_cast<int64_t>(total - target);
+    if (index2 != index1) {
+      input_count += input_counts[index2];
+      weight += weights[index2];
+      waste += wastes[index2];
+    }
+    if ((input_count > max_input_count) || (weight > max_weight)) return;
+    if ((!is_found) || (waste < *best_waste)) {
+      selection->clear();
+      selection->push_back(index1);
+      if (index2 != index1) selection->push_back(index2);
+      *best_waste = waste;
+      is_found = true;
+    }
+  };
+
+  // single utxo
+  size_t range_begin = 0;
+  size_t range_end = 0;
+  get_range(target, upper_target, 0, &range_begin, &range_end);
+  for (size_t index = range_begin; index < range_end; ++index) {
+    if (++count > max_count) {
+      *is_completed = false;
+      return is_found;
+    }
+    apply(index, index, values[index]);
+  }
+
+  // two utxos (index1 < index2)
+  for (size_t index1 = 0; index1 + 1 < utxo_count; ++index1) {
+    const uint64_t value = values[index1];
+    if (value + values[index1 + 1] < target) break;  // 以降も収集額未満
+    if (value >= upper_target) continue;
+    uint64_t lower = (target > value) ? target - value : 0;
+    get_range(lower, upper_target - value, index1 + 1, &range_begin,
+              &range_end);
+    for (size_t index2 = range_begin; index2 < range_end; ++index2) {
+      if (++count > max_count) {
+        *is_completed = false;
+        return is_found;
+      }
+      apply(index1, index2, value + values[index2]);
+    }
+  }
+  *is_completed = true;
+  return is_found;
+}
+
+/**
+ * @brief 選択したUTXOのwasteを取得する.
+ * @details UTXO毎の(fee - long_term_fee)の合計に、お釣りを作成する場合は
+ *   お釣りのコストを、作成しない場合は超過額を加算した値となる。
+ * @param[in] indexes         選択したUTXOのindex一覧
+ * @param[in] utxo_pool       UTXOプール
+ * @param[in] target_value    収集額
+ * @param[in] cost_of_change  お釣り出力のコスト
+ * @return waste
+ */
+static int64_t GetSelectionWaste(
+    const std::vector<size_t>& indexes, const UtxoPool& utxo_pool,
+    uint64_t target_value, uint64_t cost_of_change) {
+  const std::vector<uint64_t>& values = utxo_pool.GetEffectiveValues();
+  const std::vector<uint64_t>& fees = utxo_pool.GetFees();
+  const std::vector<uint64_t>& long_term_fees = utxo_pool.GetLongTermFees();
+  int64_t waste = 0;
+  uint64_t total = 0;
+  for (size_t index : indexes) {
+    total += values[index];
+    waste += static_cast<int64_t>(fees[index]) -
+             static_cast<int64_t>(long_term_fees[index]);
+  }
+  uint64_t excess = (total > target_value) ? total - target_value : 0;
+  waste += static_cast<int64_t>(std::min(excess, cost_of_change));
+  return waste;
+}
+
+/**
+ * @brief 選択結果の評価情報を設定する.
+ * @param[in] indexes         選択したUTXOのindex一覧
+ * @param[in] utxo_pool       UTXOプール
+ * @param[in] target_value    収集額
+ * @param[in] tx_fee_value    TxIn以外のfee
+ * @param[in] option_params   オプション情報
+ * @param[in] solver          選択結果を決定したアルゴリズム
+ * @param[in] bnb_statistics  BnB探索の統計情報
+ * @param[out] report         評価情報
+ */
+static void SetCoinSelectionReport(
+    const std::vector<size_t>& indexes, const UtxoPool& utxo_pool,
+    const Amount& target_value, const Amount& tx_fee_value,
+    const CoinSelectionOption& option_params, CoinSelectionSolver solver,
+    const BnBSearchStatistics& bnb_statistics, CoinSelectionReport* report) {
+  uint64_t target = 0;
+  if (target_value.GetSatoshiValue() > 0) {
+    target += static_cast<uint64_t>(target_value.GetSatoshiValue());
+  }
+  if (tx_fee_value.GetSatoshiValue() > 0) {
+    target += static_cast<uint64_t>(tx_fee_value.GetSatoshiValue());
+  }
+  uint64_t cost_of_change =
+      static_cast<uint64_t>(GetCostOfChange(option_params).GetSatoshiValue());
+
+  CoinSelectionReport result;
+  result.solver = solver;
+  result.input_count = static_cast<uint32_t>(indexes.size());
+  result.target_value = target;
+  result.cost_of_change = cost_of_change;
+  result.bnb_statistics = bnb_statistics;
+  const std::vector<uint64_t>& values = utxo_pool.GetEffectiveValues();
+  const std::vector<uint64_t>& fees = utxo_pool.GetFees();
+  for (size_t index : indexes) {
+    result.selected_value += values[index];
+    result.input_fee += fees[index];
+  }
+  result.waste =
+      GetSelectionWaste(indexes, utxo_pool, target, cost_of_change);
+
+  // お釣りのコスト以下の超過額はお釣りを作成せずfeeとなる
+  uint64_t excess = (result.selected_value > target)
+                        ? result.selected_value - target
+                        : 0;
+  if (excess > cost_of_change) {
+    uint64_t change_fee = 0;
+    if (option_params.GetEffectiveFeeBaserate() != 0) {
+      FeeCalculator effective_fee(option_params.GetEffectiveFeeBaserate());
+      change_fee = static_cast<uint64_t>(
+          effective_fee.GetFee(option_params.GetChangeOutputSize())
+              .GetSatoshiValue());
+    }
+    result.has_change = true;
+    result.change_value = (excess > change_fee) ? excess - change_fee : 0;
+  }
+  *report = result;
+}
+
+/**
+ * @brief 指定順にUTXOを収集する.
+ * @details 収集額に達し、お釣り無しの範囲かお釣りの最小額以上となった時点で終了する。
+ *   全UTXOを収集してもこれを満たさない場合は、収集額に達していれば採用する。
+ *   weightの上限を超えるUTXOは読み飛ばし、TxIn数の上限に達した時点で打ち切る。
+ * @param[in] order       UTXOの収集順 (utxo_pool上のindex)
+ * @param[in] parameter   選択条件
+ * @param[in] utxo_pool   UTXOプール
+ * @return 選択したUTXOのindex一覧。空の場合は未検出。
+ */
+static std::vector<size_t> SelectCoinsByOrder(
+    const std::vector<size_t>& order, const CoinSelectionParameter& parameter,
+    const UtxoPool& utxo_pool) {
+  const std::vector<uint64_t>& values = utxo_pool.GetEffectiveValues();
+  const std::vector<uint64_t>& weights = utxo_pool.GetWeights();
+  const std::vector<uint32_t>& input_counts = utxo_pool.GetInputCounts();
+  const uint64_t target = parameter.target_value;
+  const uint64_t input_count_limit = GetInputLimit(parameter.max_input_count);
+  const uint64_t weight_limit = GetInputLimit(parameter.max_weight);
+  std::vector<size_t> result;
+  uint64_t total = 0;
+  uint64_t input_count = 0;
+  uint64_t weight = 0;
+  for (size_t index : order) {
+    if (input_count >= input_count_limit) break;
+    if ((input_count + input_counts[index] > input_count_limit) ||
+        (weight + weights[index] > weight_limit)) {
+      continue;
+    }
+    result.push_back(index);
+    total += values[index];
+    input_count += input_counts[index];
+    weight += weights[index];
+    if ((total >= target) && ((total <= target + parameter.cost_of_change) ||
+                              (total >= target + parameter.min_change))) {
+      return result;
+    }
+  }
+  if (total < target) result.clear();
+  return result;
+}
+
+/**
+ * @brief 有効額で並べ替えたUTXOのindex一覧を取得する.
+ * @param[in] utxo_pool     UTXOプール
+ * @param[in] descending    降順にするかどうか
+ * @return index一覧
+ */
+static std::vector<size_t> GetOrderByEffectiveValue(
+    const UtxoPool& utxo_pool, bool descending) {
+  const std::vector<uint64_t>& values = utxo_pool.GetEffectiveValues();
+  std::vector<size_t> order(utxo_pool.GetSize());
+  for (size_t index = 0; index < order.size(); ++index) {
+    order[index] = index;
+  }
+  if (descending) {
+    std::stable_sort(order.begin(), order.end(), [&values](size_t a, size_t b) {
+      return values[a] > values[b];
+    });
+  } else {
+    std::stable_sort(order.begin(), order.end(), [&values](size_t a, size_t b) {
+      return values[a] < values[b];
+    });
+  }
+  return order;
+}
+
+// -----------------------------------------------------------------------------
+// CoinSelectionRandom
+// -----------------------------------------------------------------------------
+/**
+ * @brief splitmix64により次の値を取得する.
+ * @param[in,out] value   状態値
+ * @return 乱数
+ */
+static uint64_t GetSplitMix64(uint64_t* value) {
+  uint64_t result = (*value += 0x9e3779b97f4a7c15ULL);
+  result = (result ^ (result >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  result = (result ^ (result >> 27)) * 0x94d049bb133111ebULL;
+  return result ^ (result >> 31);
+}
+
+/**
+ * @brief 64bit値を左ローテートする.
+ * @param[in] value   値
+ * @param[in] count   ローテート数
+ * @return ローテート後の値
+ */
+static inline uint64_t RotateLeft(uint64_t value, int count) {
+  return (value << count) | (value >> (64 - count));
+}
+
+/**
+ * @brief 下位から連続する0のbit数を取得する.
+ * @param[in] value   値 (0以外)
+ * @return 0のbit数
+ */
+static inline uint32_t CountTrailingZero(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<uint32_t>(__builtin_ctzll(value));
+#else
+  uint32_t count = 0;
+  while ((value & 1) == 0) {
+    value >>= 1;
+    ++count;
+  }
+  return count;
+#endif
+}
+
+/**
+ * @brief descriptorから算出したサイズ情報をUTXOに設定する.
+ * @param[in] size_data             txin size data
+ * @param[in] is_set_locking_script locking scriptを設定するかどうか
+ * @param[in,out] utxo              utxo
+ */
+static void SetDescriptorTxInSizeData(
+    const DescriptorTxInSizeData& size_data, bool is_set_locking_script,
+    Utxo* utxo) {
+  utxo->address_type = static_cast<uint16_t>(size_data.address_type);
+  utxo->uscript_size_max =
+      static_cast<uint16_t>(size_data.unlocking_script_size);
+  utxo->witness_size_max = static_cast<uint16_t>(size_data.witness_size);
+  if (is_set_locking_script && (!size_data.locking_script.IsEmpty())) {
+    const std::vector<uint8_t> script =
+        size_data.locking_script.GetData().GetBytes();
+    if (script.size() < sizeof(utxo->locking_script)) {
+      memcpy(utxo->locking_script, script.data(), script.size());
+      utxo->script_length = static_cast<uint16_t>(script.size());
+    }
+  }
+}
+
+CoinSelectionRandom::CoinSelectionRandom(uint64_t seed)
+    : bool_cache_(0), bool_cache_count_(0) {
+  // xoshiro256**の推奨に従い、splitmix64で内部状態を初期化する
+  uint64_t value = seed;
+  for (uint64_t& state : state_) {
+    state = GetSplitMix64(&value);
+  }
+}
+
+uint64_t CoinSelectionRandom::GetRandom() {
+  const uint64_t result = RotateLeft(state_[1] * 5, 7) * 9;
+  const uint64_t temp = state_[1] << 17;
+  state_[2] ^= state_[0];
+  state_[3] ^= state_[1];
+  state_[1] ^= state_[2];
+  state_[0] ^= state_[3];
+  state_[2] ^= temp;
+  state_[3] = RotateLeft(state_[3], 45);
+  return result;
+}
+
+bool CoinSelectionRandom::GetRandomBool() {
+  if (bool_cache_count_ == 0) {
+    bool_cache_ = GetRandom();
+    bool_cache_count_ = 64;
+  }
+  bool result = (bool_cache_ & 1) != 0;
+  bool_cache_ >>= 1;
+  --bool_cache_count_;
+  return result;
+}
+
+uint64_t CoinSelectionRandom::GetRandomBits(uint32_t count) {
+  if (count == 0) return 0;
+  if (count > 64) count = 64;
+  uint64_t result;
+  if (count <= bool_cache_count_) {
+    if (count == 64) {
+      result = bool_cache_;
+      bool_cache_ = 0;
+    } else {
+      result = bool_cache_ & ((1ULL << count) - 1);
+      bool_cache_ >>= count;
+    }
+    bool_cache_count_ -= count;
+    return result;
+  }
+
+  // 残りのbitを下位に、新しい乱数のbitを上位に詰める
+  uint32_t remain = bool_cache_count_;
+  uint32_t need = count - remain;
+  uint64_t value = GetRandom();
+  result = bool_cache_;
+  if (need == 64) {
+    result = value;
+    bool_cache_ = 0;
+  } else {
+    result |= (value & ((1ULL << need) - 1)) << remain;
+    bool_cache_ = value >> need;
+  }
+  bool_cache_count_ = 64 - need;
+  return result;
+}
+
+uint64_t CoinSelectionRandom::GenerateSeed() {
+  static thread_local CoinSelectionRandom seed_random([]() {
+    std::random_device device;
+    return (static_cast<uint64_t>(device()) << 32) ^ device();
+  }());
+  return seed_random.GetRandom();
+}
+
+// -----------------------------------------------------------------------------
+// CoinSelectionThreadPool
+// -----------------------------------------------------------------------------
+CoinSelectionThreadPool::CoinSelectionThreadPool(size_t thread_count)
+    : next_index_(0) {
+  threads_.reserve(thread_count);
+  for (size_t count = 0; count < thread_count; ++count) {
+    try {
+      threads_.emplace_back(&CoinSelectionThreadPool::WorkerMain, this);
+    } catch (const std::system_error& except) {
+      // 生成済みのスレッドのみで動作する
+      warn(
+          CFD_LOG_SOURCE, "Failed to create thread. count={}, error={}",
+          count, except.what());
+      break;
+    }
+  }
+}
+
+CoinSelectionThreadPool::~CoinSelectionThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_stop_ = true;
+  }
+  start_cond_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+size_t CoinSelectionThreadPool::GetThreadCount() const {
+  return threads_.size();
+}
+
+void CoinSelectionThreadPool::Run(
+    size_t task_count, const std::function<void(size_t)>& task,
+    size_t max_parallel) {
+  // 実行中(再入を含む)の場合は呼び出し元スレッドで逐次実行する
+  std::unique_lock<std::mutex> run_lock(run_mutex_, std::try_to_lock);
+  if ((!run_lock.owns_lock()) || threads_.empty() || (task_count <= 1) ||
+      (max_parallel == 1)) {
+    for (size_t index = 0; index < task_count; ++index) {
+      task(index);
+    }
+    return;
+  }
+
+  size_t worker_count = std::min(threads_.size(), task_count - 1);
+  if ((max_parallel != 0) && (worker_count > max_parallel - 1)) {
+    worker_count = max_parallel - 1;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    task_count_ = task_count;
+    next_index_.store(0);
+    worker_slots_ = worker_count;
+    error_ = nullptr;
+    ++generation_;
+  }
+  start_cond_.notify_all();
+  RunTasks();
+
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // 未参加のワーカーは参加させずに完了とする
+    worker_slots_ = 0;
+    done_cond_.wait(lock, [this]() { return running_count_ == 0; });
+    task_ = nullptr;
+    error = error_;
+    error_ = nullptr;
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+CoinSelectionThreadPool* CoinSelectionThreadPool::GetDefault() {
+  static CoinSelectionThreadPool default_pool([]() {
+    size_t count = std::thread::hardware_concurrency();
+    return (count > 1) ? count - 1 : 1;
+  }());
+  return &default_pool;
+}
+
+void CoinSelectionThreadPool::WorkerMain() {
+  uint64_t generation = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    start_cond_.wait(lock, [this, &generation]() {
+      return is_stop_ || ((generation_ != generation) && (worker_slots_ != 0));
+    });
+    if (is_stop_) return;
+    generation = generation_;
+    --worker_slots_;
+    ++running_count_;
+    lock.unlock();
+    RunTasks();
+    lock.lock();
+    if (--running_count_ == 0) done_cond_.notify_all();
+  }
+}
+
+void CoinSelectionThreadPool::RunTasks() {
+  size_t index;
+  while ((index = next_index_.fetch_add(1)) < task_count_) {
+    try {
+      (*task_)(index);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) error_ = std::current_exception();
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// CoinSelectionStrategy
+// -----------------------------------------------------------------------------
+std::vector<size_t> SingleRandomDrawStrategy::Select(
+    const CoinSelectionParameter& parameter, const UtxoPool& utxo_pool,
+    CoinSelectionRandom* random) const {
+  if (random == nullptr) {
+    warn(CFD_LOG_SOURCE, "random is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to select coin. random is nullptr.");
+  }
+  std::vector<size_t> order(utxo_pool.GetSize());
+  for (size_t index = 0; index < order.size(); ++index) {
+    order[index] = index;
+  }
+  // Fisher-Yates shuffle
+  for (size_t index = order.size(); index > 1; --index) {
+    size_t target = static_cast<size_t>(random->GetRandom() % index);
+    std::swap(order[index - 1], order[target]);
+  }
+  return SelectCoinsByOrder(order, parameter, utxo_pool);
+}
+
+std::vector<size_t> LargestFirstStrategy::Select(
+    const CoinSelectionParameter& parameter, const UtxoPool& utxo_pool,
+    CoinSelectionRandom* /* random */) const {
+  return SelectCoinsByOrder(
+      GetOrderByEffectiveValue(utxo_pool, true), parameter, utxo_pool);
+}
+
+std::vector<size_t> SmallestFirstStrategy::Select(
+    const CoinSelectionParameter& parameter, const UtxoPool& utxo_pool,
+    CoinSelectionRandom* /* random */) const {
+  return SelectCoinsByOrder(
+      GetOrderByEffectiveValue(utxo_pool, false), parameter, utxo_pool);
+}
+
 // -----------------------------------------------------------------------------
 // CoinSelectionOption
 // -----------------------------------------------------------------------------
@@ -82,12 +904,17 @@ CoinSelectionOption::CoinSelectionOption()
     : effective_fee_baserate_(kDefaultLongTermFeeRate),
       long_term_fee_baserate_(kDefaultLongTermFeeRate),
       knapsack_minimum_change_(-1),
-      dust_fee_rate_(kDustRelayTxFeeRate) {
+      dust_fee_rate_(kDustRelayTxFeeRate),
+      bnb_max_tries_(kBnBMaxTotalTries) {
   // do nothing
 }
 
 bool CoinSelectionOption::IsUseBnB() const { return use_bnb_; }
 
+bool CoinSelectionOption::IsUseOutputGroup() const {
+  return use_output_group_;
+}
+
 size_t CoinSelectionOption::GetChangeOutputSize() const {
   return change_output_size_;
 }
@@ -104,6 +931,30 @@ uint64_t CoinSelectionOption::GetLongTermFeeBaserate() const {
   return long_term_fee_baserate_;
 }
 
+bool CoinSelectionOption::HasRandomSeed() const { return has_random_seed_; }
+
+uint64_t CoinSelectionOption::GetRandomSeed() const { return random_seed_; }
+
+uint64_t CoinSelectionOption::GetBnBMaxTries() const { return bnb_max_tries_; }
+
+uint64_t CoinSelectionOption::GetBnBTimeLimit() const {
+  return bnb_time_limit_;
+}
+
+uint32_t CoinSelectionOption::GetMaxInputCount() const {
+  return max_input_count_;
+}
+
+uint64_t CoinSelectionOption::GetMaxWeight() const { return max_weight_; }
+
+CoinSelectionAlgorithm CoinSelectionOption::GetAlgorithm() const {
+  return algorithm_;
+}
+
+const CoinSelectionStrategy* CoinSelectionOption::GetStrategy() const {
+  return strategy_;
+}
+
 int64_t CoinSelectionOption::GetKnapsackMinimumChange() const {
   return knapsack_minimum_change_;
 }
@@ -129,6 +980,10 @@ Amount CoinSelectionOption::GetDustFeeAmount(const Address& address) const {
 
 void CoinSelectionOption::SetUseBnB(bool use_bnb) { use_bnb_ = use_bnb; }
 
+void CoinSelectionOption::SetUseOutputGroup(bool use_output_group) {
+  use_output_group_ = use_output_group;
+}
+
 void CoinSelectionOption::SetChangeOutputSize(size_t size) {
   change_output_size_ = size;
 }
@@ -149,6 +1004,35 @@ void CoinSelectionOption::SetKnapsackMinimumChange(int64_t min_change) {
   knapsack_minimum_change_ = min_change;
 }
 
+void CoinSelectionOption::SetRandomSeed(uint64_t seed) {
+  random_seed_ = seed;
+  has_random_seed_ = true;
+}
+
+void CoinSelectionOption::SetBnBMaxTries(uint64_t max_tries) {
+  bnb_max_tries_ = max_tries;
+}
+
+void CoinSelectionOption::SetBnBTimeLimit(uint64_t time_limit) {
+  bnb_time_limit_ = time_limit;
+}
+
+void CoinSelectionOption::SetMaxInputCount(uint32_t max_input_count) {
+  max_input_count_ = max_input_count;
+}
+
+void CoinSelectionOption::SetMaxWeight(uint64_t max_weight) {
+  max_weight_ = max_weight;
+}
+
+void CoinSelectionOption::SetAlgorithm(CoinSelectionAlgorithm algorithm) {
+  algorithm_ = algorithm;
+}
+
+void CoinSelectionOption::SetStrategy(const CoinSelectionStrategy* strategy) {
+  strategy_ = strategy;
+}
+
 void CoinSelectionOption::SetDustFeeRate(double baserate) {
   dust_fee_rate_ = static_cast<uint64_t>(floor(baserate * 1000));
 }
@@ -161,8 +1045,8 @@ void CoinSelectionOption::InitializeTxSizeInfo() {
   uint32_t size = txout_ref.GetSerializeSize();
   change_output_size_ = AbstractTransaction::GetVsizeFromSize(size, 0);
   uint32_t witness_size = 0;
-  uint32_t total_size = TxIn::EstimateTxInSize(
-      AddressType::kP2wpkhAddress, Script(), &witness_size);
+  uint32_t total_size = TxInSizeTable::GetTxInSize(
+      AddressType::kP2wpkhAddress, &witness_size);
   change_spend_size_ = AbstractTransaction::GetVsizeFromSize(
       (total_size - witness_size), witness_size);
 }
@@ -200,6 +1084,23 @@ Amount CoinSelectionOption::GetConfidentialDustFeeAmount(
   return dust_fee.GetFee(size);
 }
 
+uint32_t CoinSelectionOption::GetAssetSelectionThreadCount() const {
+  return asset_thread_count_;
+}
+
+void CoinSelectionOption::SetAssetSelectionThreadCount(uint32_t thread_count) {
+  asset_thread_count_ = thread_count;
+}
+
+CoinSelectionThreadPool* CoinSelectionOption::GetThreadPool() const {
+  return thread_pool_;
+}
+
+void CoinSelectionOption::SetThreadPool(
+    CoinSelectionThreadPool* thread_pool) {
+  thread_pool_ = thread_pool;
+}
+
 void CoinSelectionOption::InitializeConfidentialTxSizeInfo() {
   uint32_t size;
   uint32_t witness_size = 0;
@@ -215,14 +1116,645 @@ void CoinSelectionOption::InitializeConfidentialTxSizeInfo() {
       (size - witness_size), witness_size);
 
   witness_size = 0;
-  size = ConfidentialTxIn::EstimateTxInSize(
-      AddressType::kP2wpkhAddress, Script(), 0, Script(), false, false,
-      &witness_size);
+  size = TxInSizeTable::GetConfidentialTxInSize(
+      AddressType::kP2wpkhAddress, false, false, &witness_size);
   change_spend_size_ = AbstractTransaction::GetVsizeFromSize(
       (size - witness_size), witness_size);
 }
 #endif  // CFD_DISABLE_ELEMENTS
 
+// -----------------------------------------------------------------------------
+// UtxoPool
+// -----------------------------------------------------------------------------
+UtxoPool::UtxoPool() {
+  // do nothing
+}
+
+void UtxoPool::Reserve(size_t size) {
+  effective_values_.reserve(size);
+  amounts_.reserve(size);
+  fees_.reserve(size);
+  long_term_fees_.reserve(size);
+  weights_.reserve(size);
+  input_counts_.reserve(size);
+  utxos_.reserve(size);
+}
+
+void UtxoPool::Clear() {
+  effective_values_.clear();
+  amounts_.clear();
+  fees_.clear();
+  long_term_fees_.clear();
+  weights_.clear();
+  input_counts_.clear();
+  utxos_.clear();
+}
+
+void UtxoPool::Add(
+    const Utxo* utxo, uint64_t effective_value, uint64_t fee,
+    uint64_t long_term_fee) {
+  Add(utxo, (utxo == nullptr) ? 0 : utxo->amount, effective_value, fee,
+      long_term_fee);
+}
+
+void UtxoPool::Add(
+    const Utxo* utxo, uint64_t amount, uint64_t effective_value, uint64_t fee,
+    uint64_t long_term_fee) {
+  if (utxo == nullptr) {
+    warn(CFD_LOG_SOURCE, "utxo is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to add utxo pool. utxo is nullptr.");
+  }
+  Add(utxo, amount, effective_value, fee, long_term_fee,
+      FeeCalculator::GetTxInWeight(*utxo), 1);
+}
+
+void UtxoPool::Add(
+    const Utxo* utxo, uint64_t amount, uint64_t effective_value, uint64_t fee,
+    uint64_t long_term_fee, uint64_t weight, uint32_t input_count) {
+  if (utxo == nullptr) {
+    warn(CFD_LOG_SOURCE, "utxo is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to add utxo pool. utxo is nullptr.");
+  }
+  effective_values_.push_back(effective_value);
+  amounts_.push_back(amount);
+  fees_.push_back(fee);
+  long_term_fees_.push_back(long_term_fee);
+  weights_.push_back(weight);
+  input_counts_.push_back(input_count);
+  utxos_.push_back(utxo);
+}
+
+size_t UtxoPool::GetSize() const { return utxos_.size(); }
+
+bool UtxoPool::IsEmpty() const { return utxos_.empty(); }
+
+const std::vector<uint64_t>& UtxoPool::GetEffectiveValues() const {
+  return effective_values_;
+}
+
+const std::vector<uint64_t>& UtxoPool::GetAmounts() const { return amounts_; }
+
+const std::vector<uint64_t>& UtxoPool::GetFees() const { return fees_; }
+
+const std::vector<uint64_t>& UtxoPool::GetLongTermFees() const {
+  return long_term_fees_;
+}
+
+const std::vector<uint64_t>& UtxoPool::GetWeights() const { return weights_; }
+
+const std::vector<uint32_t>& UtxoPool::GetInputCounts() const {
+  return input_counts_;
+}
+
+const Utxo* UtxoPool::GetUtxo(size_t index) const { return utxos_.at(index); }
+
+Utxo UtxoPool::CopyUtxo(size_t index) const {
+  Utxo utxo = *utxos_.at(index);
+  utxo.effective_value = effective_values_[index];
+  utxo.fee = fees_[index];
+  utxo.long_term_fee = long_term_fees_[index];
+  return utxo;
+}
+
+UtxoPool UtxoPool::GetSortedByEffectiveValue(
+    std::vector<size_t>* source_indexes) const {
+  std::vector<size_t> indexes(utxos_.size());
+  for (size_t index = 0; index < indexes.size(); ++index) {
+    indexes[index] = index;
+  }
+  const std::vector<uint64_t>& values = effective_values_;
+  std::stable_sort(
+      indexes.begin(), indexes.end(),
+      [&values](size_t a, size_t b) { return values[a] > values[b]; });
+
+  UtxoPool result;
+  result.Reserve(indexes.size());
+  for (size_t index : indexes) {
+    result.effective_values_.push_back(effective_values_[index]);
+    result.amounts_.push_back(amounts_[index]);
+    result.fees_.push_back(fees_[index]);
+    result.long_term_fees_.push_back(long_term_fees_[index]);
+    result.weights_.push_back(weights_[index]);
+    result.input_counts_.push_back(input_counts_[index]);
+    result.utxos_.push_back(utxos_[index]);
+  }
+  if (source_indexes != nullptr) *source_indexes = indexes;
+  return result;
+}
+
+// -----------------------------------------------------------------------------
+// UtxoOutPoint / UtxoOutPointHash / UtxoOutPointEqual
+// -----------------------------------------------------------------------------
+UtxoOutPoint UtxoOutPoint::Create(const Txid& txid, uint32_t vout) {
+  UtxoOutPoint outpoint;
+  memset(&outpoint, 0, sizeof(outpoint));
+  std::vector<uint8_t> txid_bytes = txid.GetData().GetBytes();
+  if (txid_bytes.size() == sizeof(outpoint.txid)) {
+    memcpy(outpoint.txid, txid_bytes.data(), sizeof(outpoint.txid));
+  }
+  outpoint.vout = vout;
+  return outpoint;
+}
+
+UtxoOutPoint UtxoOutPoint::Create(const Utxo& utxo) {
+  UtxoOutPoint outpoint;
+  memset(&outpoint, 0, sizeof(outpoint));
+  memcpy(outpoint.txid, utxo.txid, sizeof(outpoint.txid));
+  outpoint.vout = utxo.vout;
+  return outpoint;
+}
+
+size_t UtxoOutPointHash::operator()(const UtxoOutPoint& outpoint) const {
+  // txidはハッシュ値のため、先頭部分をそのまま利用する
+  uint64_t value = 0;
+  memcpy(&value, outpoint.txid, sizeof(value));
+  value ^= static_cast<uint64_t>(outpoint.vout) * 0x9e3779b97f4a7c15ULL;
+  return static_cast<size_t>(value);
+}
+
+bool UtxoOutPointEqual::operator()(
+    const UtxoOutPoint& lhs, const UtxoOutPoint& rhs) const {
+  return (lhs.vout == rhs.vout) &&
+         (memcmp(lhs.txid, rhs.txid, sizeof(lhs.txid)) == 0);
+}
+
+// -----------------------------------------------------------------------------
+// UtxoIndex
+// -----------------------------------------------------------------------------
+UtxoIndex::UtxoIndex() {
+  // do nothing
+}
+
+void UtxoIndex::Add(const Utxo& utxo) {
+  UtxoOutPoint outpoint = UtxoOutPoint::Create(utxo);
+  if (positions_.find(outpoint) != positions_.end()) {
+    warn(CFD_LOG_SOURCE, "Failed to add utxo index. utxo already exists.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to add utxo index. utxo already exists.");
+  }
+  // dequeの末尾追加では既存要素の参照は無効化されない
+  utxos_.push_back(utxo);
+  positions_.emplace(outpoint, utxos_.size() - 1);
+
+  const Utxo* added = &utxos_.back();
+  for (auto& cache : fee_pools_) {
+    AddFeePoolUtxo(
+        added, FeeCalculator(cache.first.first),
+        FeeCalculator(cache.first.second), &cache.second);
+  }
+}
+
+void UtxoIndex::Update(const Utxo& utxo) {
+  auto iter = positions_.find(UtxoOutPoint::Create(utxo));
+  if (iter == positions_.end()) {
+    warn(CFD_LOG_SOURCE, "Failed to update utxo index. utxo not found.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to update utxo index. utxo not found.");
+  }
+  size_t position = iter->second;
+  Utxo& target = utxos_[position];
+  target = utxo;
+
+  for (auto& cache : fee_pools_) {
+    FeeCalculator effective_fee(cache.first.first);
+    FeeCalculator long_term_fee(cache.first.second);
+    UtxoPool& pool = cache.second;
+    pool.effective_values_[position] = target.amount;
+    pool.amounts_[position] = target.amount;
+    pool.fees_[position] = static_cast<uint64_t>(
+        effective_fee.GetFee(target).GetSatoshiValue());
+    pool.long_term_fees_[position] = static_cast<uint64_t>(
+        long_term_fee.GetFee(target).GetSatoshiValue());
+    pool.weights_[position] = FeeCalculator::GetTxInWeight(target);
+  }
+}
+
+bool UtxoIndex::Spend(const Txid& txid, uint32_t vout) {
+  auto iter = positions_.find(UtxoOutPoint::Create(txid, vout));
+  if (iter == positions_.end()) return false;
+
+  // 末尾要素を削除位置へ移動して詰める
+  size_t position = iter->second;
+  size_t last = utxos_.size() - 1;
+  positions_.erase(iter);
+  if (position != last) {
+    utxos_[position] = utxos_[last];
+    positions_[UtxoOutPoint::Create(utxos_[position])] = position;
+  }
+  utxos_.pop_back();
+
+  for (auto& cache : fee_pools_) {
+    UtxoPool& pool = cache.second;
+    if (position != last) {
+      pool.effective_values_[position] = pool.effective_values_[last];
+      pool.amounts_[position] = pool.amounts_[last];
+      pool.fees_[position] = pool.fees_[last];
+      pool.long_term_fees_[position] = pool.long_term_fees_[last];
+      pool.weights_[position] = pool.weights_[last];
+      pool.input_counts_[position] = pool.input_counts_[last];
+      // utxos_[position] の参照先は移動後の要素を示すため変更不要
+    }
+    pool.effective_values_.pop_back();
+    pool.amounts_.pop_back();
+    pool.fees_.pop_back();
+    pool.long_term_fees_.pop_back();
+    pool.weights_.pop_back();
+    pool.input_counts_.pop_back();
+    pool.utxos_.pop_back();
+  }
+  return true;
+}
+
+const Utxo* UtxoIndex::Find(const Txid& txid, uint32_t vout) const {
+  auto iter = positions_.find(UtxoOutPoint::Create(txid, vout));
+  if (iter == positions_.end()) return nullptr;
+  return &utxos_[iter->second];
+}
+
+void UtxoIndex::Clear() {
+  utxos_.clear();
+  positions_.clear();
+  fee_pools_.clear();
+  fee_pool_access_.clear();
+}
+
+size_t UtxoIndex::GetSize() const { return utxos_.size(); }
+
+const Utxo* UtxoIndex::GetUtxo(size_t index) const {
+  return &utxos_.at(index);
+}
+
+const UtxoPool& UtxoIndex::GetFeePool(
+    uint64_t effective_fee_baserate, uint64_t long_term_fee_baserate) {
+  FeeRateKey key(effective_fee_baserate, long_term_fee_baserate);
+  ++fee_pool_access_count_;
+  auto iter = fee_pools_.find(key);
+  if (iter != fee_pools_.end()) {
+    fee_pool_access_[key] = fee_pool_access_count_;
+    return iter->second;
+  }
+
+  if (fee_pools_.size() >= kUtxoIndexFeePoolCacheMax) {
+    // 最も長く参照されていないプールのみを破棄する
+    auto oldest = fee_pool_access_.begin();
+    for (auto access = fee_pool_access_.begin();
+         access != fee_pool_access_.end(); ++access) {
+      if (access->second < oldest->second) oldest = access;
+    }
+    fee_pools_.erase(oldest->first);
+    fee_pool_access_.erase(oldest);
+  }
+  fee_pool_access_[key] = fee_pool_access_count_;
+  UtxoPool& pool = fee_pools_[key];
+  FeeCalculator effective_fee(effective_fee_baserate);
+  FeeCalculator long_term_fee(long_term_fee_baserate);
+  pool.Reserve(utxos_.size());
+  for (const auto& utxo : utxos_) {
+    AddFeePoolUtxo(&utxo, effective_fee, long_term_fee, &pool);
+  }
+  return pool;
+}
+
+// -----------------------------------------------------------------------------
+// UtxoReservationSet
+// -----------------------------------------------------------------------------
+UtxoReservationSet::UtxoReservationSet(const std::vector<Utxo>& utxos)
+    : utxos_(utxos),
+      positions_(),
+      states_(new std::atomic<uint64_t>[utxos.size()]),
+      deadlines_(new std::atomic<uint64_t>[utxos.size()]),
+      sequence_(0),
+      base_time_(std::chrono::steady_clock::now()),
+      fee_index_(),
+      fee_index_mutex_() {
+  positions_.reserve(utxos_.size());
+  for (size_t index = 0; index < utxos_.size(); ++index) {
+    if (!positions_.emplace(UtxoOutPoint::Create(utxos_[index]), index)
+             .second) {
+      warn(
+          CFD_LOG_SOURCE,
+          "Failed to create utxo reservation set. utxo already exists.");
+      throw CfdException(
+          CfdError::kCfdIllegalArgumentError,
+          "Failed to create utxo reservation set. utxo already exists.");
+    }
+    states_[index].store(kReservationStateFree, std::memory_order_relaxed);
+    deadlines_[index].store(kReservationNoDeadline, std::memory_order_relaxed);
+    fee_index_.Add(utxos_[index]);
+  }
+}
+
+size_t UtxoReservationSet::GetSize() const { return utxos_.size(); }
+
+const Utxo* UtxoReservationSet::GetUtxo(size_t index) const {
+  return &utxos_.at(index);
+}
+
+bool UtxoReservationSet::Find(
+    const Txid& txid, uint32_t vout, size_t* index) const {
+  auto iter = positions_.find(UtxoOutPoint::Create(txid, vout));
+  if (iter == positions_.end()) return false;
+  if (index != nullptr) *index = iter->second;
+  return true;
+}
+
+UtxoReservationState UtxoReservationSet::GetState(size_t index) const {
+  if (index >= utxos_.size()) {
+    warn(CFD_LOG_SOURCE, "Failed to get state. index out of range.");
+    throw CfdException(
+        CfdError::kCfdOutOfRangeError,
+        "Failed to get state. index out of range.");
+  }
+  uint64_t state = states_[index].load(std::memory_order_acquire);
+  if (state == kReservationStateSpent) return kUtxoReservationSpent;
+  if (IsReservationAvailable(index, state, GetElapsedTime())) {
+    return kUtxoReservationFree;
+  }
+  return kUtxoReservationReserved;
+}
+
+void UtxoReservationSet::GetFreeFeePool(
+    uint64_t effective_fee_baserate, uint64_t long_term_fee_baserate,
+    UtxoPool* fee_pool) {
+  if (fee_pool == nullptr) {
+    warn(CFD_LOG_SOURCE, "Outparameter(fee_pool) is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to get fee pool. Outparameter is nullptr.");
+  }
+  const uint64_t elapsed_time = GetElapsedTime();
+  fee_pool->Clear();
+  fee_pool->Reserve(utxos_.size());
+
+  // fee計算済みのプールから未予約のUTXOのみを複写する
+  std::lock_guard<std::mutex> lock(fee_index_mutex_);
+  const UtxoPool& cache =
+      fee_index_.GetFeePool(effective_fee_baserate, long_term_fee_baserate);
+  const std::vector<uint64_t>& amounts = cache.GetAmounts();
+  const std::vector<uint64_t>& effective_values = cache.GetEffectiveValues();
+  const std::vector<uint64_t>& fees = cache.GetFees();
+  const std::vector<uint64_t>& long_term_fees = cache.GetLongTermFees();
+  const std::vector<uint64_t>& weights = cache.GetWeights();
+  const std::vector<uint32_t>& input_counts = cache.GetInputCounts();
+  for (size_t index = 0; index < utxos_.size(); ++index) {
+    uint64_t state = states_[index].load(std::memory_order_acquire);
+    if (!IsReservationAvailable(index, state, elapsed_time)) continue;
+    fee_pool->Add(
+        &utxos_[index], amounts[index], effective_values[index], fees[index],
+        long_term_fees[index], weights[index], input_counts[index]);
+  }
+}
+
+bool UtxoReservationSet::Reserve(
+    const std::vector<size_t>& indexes, uint64_t timeout_msec,
+    UtxoReservation* reservation) {
+  if (reservation == nullptr) {
+    warn(CFD_LOG_SOURCE, "Outparameter(reservation) is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to reserve utxo. Outparameter is nullptr.");
+  }
+  for (size_t index : indexes) {
+    if (index >= utxos_.size()) {
+      warn(CFD_LOG_SOURCE, "Failed to reserve utxo. index out of range.");
+      throw CfdException(
+          CfdError::kCfdOutOfRangeError,
+          "Failed to reserve utxo. index out of range.");
+    }
+  }
+  std::vector<size_t> target_indexes = indexes;
+  std::sort(target_indexes.begin(), target_indexes.end());
+  target_indexes.erase(
+      std::unique(target_indexes.begin(), target_indexes.end()),
+      target_indexes.end());
+
+  const uint64_t elapsed_time = GetElapsedTime();
+  uint64_t deadline = kReservationNoDeadline;
+  if ((timeout_msec != 0) &&
+      (timeout_msec < kReservationNoDeadline - elapsed_time)) {
+    deadline = elapsed_time + timeout_msec;
+  }
+  // 予約IDは64bitの連番のため、インスタンス内で一巡しない
+  const uint64_t id = sequence_.fetch_add(1, std::memory_order_relaxed) + 1;
+
+  std::vector<size_t> reserved_indexes;
+  reserved_indexes.reserve(target_indexes.size());
+  bool is_success = true;
+  for (size_t index : target_indexes) {
+    std::atomic<uint64_t>& state = states_[index];
+    uint64_t current = state.load(std::memory_order_acquire);
+    bool is_reserved = false;
+    while (IsReservationAvailable(index, current, elapsed_time)) {
+      // 設定中に変更してから有効期限を書き込み、予約IDを設定する
+      if (state.compare_exchange_weak(
+              current, kReservationStateLocking, std::memory_order_acq_rel,
+              std::memory_order_acquire)) {
+        deadlines_[index].store(deadline, std::memory_order_release);
+        // 設定中にMarkSpentで消費済みとなった場合は予約失敗
+        uint64_t locking = kReservationStateLocking;
+        is_reserved = state.compare_exchange_strong(
+            locking, id, std::memory_order_acq_rel);
+        break;
+      }
+    }
+    if (!is_reserved) {
+      is_success = false;
+      break;
+    }
+    reserved_indexes.push_back(index);
+  }
+
+  if (!is_success) {
+    // rollback
+    for (size_t index : reserved_indexes) {
+      uint64_t expected = id;
+      states_[index].compare_exchange_strong(
+          expected, kReservationStateFree, std::memory_order_acq_rel);
+    }
+    return false;
+  }
+  reservation->id = id;
+  reservation->indexes = reserved_indexes;
+  return true;
+}
+
+size_t UtxoReservationSet::Release(const UtxoReservation& reservation) {
+  size_t count = 0;
+  if (reservation.id == kReservationStateFree) return count;
+  for (size_t index : reservation.indexes) {
+    if (index >= utxos_.size()) continue;
+    uint64_t expected = reservation.id;
+    if (states_[index].compare_exchange_strong(
+            expected, kReservationStateFree, std::memory_order_acq_rel)) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+bool UtxoReservationSet::Commit(const UtxoReservation& reservation) {
+  if ((reservation.id == kReservationStateFree) ||
+      (reservation.id >= kReservationStateLocking)) {
+    return false;
+  }
+  for (size_t index : reservation.indexes) {
+    if (index >= utxos_.size()) return false;
+  }
+
+  // 全UTXOを確定中に変更できた場合のみ消費済みとし、
+  // 予約を失ったUTXOがある場合は予約状態に戻す。
+  std::vector<size_t> marked_indexes;
+  marked_indexes.reserve(reservation.indexes.size());
+  for (size_t index : reservation.indexes) {
+    uint64_t expected = reservation.id;
+    if (!states_[index].compare_exchange_strong(
+            expected, kReservationStateCommitting,
+            std::memory_order_acq_rel)) {
+      for (size_t marked_index : marked_indexes) {
+        uint64_t committing = kReservationStateCommitting;
+        states_[marked_index].compare_exchange_strong(
+            committing, reservation.id, std::memory_order_acq_rel);
+      }
+      return false;
+    }
+    marked_indexes.push_back(index);
+  }
+  for (size_t index : marked_indexes) {
+    // MarkSpentで消費済みとなった場合はそのまま
+    uint64_t committing = kReservationStateCommitting;
+    states_[index].compare_exchange_strong(
+        committing, kReservationStateSpent, std::memory_order_acq_rel);
+  }
+  return true;
+}
+
+bool UtxoReservationSet::MarkSpent(const Txid& txid, uint32_t vout) {
+  size_t index = 0;
+  if (!Find(txid, vout, &index)) return false;
+  states_[index].store(kReservationStateSpent, std::memory_order_release);
+  return true;
+}
+
+uint64_t UtxoReservationSet::GetElapsedTime() const {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - base_time_)
+          .count());
+}
+
+bool UtxoReservationSet::IsReservationAvailable(
+    size_t index, uint64_t state, uint64_t elapsed_time) const {
+  if (state == kReservationStateFree) return true;
+  if (state >= kReservationStateLocking) return false;
+  // 有効期限は予約IDと別領域のため、読込後に予約IDが変わらないことを確認する
+  // (予約IDは再利用しないため、一致すれば同一予約の有効期限となる)
+  uint64_t deadline = deadlines_[index].load(std::memory_order_acquire);
+  if (states_[index].load(std::memory_order_acquire) != state) return false;
+  return (deadline != kReservationNoDeadline) && (deadline <= elapsed_time);
+}
+
+#ifndef CFD_DISABLE_ELEMENTS
+// -----------------------------------------------------------------------------
+// UtxoAssetKeyHash / UtxoAssetKeyEqual
+// -----------------------------------------------------------------------------
+size_t UtxoAssetKeyHash::operator()(const UtxoAssetKey& key) const {
+  // asset idはハッシュ値のため、先頭(version)以降をそのまま利用する
+  uint64_t value = 0;
+  memcpy(&value, &key.asset[1], sizeof(value));
+  value ^= static_cast<uint64_t>(key.asset[0]);
+  return static_cast<size_t>(value);
+}
+
+bool UtxoAssetKeyEqual::operator()(
+    const UtxoAssetKey& lhs, const UtxoAssetKey& rhs) const {
+  return memcmp(lhs.asset, rhs.asset, sizeof(lhs.asset)) == 0;
+}
+
+// -----------------------------------------------------------------------------
+// UtxoAssetBuckets
+// -----------------------------------------------------------------------------
+UtxoAssetBuckets::UtxoAssetBuckets() {
+  // do nothing
+}
+
+void UtxoAssetBuckets::Build(const UtxoPool& fee_pool) {
+  Clear();
+  const std::vector<uint64_t>& amounts = fee_pool.GetAmounts();
+  const std::vector<uint64_t>& fees = fee_pool.GetFees();
+  const std::vector<uint64_t>& long_term_fees = fee_pool.GetLongTermFees();
+  const std::vector<uint64_t>& weights = fee_pool.GetWeights();
+  const std::vector<uint32_t>& input_counts = fee_pool.GetInputCounts();
+  UtxoAssetKey key;
+  UtxoPool* pool = nullptr;
+  for (size_t index = 0; index < fee_pool.GetSize(); ++index) {
+    const Utxo* utxo = fee_pool.GetUtxo(index);
+    // 同一assetが連続する場合はmapの検索を省略する
+    if ((pool == nullptr) ||
+        (memcmp(key.asset, utxo->asset, sizeof(key.asset)) != 0)) {
+      memcpy(key.asset, utxo->asset, sizeof(key.asset));
+      pool = &buckets_[key];
+    }
+    pool->Add(
+        utxo, amounts[index], amounts[index], fees[index],
+        long_term_fees[index], weights[index], input_counts[index]);
+  }
+}
+
+void UtxoAssetBuckets::Build(
+    const Utxo* utxos, size_t utxo_count,
+    const CoinSelectionOption& option_params) {
+  if ((utxos == nullptr) && (utxo_count != 0)) {
+    warn(CFD_LOG_SOURCE, "utxos is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to build utxo buckets. utxos is nullptr.");
+  }
+  Clear();
+  FeeCalculator effective_fee(option_params.GetEffectiveFeeBaserate());
+  FeeCalculator long_term_fee(option_params.GetLongTermFeeBaserate());
+  UtxoAssetKey key;
+  UtxoPool* pool = nullptr;
+  for (size_t index = 0; index < utxo_count; ++index) {
+    const Utxo* utxo = &utxos[index];
+    if ((pool == nullptr) ||
+        (memcmp(key.asset, utxo->asset, sizeof(key.asset)) != 0)) {
+      memcpy(key.asset, utxo->asset, sizeof(key.asset));
+      pool = &buckets_[key];
+    }
+    AddFeePoolUtxo(utxo, effective_fee, long_term_fee, pool);
+  }
+}
+
+void UtxoAssetBuckets::Clear() {
+  // 領域を再利用するため、bucketは削除せずに空にする
+  for (auto& bucket : buckets_) {
+    bucket.second.Clear();
+  }
+}
+
+const UtxoPool* UtxoAssetBuckets::GetPool(
+    const ConfidentialAssetId& asset) const {
+  std::vector<uint8_t> asset_bytes = asset.GetData().GetBytes();
+  if (asset_bytes.size() != sizeof(UtxoAssetKey::asset)) return nullptr;
+  return GetPool(asset_bytes.data());
+}
+
+const UtxoPool* UtxoAssetBuckets::GetPool(const uint8_t* asset) const {
+  if (asset == nullptr) return nullptr;
+  UtxoAssetKey key;
+  memcpy(key.asset, asset, sizeof(key.asset));
+  auto iter = buckets_.find(key);
+  if ((iter == buckets_.end()) || iter->second.IsEmpty()) return nullptr;
+  return &iter->second;
+}
+#endif  // CFD_DISABLE_ELEMENTS
+
 // -----------------------------------------------------------------------------
 // CoinSelection
 // -----------------------------------------------------------------------------
@@ -230,23 +1762,160 @@ CoinSelection::CoinSelection() : use_bnb_(true) {
   // do nothing
 }
 
-CoinSelection::CoinSelection(bool use_bnb) : use_bnb_(use_bnb) {
-  // do nothing
+CoinSelection::CoinSelection(bool use_bnb) : use_bnb_(use_bnb) {
+  // do nothing
+}
+
+std::vector<Utxo> CoinSelection::SelectCoins(
+    const Amount& target_value, const std::vector<Utxo>& utxos,
+    const UtxoFilter& filter, const CoinSelectionOption& option_params,
+    const Amount& tx_fee_value, Amount* select_value, Amount* utxo_fee_value,
+    bool* searched_bnb, BnBSearchStatistics* bnb_statistics,
+    CoinSelectionReport* report) {
+#ifndef CFD_DISABLE_ELEMENTS
+  bool first = true;
+  uint8_t src[33];
+  for (auto& utxo : utxos) {
+    if (first) {
+      memcpy(src, utxo.asset, sizeof(src));
+      first = false;
+    } else if (memcmp(utxo.asset, src, sizeof(src)) != 0) {
+      warn(
+          CFD_LOG_SOURCE,
+          "Failed to SelectCoins. Exists multiple assets in utxo list.");
+      throw CfdException(
+          CfdError::kCfdIllegalStateError,
+          "Failed to SelectCoins. Exists multiple assets in utxo list.");
+    }
+  }
+#endif
+  if (select_value == nullptr) {
+    warn(CFD_LOG_SOURCE, "Outparameter(select_value) is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to select coin. Outparameter is nullptr.");
+  }
+
+  // calculate utxo fee
+  UtxoPool fee_pool;
+  CreateFeePool(utxos.data(), utxos.size(), option_params, &fee_pool);
+
+  // initialize output parameter
+  Amount utxo_fee_out = Amount();
+  bool use_bnb_out = false;
+  CoinSelectionSolver solver = kCoinSelectionSolverNone;
+  BnBSearchStatistics work_statistics;
+  const bool consider_fee = true;
+  UtxoPool utxo_pool;
+  std::vector<size_t> indexes = SelectCoinsMinConf(
+      target_value, fee_pool, filter, option_params, tx_fee_value,
+      consider_fee, &utxo_pool, select_value, &utxo_fee_out, &use_bnb_out,
+      (report != nullptr) ? &work_statistics : bnb_statistics, &solver);
+  if (utxo_fee_value != nullptr) {
+    *utxo_fee_value = utxo_fee_out;
+  }
+  if (searched_bnb != nullptr) {
+    *searched_bnb = use_bnb_out;
+  }
+  if (report != nullptr) {
+    if (bnb_statistics != nullptr) *bnb_statistics = work_statistics;
+    SetCoinSelectionReport(
+        indexes, utxo_pool, target_value, tx_fee_value, option_params, solver,
+        work_statistics, report);
+  }
+
+  std::vector<Utxo> result;
+  result.reserve(indexes.size());
+  for (size_t index : indexes) {
+    result.push_back(utxo_pool.CopyUtxo(index));
+  }
+  return result;
+}
+
+std::vector<size_t> CoinSelection::SelectCoins(
+    const Amount& target_value, const Utxo* utxos, size_t utxo_count,
+    const UtxoFilter& filter, const CoinSelectionOption& option_params,
+    const Amount& tx_fee_value, Amount* select_value, Amount* utxo_fee_value,
+    bool* searched_bnb, UtxoPool* utxo_pool,
+    BnBSearchStatistics* bnb_statistics, CoinSelectionReport* report) {
+  if ((utxos == nullptr) && (utxo_count != 0)) {
+    warn(CFD_LOG_SOURCE, "utxos is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to select coin. utxos is nullptr.");
+  }
+#ifndef CFD_DISABLE_ELEMENTS
+  for (size_t index = 1; index < utxo_count; ++index) {
+    if (memcmp(utxos[index].asset, utxos[0].asset, sizeof(utxos[0].asset)) !=
+        0) {
+      warn(
+          CFD_LOG_SOURCE,
+          "Failed to SelectCoins. Exists multiple assets in utxo list.");
+      throw CfdException(
+          CfdError::kCfdIllegalStateError,
+          "Failed to SelectCoins. Exists multiple assets in utxo list.");
+    }
+  }
+#endif
+  if (select_value == nullptr) {
+    warn(CFD_LOG_SOURCE, "Outparameter(select_value) is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to select coin. Outparameter is nullptr.");
+  }
+
+  UtxoPool fee_pool;
+  CreateFeePool(utxos, utxo_count, option_params, &fee_pool);
+
+  Amount utxo_fee_out = Amount();
+  bool use_bnb_out = false;
+  CoinSelectionSolver solver = kCoinSelectionSolverNone;
+  BnBSearchStatistics work_statistics;
+  const bool consider_fee = true;
+  UtxoPool work_pool;
+  UtxoPool* pool = (utxo_pool != nullptr) ? utxo_pool : &work_pool;
+  std::vector<size_t> indexes = SelectCoinsMinConf(
+      target_value, fee_pool, filter, option_params, tx_fee_value,
+      consider_fee, pool, select_value, &utxo_fee_out, &use_bnb_out,
+      (report != nullptr) ? &work_statistics : bnb_statistics, &solver);
+  if (utxo_fee_value != nullptr) {
+    *utxo_fee_value = utxo_fee_out;
+  }
+  if (searched_bnb != nullptr) {
+    *searched_bnb = use_bnb_out;
+  }
+  if (report != nullptr) {
+    if (bnb_statistics != nullptr) *bnb_statistics = work_statistics;
+    SetCoinSelectionReport(
+        indexes, *pool, target_value, tx_fee_value, option_params, solver,
+        work_statistics, report);
+  }
+
+  // convert pool index to utxos index
+  for (auto& index : indexes) {
+    index = static_cast<size_t>(pool->GetUtxo(index) - utxos);
+  }
+  return indexes;
 }
 
 std::vector<Utxo> CoinSelection::SelectCoins(
-    const Amount& target_value, const std::vector<Utxo>& utxos,
+    const Amount& target_value, UtxoIndex* utxo_index,
     const UtxoFilter& filter, const CoinSelectionOption& option_params,
     const Amount& tx_fee_value, Amount* select_value, Amount* utxo_fee_value,
-    bool* searched_bnb) {
+    bool* searched_bnb, BnBSearchStatistics* bnb_statistics,
+    CoinSelectionReport* report) {
+  if (utxo_index == nullptr) {
+    warn(CFD_LOG_SOURCE, "utxo_index is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to select coin. utxo_index is nullptr.");
+  }
 #ifndef CFD_DISABLE_ELEMENTS
-  bool first = true;
-  uint8_t src[33];
-  for (auto& utxo : utxos) {
-    if (first) {
-      memcpy(src, utxo.asset, sizeof(src));
-      first = false;
-    } else if (memcmp(utxo.asset, src, sizeof(src)) != 0) {
+  size_t utxo_count = utxo_index->GetSize();
+  for (size_t index = 1; index < utxo_count; ++index) {
+    if (memcmp(
+            utxo_index->GetUtxo(index)->asset, utxo_index->GetUtxo(0)->asset,
+            sizeof(Utxo::asset)) != 0) {
       warn(
           CFD_LOG_SOURCE,
           "Failed to SelectCoins. Exists multiple assets in utxo list.");
@@ -263,37 +1932,255 @@ std::vector<Utxo> CoinSelection::SelectCoins(
         "Failed to select coin. Outparameter is nullptr.");
   }
 
-  // convert utxo list
-  std::vector<Utxo> work_utxos = utxos;
-  std::vector<Utxo*> p_utxos;
-  p_utxos.reserve(utxos.size());
-  for (auto& utxo : work_utxos) {
-    p_utxos.push_back(&utxo);
-  }
+  const UtxoPool& fee_pool = utxo_index->GetFeePool(
+      option_params.GetEffectiveFeeBaserate(),
+      option_params.GetLongTermFeeBaserate());
 
-  // initialize output parameter
   Amount utxo_fee_out = Amount();
   bool use_bnb_out = false;
+  CoinSelectionSolver solver = kCoinSelectionSolverNone;
+  BnBSearchStatistics work_statistics;
   const bool consider_fee = true;
-  std::vector<Utxo> result = SelectCoinsMinConf(
-      target_value, p_utxos, filter, option_params, tx_fee_value, consider_fee,
-      select_value, &utxo_fee_out, &use_bnb_out);
+  UtxoPool utxo_pool;
+  std::vector<size_t> indexes = SelectCoinsMinConf(
+      target_value, fee_pool, filter, option_params, tx_fee_value,
+      consider_fee, &utxo_pool, select_value, &utxo_fee_out, &use_bnb_out,
+      (report != nullptr) ? &work_statistics : bnb_statistics, &solver);
   if (utxo_fee_value != nullptr) {
     *utxo_fee_value = utxo_fee_out;
   }
   if (searched_bnb != nullptr) {
     *searched_bnb = use_bnb_out;
   }
+  if (report != nullptr) {
+    if (bnb_statistics != nullptr) *bnb_statistics = work_statistics;
+    SetCoinSelectionReport(
+        indexes, utxo_pool, target_value, tx_fee_value, option_params, solver,
+        work_statistics, report);
+  }
 
+  std::vector<Utxo> result;
+  result.reserve(indexes.size());
+  for (size_t index : indexes) {
+    result.push_back(utxo_pool.CopyUtxo(index));
+  }
   return result;
 }
 
+std::vector<Utxo> CoinSelection::SelectCoins(
+    const Amount& target_value, UtxoReservationSet* reservation_set,
+    const UtxoFilter& filter, const CoinSelectionOption& option_params,
+    const Amount& tx_fee_value, uint64_t timeout_msec, Amount* select_value,
+    UtxoReservation* reservation, Amount* utxo_fee_value,
+    bool* searched_bnb) {
+  if (reservation_set == nullptr) {
+    warn(CFD_LOG_SOURCE, "reservation_set is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to select coin. reservation_set is nullptr.");
+  }
+  if ((select_value == nullptr) || (reservation == nullptr)) {
+    warn(
+        CFD_LOG_SOURCE,
+        "Outparameter(select_value or reservation) is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to select coin. Outparameter is nullptr.");
+  }
+
+  const bool consider_fee = true;
+  UtxoPool fee_pool;
+  for (uint32_t retry = 0; retry < kReservationMaxRetry; ++retry) {
+    // 未予約のUTXOのみを候補とする (fee計算結果は再利用する)
+    reservation_set->GetFreeFeePool(
+        option_params.GetEffectiveFeeBaserate(),
+        option_params.GetLongTermFeeBaserate(), &fee_pool);
+#ifndef CFD_DISABLE_ELEMENTS
+    for (size_t index = 1; index < fee_pool.GetSize(); ++index) {
+      if (memcmp(
+              fee_pool.GetUtxo(index)->asset, fee_pool.GetUtxo(0)->asset,
+              sizeof(Utxo::asset)) != 0) {
+        warn(
+            CFD_LOG_SOURCE,
+            "Failed to SelectCoins. Exists multiple assets in utxo list.");
+        throw CfdException(
+            CfdError::kCfdIllegalStateError,
+            "Failed to SelectCoins. Exists multiple assets in utxo list.");
+      }
+    }
+#endif
+
+    Amount utxo_fee_out = Amount();
+    bool use_bnb_out = false;
+    UtxoPool utxo_pool;
+    std::vector<size_t> indexes = SelectCoinsMinConf(
+        target_value, fee_pool, filter, option_params, tx_fee_value,
+        consider_fee, &utxo_pool, select_value, &utxo_fee_out, &use_bnb_out);
+
+    // 選択結果を予約する。競合した場合は最新の状態で選択し直す。
+    std::vector<size_t> reserve_indexes;
+    reserve_indexes.reserve(indexes.size());
+    for (size_t index : indexes) {
+      reserve_indexes.push_back(static_cast<size_t>(
+          utxo_pool.GetUtxo(index) - reservation_set->GetUtxo(0)));
+    }
+    if (reservation_set->Reserve(
+            reserve_indexes, timeout_msec, reservation)) {
+      if (utxo_fee_value != nullptr) {
+        *utxo_fee_value = utxo_fee_out;
+      }
+      if (searched_bnb != nullptr) {
+        *searched_bnb = use_bnb_out;
+      }
+      std::vector<Utxo> result;
+      result.reserve(indexes.size());
+      for (size_t index : indexes) {
+        result.push_back(utxo_pool.CopyUtxo(index));
+      }
+      return result;
+    }
+    info(CFD_LOG_SOURCE, "Conflict utxo reservation. retry={}", retry);
+    std::this_thread::yield();
+  }
+
+  warn(
+      CFD_LOG_SOURCE, "Failed to SelectCoins. Reservation retry limit over.");
+  throw CfdException(
+      CfdError::kCfdIllegalStateError,
+      "Failed to select coin. Reservation retry limit over.");
+}
+
+std::vector<CoinSelectionFeeRateResult> CoinSelection::SelectCoinsByFeeRates(
+    const Amount& target_value, const std::vector<Utxo>& utxos,
+    const UtxoFilter& filter, const CoinSelectionOption& option_params,
+    uint32_t tx_size, const std::vector<double>& fee_rates) {
+#ifndef CFD_DISABLE_ELEMENTS
+  for (size_t index = 1; index < utxos.size(); ++index) {
+    if (memcmp(utxos[index].asset, utxos[0].asset, sizeof(utxos[0].asset)) !=
+        0) {
+      warn(
+          CFD_LOG_SOURCE,
+          "Failed to SelectCoins. Exists multiple assets in utxo list.");
+      throw CfdException(
+          CfdError::kCfdIllegalStateError,
+          "Failed to SelectCoins. Exists multiple assets in utxo list.");
+    }
+  }
+#endif
+
+  // fee rateに依存しない処理(フィルタ・TxInサイズ・long term fee)は一度のみ行う
+  UtxoPool source_pool;
+  source_pool.Reserve(utxos.size());
+  for (const auto& utxo : utxos) {
+    source_pool.Add(&utxo, utxo.amount, 0, 0);
+  }
+  UtxoPool filtered_pool;
+  if (IsEnableUtxoFilter(filter)) {
+    FilterUtxoPool(source_pool, filter, &filtered_pool);
+  }
+  const UtxoPool& base_pool =
+      IsEnableUtxoFilter(filter) ? filtered_pool : source_pool;
+  const std::vector<uint64_t>& amounts = base_pool.GetAmounts();
+  const size_t utxo_count = base_pool.GetSize();
+  std::vector<uint32_t> vsizes(utxo_count);
+  for (size_t index = 0; index < utxo_count; ++index) {
+    vsizes[index] = FeeCalculator::GetTxInVsize(*base_pool.GetUtxo(index));
+  }
+  std::vector<uint64_t> long_term_fees(utxo_count);
+  FeeCalculator(option_params.GetLongTermFeeBaserate())
+      .GetFees(vsizes.data(), utxo_count, long_term_fees.data());
+
+  const UtxoFilter no_filter;
+  const bool consider_fee = true;
+  std::vector<uint64_t> fees(utxo_count);
+  UtxoPool fee_pool;
+  UtxoPool utxo_pool;
+  std::vector<CoinSelectionFeeRateResult> results(fee_rates.size());
+  for (size_t rate_index = 0; rate_index < fee_rates.size(); ++rate_index) {
+    CoinSelectionFeeRateResult& result = results[rate_index];
+    result.fee_rate = fee_rates[rate_index];
+    CoinSelectionOption rate_option = option_params;
+    rate_option.SetEffectiveFeeBaserate(result.fee_rate);
+    FeeCalculator effective_fee(rate_option.GetEffectiveFeeBaserate());
+    effective_fee.GetFees(vsizes.data(), utxo_count, fees.data());
+    fee_pool.Clear();
+    fee_pool.Reserve(utxo_count);
+    for (size_t index = 0; index < utxo_count; ++index) {
+      fee_pool.Add(
+          base_pool.GetUtxo(index), amounts[index], fees[index],
+          long_term_fees[index]);
+    }
+    result.tx_fee = effective_fee.GetFee(tx_size);
+
+    bool use_bnb = false;
+    BnBSearchStatistics statistics;
+    CoinSelectionSolver solver = kCoinSelectionSolverNone;
+    try {
+      std::vector<size_t> indexes = SelectCoinsMinConf(
+          target_value, fee_pool, no_filter, rate_option, result.tx_fee,
+          consider_fee, &utxo_pool, &result.select_value, &result.utxo_fee,
+          &use_bnb, &statistics, &solver);
+      SetCoinSelectionReport(
+          indexes, utxo_pool, target_value, result.tx_fee, rate_option,
+          solver, statistics, &result.report);
+      result.indexes.reserve(indexes.size());
+      for (size_t index : indexes) {
+        result.indexes.push_back(
+            static_cast<size_t>(utxo_pool.GetUtxo(index) - utxos.data()));
+      }
+      result.is_success = true;
+    } catch (const CfdException& except) {
+      info(
+          CFD_LOG_SOURCE, "SelectCoinsByFeeRates skip. fee_rate={}, {}",
+          result.fee_rate, except.what());
+      result.select_value = Amount();
+      result.utxo_fee = Amount();
+    }
+  }
+  return results;
+}
+
 #ifndef CFD_DISABLE_ELEMENTS
 std::vector<Utxo> CoinSelection::SelectCoins(
     const AmountMap& map_target_value, const std::vector<Utxo>& utxos,
     const UtxoFilter& filter, const CoinSelectionOption& option_params,
     const Amount& tx_fee_value, AmountMap* map_select_value,
-    Amount* utxo_fee_value, std::map<std::string, bool>* map_searched_bnb) {
+    Amount* utxo_fee_value, std::map<std::string, bool>* map_searched_bnb,
+    std::map<std::string, CoinSelectionReport>* map_report) {
+  UtxoAssetBuckets utxo_buckets;
+  utxo_buckets.Build(utxos.data(), utxos.size(), option_params);
+  return SelectCoins(
+      map_target_value, utxo_buckets, filter, option_params, tx_fee_value,
+      map_select_value, utxo_fee_value, map_searched_bnb, map_report);
+}
+
+std::vector<Utxo> CoinSelection::SelectCoins(
+    const AmountMap& map_target_value, UtxoIndex* utxo_index,
+    const UtxoFilter& filter, const CoinSelectionOption& option_params,
+    const Amount& tx_fee_value, AmountMap* map_select_value,
+    Amount* utxo_fee_value, std::map<std::string, bool>* map_searched_bnb,
+    std::map<std::string, CoinSelectionReport>* map_report) {
+  if (utxo_index == nullptr) {
+    warn(CFD_LOG_SOURCE, "utxo_index is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to select coin. utxo_index is nullptr.");
+  }
+  UtxoAssetBuckets utxo_buckets;
+  utxo_buckets.Build(utxo_index->GetFeePool(
+      option_params.GetEffectiveFeeBaserate(),
+      option_params.GetLongTermFeeBaserate()));
+  return SelectCoins(
+      map_target_value, utxo_buckets, filter, option_params, tx_fee_value,
+      map_select_value, utxo_fee_value, map_searched_bnb, map_report);
+}
+
+std::vector<Utxo> CoinSelection::SelectCoins(
+    const AmountMap& map_target_value, const UtxoAssetBuckets& utxo_buckets,
+    const UtxoFilter& filter, const CoinSelectionOption& option_params,
+    const Amount& tx_fee_value, AmountMap* map_select_value,
+    Amount* utxo_fee_value, std::map<std::string, bool>* map_searched_bnb,
+    std::map<std::string, CoinSelectionReport>* map_report) {
   bool calculate_fee = (option_params.GetEffectiveFeeBaserate() != 0);
   if (map_target_value.size() == 0) {
     warn(CFD_LOG_SOURCE, "Failed to SelectCoins. Target value is empty.");
@@ -331,8 +2218,7 @@ std::vector<Utxo> CoinSelection::SelectCoins(
   }
 
   // asset exists check
-  std::map<std::string, std::vector<Utxo*>> asset_utxos;
-  std::vector<Utxo> work_utxos = utxos;
+  std::map<std::string, const UtxoPool*> asset_utxos;
   for (auto& target : work_target_values) {
     // asset valid check...
     ConfidentialAssetId target_asset(target.first);
@@ -343,17 +2229,8 @@ std::vector<Utxo> CoinSelection::SelectCoins(
           "Failed to SelectCoins. Target asset is empty.");
     }
 
-    // convert utxo list to ptr
-    std::vector<Utxo*> p_utxos;
-    p_utxos.reserve(utxos.size());
-    for (auto& utxo : work_utxos) {
-      std::vector<uint8_t> asset_byte(
-          std::begin(utxo.asset), std::end(utxo.asset));
-      if (target.first == ConfidentialAssetId(asset_byte).GetHex()) {
-        p_utxos.push_back(&utxo);
-      }
-    }
-    if (p_utxos.size() == 0) {
+    const UtxoPool* asset_pool = utxo_buckets.GetPool(target_asset);
+    if (asset_pool == nullptr) {
       warn(
           CFD_LOG_SOURCE,
           "Failed to SelectCoins. Target asset is not found in utxo list."
@@ -364,57 +2241,115 @@ std::vector<Utxo> CoinSelection::SelectCoins(
           "Failed to SelectCoins. Target asset is not found in utxo list.");
     }
 
-    asset_utxos.insert(std::make_pair(target.first, p_utxos));
+    asset_utxos.insert(std::make_pair(target.first, asset_pool));
   }
 
   // coin selection function
-  std::vector<Utxo> result;
-  result.reserve(utxos.size());
-  Amount tx_fee_out = tx_fee_value;
-  AmountMap work_selected_values;
-  Amount work_utxo_fee = Amount();
-  std::map<std::string, bool> work_searched_bnb;
-  auto coin_selection_function = [this, filter, option_params, &result,
-                                  &tx_fee_out, &work_selected_values,
-                                  &work_utxo_fee, &work_searched_bnb](
-                                     const Amount& target_value,
-                                     const std::vector<Utxo*> utxos,
-                                     const Amount& tx_fee,
-                                     const std::string asset_id,
-                                     const bool consider_fee) {
-    Amount select_value_out = Amount();
-    Amount utxo_fee_out = Amount();
-    bool use_bnb_out = false;
-    std::vector<Utxo> ret_utxos = SelectCoinsMinConf(
-        target_value, utxos, filter, option_params, tx_fee, consider_fee,
-        &select_value_out, &utxo_fee_out, &use_bnb_out);
-    std::copy(ret_utxos.begin(), ret_utxos.end(), std::back_inserter(result));
-    tx_fee_out += utxo_fee_out;
-    work_selected_values[asset_id] = select_value_out;
-    work_utxo_fee += utxo_fee_out;
-    work_searched_bnb[asset_id] = use_bnb_out;
+  struct AssetSelectResult {
+    std::vector<Utxo> utxos;
+    Amount select_value;
+    Amount utxo_fee;
+    bool use_bnb = false;
+    CoinSelectionReport report;
   };
+  const bool need_report = (map_report != nullptr);
+  auto coin_selection_function =
+      [this, &filter, &option_params, need_report](
+          const Amount& target_value, const UtxoPool& asset_pool,
+          const Amount& tx_fee, const bool consider_fee,
+          AssetSelectResult* select_result) {
+        UtxoPool utxo_pool;
+        BnBSearchStatistics statistics;
+        CoinSelectionSolver solver = kCoinSelectionSolverNone;
+        std::vector<size_t> indexes = SelectCoinsMinConf(
+            target_value, asset_pool, filter, option_params, tx_fee,
+            consider_fee, &utxo_pool, &select_result->select_value,
+            &select_result->utxo_fee, &select_result->use_bnb,
+            (need_report) ? &statistics : nullptr, &solver);
+        if (need_report) {
+          SetCoinSelectionReport(
+              indexes, utxo_pool, target_value, tx_fee, option_params,
+              solver, statistics, &select_result->report);
+        }
+        select_result->utxos.reserve(indexes.size());
+        for (size_t index : indexes) {
+          select_result->utxos.push_back(utxo_pool.CopyUtxo(index));
+        }
+      };
 
   // do coin selection exclude fee asset
+  // fee以外の asset については、tx_fee=0, feeを考慮せずに計算
+  std::vector<std::string> asset_ids;
   for (auto& target : work_target_values) {
     // skip fee asset
-    if (target.first == fee_asset.GetHex()) {
-      continue;
+    if (target.first != fee_asset.GetHex()) {
+      asset_ids.push_back(target.first);
+    }
+  }
+  std::vector<AssetSelectResult> asset_results(asset_ids.size());
+  size_t thread_count = option_params.GetAssetSelectionThreadCount();
+  if (thread_count > asset_ids.size()) thread_count = asset_ids.size();
+  if (thread_count <= 1) {
+    for (size_t index = 0; index < asset_ids.size(); ++index) {
+      coin_selection_function(
+          work_target_values[asset_ids[index]],
+          *asset_utxos[asset_ids[index]], Amount(), false,
+          &asset_results[index]);
     }
+  } else {
+    // asset毎に独立して計算可能なため、スレッドプールで分担する。
+    // 結果はasset毎の領域に格納し、逐次実行時と同じ順序で集計する。
+    std::vector<std::exception_ptr> errors(asset_ids.size());
+    auto task = [&coin_selection_function, &work_target_values, &asset_utxos,
+                 &asset_ids, &asset_results, &errors](size_t index) {
+      try {
+        coin_selection_function(
+            work_target_values.at(asset_ids[index]),
+            *asset_utxos.at(asset_ids[index]), Amount(), false,
+            &asset_results[index]);
+      } catch (...) {
+        errors[index] = std::current_exception();
+      }
+    };
+    CoinSelectionThreadPool* thread_pool = option_params.GetThreadPool();
+    if (thread_pool == nullptr) {
+      thread_pool = CoinSelectionThreadPool::GetDefault();
+    }
+    thread_pool->Run(asset_ids.size(), task, thread_count);
+    for (auto& error : errors) {
+      if (error) std::rethrow_exception(error);
+    }
+  }
 
-    // fee以外の asset については、tx_fee=0, feeを考慮せずに計算
-    const Amount& target_value = target.second;
-    coin_selection_function(
-        target_value, asset_utxos[target.first], Amount(), target.first,
-        false);
+  std::vector<Utxo> result;
+  Amount tx_fee_out = tx_fee_value;
+  AmountMap work_selected_values;
+  Amount work_utxo_fee = Amount();
+  std::map<std::string, bool> work_searched_bnb;
+  std::map<std::string, CoinSelectionReport> work_report;
+  for (size_t index = 0; index < asset_ids.size(); ++index) {
+    AssetSelectResult& asset_result = asset_results[index];
+    result.insert(
+        result.end(), asset_result.utxos.begin(), asset_result.utxos.end());
+    tx_fee_out += asset_result.utxo_fee;
+    work_selected_values[asset_ids[index]] = asset_result.select_value;
+    work_utxo_fee += asset_result.utxo_fee;
+    work_searched_bnb[asset_ids[index]] = asset_result.use_bnb;
+    work_report[asset_ids[index]] = asset_result.report;
   }
 
   // do coin selection with fee asset
   if (calculate_fee) {
-    const Amount& target_value = work_target_values[fee_asset.GetHex()];
+    AssetSelectResult fee_result;
     coin_selection_function(
-        target_value, asset_utxos[fee_asset.GetHex()], tx_fee_out,
-        fee_asset.GetHex(), true);
+        work_target_values[fee_asset.GetHex()],
+        *asset_utxos[fee_asset.GetHex()], tx_fee_out, true, &fee_result);
+    result.insert(
+        result.end(), fee_result.utxos.begin(), fee_result.utxos.end());
+    work_selected_values[fee_asset.GetHex()] = fee_result.select_value;
+    work_utxo_fee += fee_result.utxo_fee;
+    work_searched_bnb[fee_asset.GetHex()] = fee_result.use_bnb;
+    work_report[fee_asset.GetHex()] = fee_result.report;
   }
 
   if (map_select_value != nullptr) {
@@ -426,104 +2361,99 @@ std::vector<Utxo> CoinSelection::SelectCoins(
   if (map_searched_bnb != nullptr) {
     *map_searched_bnb = work_searched_bnb;
   }
+  if (map_report != nullptr) {
+    *map_report = work_report;
+  }
 
   return result;
 }
 #endif  // CFD_DISABLE_ELEMENTS
 
-std::vector<Utxo> CoinSelection::SelectCoinsMinConf(
-    const Amount& target_value, const std::vector<Utxo*>& utxos,
+std::vector<size_t> CoinSelection::SelectCoinsMinConf(
+    const Amount& target_value, const UtxoPool& source_fee_pool,
     const UtxoFilter& filter, const CoinSelectionOption& option_params,
-    const Amount& tx_fee_value, const bool consider_fee, Amount* select_value,
-    Amount* utxo_fee_value, bool* searched_bnb) {
-  // for btc default(DUST_RELAY_TX_FEE(3000)) -> DEFAULT_DISCARD_FEE(10000)
+    const Amount& tx_fee_value, const bool consider_fee, UtxoPool* utxo_pool,
+    Amount* select_value, Amount* utxo_fee_value, bool* searched_bnb,
+    BnBSearchStatistics* bnb_statistics, CoinSelectionSolver* solver) {
   if (select_value != nullptr) {
     *select_value = Amount::CreateBySatoshiAmount(0);
-  } else {
-    cfd::core::logger::info(
-        CFD_LOG_SOURCE, "select_value=null, filter={}",
-        static_cast<const void*>(&filter));
-    // for unused parameter
   }
   if (searched_bnb != nullptr) *searched_bnb = false;
+  if (bnb_statistics != nullptr) *bnb_statistics = BnBSearchStatistics();
+  if (solver != nullptr) *solver = kCoinSelectionSolverNone;
 
-  // Copy the list to change the calculation area.
-  std::vector<Utxo*> work_utxos = utxos;
-  FeeCalculator effective_fee(option_params.GetEffectiveFeeBaserate());
-  FeeCalculator discard_fee(kDefaultDiscardFee);
-  Amount cost_of_change = Amount::CreateBySatoshiAmount(0);
-  bool use_fee = false;
-  if (option_params.GetEffectiveFeeBaserate() != 0) {
-    cost_of_change = discard_fee.GetFee(option_params.GetChangeSpendSize()) +
-                     effective_fee.GetFee(option_params.GetChangeOutputSize());
-    use_fee = true;
+  Amount cost_of_change = GetCostOfChange(option_params);
+  bool use_fee = (option_params.GetEffectiveFeeBaserate() != 0);
+
+  // The calculated values are held by the pool, not written to the utxos.
+  if (utxo_pool == nullptr) {
+    warn(CFD_LOG_SOURCE, "Outparameter(utxo_pool) is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to select coin. Outparameter is nullptr.");
+  }
+  // Filter by the min conf specs
+  UtxoPool filtered_pool;
+  if (IsEnableUtxoFilter(filter)) {
+    FilterUtxoPool(source_fee_pool, filter, &filtered_pool);
+  }
+  const UtxoPool& fee_pool =
+      IsEnableUtxoFilter(filter) ? filtered_pool : source_fee_pool;
+
+  if (option_params.IsUseOutputGroup()) {
+    return SelectCoinsByOutputGroup(
+        target_value, fee_pool, option_params, tx_fee_value, consider_fee,
+        utxo_pool, select_value, utxo_fee_value, searched_bnb,
+        bnb_statistics, solver);
+  }
+
+  uint64_t min_change =
+      GetMinimumChange(option_params, use_fee, cost_of_change);
+  if ((option_params.GetAlgorithm() != kCoinSelectionDefault) ||
+      (option_params.GetStrategy() != nullptr)) {
+    return SelectCoinsByStrategy(
+        target_value, fee_pool, option_params, tx_fee_value, use_fee,
+        consider_fee, cost_of_change, min_change, utxo_pool, select_value,
+        utxo_fee_value, searched_bnb, bnb_statistics, solver);
   }
 
-  std::vector<Utxo*> utxo_pool;
+  // fee/long term feeは fee_pool で計算済み
+  const std::vector<uint64_t>& amounts = fee_pool.GetAmounts();
+  const std::vector<uint64_t>& fees = fee_pool.GetFees();
+  const std::vector<uint64_t>& long_term_fees = fee_pool.GetLongTermFees();
+  const size_t utxo_count = fee_pool.GetSize();
+  utxo_pool->Clear();
+  utxo_pool->Reserve(utxo_count);
   if (use_bnb_ && option_params.IsUseBnB()) {
-    // Get long term estimate
-    FeeCalculator long_term_fee(option_params.GetLongTermFeeBaserate());
-
-    // NOLINT Filter by the min conf specs and add to utxo_pool and calculate effective value
-    for (auto& utxo : work_utxos) {
-      if (utxo == nullptr) continue;
-      // if (!group.EligibleForSpending(eligibility_filter)) continue;
-      utxo->fee = 0;
-      utxo->long_term_fee = 0;
-      utxo->effective_value = 0;
-
-      uint64_t fee = effective_fee.GetFee(*utxo).GetSatoshiValue();
-      // Only include outputs that are positive effective value (i.e. not dust)
-      if (utxo->amount > fee) {
-        uint64_t effective_value = utxo->amount;
-        if (use_fee) {
-          if (consider_fee) {
-            effective_value -= fee;
-          }
-          utxo->fee = fee;
-          utxo->long_term_fee = long_term_fee.GetFee(*utxo).GetSatoshiValue();
-        }
-#if 0
-        std::vector<uint8_t> txid_byte(sizeof(utxo->txid));
-        memcpy(txid_byte.data(), utxo->txid, txid_byte.size());
-        info(
-            CFD_LOG_SOURCE, "utxo({},{}) size={}/{} amount={}/{}/{}",
-            Txid(txid_byte).GetHex(), utxo->vout, utxo->uscript_size_max,
-            utxo->witness_size_max, utxo->amount, utxo->fee,
-            utxo->long_term_fee);
-#endif
-        if (utxo->long_term_fee > utxo->fee) {
-          utxo->long_term_fee = utxo->fee;  // TODO(k-matsuzawa): 後で見直し
-        }
-        utxo->effective_value = effective_value;
-        utxo_pool.push_back(utxo);
-      }
-    }
+    // add to utxo_pool and calculate effective value
+    CreateBnBPool(fee_pool, use_fee, consider_fee, utxo_pool);
     // Calculate the fees for things that aren't inputs
-    std::vector<Utxo> result = SelectCoinsBnB(
-        target_value, utxo_pool, cost_of_change, tx_fee_value, select_value,
-        utxo_fee_value);
+    std::vector<size_t> result = SelectCoinsBnB(
+        target_value, *utxo_pool, cost_of_change, tx_fee_value,
+        option_params.GetBnBMaxTries(), option_params.GetBnBTimeLimit(),
+        select_value, utxo_fee_value, bnb_statistics,
+        option_params.GetMaxInputCount(), option_params.GetMaxWeight());
     if (!result.empty()) {
       if (searched_bnb) *searched_bnb = true;
+      if (solver != nullptr) *solver = kCoinSelectionSolverBnB;
       return result;
     }
     // SelectCoinsBnB fail, go to KnapsackSolver.
   }
 
-  // Filter by the min conf specs and add to utxo_pool
-  // TODO(k-matsuzawa): 現状はフィルタリングしていないためUtxo一覧の再作成不要
-  // for (const OutputGroup& group : groups) {
-  //   if (!group.EligibleForSpending(eligibility_filter)) continue;
-  //   utxo_pool.push_back(group);
-  // }
-  if (utxo_pool.empty()) {
-    for (auto& utxo : work_utxos) {
-      if (utxo == nullptr) continue;
-      utxo->fee =
-          (use_fee) ? effective_fee.GetFee(*utxo).GetSatoshiValue() : 0;
-      if (utxo->amount > utxo->fee) {
-        utxo->effective_value = utxo->amount - utxo->fee;
-        utxo_pool.push_back(utxo);
+  // add to utxo_pool (filtered by fee_pool)
+  if (utxo_pool->IsEmpty()) {
+    const std::vector<uint64_t>& weights = fee_pool.GetWeights();
+    const std::vector<uint32_t>& input_counts = fee_pool.GetInputCounts();
+    for (size_t index = 0; index < utxo_count; ++index) {
+      const Utxo* utxo = fee_pool.GetUtxo(index);
+      uint64_t fee = (use_fee) ? fees[index] : 0;
+      uint64_t long_term_fee =
+          (use_fee) ? GetCappedLongTermFee(fee, long_term_fees[index]) : 0;
+      if (amounts[index] > fee) {
+        utxo_pool->Add(
+            utxo, amounts[index], amounts[index] - fee, fee, long_term_fee,
+            weights[index], input_counts[index]);
       }
     }
   }
@@ -532,18 +2462,23 @@ std::vector<Utxo> CoinSelection::SelectCoinsMinConf(
   if (tx_fee_value.GetSatoshiValue() > 0) {
     search_value += tx_fee_value;
   }
-  // using minimum fee
-  uint64_t min_change = kMinChange;
-  int64_t opt_min_change = option_params.GetKnapsackMinimumChange();
-  if (opt_min_change >= 0) {
-    if ((!use_fee) || (opt_min_change > cost_of_change.GetSatoshiValue())) {
-      min_change = static_cast<uint64_t>(opt_min_change);
-    } else if (use_fee) {
-      min_change = static_cast<uint64_t>(cost_of_change.GetSatoshiValue());
-    }
+  CoinSelectionRandom random(
+      (option_params.HasRandomSeed()) ? option_params.GetRandomSeed()
+                                      : CoinSelectionRandom::GenerateSeed());
+  std::vector<size_t> result = KnapsackSolver(
+      search_value, *utxo_pool, min_change, &random, select_value,
+      &utxo_fee, option_params.GetMaxInputCount(),
+      option_params.GetMaxWeight());
+  if (result.empty() && (search_value.GetSatoshiValue() > 0)) {
+    warn(
+        CFD_LOG_SOURCE,
+        "Failed to KnapsackSolver. Not enough utxos within the input limit."
+        ": max_input_count={}, max_weight={}",
+        option_params.GetMaxInputCount(), option_params.GetMaxWeight());
+    throw CfdException(
+        CfdError::kCfdIllegalStateError,
+        "Failed to KnapsackSolver. Not enough utxos within the input limit.");
   }
-  std::vector<Utxo> result = KnapsackSolver(
-      search_value, utxo_pool, min_change, select_value, &utxo_fee);
   if (use_fee) {
     // Check if the required amount was detected
     // (May be a non-passing route)
@@ -564,42 +2499,329 @@ std::vector<Utxo> CoinSelection::SelectCoinsMinConf(
   if (utxo_fee_value != nullptr) {
     *utxo_fee_value = utxo_fee;
   }
+  if ((solver != nullptr) && !result.empty()) {
+    *solver = kCoinSelectionSolverKnapsack;
+  }
+  return result;
+}
+
+std::vector<size_t> CoinSelection::SelectCoinsByOutputGroup(
+    const Amount& target_value, const UtxoPool& fee_pool,
+    const CoinSelectionOption& option_params, const Amount& tx_fee_value,
+    bool consider_fee, UtxoPool* utxo_pool, Amount* select_value,
+    Amount* utxo_fee_value, bool* searched_bnb,
+    BnBSearchStatistics* bnb_statistics, CoinSelectionSolver* solver) {
+  // group by locking script (key: locking script, value: groups index)
+  const size_t utxo_count = fee_pool.GetSize();
+  std::vector<std::vector<size_t>> groups;
+  std::unordered_map<std::string, size_t> group_positions;
+  groups.reserve(utxo_count);
+  for (size_t index = 0; index < utxo_count; ++index) {
+    const Utxo* utxo = fee_pool.GetUtxo(index);
+    size_t script_length = utxo->script_length;
+    if (script_length > sizeof(utxo->locking_script)) {
+      script_length = sizeof(utxo->locking_script);
+    }
+    if (script_length == 0) {
+      groups.emplace_back(1, index);
+      continue;
+    }
+    std::string key(
+        reinterpret_cast<const char*>(utxo->locking_script), script_length);
+    auto iter = group_positions.find(key);
+    if ((iter != group_positions.end()) &&
+        (groups[iter->second].size() < kOutputGroupMaxEntries)) {
+      groups[iter->second].push_back(index);
+    } else {
+      group_positions[key] = groups.size();
+      groups.emplace_back(1, index);
+    }
+  }
+
+  CoinSelectionOption group_option = option_params;
+  group_option.SetUseOutputGroup(false);
+  const UtxoFilter group_filter;
+  if (groups.size() == utxo_count) {
+    // all utxos have a different locking script.
+    return SelectCoinsMinConf(
+        target_value, fee_pool, group_filter, group_option, tx_fee_value,
+        consider_fee, utxo_pool, select_value, utxo_fee_value, searched_bnb,
+        bnb_statistics, solver);
+  }
+
+  // The group is represented by its first utxo.
+  const std::vector<uint64_t>& amounts = fee_pool.GetAmounts();
+  const std::vector<uint64_t>& fees = fee_pool.GetFees();
+  const std::vector<uint64_t>& long_term_fees = fee_pool.GetLongTermFees();
+  const std::vector<uint64_t>& weights = fee_pool.GetWeights();
+  const std::vector<uint32_t>& input_counts = fee_pool.GetInputCounts();
+  UtxoPool group_pool;
+  std::unordered_map<const Utxo*, size_t> group_indexes;
+  group_pool.Reserve(groups.size());
+  group_indexes.reserve(groups.size());
+  for (size_t group_index = 0; group_index < groups.size(); ++group_index) {
+    uint64_t amount = 0;
+    uint64_t fee = 0;
+    uint64_t long_term_fee = 0;
+    uint64_t weight = 0;
+    uint32_t input_count = 0;
+    for (size_t index : groups[group_index]) {
+      amount += amounts[index];
+      fee += fees[index];
+      long_term_fee += long_term_fees[index];
+      weight += weights[index];
+      input_count += input_counts[index];
+    }
+    const Utxo* utxo = fee_pool.GetUtxo(groups[group_index][0]);
+    group_pool.Add(
+        utxo, amount, amount, fee, long_term_fee, weight, input_count);
+    group_indexes.emplace(utxo, group_index);
+  }
+
+  UtxoPool group_utxo_pool;
+  std::vector<size_t> group_result = SelectCoinsMinConf(
+      target_value, group_pool, group_filter, group_option, tx_fee_value,
+      consider_fee, &group_utxo_pool, select_value, utxo_fee_value,
+      searched_bnb, bnb_statistics, solver);
+
+  // expand the selected groups to the utxos.
+  const bool use_fee = (option_params.GetEffectiveFeeBaserate() != 0);
+  std::vector<size_t> result;
+  utxo_pool->Clear();
+  for (size_t group_utxo_index : group_result) {
+    const Utxo* group_utxo = group_utxo_pool.GetUtxo(group_utxo_index);
+    for (size_t index : groups[group_indexes[group_utxo]]) {
+      uint64_t fee = (use_fee) ? fees[index] : 0;
+      uint64_t long_term_fee =
+          (use_fee) ? GetCappedLongTermFee(fee, long_term_fees[index]) : 0;
+      uint64_t effective_value = amounts[index];
+      if (consider_fee) {
+        effective_value = (effective_value > fee) ? effective_value - fee : 0;
+      }
+      result.push_back(utxo_pool->GetSize());
+      utxo_pool->Add(
+          fee_pool.GetUtxo(index), amounts[index], effective_value, fee,
+          long_term_fee, weights[index], input_counts[index]);
+    }
+  }
   return result;
 }
 
-std::vector<Utxo> CoinSelection::SelectCoinsBnB(
-    const Amount& target_value, const std::vector<Utxo*>& utxos,
+std::vector<size_t> CoinSelection::SelectCoinsByStrategy(
+    const Amount& target_value, const UtxoPool& fee_pool,
+    const CoinSelectionOption& option_params, const Amount& tx_fee_value,
+    bool use_fee, bool consider_fee, const Amount& cost_of_change,
+    uint64_t min_change, UtxoPool* utxo_pool, Amount* select_value,
+    Amount* utxo_fee_value, bool* searched_bnb,
+    BnBSearchStatistics* bnb_statistics, CoinSelectionSolver* solver) {
+  CreateBnBPool(fee_pool, use_fee, consider_fee, utxo_pool);
+  const UtxoPool& pool = *utxo_pool;
+
+  CoinSelectionParameter parameter;
+  parameter.target_value =
+      static_cast<uint64_t>(target_value.GetSatoshiValue());
+  if (tx_fee_value.GetSatoshiValue() > 0) {
+    parameter.target_value +=
+        static_cast<uint64_t>(tx_fee_value.GetSatoshiValue());
+  }
+  parameter.cost_of_change =
+      static_cast<uint64_t>(cost_of_change.GetSatoshiValue());
+  parameter.min_change = min_change;
+  parameter.max_input_count = option_params.GetMaxInputCount();
+  parameter.max_weight = option_params.GetMaxWeight();
+  CoinSelectionRandom random(
+      (option_params.HasRandomSeed()) ? option_params.GetRandomSeed()
+                                      : CoinSelectionRandom::GenerateSeed());
+
+  // 収集額に達し、TxIn数・weightが上限内の結果のうち、
+  // wasteが最小のものを採用する
+  const std::vector<uint64_t>& values = pool.GetEffectiveValues();
+  const std::vector<uint64_t>& weights = pool.GetWeights();
+  const std::vector<uint32_t>& input_counts = pool.GetInputCounts();
+  const uint64_t input_count_limit = GetInputLimit(parameter.max_input_count);
+  const uint64_t weight_limit = GetInputLimit(parameter.max_weight);
+  std::vector<size_t> best_result;
+  int64_t best_waste = 0;
+  bool is_found = false;
+  CoinSelectionSolver best_solver = kCoinSelectionSolverNone;
+  auto apply_result = [&](const std::vector<size_t>& result,
+                          CoinSelectionSolver result_solver) {
+    if (result.empty()) return;
+    uint64_t total = 0;
+    uint64_t input_count = 0;
+    uint64_t weight = 0;
+    for (size_t index : result) {
+      total += values[index];
+      input_count += input_counts[index];
+      weight += weights[index];
+    }
+    if (total < parameter.target_value) return;
+    if ((input_count > input_count_limit) || (weight > weight_limit)) return;
+    int64_t waste = GetSelectionWaste(
+        result, pool, parameter.target_value, parameter.cost_of_change);
+    if ((!is_found) || (waste < best_waste)) {
+      best_result = result;
+      best_waste = waste;
+      is_found = true;
+      best_solver = result_solver;
+    }
+  };
+
+  Amount work_select_value;
+  Amount work_utxo_fee;
+  const CoinSelectionStrategy* strategy = option_params.GetStrategy();
+  CoinSelectionAlgorithm algorithm = option_params.GetAlgorithm();
+  if (algorithm == kCoinSelectionLowestWaste) {
+    if (use_bnb_ && option_params.IsUseBnB()) {
+      try {
+        apply_result(
+            SelectCoinsBnB(
+                target_value, pool, cost_of_change, tx_fee_value,
+                option_params.GetBnBMaxTries(),
+                option_params.GetBnBTimeLimit(), &work_select_value,
+                &work_utxo_fee, bnb_statistics, parameter.max_input_count,
+                parameter.max_weight),
+            kCoinSelectionSolverBnB);
+      } catch (const CfdException& except) {
+        info(CFD_LOG_SOURCE, "SelectCoinsBnB skip. {}", except.what());
+      }
+    }
+    try {
+      apply_result(
+          KnapsackSolver(
+              Amount::CreateBySatoshiAmount(
+                  static_cast<int64_t>(parameter.target_value)),
+              pool, min_change, &random, &work_select_value, &work_utxo_fee,
+              parameter.max_input_count, parameter.max_weight),
+          kCoinSelectionSolverKnapsack);
+    } catch (const CfdException& except) {
+      info(CFD_LOG_SOURCE, "KnapsackSolver skip. {}", except.what());
+    }
+    apply_result(
+        SingleRandomDrawStrategy().Select(parameter, pool, &random),
+        kCoinSelectionSolverSingleRandomDraw);
+    apply_result(
+        LargestFirstStrategy().Select(parameter, pool, &random),
+        kCoinSelectionSolverLargestFirst);
+    apply_result(
+        SmallestFirstStrategy().Select(parameter, pool, &random),
+        kCoinSelectionSolverSmallestFirst);
+    if (strategy != nullptr) {
+      apply_result(
+          strategy->Select(parameter, pool, &random),
+          kCoinSelectionSolverStrategy);
+    }
+  } else if (strategy != nullptr) {
+    apply_result(
+        strategy->Select(parameter, pool, &random),
+        kCoinSelectionSolverStrategy);
+  } else if (algorithm == kCoinSelectionKnapsack) {
+    apply_result(
+        KnapsackSolver(
+            Amount::CreateBySatoshiAmount(
+                static_cast<int64_t>(parameter.target_value)),
+            pool, min_change, &random, &work_select_value, &work_utxo_fee,
+            parameter.max_input_count, parameter.max_weight),
+        kCoinSelectionSolverKnapsack);
+  } else if (algorithm == kCoinSelectionSingleRandomDraw) {
+    apply_result(
+        SingleRandomDrawStrategy().Select(parameter, pool, &random),
+        kCoinSelectionSolverSingleRandomDraw);
+  } else if (algorithm == kCoinSelectionLargestFirst) {
+    apply_result(
+        LargestFirstStrategy().Select(parameter, pool, &random),
+        kCoinSelectionSolverLargestFirst);
+  } else if (algorithm == kCoinSelectionSmallestFirst) {
+    apply_result(
+        SmallestFirstStrategy().Select(parameter, pool, &random),
+        kCoinSelectionSolverSmallestFirst);
+  } else {
+    warn(
+        CFD_LOG_SOURCE, "Unknown algorithm. algorithm={}",
+        static_cast<int>(algorithm));
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to select coin. Unknown algorithm.");
+  }
+
+  if (!is_found) {
+    warn(
+        CFD_LOG_SOURCE,
+        "Failed to SelectCoins. Not enough utxos. target={}",
+        parameter.target_value);
+    throw CfdException(
+        CfdError::kCfdIllegalStateError,
+        "Failed to select coin. Not enough utxos.");
+  }
+
+  const std::vector<uint64_t>& amounts = pool.GetAmounts();
+  const std::vector<uint64_t>& fees = pool.GetFees();
+  uint64_t select_amount = 0;
+  uint64_t select_fee = 0;
+  for (size_t index : best_result) {
+    select_amount += amounts[index];
+    select_fee += fees[index];
+  }
+  if (select_value != nullptr) {
+    *select_value =
+        Amount::CreateBySatoshiAmount(static_cast<int64_t>(select_amount));
+  }
+  if (utxo_fee_value != nullptr) {
+    *utxo_fee_value =
+        Amount::CreateBySatoshiAmount(static_cast<int64_t>(select_fee));
+  }
+  if (searched_bnb != nullptr) {
+    *searched_bnb = (best_solver == kCoinSelectionSolverBnB);
+  }
+  if (solver != nullptr) *solver = best_solver;
+  info(
+      CFD_LOG_SOURCE, "SelectCoinsByStrategy end. results={}, waste={}",
+      best_result.size(), best_waste);
+  return best_result;
+}
+
+std::vector<size_t> CoinSelection::SelectCoinsBnB(
+    const Amount& target_value, const UtxoPool& utxo_pool,
     const Amount& cost_of_change, const Amount& not_input_fees,
     Amount* select_value, Amount* utxo_fee_value) {
+  return SelectCoinsBnB(
+      target_value, utxo_pool, cost_of_change, not_input_fees,
+      kBnBMaxTotalTries, 0, select_value, utxo_fee_value, nullptr);
+}
+
+std::vector<size_t> CoinSelection::SelectCoinsBnB(
+    const Amount& target_value, const UtxoPool& utxo_pool,
+    const Amount& cost_of_change, const Amount& not_input_fees,
+    uint64_t max_tries, uint64_t time_limit, Amount* select_value,
+    Amount* utxo_fee_value, BnBSearchStatistics* statistics,
+    uint32_t max_input_count, uint64_t max_weight) {
   info(
       CFD_LOG_SOURCE,
       "SelectCoinsBnB start. cost_of_change={}, not_input_fees={}",
       cost_of_change.GetSatoshiValue(), not_input_fees.GetSatoshiValue());
 
-  std::vector<Utxo> results;
-  Amount curr_value = Amount::CreateBySatoshiAmount(0);
-
+  std::vector<size_t> results;
   std::vector<bool> curr_selection;
-  curr_selection.reserve(utxos.size());
+  curr_selection.reserve(utxo_pool.GetSize());
   Amount actual_target = not_input_fees + target_value;
 
   // Calculate curr_available_value
   Amount curr_available_value = Amount::CreateBySatoshiAmount(0);
-  for (const Utxo* utxo : utxos) {
+  for (uint64_t effective_value : utxo_pool.GetEffectiveValues()) {
     // Assert that this utxo is not negative. It should never be negative,
     //  effective value calculation should have removed it
-    // assert(utxo->effective_value > 0);
-    if (utxo->effective_value == 0) {
+    // assert(effective_value > 0);
+    if (effective_value == 0) {
       warn(
           CFD_LOG_SOURCE,
           "Failed to SelectCoinsBnB. effective_value is 0."
           ": effective_value={}",
-          utxo->effective_value);
+          effective_value);
       throw CfdException(
           CfdError::kCfdIllegalStateError,
           "Failed to select coin. effective amount is 0.");
     }
-    curr_available_value += utxo->effective_value;
+    curr_available_value += effective_value;
   }
   if (curr_available_value < actual_target) {
     // not enough amount
@@ -616,84 +2838,195 @@ std::vector<Utxo> CoinSelection::SelectCoinsBnB(
   }
 
   // Sort the utxos
-  std::vector<Utxo*> p_utxos = utxos;
-  std::sort(p_utxos.begin(), p_utxos.end(), [](const Utxo* a, const Utxo* b) {
-    return a->effective_value > b->effective_value;
-  });
-
-  Amount curr_waste = Amount::CreateBySatoshiAmount(0);
+  std::vector<size_t> source_indexes;
+  UtxoPool sorted_pool = utxo_pool.GetSortedByEffectiveValue(&source_indexes);
+  const std::vector<uint64_t>& values = sorted_pool.GetEffectiveValues();
+  const std::vector<uint64_t>& fees = sorted_pool.GetFees();
+  const std::vector<uint64_t>& long_term_fees = sorted_pool.GetLongTermFees();
+  const std::vector<uint64_t>& weights = sorted_pool.GetWeights();
+  const std::vector<uint32_t>& input_counts = sorted_pool.GetInputCounts();
+  const size_t utxo_count = sorted_pool.GetSize();
+  const bool has_input_limit = (max_input_count != 0) || (max_weight != 0);
+  const uint64_t input_count_limit = GetInputLimit(max_input_count);
+  const uint64_t weight_limit = GetInputLimit(max_weight);
+
+  // 探索中に参照する値を事前に計算する
+  // - suffix_values[i]: i以降のUTXOの有効額の合計
+  // - min_suffix_wastes[i]: i以降のUTXOのwasteの最小値
+  // - min_suffix_weights[i]: i以降のUTXOのweightの最小値
+  std::vector<uint64_t> suffix_values(utxo_count + 1, 0);
+  std::vector<int64_t> wastes(utxo_count);
+  std::vector<int64_t> min_suffix_wastes(utxo_count + 1, kMaxAmount);
+  std::vector<uint64_t> min_suffix_weights(
+      utxo_count + 1, std::numeric_limits<uint64_t>::max());
+  bool has_negative_waste = false;
+  for (size_t index = utxo_count; index > 0; --index) {
+    size_t pos = index - 1;
+    suffix_values[pos] = suffix_values[index] + values[pos];
+    wastes[pos] = static_cast<int64_t>(fees[pos]) -
+                  static_cast<int64_t>(long_term_fees[pos]);
+    if (wastes[pos] < 0) has_negative_waste = true;
+    min_suffix_wastes[pos] = std::min(min_suffix_wastes[index], wastes[pos]);
+    min_suffix_weights[pos] =
+        std::min(min_suffix_weights[index], weights[pos]);
+  }
+  const bool is_waste_increasing =
+      (utxo_count != 0) && (fees[0] > long_term_fees[0]);
+  const uint64_t target =
+      static_cast<uint64_t>(actual_target.GetSatoshiValue());
+  const uint64_t upper_target =
+      target + static_cast<uint64_t>(cost_of_change.GetSatoshiValue());
+
+  uint64_t curr_value = 0;
+  int64_t curr_waste = 0;
+  uint64_t curr_input_count = 0;
+  uint64_t curr_weight = 0;
   std::vector<bool> best_selection;
-  Amount best_waste = Amount::CreateBySatoshiAmount(kMaxAmount);
+  int64_t best_waste = kMaxAmount;
+
+  // 1件・2件でお釣りなしとなる選択を先に探索する。
+  // wasteが3件以上の選択の下限以下であれば最良解のため、探索を省略する。
+  // 最良解と判定できない場合も、探索の初期解(wasteの上限)として利用する。
+  std::vector<size_t> changeless_selection;
+  int64_t changeless_waste = 0;
+  bool is_changeless_completed = false;
+  bool is_changeless_best = false;
+  const bool is_changeless_found =
+      (!has_negative_waste) &&
+      FindChangelessSelection(
+          values, wastes, weights, input_counts, input_count_limit,
+          weight_limit, target, upper_target, max_tries,
+          &changeless_selection, &changeless_waste,
+          &is_changeless_completed);
+  if (is_changeless_found && is_changeless_completed) {
+    std::vector<int64_t> min_wastes(wastes);
+    size_t min_count = std::min(min_wastes.size(), static_cast<size_t>(3));
+    std::partial_sort(
+        min_wastes.begin(), min_wastes.begin() + min_count, min_wastes.end());
+    // TxIn数の上限が3未満の場合、3件以上の選択は存在しない
+    is_changeless_best =
+        (min_count < 3) || (input_count_limit < 3) ||
+        (changeless_waste <= min_wastes[0] + min_wastes[1] + min_wastes[2]);
+  }
+  if (is_changeless_found) {
+    best_selection.assign(utxo_count, false);
+    for (size_t index : changeless_selection) {
+      best_selection[index] = true;
+    }
+    best_waste = changeless_waste;
+  }
+
+  // 時刻取得の負荷を抑えるため、一定回数毎に探索時間上限を確認する
+  static constexpr const uint64_t kBnBTimeCheckInterval = 1024;
+  const auto start_time = std::chrono::steady_clock::now();
+  const auto deadline = start_time + std::chrono::microseconds(time_limit);
+  uint64_t tries = 0;
+  uint64_t backtracks = 0;
+  bool is_completed = is_changeless_best;
+  bool is_timeout = false;
+  const uint64_t search_tries = (is_changeless_best) ? 0 : max_tries;
+
+  // 上限内で追加できるUTXOで収集額に達し得るかを判定する。
+  // 降順のため、残りTxIn数分の先頭UTXOの合計が到達可能額の上限となる。
+  auto is_reachable_in_limit = [&](size_t depth) {
+    if (curr_input_count >= input_count_limit) return false;
+    if (curr_weight + min_suffix_weights[depth] > weight_limit) return false;
+    uint64_t remain_count = std::min<uint64_t>(
+        input_count_limit - curr_input_count, utxo_count - depth);
+    uint64_t reachable_value =
+        suffix_values[depth] - suffix_values[depth + remain_count];
+    return (curr_value + reachable_value >= target);
+  };
 
   // Depth First search loop for choosing the UTXOs
-  for (size_t i = 0; i < kBnBMaxTotalTries; ++i) {
+  for (; tries < search_tries; ++tries) {
+    if ((time_limit != 0) && (tries % kBnBTimeCheckInterval == 0) &&
+        (tries != 0) && (std::chrono::steady_clock::now() >= deadline)) {
+      is_timeout = true;
+      break;
+    }
+    const size_t depth = curr_selection.size();
     // Conditions for starting a backtrack
     bool backtrack = false;
-    if (curr_value + curr_available_value <
-            actual_target ||  //NOLINT Cannot possibly reach target with the amount remaining in the curr_available_value.
-        curr_value >
-            actual_target +
-                cost_of_change ||  //NOLINT Selected value is out of range, go back and try other branch
-        (curr_waste > best_waste &&
-         (p_utxos.at(0)->fee - p_utxos.at(0)->long_term_fee) >
-             0)) {  //NOLINT Don't select things which we know will be more wasteful if the waste is increasing
+    if (curr_value + suffix_values[depth] < target) {
+      // Cannot possibly reach target with the amount remaining.
+      backtrack = true;
+    } else if (
+        has_input_limit && ((curr_input_count > input_count_limit) ||
+                            (curr_weight > weight_limit))) {
+      // Selected inputs exceed the input count or weight limit.
+      backtrack = true;
+    } else if (
+        has_input_limit && (curr_value < target) &&
+        !is_reachable_in_limit(depth)) {
+      // NOLINT Cannot reach target with the remaining inputs within the input count or weight limit.
+      backtrack = true;
+    } else if (curr_value > upper_target) {
+      // Selected value is out of range, go back and try other branch
+      backtrack = true;
+    } else if (curr_waste > best_waste && is_waste_increasing) {
+      // NOLINT Don't select things which we know will be more wasteful if the waste is increasing
       backtrack = true;
     } else if (
-        curr_value >= actual_target) {  //NOLINT Selected value is within range
-      curr_waste +=
-          (curr_value -
-           actual_target);  //NOLINT This is the excess value which is added to the waste for the below comparison
+        (curr_value < target) && (!has_negative_waste) &&
+        (curr_waste + min_suffix_wastes[depth] > best_waste)) {
+      // NOLINT At least one more UTXO is needed, and every candidate adds at least min_suffix_wastes[depth].
+      backtrack = true;
+    } else if (curr_value >= target) {  // Selected value is within range
+      // NOLINT This is the excess value which is added to the waste for the below comparison
+      int64_t waste = curr_waste + static_cast<int64_t>(curr_value - target);
       //NOLINT Adding another UTXO after this check could bring the waste down if the long term fee is higher than the current fee.
       //NOLINT However we are not going to explore that because this optimization for the waste is only done when we have hit our target
       //NOLINT value. Adding any more UTXOs will be just burning the UTXO; it will go entirely to fees. Thus we aren't going to
       //NOLINT explore any more UTXOs to avoid burning money like that.
-      if (curr_waste <= best_waste) {
+      if (waste <= best_waste) {
         best_selection = curr_selection;
-        best_selection.resize(p_utxos.size());
-        best_waste = curr_waste;
+        best_selection.resize(utxo_count);
+        best_waste = waste;
       }
-      curr_waste -= (curr_value - actual_target);
-      //NOLINT Remove the excess value as we will be selecting different coins now
       backtrack = true;
     }
 
     // Backtracking, moving backwards
     if (backtrack) {
+      ++backtracks;
       //NOLINT Walk backwards to find the last included UTXO that still needs to have its omission branch traversed.
       while (!curr_selection.empty() && !curr_selection.back()) {
         curr_selection.pop_back();
-        curr_available_value +=
-            p_utxos.at(curr_selection.size())->effective_value;
       }
 
       if (curr_selection
               .empty()) {  //NOLINT We have walked back to the first utxo and no branch is untraversed. All solutions searched
+        is_completed = true;
         break;
       }
 
       // Output was included on previous iterations, try excluding now.
       curr_selection.back() = false;
-      const Utxo* utxo = p_utxos.at(curr_selection.size() - 1);
-      curr_value -= utxo->effective_value;
-      curr_waste -= utxo->fee - utxo->long_term_fee;
+      size_t index = curr_selection.size() - 1;
+      curr_value -= values[index];
+      curr_waste -= wastes[index];
+      curr_input_count -= input_counts[index];
+      curr_weight -= weights[index];
     } else {  // Moving forwards, continuing down this branch
-      const Utxo* utxo = p_utxos.at(curr_selection.size());
-
-      // Remove this utxo from the curr_available_value utxo amount
-      curr_available_value -= utxo->effective_value;
+      size_t index = depth;
 
       // NOLINT Avoid searching a branch if the previous UTXO has the same value and same waste and was excluded. Since the ratio of fee to
       // NOLINT long term fee is the same, we only need to check if one of those values match in order to know that the waste is the same.
       if (!curr_selection.empty() && !curr_selection.back() &&
-          utxo->effective_value ==
-              p_utxos.at(curr_selection.size() - 1)->effective_value &&
-          utxo->fee == p_utxos.at(curr_selection.size() - 1)->fee) {
+          values[index] == values[index - 1] &&
+          fees[index] == fees[index - 1] &&
+          ((!has_input_limit) ||
+           ((weights[index] == weights[index - 1]) &&
+            (input_counts[index] == input_counts[index - 1])))) {
         curr_selection.push_back(false);
       } else {
         // Inclusion branch first (Largest First Exploration)
         curr_selection.push_back(true);
-        curr_value += utxo->effective_value;
-        curr_waste += utxo->fee - utxo->long_term_fee;
+        curr_value += values[index];
+        curr_waste += wastes[index];
+        curr_input_count += input_counts[index];
+        curr_weight += weights[index];
       }
     }
   }
@@ -702,72 +3035,120 @@ std::vector<Utxo> CoinSelection::SelectCoinsBnB(
   Amount fee_value = Amount::CreateBySatoshiAmount(0);
   if (!best_selection.empty()) {
     // Set output set
-    *select_value = Amount::CreateBySatoshiAmount(0);
+    const std::vector<uint64_t>& amounts = sorted_pool.GetAmounts();
+    uint64_t select_amount = 0;
+    uint64_t select_fee = 0;
     for (size_t i = 0; i < best_selection.size(); ++i) {
-      if (best_selection.at(i)) {
-        Utxo* p_utxo = p_utxos.at(i);
-        results.push_back(*p_utxo);
-        *select_value += static_cast<int64_t>(p_utxo->amount);
-        fee_value += static_cast<int64_t>(p_utxo->fee);
+      if (best_selection[i]) {
+        results.push_back(source_indexes[i]);
+        select_amount += amounts[i];
+        select_fee += fees[i];
       }
     }
+    *select_value = Amount::CreateBySatoshiAmount(
+        static_cast<int64_t>(select_amount));
+    fee_value = Amount::CreateBySatoshiAmount(static_cast<int64_t>(select_fee));
   }
   if (utxo_fee_value != nullptr) {
     *utxo_fee_value = fee_value;
   }
+  if (statistics != nullptr) {
+    // 最後の探索(break)も1回として数える
+    statistics->tries =
+        (is_completed && !is_changeless_best) ? tries + 1 : tries;
+    statistics->backtracks = backtracks;
+    statistics->best_waste =
+        (best_selection.empty()) ? -1 : best_waste;
+    statistics->is_exhausted = (!is_completed) && (!is_timeout);
+    statistics->is_timeout = is_timeout;
+  }
 
-  info(CFD_LOG_SOURCE, "SelectCoinsBnB end. results={}", results.size());
+  info(
+      CFD_LOG_SOURCE, "SelectCoinsBnB end. results={}, tries={}",
+      results.size(), tries);
   return results;
 }
 
-std::vector<Utxo> CoinSelection::KnapsackSolver(
-    const Amount& target_value, const std::vector<Utxo*>& utxos,
+std::vector<size_t> CoinSelection::KnapsackSolver(
+    const Amount& target_value, const UtxoPool& utxo_pool,
     uint64_t min_change, Amount* select_value, Amount* utxo_fee_value) {
-  std::vector<Utxo> ret_utxos;
+  CoinSelectionRandom random(CoinSelectionRandom::GenerateSeed());
+  return KnapsackSolver(
+      target_value, utxo_pool, min_change, &random, select_value,
+      utxo_fee_value);
+}
+
+std::vector<size_t> CoinSelection::KnapsackSolver(
+    const Amount& target_value, const UtxoPool& utxo_pool,
+    uint64_t min_change, CoinSelectionRandom* random, Amount* select_value,
+    Amount* utxo_fee_value, uint32_t max_input_count, uint64_t max_weight) {
+  if (random == nullptr) {
+    warn(CFD_LOG_SOURCE, "random is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to select coin. random is nullptr.");
+  }
+  std::vector<size_t> ret_utxos;
   uint64_t n_target = target_value.GetSatoshiValue();
   info(CFD_LOG_SOURCE, "KnapsackSolver start. target={}", n_target);
 
+  const std::vector<uint64_t>& values = utxo_pool.GetEffectiveValues();
+  const std::vector<uint64_t>& amounts = utxo_pool.GetAmounts();
+  const std::vector<uint64_t>& fees = utxo_pool.GetFees();
+  const std::vector<uint64_t>& weights = utxo_pool.GetWeights();
+  const std::vector<uint32_t>& input_counts = utxo_pool.GetInputCounts();
+  const bool has_input_limit = (max_input_count != 0) || (max_weight != 0);
+  const uint64_t input_count_limit = GetInputLimit(max_input_count);
+  const uint64_t weight_limit = GetInputLimit(max_weight);
+
   // List of values less than target
-  const Utxo* lowest_larger = nullptr;
-  std::vector<const Utxo*> applicable_groups;
+  static constexpr const size_t kNotFound = SIZE_MAX;
+  size_t lowest_larger = kNotFound;
+  std::vector<size_t> applicable_groups;
   uint64_t n_total = 0;
   uint64_t n_effective_total = 0;  // amount excluding fee
+  uint64_t n_input_count = 0;
+  uint64_t n_weight = 0;
   uint64_t utxo_fee = 0;
 
-  std::vector<uint32_t> indexes =
-      RandomNumberUtil::GetRandomIndexes(static_cast<uint32_t>(utxos.size()));
-
-  for (size_t index = 0; index < indexes.size(); ++index) {
-    // if (utxos[index]->amount == n_target) {
-    if (utxos[index]->effective_value == n_target) {
+  for (size_t index = 0; index < utxo_pool.GetSize(); ++index) {
+    if (has_input_limit && ((input_counts[index] > input_count_limit) ||
+                            (weights[index] > weight_limit))) {
+      continue;  // 単独で上限を超えるUTXOは選択しない
+    }
+    // if (amounts[index] == n_target) {
+    if (values[index] == n_target) {
       // that meets the required value
-      ret_utxos.push_back(*utxos[index]);
-      *select_value = Amount::CreateBySatoshiAmount(utxos[index]->amount);
-      *utxo_fee_value = Amount::CreateBySatoshiAmount(utxos[index]->fee);
+      ret_utxos.push_back(index);
+      *select_value = Amount::CreateBySatoshiAmount(amounts[index]);
+      *utxo_fee_value = Amount::CreateBySatoshiAmount(fees[index]);
       info(CFD_LOG_SOURCE, "KnapsackSolver end. results={}", ret_utxos.size());
       return ret_utxos;
 
-    } else if (utxos[index]->effective_value < n_target + min_change) {
-      // } else if ((utxos[index]->amount < n_target + min_change) {
-      applicable_groups.push_back(utxos[index]);
-      n_total += utxos[index]->amount;
-      n_effective_total += utxos[index]->effective_value;
+    } else if (values[index] < n_target + min_change) {
+      // } else if ((amounts[index] < n_target + min_change) {
+      applicable_groups.push_back(index);
+      n_total += amounts[index];
+      n_effective_total += values[index];
+      n_input_count += input_counts[index];
+      n_weight += weights[index];
 
     } else if (
-        lowest_larger == nullptr ||
-        utxos[index]->amount < lowest_larger->amount) {
+        lowest_larger == kNotFound ||
+        amounts[index] < amounts[lowest_larger]) {
       // greater than `n_target + min_change`
-      lowest_larger = utxos[index];
+      lowest_larger = index;
     }
   }
 
   // if (n_total == n_target) {
-  if (n_effective_total == n_target) {
+  if ((n_effective_total == n_target) &&
+      (n_input_count <= input_count_limit) && (n_weight <= weight_limit)) {
     uint64_t ret_value = 0;
-    for (const auto& utxo : applicable_groups) {
-      ret_utxos.push_back(*utxo);
-      ret_value += utxo->amount;
-      utxo_fee += utxo->fee;
+    for (size_t index : applicable_groups) {
+      ret_utxos.push_back(index);
+      ret_value += amounts[index];
+      utxo_fee += fees[index];
     }
     *select_value = Amount::CreateBySatoshiAmount(ret_value);
     *utxo_fee_value = Amount::CreateBySatoshiAmount(utxo_fee);
@@ -777,7 +3158,7 @@ std::vector<Utxo> CoinSelection::KnapsackSolver(
 
   // if (n_total < n_target) {
   if (n_effective_total < n_target) {
-    if (lowest_larger == nullptr) {
+    if (lowest_larger == kNotFound) {
       warn(
           CFD_LOG_SOURCE, "insufficient funds. effective_total:{} target:{}",
           n_effective_total, n_target);
@@ -785,31 +3166,63 @@ std::vector<Utxo> CoinSelection::KnapsackSolver(
           CfdError::kCfdIllegalStateError, "insufficient funds.");
     }
 
-    ret_utxos.push_back(*lowest_larger);
-    *select_value = Amount::CreateBySatoshiAmount(lowest_larger->amount);
-    *utxo_fee_value = Amount::CreateBySatoshiAmount(lowest_larger->fee);
+    ret_utxos.push_back(lowest_larger);
+    *select_value = Amount::CreateBySatoshiAmount(amounts[lowest_larger]);
+    *utxo_fee_value = Amount::CreateBySatoshiAmount(fees[lowest_larger]);
     info(CFD_LOG_SOURCE, "KnapsackSolver end. results={}", ret_utxos.size());
     return ret_utxos;
   }
 
-  std::sort(
+  std::stable_sort(
       applicable_groups.begin(), applicable_groups.end(),
-      [](const Utxo* a, const Utxo* b) {
-        return a->effective_value > b->effective_value;
-      });
+      [&values](size_t a, size_t b) { return values[a] > values[b]; });
+  std::vector<uint64_t> applicable_values;
+  std::vector<uint64_t> applicable_weights;
+  std::vector<uint32_t> applicable_input_counts;
+  applicable_values.reserve(applicable_groups.size());
+  for (size_t index : applicable_groups) {
+    applicable_values.push_back(values[index]);
+  }
+  if (has_input_limit) {
+    applicable_weights.reserve(applicable_groups.size());
+    applicable_input_counts.reserve(applicable_groups.size());
+    for (size_t index : applicable_groups) {
+      applicable_weights.push_back(weights[index]);
+      applicable_input_counts.push_back(input_counts[index]);
+    }
+  }
+  const std::vector<uint64_t>* limit_weights =
+      (has_input_limit) ? &applicable_weights : nullptr;
+  const std::vector<uint32_t>* limit_input_counts =
+      (has_input_limit) ? &applicable_input_counts : nullptr;
   std::vector<char> vf_best;
   uint64_t n_best;
 
-  randomize_cache_.clear();
-  ApproximateBestSubset(
-      applicable_groups, n_effective_total, n_target, &vf_best, &n_best,
-      kApproximateBestSubsetIterations);
-  if (n_best != n_target && n_effective_total >= n_target + min_change) {
+  // TxIn数の上限内で収集額に達し得ない場合は、近似探索を省略する
+  uint64_t reachable_total = n_effective_total;
+  if (input_count_limit < applicable_values.size()) {
+    reachable_total = 0;
+    for (size_t index = 0; index < input_count_limit; ++index) {
+      reachable_total += applicable_values[index];
+    }
+  }
+  if (reachable_total < n_target) {
+    vf_best.assign(applicable_values.size(), 0);
+    n_best = std::numeric_limits<uint64_t>::max();
+  } else {
+    ApproximateBestSubset(
+        applicable_values, n_effective_total, n_target, &vf_best, &n_best,
+        kApproximateBestSubsetIterations, random, limit_weights,
+        limit_input_counts, input_count_limit, weight_limit);
+  }
+  if (n_best != n_target && n_effective_total >= n_target + min_change &&
+      reachable_total >= n_target + min_change) {
     uint64_t n_best2 = n_best;
     std::vector<char> vf_best2;
     ApproximateBestSubset(
-        applicable_groups, n_effective_total, (n_target + min_change),
-        &vf_best2, &n_best2, kApproximateBestSubsetIterations);
+        applicable_values, n_effective_total, (n_target + min_change),
+        &vf_best2, &n_best2, kApproximateBestSubsetIterations, random,
+        limit_weights, limit_input_counts, input_count_limit, weight_limit);
     if ((n_best2 == n_target) || (n_best > n_best2)) {
       n_best = n_best2;
       vf_best = vf_best2;
@@ -818,21 +3231,22 @@ std::vector<Utxo> CoinSelection::KnapsackSolver(
 
   // NOLINT If we have a bigger coin and (either the stochastic approximation didn't find a good solution,
   // NOLINT                                or the next bigger coin is closer), return the bigger coin
-  if (lowest_larger != nullptr &&
+  if (lowest_larger != kNotFound &&
       ((n_best != n_target && n_best < n_target + min_change) ||
-       lowest_larger->effective_value <= n_best)) {
-    // lowest_larger->amount <= n_best)) {
-    ret_utxos.push_back(*lowest_larger);
-    *select_value = Amount::CreateBySatoshiAmount(lowest_larger->amount);
-    *utxo_fee_value = Amount::CreateBySatoshiAmount(lowest_larger->fee);
+       values[lowest_larger] <= n_best)) {
+    // amounts[lowest_larger] <= n_best)) {
+    ret_utxos.push_back(lowest_larger);
+    *select_value = Amount::CreateBySatoshiAmount(amounts[lowest_larger]);
+    *utxo_fee_value = Amount::CreateBySatoshiAmount(fees[lowest_larger]);
 
   } else {
     uint64_t ret_value = 0;
-    for (unsigned int i = 0; i < applicable_groups.size(); i++) {
+    for (size_t i = 0; i < applicable_groups.size(); i++) {
       if (vf_best[i]) {
-        ret_utxos.push_back(*applicable_groups[i]);
-        ret_value += applicable_groups[i]->amount;
-        utxo_fee += applicable_groups[i]->fee;
+        size_t index = applicable_groups[i];
+        ret_utxos.push_back(index);
+        ret_value += amounts[index];
+        utxo_fee += fees[index];
       }
     }
     *select_value = Amount::CreateBySatoshiAmount(ret_value);
@@ -843,9 +3257,12 @@ std::vector<Utxo> CoinSelection::KnapsackSolver(
 }
 
 void CoinSelection::ApproximateBestSubset(
-    const std::vector<const Utxo*>& utxos, uint64_t n_total_value,
+    const std::vector<uint64_t>& values, uint64_t n_total_value,
     uint64_t n_target_value, std::vector<char>* vf_best, uint64_t* n_best,
-    int iterations) {
+    int iterations, CoinSelectionRandom* random,
+    const std::vector<uint64_t>* weights,
+    const std::vector<uint32_t>* input_counts, uint64_t max_input_count,
+    uint64_t max_weight) {
   if (vf_best == nullptr || n_best == nullptr) {
     warn(CFD_LOG_SOURCE, "Outparameter(select_value) is nullptr.");
     throw CfdException(
@@ -853,45 +3270,98 @@ void CoinSelection::ApproximateBestSubset(
         "Failed to select coin. Outparameter is nullptr.");
   }
 
-  std::vector<char> vf_includes;
-  vf_best->assign(utxos.size(), true);
+  // 収集対象フラグを64件単位のbit列で保持する
+  const size_t value_count = values.size();
+  const size_t word_count = (value_count + 63) / 64;
+  std::vector<uint64_t> includes(word_count);
+  std::vector<uint64_t> best_includes(word_count, ~0ULL);
   *n_best = n_total_value;
+  // 上限指定時は、上限内で収集額に達した組み合わせのみを採用する
+  const bool has_input_limit =
+      (weights != nullptr) && (input_counts != nullptr);
+  const uint64_t input_count_limit =
+      (has_input_limit) ? max_input_count
+                        : std::numeric_limits<uint64_t>::max();
+  const uint64_t weight_limit =
+      (has_input_limit) ? max_weight : std::numeric_limits<uint64_t>::max();
+  uint64_t min_weight = 0;
+  if (has_input_limit) {
+    std::fill(best_includes.begin(), best_includes.end(), 0);
+    *n_best = std::numeric_limits<uint64_t>::max();
+    if (!weights->empty()) {
+      min_weight = *std::min_element(weights->begin(), weights->end());
+    }
+  }
 
   for (int n_rep = 0; n_rep < iterations && *n_best != n_target_value;
        n_rep++) {
-    vf_includes.assign(utxos.size(), false);
+    std::fill(includes.begin(), includes.end(), 0);
     uint64_t n_total = 0;
+    uint64_t n_input_count = 0;
+    uint64_t n_weight = 0;
     bool is_reached_target = false;
     for (int n_pass = 0; n_pass < 2 && !is_reached_target; n_pass++) {
-      for (unsigned int i = 0; i < utxos.size(); i++) {
+      // TxIn数・weightの上限に達した場合、以降のUTXOは追加できない
+      for (size_t word = 0; (word < word_count) &&
+                            (n_input_count < input_count_limit) &&
+                            (n_weight + min_weight <= weight_limit);
+           ++word) {
+        const size_t offset = word * 64;
+        const uint32_t bit_count =
+            static_cast<uint32_t>(std::min<size_t>(value_count - offset, 64));
         // The solver here uses a randomized algorithm,
         // the randomness serves no real security purpose but is just
         // needed to prevent degenerate behavior and it is important
         // that the rng is fast. We do not use a constant random sequence,
         // because there may be some privacy improvement by making
         // the selection random.
-        bool rand_bool = !vf_includes[i];
+        uint64_t candidates;
         if (n_pass == 0) {
-          rand_bool = RandomNumberUtil::GetRandomBool(&randomize_cache_);
+          candidates = random->GetRandomBits(bit_count);
+        } else {
+          candidates = ~includes[word];
+          if (bit_count < 64) candidates &= (1ULL << bit_count) - 1;
         }
-        if (rand_bool) {
-          // n_total += utxos[i]->amount;
-          n_total += utxos[i]->effective_value;
-          vf_includes[i] = true;
+        // 対象となるbitのみを順に処理する
+        while (candidates != 0) {
+          const uint32_t bit = CountTrailingZero(candidates);
+          const uint64_t mask = 1ULL << bit;
+          candidates &= candidates - 1;
+          const uint64_t value = values[offset + bit];
+          if (has_input_limit) {
+            const uint64_t input_count = (*input_counts)[offset + bit];
+            const uint64_t weight = (*weights)[offset + bit];
+            if ((n_input_count + input_count > input_count_limit) ||
+                (n_weight + weight > weight_limit)) {
+              continue;
+            }
+            n_input_count += input_count;
+            n_weight += weight;
+          }
+          n_total += value;
+          includes[word] |= mask;
           if (n_total >= n_target_value) {
             is_reached_target = true;
             if (n_total < *n_best) {
               *n_best = n_total;
-              *vf_best = vf_includes;
+              best_includes = includes;
+            }
+            n_total -= value;
+            includes[word] &= ~mask;
+            if (has_input_limit) {
+              n_input_count -= (*input_counts)[offset + bit];
+              n_weight -= (*weights)[offset + bit];
             }
-            // n_total -= utxos[i]->amount;
-            n_total -= utxos[i]->effective_value;
-            vf_includes[i] = false;
           }
         }
       }
     }
   }
+
+  vf_best->resize(value_count);
+  for (size_t index = 0; index < value_count; ++index) {
+    (*vf_best)[index] = (best_includes[index / 64] >> (index % 64)) & 1;
+  }
 }
 
 void CoinSelection::ConvertToUtxo(
@@ -912,46 +3382,46 @@ void CoinSelection::ConvertToUtxo(
   }
   utxo->vout = vout;
 
-  // TODO(k-matsuzawa): descriptor解析は暫定対処。本対応が必要。
-
+  // descriptorを解析できない場合は、先頭文字列で種別を判定する
   uint32_t minimum_txin = static_cast<uint32_t>(TxIn::kMinimumTxInSize);
   uint32_t witness_size = 0;
-  if (output_descriptor.find("wpkh(") == 0) {
+  DescriptorTxInSizeData size_data;
+  if (TxInSizeTable::GetDescriptorTxInSizeData(output_descriptor, &size_data)) {
+    SetDescriptorTxInSizeData(size_data, true, utxo);
+  } else if (output_descriptor.find("wpkh(") == 0) {
     utxo->address_type = AddressType::kP2wpkhAddress;
-    TxIn::EstimateTxInSize(
-        AddressType::kP2wpkhAddress, Script(), &witness_size);
+    TxInSizeTable::GetTxInSize(AddressType::kP2wpkhAddress, &witness_size);
     utxo->witness_size_max = static_cast<uint16_t>(witness_size);
   } else if (output_descriptor.find("wsh(") == 0) {
     utxo->address_type = AddressType::kP2wshAddress;
-    TxIn::EstimateTxInSize(
-        AddressType::kP2wshAddress, Script(), &witness_size);
+    TxInSizeTable::GetTxInSize(AddressType::kP2wshAddress, &witness_size);
     utxo->witness_size_max = static_cast<uint16_t>(witness_size);
     utxo->witness_size_max += kScriptSize;
   } else if (output_descriptor.find("sh(") == 0) {
     if (output_descriptor.find("sh(wpkh(") == 0) {
       utxo->address_type = AddressType::kP2shP2wpkhAddress;
-      utxo->uscript_size_max = 22;
-      TxIn::EstimateTxInSize(
-          AddressType::kP2wpkhAddress, Script(), &witness_size);
+      utxo->uscript_size_max =
+          TxInSizeTable::kP2shP2wpkhUnlockingScriptSize;
+      TxInSizeTable::GetTxInSize(AddressType::kP2wpkhAddress, &witness_size);
       utxo->witness_size_max = static_cast<uint16_t>(witness_size);
     } else if (output_descriptor.find("sh(wsh(") == 0) {
       utxo->address_type = AddressType::kP2shP2wshAddress;
-      utxo->uscript_size_max = 34;
-      TxIn::EstimateTxInSize(
-          AddressType::kP2wshAddress, Script(), &witness_size);
+      utxo->uscript_size_max =
+          TxInSizeTable::kP2shP2wshUnlockingScriptSize;
+      TxInSizeTable::GetTxInSize(AddressType::kP2wshAddress, &witness_size);
       utxo->witness_size_max = static_cast<uint16_t>(witness_size);
       utxo->witness_size_max += kScriptSize;
     } else {
       utxo->address_type = AddressType::kP2shAddress;
       utxo->uscript_size_max = kScriptSize;
       utxo->uscript_size_max +=
-          TxIn::EstimateTxInSize(AddressType::kP2shAddress, Script()) -
+          TxInSizeTable::GetTxInSize(AddressType::kP2shAddress) -
           minimum_txin;
     }
   } else if (output_descriptor.find("pkh(") == 0) {
     utxo->address_type = AddressType::kP2pkhAddress;
     utxo->uscript_size_max =
-        TxIn::EstimateTxInSize(AddressType::kP2pkhAddress, Script()) -
+        TxInSizeTable::GetTxInSize(AddressType::kP2pkhAddress) -
         minimum_txin;
   } else {
     // unknown type?
@@ -1012,44 +3482,44 @@ void CoinSelection::ConvertToUtxo(
 
   uint32_t minimum_txin = static_cast<uint32_t>(TxIn::kMinimumTxInSize);
   uint32_t witness_size = 0;
-  if (locking_script.IsP2pkhScript()) {
+  DescriptorTxInSizeData size_data;
+  if (TxInSizeTable::GetDescriptorTxInSizeData(output_descriptor, &size_data)) {
+    SetDescriptorTxInSizeData(size_data, script.empty(), utxo);
+  } else if (locking_script.IsP2pkhScript()) {
     utxo->address_type = AddressType::kP2pkhAddress;
     utxo->uscript_size_max =
-        TxIn::EstimateTxInSize(AddressType::kP2pkhAddress, Script()) -
+        TxInSizeTable::GetTxInSize(AddressType::kP2pkhAddress) -
         minimum_txin;
   } else if (locking_script.IsP2shScript()) {
     utxo->address_type = AddressType::kP2shAddress;
     utxo->uscript_size_max = kScriptSize;
     utxo->uscript_size_max +=
-        TxIn::EstimateTxInSize(AddressType::kP2shAddress, Script()) -
+        TxInSizeTable::GetTxInSize(AddressType::kP2shAddress) -
         minimum_txin;
     if (output_descriptor.find("sh(wpkh(") == 0) {
       utxo->address_type = AddressType::kP2shP2wpkhAddress;
-      utxo->uscript_size_max = 22;
-      TxIn::EstimateTxInSize(
-          AddressType::kP2wpkhAddress, Script(), &witness_size);
+      utxo->uscript_size_max =
+          TxInSizeTable::kP2shP2wpkhUnlockingScriptSize;
+      TxInSizeTable::GetTxInSize(AddressType::kP2wpkhAddress, &witness_size);
       utxo->witness_size_max = static_cast<uint16_t>(witness_size);
     } else if (output_descriptor.find("sh(wsh(") == 0) {
       utxo->address_type = AddressType::kP2shP2wshAddress;
-      utxo->uscript_size_max = 34;
-      TxIn::EstimateTxInSize(
-          AddressType::kP2wshAddress, Script(), &witness_size);
+      utxo->uscript_size_max =
+          TxInSizeTable::kP2shP2wshUnlockingScriptSize;
+      TxInSizeTable::GetTxInSize(AddressType::kP2wshAddress, &witness_size);
       utxo->witness_size_max = static_cast<uint16_t>(witness_size);
       utxo->witness_size_max += kScriptSize;
     }
   } else if (locking_script.IsP2wpkhScript()) {
     utxo->address_type = AddressType::kP2wpkhAddress;
-    TxIn::EstimateTxInSize(
-        AddressType::kP2wpkhAddress, Script(), &witness_size);
+    TxInSizeTable::GetTxInSize(AddressType::kP2wpkhAddress, &witness_size);
     utxo->witness_size_max = static_cast<uint16_t>(witness_size);
   } else if (locking_script.IsP2wshScript()) {
     utxo->address_type = AddressType::kP2wshAddress;
-    TxIn::EstimateTxInSize(
-        AddressType::kP2wshAddress, Script(), &witness_size);
+    TxInSizeTable::GetTxInSize(AddressType::kP2wshAddress, &witness_size);
     utxo->witness_size_max = static_cast<uint16_t>(witness_size);
     utxo->witness_size_max += kScriptSize;
   }
-  // TODO(k-matsuzawa): 後でOutputDescriptor対応する
   utxo->amount = amount.GetSatoshiValue();
   memcpy(&utxo->binary_data, &binary_data, sizeof(void*));
   utxo->effective_value = utxo->amount;
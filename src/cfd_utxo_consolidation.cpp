@@ -0,0 +1,351 @@
+// Copyright 2019 CryptoGarage
+/**
+ * @file cfd_utxo_consolidation.cpp
+ *
+ * @brief UTXO集約(consolidation)計画の関連クラスの実装ファイル
+ */
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "cfd/cfd_utxo_consolidation.h"
+
+#include "cfd/cfd_common.h"
+#include "cfd/cfd_fee.h"
+#include "cfdcore/cfdcore_address.h"
+#include "cfdcore/cfdcore_amount.h"
+#include "cfdcore/cfdcore_bytedata.h"
+#include "cfdcore/cfdcore_coin.h"
+#include "cfdcore/cfdcore_exception.h"
+#include "cfdcore/cfdcore_logger.h"
+#include "cfdcore/cfdcore_transaction_common.h"
+#ifndef CFD_DISABLE_ELEMENTS
+#include "cfdcore/cfdcore_elements_transaction.h"
+#endif  // CFD_DISABLE_ELEMENTS
+
+namespace cfd {
+
+using cfd::core::AbstractTransaction;
+using cfd::core::Address;
+using cfd::core::Amount;
+using cfd::core::ByteData256;
+using cfd::core::CfdError;
+using cfd::core::CfdException;
+using cfd::core::Txid;
+#ifndef CFD_DISABLE_ELEMENTS
+using cfd::core::ConfidentialAssetId;
+using cfd::core::ConfidentialTxOut;
+using cfd::core::ConfidentialTxOutReference;
+using cfd::core::ConfidentialValue;
+#endif  // CFD_DISABLE_ELEMENTS
+using cfd::core::logger::info;
+using cfd::core::logger::warn;
+
+// -----------------------------------------------------------------------------
+// ファイル内定数
+// -----------------------------------------------------------------------------
+//! witness scale factor
+static constexpr const uint64_t kConsolidationWitnessScaleFactor = 4;
+//! 集約transactionのversion
+static constexpr const uint32_t kConsolidationTxVersion = 2;
+
+// -----------------------------------------------------------------------------
+// ファイル内関数
+// -----------------------------------------------------------------------------
+/**
+ * @brief TxSizeModelのweightを取得する.
+ * @param[in] model   transaction size model
+ * @return weight
+ */
+static uint64_t GetModelWeight(const TxSizeModel& model) {
+  uint64_t witness_size = model.GetWitnessSize();
+  return ((model.GetSize() - witness_size) * kConsolidationWitnessScaleFactor) +
+         witness_size;
+}
+
+/**
+ * @brief UTXOのTxidを取得する.
+ * @param[in] utxo    utxo
+ * @return txid
+ */
+static Txid GetUtxoTxid(const Utxo& utxo) {
+  std::vector<uint8_t> txid_bytes(sizeof(utxo.txid));
+  memcpy(txid_bytes.data(), utxo.txid, txid_bytes.size());
+  return Txid(ByteData256(txid_bytes));
+}
+
+// -----------------------------------------------------------------------------
+// UtxoConsolidationStrategy
+// -----------------------------------------------------------------------------
+std::vector<size_t> UtxoConsolidationStrategy::Select(
+    const CoinSelectionParameter& parameter, const UtxoPool& utxo_pool,
+    CoinSelectionRandom* /* random */) const {
+  const std::vector<uint64_t>& amounts = utxo_pool.GetAmounts();
+  const std::vector<uint64_t>& weights = utxo_pool.GetWeights();
+  const std::vector<uint32_t>& input_counts = utxo_pool.GetInputCounts();
+  std::vector<size_t> order(utxo_pool.GetSize());
+  for (size_t index = 0; index < order.size(); ++index) {
+    order[index] = index;
+  }
+  // 同一weightでは少額のUTXOを優先して集約する
+  std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+    if (weights[lhs] != weights[rhs]) return weights[lhs] < weights[rhs];
+    return amounts[lhs] < amounts[rhs];
+  });
+
+  const uint64_t input_count_limit =
+      (parameter.max_input_count == 0)
+          ? std::numeric_limits<uint64_t>::max()
+          : static_cast<uint64_t>(parameter.max_input_count);
+  const uint64_t weight_limit = (parameter.max_weight == 0)
+                                    ? std::numeric_limits<uint64_t>::max()
+                                    : parameter.max_weight;
+  std::vector<size_t> result;
+  uint64_t input_count = 0;
+  uint64_t weight = 0;
+  for (size_t index : order) {
+    if (input_count + input_counts[index] > input_count_limit) break;
+    if (weight + weights[index] > weight_limit) {
+      // 単独で上限を超えるUTXOは対象外
+      if (result.empty()) continue;
+      // weightの昇順のため、以降のUTXOも上限を超える
+      break;
+    }
+    result.push_back(index);
+    input_count += input_counts[index];
+    weight += weights[index];
+  }
+  // TxIn 1件ではUTXO数が減らない
+  if (input_count < 2) result.clear();
+  return result;
+}
+
+// -----------------------------------------------------------------------------
+// UtxoConsolidationPlanner
+// -----------------------------------------------------------------------------
+constexpr const uint64_t UtxoConsolidationPlanner::kDefaultMaxTxWeight;
+
+UtxoConsolidationPlanner::UtxoConsolidationPlanner(
+    const CoinSelectionOption& option, uint64_t max_tx_weight)
+    : option_(option),
+      max_tx_weight_(
+          (max_tx_weight == 0) ? kDefaultMaxTxWeight : max_tx_weight) {
+  // do nothing
+}
+
+UtxoConsolidationPlan UtxoConsolidationPlanner::Plan(
+    const std::vector<Utxo>& utxos, size_t target_pool_size,
+    const Amount& dust_amount) const {
+  UtxoConsolidationPlan plan;
+  plan.removed_count = 0;
+  plan.total_fee = 0;
+  plan.remaining_pool_size = utxos.size();
+  if (utxos.size() <= target_pool_size) return plan;
+  const size_t removal_target = utxos.size() - target_pool_size;
+
+  // TxInを除いたtransactionのサイズ
+  TxSizeModel base_model;
+#ifndef CFD_DISABLE_ELEMENTS
+  const ConfidentialAssetId fee_asset = option_.GetFeeAsset();
+  const bool is_elements = !fee_asset.IsEmpty();
+  std::vector<uint8_t> fee_asset_bytes;
+  if (is_elements) {
+    fee_asset_bytes = fee_asset.GetData().GetBytes();
+    if (fee_asset_bytes.size() != sizeof(Utxo::asset)) {
+      warn(CFD_LOG_SOURCE, "Failed to Plan. Invalid fee asset.");
+      throw CfdException(
+          CfdError::kCfdIllegalArgumentError,
+          "Failed to Plan. Invalid fee asset.");
+    }
+    base_model = TxSizeModel(true);
+    ConfidentialTxOut fee_txout(
+        Script(), fee_asset, ConfidentialValue(Amount()));
+    base_model.AddTxOut(ConfidentialTxOutReference(fee_txout), false);
+  }
+#endif  // CFD_DISABLE_ELEMENTS
+  base_model.AddTxOut(static_cast<uint32_t>(option_.GetChangeOutputSize()));
+  const uint64_t base_weight = GetModelWeight(base_model);
+  if (base_weight >= max_tx_weight_) return plan;
+
+  // elementsではfee assetのUTXOのみを対象とする
+  std::vector<Utxo> candidates;
+  candidates.reserve(utxos.size());
+  for (const auto& utxo : utxos) {
+#ifndef CFD_DISABLE_ELEMENTS
+    if (is_elements && (memcmp(utxo.asset, fee_asset_bytes.data(),
+                               sizeof(utxo.asset)) != 0)) {
+      continue;
+    }
+#endif  // CFD_DISABLE_ELEMENTS
+    candidates.push_back(utxo);
+  }
+
+  // TxInの選択はCoinSelectionで行う。
+  // 消費feeを上回るUTXOのみが対象となり、TxIn以外のfeeとdust額を
+  // 満たす組み合わせを選択する。
+  FeeCalculator fee_calc(option_.GetEffectiveFeeBaserate());
+  const Amount tx_fee = fee_calc.GetFee(base_model.GetVsize());
+  const int64_t dust_value = dust_amount.GetSatoshiValue();
+  const uint64_t dust_satoshi =
+      (dust_value > 0) ? static_cast<uint64_t>(dust_value) : 0;
+  uint64_t input_weight_limit = max_tx_weight_ - base_weight;
+  if ((option_.GetMaxWeight() != 0) &&
+      (option_.GetMaxWeight() < input_weight_limit)) {
+    input_weight_limit = option_.GetMaxWeight();
+  }
+  UtxoConsolidationStrategy strategy;
+  CoinSelectionOption select_option = option_;
+  select_option.SetStrategy(&strategy);
+  select_option.SetUseOutputGroup(false);
+  select_option.SetMaxWeight(input_weight_limit);
+  CoinSelection coin_selection;
+  UtxoFilter filter;
+
+  // 1件あたりのfeeを抑えるため、各transactionにTxInを上限まで詰める。
+  // TxIn n件のtransactionはUTXOをn-1件減らす。
+  while ((plan.removed_count < removal_target) && (candidates.size() >= 2)) {
+    uint64_t input_count_limit = removal_target - plan.removed_count + 1;
+    if ((option_.GetMaxInputCount() != 0) &&
+        (option_.GetMaxInputCount() < input_count_limit)) {
+      input_count_limit = option_.GetMaxInputCount();
+    }
+    select_option.SetMaxInputCount(static_cast<uint32_t>(input_count_limit));
+
+    std::vector<size_t> indexes;
+    Amount select_value;
+    try {
+      indexes = coin_selection.SelectCoins(
+          Amount::CreateBySatoshiAmount(static_cast<int64_t>(dust_satoshi)),
+          candidates.data(), candidates.size(), filter, select_option, tx_fee,
+          &select_value);
+    } catch (const CfdException& except) {
+      // 集約可能な組み合わせがないため、残りのUTXOは集約しない
+      info(CFD_LOG_SOURCE, "Plan end. {}", except.what());
+      break;
+    }
+
+    // segwit marker等を含めたweightが上限を超える場合は末尾から除外する
+    TxSizeModel model = base_model;
+    for (size_t index : indexes) {
+      model.AddTxIn(candidates[index]);
+    }
+    while ((!indexes.empty()) && (GetModelWeight(model) > max_tx_weight_)) {
+      model.RemoveTxIn(candidates[indexes.back()]);
+      indexes.pop_back();
+    }
+    if (indexes.size() < 2) break;
+
+    UtxoConsolidationTx tx;
+    tx.input_amount = 0;
+    tx.utxos.reserve(indexes.size());
+    for (size_t index : indexes) {
+      tx.utxos.push_back(candidates[index]);
+      tx.input_amount += candidates[index].amount;
+    }
+    tx.vsize = model.GetVsize();
+    tx.weight = GetModelWeight(model);
+    tx.fee = static_cast<uint64_t>(fee_calc.GetFee(tx.vsize).GetSatoshiValue());
+    if ((tx.input_amount <= tx.fee) ||
+        ((tx.input_amount - tx.fee) < dust_satoshi)) {
+      // 選択したUTXOは候補に残し、集約を終了する
+      info(
+          CFD_LOG_SOURCE, "Plan end. Low amount. amount={}, fee={}",
+          tx.input_amount, tx.fee);
+      break;
+    }
+    tx.output_amount = tx.input_amount - tx.fee;
+    plan.removed_count += tx.utxos.size() - 1;
+    plan.total_fee += tx.fee;
+    plan.transactions.push_back(tx);
+
+    // 集約したUTXOを候補から除外する
+    std::vector<bool> is_selected(candidates.size(), false);
+    for (size_t index : indexes) {
+      is_selected[index] = true;
+    }
+    size_t position = 0;
+    for (size_t index = 0; index < candidates.size(); ++index) {
+      if (!is_selected[index]) candidates[position++] = candidates[index];
+    }
+    candidates.resize(position);
+  }
+  plan.remaining_pool_size = utxos.size() - plan.removed_count;
+  return plan;
+}
+
+std::vector<TransactionController> UtxoConsolidationPlanner::CreateTransactions(
+    const UtxoConsolidationPlan& plan, const Address& address) const {
+  std::vector<TransactionController> result;
+  result.reserve(plan.transactions.size());
+  for (const auto& tx : plan.transactions) {
+    TransactionController txc(kConsolidationTxVersion, 0);
+    for (const auto& utxo : tx.utxos) {
+      txc.AddTxIn(GetUtxoTxid(utxo), utxo.vout);
+    }
+    txc.AddTxOut(
+        address, Amount::CreateBySatoshiAmount(
+                     static_cast<int64_t>(tx.output_amount)));
+    result.push_back(txc);
+  }
+  return result;
+}
+
+std::vector<TransactionController> UtxoConsolidationPlanner::CreateTransactions(
+    const std::vector<Utxo>& utxos, size_t target_pool_size,
+    const Address& address, UtxoConsolidationPlan* plan) const {
+  UtxoConsolidationPlan work_plan =
+      Plan(utxos, target_pool_size, option_.GetDustFeeAmount(address));
+  std::vector<TransactionController> result =
+      CreateTransactions(work_plan, address);
+  if (plan != nullptr) *plan = work_plan;
+  return result;
+}
+
+#ifndef CFD_DISABLE_ELEMENTS
+std::vector<ConfidentialTransactionController>
+UtxoConsolidationPlanner::CreateConfidentialTransactions(
+    const UtxoConsolidationPlan& plan, const Address& address) const {
+  const ConfidentialAssetId fee_asset = option_.GetFeeAsset();
+  if (fee_asset.IsEmpty()) {
+    warn(
+        CFD_LOG_SOURCE,
+        "Failed to CreateConfidentialTransactions. Fee asset is empty.");
+    throw CfdException(
+        CfdError::kCfdIllegalStateError,
+        "Failed to CreateConfidentialTransactions. Fee asset is empty.");
+  }
+
+  std::vector<ConfidentialTransactionController> result;
+  result.reserve(plan.transactions.size());
+  for (const auto& tx : plan.transactions) {
+    ConfidentialTransactionController ctxc(kConsolidationTxVersion, 0);
+    for (const auto& utxo : tx.utxos) {
+      ctxc.AddTxIn(GetUtxoTxid(utxo), utxo.vout);
+    }
+    ctxc.AddTxOut(
+        address,
+        Amount::CreateBySatoshiAmount(static_cast<int64_t>(tx.output_amount)),
+        fee_asset);
+    ctxc.AddTxOutFee(
+        Amount::CreateBySatoshiAmount(static_cast<int64_t>(tx.fee)),
+        fee_asset);
+    result.push_back(ctxc);
+  }
+  return result;
+}
+
+std::vector<ConfidentialTransactionController>
+UtxoConsolidationPlanner::CreateConfidentialTransactions(
+    const std::vector<Utxo>& utxos, size_t target_pool_size,
+    const Address& address, UtxoConsolidationPlan* plan) const {
+  UtxoConsolidationPlan work_plan =
+      Plan(utxos, target_pool_size, option_.GetDustFeeAmount(address));
+  std::vector<ConfidentialTransactionController> result =
+      CreateConfidentialTransactions(work_plan, address);
+  if (plan != nullptr) *plan = work_plan;
+  return result;
+}
+#endif  // CFD_DISABLE_ELEMENTS
+
+}  // namespace cfd
@@ -8,12 +8,62 @@
 #include <vector>
 
 #include "cfd/cfd_common.h"
+#include "cfd/cfd_fee.h"
 #include "cfd/cfd_utxo.h"
 #include "cfd/cfdapi_coin.h"
+#include "cfdcore/cfdcore_exception.h"
+#include "cfdcore/cfdcore_logger.h"
+#include "cfdcore/cfdcore_transaction.h"
 
 namespace cfd {
 namespace api {
 
+using cfd::DescriptorTxInSizeData;
+using cfd::TxInSizeTable;
+using cfd::core::CfdError;
+using cfd::core::CfdException;
+using cfd::core::TxIn;
+#ifndef CFD_DISABLE_ELEMENTS
+using cfd::core::ConfidentialTxIn;
+#endif  // CFD_DISABLE_ELEMENTS
+using cfd::core::logger::warn;
+
+/**
+ * @brief UTXOのアドレス種別を判定する.
+ * @details address未指定時はdescriptor, locking scriptの順に判定する。
+ * @param[in] utxo_data   utxo data
+ * @return address type
+ */
+static AddressType GetUtxoAddressType(const UtxoData& utxo_data) {
+  const std::string& descriptor = utxo_data.descriptor;
+  AddressType addr_type = utxo_data.address.GetAddressType();
+  if (utxo_data.address.GetAddress().empty()) {
+    if (descriptor.find("wpkh(") == 0) {
+      addr_type = AddressType::kP2wpkhAddress;
+    } else if (descriptor.find("wsh(") == 0) {
+      addr_type = AddressType::kP2wshAddress;
+    } else if (descriptor.find("pkh(") == 0) {
+      addr_type = AddressType::kP2pkhAddress;
+    } else if (descriptor.find("sh(") == 0) {
+      addr_type = AddressType::kP2shAddress;
+    } else if (utxo_data.locking_script.IsP2wpkhScript()) {
+      addr_type = AddressType::kP2wpkhAddress;
+    } else if (utxo_data.locking_script.IsP2wshScript()) {
+      addr_type = AddressType::kP2wshAddress;
+    } else if (utxo_data.locking_script.IsP2pkhScript()) {
+      addr_type = AddressType::kP2pkhAddress;
+    } else if (utxo_data.locking_script.IsP2shScript()) {
+      addr_type = AddressType::kP2shAddress;
+    }
+  }
+  if (descriptor.find("sh(wpkh(") == 0) {
+    addr_type = AddressType::kP2shP2wpkhAddress;
+  } else if (descriptor.find("sh(wsh(") == 0) {
+    addr_type = AddressType::kP2shP2wshAddress;
+  }
+  return addr_type;
+}
+
 std::vector<Utxo> CoinApi::ConvertToUtxo(
     const std::vector<UtxoData>& utxos) const {
   std::vector<Utxo> result;
@@ -28,7 +78,7 @@ std::vector<Utxo> CoinApi::ConvertToUtxo(
 
 void CoinApi::ConvertToUtxo(const UtxoData& utxo_data, Utxo* utxo) const {
   if (utxo) {
-    memset(utxo, 0, sizeof(utxo));
+    memset(utxo, 0, sizeof(*utxo));
     utxo->block_height = utxo_data.block_height;
     utxo->vout = utxo_data.vout;
     utxo->binary_data = utxo_data.binary_data;
@@ -45,17 +95,19 @@ void CoinApi::ConvertToUtxo(const UtxoData& utxo_data, Utxo* utxo) const {
       memcpy(utxo->txid, txid.GetBytes().data(), sizeof(utxo->txid));
     }
 
-    // descriptorがあれば、そこから変換
+    // descriptorがあれば、そこから種別とサイズを算出 (解析結果はキャッシュ)
+    DescriptorTxInSizeData size_data;
+    bool has_descriptor_size = TxInSizeTable::GetDescriptorTxInSizeData(
+        utxo_data.descriptor, &size_data);
     std::vector<uint8_t> locking_script_bytes;
-    if (!utxo_data.descriptor.empty()) {
-      // FIXME descriptor差し替え
-      // utxo->locking_script = utxo_data.descriptor;
-      // utxo->address_type = utxo_data.descriptor;
-    } else if (!utxo_data.address.GetAddress().empty()) {
+    if (!utxo_data.address.GetAddress().empty()) {
       locking_script_bytes =
           utxo_data.address.GetLockingScript().GetData().GetBytes();
       utxo->address_type =
           static_cast<uint16_t>(utxo_data.address.GetAddressType());
+    } else if (has_descriptor_size && !size_data.locking_script.IsEmpty()) {
+      // 引数を持つdescriptorはlocking scriptが確定しないため、指定値を使用
+      locking_script_bytes = size_data.locking_script.GetData().GetBytes();
     } else if (!utxo_data.locking_script.IsEmpty()) {
       locking_script_bytes = utxo_data.locking_script.GetData().GetBytes();
       if (utxo_data.locking_script.IsP2wpkhScript()) {
@@ -68,6 +120,9 @@ void CoinApi::ConvertToUtxo(const UtxoData& utxo_data, Utxo* utxo) const {
         utxo->address_type = AddressType::kP2shAddress;
       }
     }
+    if (has_descriptor_size) {
+      utxo->address_type = static_cast<uint16_t>(size_data.address_type);
+    }
 
     if (!locking_script_bytes.empty()) {
       utxo->script_length = static_cast<uint16_t>(locking_script_bytes.size());
@@ -78,27 +133,22 @@ void CoinApi::ConvertToUtxo(const UtxoData& utxo_data, Utxo* utxo) const {
       }
     }
 
-    switch (utxo->address_type) {
-      case AddressType::kP2wpkhAddress:
-        utxo->witness_size_max = 71 + 33 + 2;
-        // fall-through
-      case AddressType::kP2shP2wpkhAddress:
-        utxo->uscript_size_max = 20 + 2;
-        break;
-      case AddressType::kP2wshAddress:
-        utxo->witness_size_max = 71 + utxo->script_length + 2;
-        // fall-through
-      case AddressType::kP2shP2wshAddress:
-        utxo->uscript_size_max = 32 + 2;
-        break;
-      case AddressType::kP2pkhAddress:
-        utxo->uscript_size_max = 71 + 33 + 3;
-        break;
-      case AddressType::kP2shAddress:
-      default:
-        utxo->uscript_size_max = 71 + utxo->script_length + 3;
-        break;
+    // fee算出(EstimateFee等)と同じ推定サイズを設定する
+    uint32_t witness_size = 0;
+    uint32_t txin_size = 0;
+#ifndef CFD_DISABLE_ELEMENTS
+    if (!utxo_data.asset.IsEmpty()) {
+      txin_size = EstimateConfidentialTxInSize(
+          utxo_data, false, false, false, 0, Script(), &witness_size);
     }
+#endif  // CFD_DISABLE_ELEMENTS
+    if (txin_size == 0) {
+      txin_size = EstimateTxInSize(utxo_data, &witness_size);
+    }
+    utxo->uscript_size_max = static_cast<uint16_t>(
+        txin_size - witness_size -
+        static_cast<uint32_t>(TxIn::kMinimumTxInSize));
+    utxo->witness_size_max = static_cast<uint16_t>(witness_size);
 
 #ifndef CFD_DISABLE_ELEMENTS
     if (!utxo_data.asset.IsEmpty()) {
@@ -110,5 +160,79 @@ void CoinApi::ConvertToUtxo(const UtxoData& utxo_data, Utxo* utxo) const {
   }
 }
 
+uint32_t CoinApi::EstimateTxInSize(
+    const UtxoData& utxo_data, uint32_t* witness_size) const {
+  // descriptorを解析できる場合はscript(multisig等)を含めて算出する
+  uint32_t txin_size = 0;
+  if (utxo_data.redeem_script.IsEmpty() &&
+      TxInSizeTable::GetDescriptorTxInSize(
+          utxo_data.descriptor, &txin_size, witness_size)) {
+    return txin_size;
+  }
+
+  // redeem script未指定時は種別ごとの算出済みサイズを参照する
+  AddressType addr_type = GetUtxoAddressType(utxo_data);
+  if (utxo_data.redeem_script.IsEmpty()) {
+    return TxInSizeTable::GetTxInSize(addr_type, witness_size);
+  }
+  return TxIn::EstimateTxInSize(
+      addr_type, utxo_data.redeem_script, witness_size);
+}
+
+#ifndef CFD_DISABLE_ELEMENTS
+uint32_t CoinApi::EstimateConfidentialTxInSize(
+    const UtxoData& utxo_data, bool is_issuance, bool is_blind_issuance,
+    bool is_pegin, uint32_t pegin_btc_tx_size, const Script& fedpeg_script,
+    uint32_t* witness_size) const {
+  // descriptorを解析できる場合はscript(multisig等)を含めて算出する
+  uint32_t txin_size = 0;
+  if ((!is_pegin) && utxo_data.redeem_script.IsEmpty() &&
+      TxInSizeTable::GetConfidentialDescriptorTxInSize(
+          utxo_data.descriptor, is_issuance, is_blind_issuance, &txin_size,
+          witness_size)) {
+    return txin_size;
+  }
+
+  // pegin・redeem script未指定時は種別ごとの算出済みサイズを参照する
+  AddressType addr_type = GetUtxoAddressType(utxo_data);
+  if ((!is_pegin) && utxo_data.redeem_script.IsEmpty()) {
+    return TxInSizeTable::GetConfidentialTxInSize(
+        addr_type, is_issuance, is_blind_issuance, witness_size);
+  }
+  return ConfidentialTxIn::EstimateTxInSize(
+      addr_type, utxo_data.redeem_script,
+      (is_pegin) ? pegin_btc_tx_size : 0,
+      (is_pegin) ? fedpeg_script : Script(), is_issuance, is_blind_issuance,
+      witness_size);
+}
+#endif  // CFD_DISABLE_ELEMENTS
+
+void CoinApi::AddUtxo(const UtxoData& utxo_data, UtxoIndex* utxo_index) const {
+  if (utxo_index == nullptr) {
+    warn(CFD_LOG_SOURCE, "utxo_index is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to add utxo. utxo_index is nullptr.");
+  }
+  Utxo utxo;
+  memset(&utxo, 0, sizeof(utxo));
+  ConvertToUtxo(utxo_data, &utxo);
+  utxo_index->Add(utxo);
+}
+
+void CoinApi::UpdateUtxo(
+    const UtxoData& utxo_data, UtxoIndex* utxo_index) const {
+  if (utxo_index == nullptr) {
+    warn(CFD_LOG_SOURCE, "utxo_index is nullptr.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError,
+        "Failed to update utxo. utxo_index is nullptr.");
+  }
+  Utxo utxo;
+  memset(&utxo, 0, sizeof(utxo));
+  ConvertToUtxo(utxo_data, &utxo);
+  utxo_index->Update(utxo);
+}
+
 }  // namespace api
 }  // namespace cfd
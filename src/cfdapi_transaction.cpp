@@ -7,6 +7,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -34,10 +35,13 @@ namespace api {
 
 using cfd::FeeCalculator;
 using cfd::TransactionController;
+using cfd::TxSizeModel;
 using cfd::api::TransactionApiBase;
 using cfd::core::CfdError;
 using cfd::core::CfdException;
 using cfd::core::Txid;
+using cfd::core::TxOut;
+using cfd::core::TxOutReference;
 using cfd::core::logger::info;
 using cfd::core::logger::warn;
 
@@ -54,6 +58,216 @@ static TransactionController CreateController(const std::string& hex) {
   return TransactionController(hex);
 }
 
+/**
+ * @brief UTXO一覧をTxInとした場合のサイズを推定する.
+ * @param[in] utxos           utxo list
+ * @param[out] witness_size   witness area size
+ * @return txin size (witness領域を除く)
+ */
+static uint32_t EstimateUtxoSize(
+    const std::vector<UtxoData>& utxos, uint32_t* witness_size) {
+  CoinApi coin_api;
+  uint32_t size = 0;
+  uint32_t wit_size = 0;
+  *witness_size = 0;
+  for (const auto& utxo : utxos) {
+    uint32_t txin_size = coin_api.EstimateTxInSize(utxo, &wit_size);
+    txin_size -= wit_size;
+    size += txin_size;
+    *witness_size += wit_size;
+  }
+  return size;
+}
+
+/**
+ * @brief UTXO一覧をTxInとした場合のvsizeを推定する.
+ * @param[in] utxos   utxo list
+ * @return txin virtual size
+ */
+static uint32_t EstimateUtxoVsize(const std::vector<UtxoData>& utxos) {
+  uint32_t witness_size = 0;
+  uint32_t size = EstimateUtxoSize(utxos, &witness_size);
+  return AbstractTransaction::GetVsizeFromSize(size, witness_size);
+}
+
+//! coin selection function type
+using SelectCoinsFunction = std::function<std::vector<Utxo>(
+    const Amount& target_value, const UtxoFilter& filter,
+    const CoinSelectionOption& option_params, const Amount& tx_fee_value,
+    Amount* select_value)>;
+
+//! utxo fee estimation function type (selected txin utxos and coins)
+using EstimateUtxoFeeFunction =
+    std::function<Amount(const std::vector<Utxo>& selected_coins)>;
+
+/**
+ * @brief FundRawTransactionの共通処理.
+ * @details UTXOの収集方法と、TxIn分(選択したcoinを含む)のfee算出方法は
+ *   呼び出し元で指定する。TxIn以外のサイズはTxSizeModelで差分更新する。
+ *   txc を直接更新し、hex文字列への変換は行わない。
+ * @param[in,out] txc                  transaction controller
+ * @param[in] select_coins             coin selection function
+ * @param[in] estimate_utxo_fee        utxo fee estimation function
+ * @param[in] target_value             target value
+ * @param[in] selected_txin_utxos      selected txin utxo
+ * @param[in] reserve_txout_address    reserved address
+ * @param[in] effective_fee_rate       effective fee rate (minimum)
+ * @param[out] estimate_fee            estimate fee
+ * @param[in] filter                   utxo search filter
+ * @param[in] option_params            utxo search option
+ * @param[out] append_txout_addresses  used txout additional address
+ * @param[in] net_type                 network type
+ * @param[in] prefix_list              address prefix list
+ */
+static void FundRawTransactionImpl(
+    TransactionController* txc, const SelectCoinsFunction& select_coins,
+    const EstimateUtxoFeeFunction& estimate_utxo_fee,
+    const Amount& target_value,
+    const std::vector<UtxoData>& selected_txin_utxos,
+    const std::string& reserve_txout_address, double effective_fee_rate,
+    Amount* estimate_fee, const UtxoFilter* filter,
+    const CoinSelectionOption* option_params,
+    std::vector<std::string>* append_txout_addresses, NetType net_type,
+    const std::vector<AddressFormatData>* prefix_list) {
+  // set option
+  CoinSelectionOption option;
+  UtxoFilter utxo_filter;
+  if (filter) utxo_filter = *filter;
+  if (option_params) {
+    option = *option_params;
+  } else {
+    option.InitializeTxSizeInfo();
+    option.SetEffectiveFeeBaserate(effective_fee_rate);
+    option.SetLongTermFeeBaserate(effective_fee_rate);
+  }
+
+  AddressFactory addr_factory(net_type);
+  if (prefix_list) {
+    addr_factory = AddressFactory(net_type, *prefix_list);
+  }
+
+  // txから設定済みTxIn/TxOutの額を収集
+  // (selected_txin_utxos指定分はtxid一致なら設定済みUTXO扱い)
+  const Transaction& tx = txc->GetTransaction();
+  Amount txin_amount;
+  Amount tx_amount;
+  for (const auto& txout : tx.GetTxOutList()) {
+    tx_amount += txout.GetValue();
+  }
+  const auto& txin_list = tx.GetTxInList();
+  UtxoOutPointSet txin_outpoints;
+  txin_outpoints.reserve(txin_list.size());
+  for (const auto& txin : txin_list) {
+    txin_outpoints.insert(UtxoOutPoint::Create(txin.GetTxid(), txin.GetVout()));
+  }
+  for (const auto& utxo : selected_txin_utxos) {
+    if (txin_outpoints.find(UtxoOutPoint::Create(utxo.txid, utxo.vout)) !=
+        txin_outpoints.end()) {
+      txin_amount += utxo.amount;
+    }
+  }
+
+  // TxIn以外のサイズ。以降のTxOut追加はサイズ差分のみ反映する。
+  Amount fee;
+  FeeCalculator fee_calc(
+      static_cast<uint64_t>(floor(effective_fee_rate * 1000)));
+  TxSizeModel tx_size;
+  if (option.GetEffectiveFeeBaserate() != 0) {
+    tx_size = TxSizeModel(
+        txc->GetSizeIgnoreTxIn(), 0, 0, tx.GetTxOutCount());
+    fee = fee_calc.GetFee(tx_size.GetVsize()) +
+          estimate_utxo_fee(std::vector<Utxo>());
+    info(CFD_LOG_SOURCE, "fee={}", fee.GetSatoshiValue());
+  }
+
+  // 探索対象額を設定。未設定時はTxOutの合計額を設定。
+  Amount target_amount = target_value;
+  if (target_amount.GetSatoshiValue() == 0) {
+    target_amount = tx_amount;
+  }
+  if (target_amount > txin_amount) {
+    target_amount -= txin_amount;
+  } else {
+    target_amount = Amount::CreateBySatoshiAmount(0);
+  }
+
+  std::vector<uint8_t> txid_bytes(cfd::core::kByteData256Length);
+  Amount dest_amount = tx_amount;
+  if (target_value > dest_amount) {
+    // txout設定額よりも大きな額を収集要求した
+    dest_amount = target_value;
+  }
+
+  // execute coinselection
+  Amount utxo_amount = txin_amount;
+  std::vector<Utxo> selected_coins;
+  if (target_amount > 0) {
+    info(CFD_LOG_SOURCE, "target_amount={}", target_amount.GetSatoshiValue());
+    selected_coins =
+        select_coins(target_amount, utxo_filter, option, fee, &utxo_amount);
+    utxo_amount += txin_amount;
+    info(CFD_LOG_SOURCE, "utxo_amount={}", utxo_amount.GetSatoshiValue());
+    if (utxo_amount < dest_amount) {
+      warn(CFD_LOG_SOURCE, "Failed to FundRawTransaction. low BTC.");
+      throw CfdException(CfdError::kCfdIllegalArgumentError, "low BTC.");
+    }
+  }
+
+  Amount diff_amount = utxo_amount;
+  diff_amount -= dest_amount;
+  int64_t diff_satoshi = diff_amount.GetSatoshiValue();
+  Address address = addr_factory.GetAddress(reserve_txout_address);
+  Amount dust_amount = option.GetDustFeeAmount(address);
+  info(CFD_LOG_SOURCE, "dust_amount={}", dust_amount.GetSatoshiValue());
+
+  if (option.GetEffectiveFeeBaserate() > 0) {
+    Amount need_amount = dest_amount + fee;
+    Amount check_amount = utxo_amount - dust_amount;
+    if (check_amount > need_amount) {
+      // 必要額以上ある場合、TxOutが増えるのでfee再計算
+      // (追加するTxOutのサイズ差分のみ反映。額は無視)
+      TxOut change_txout(fee, address.GetLockingScript());
+      tx_size.AddTxOut(TxOutReference(change_txout));
+      fee = fee_calc.GetFee(tx_size.GetVsize()) +
+            estimate_utxo_fee(selected_coins);
+      info(CFD_LOG_SOURCE, "new_fee={}", fee.GetSatoshiValue());
+      need_amount = dest_amount + fee;
+    }
+
+    if (utxo_amount < need_amount) {
+      warn(CFD_LOG_SOURCE, "Failed to FundRawTransaction. low fee.");
+      throw CfdException(CfdError::kCfdIllegalArgumentError, "low fee.");
+    }
+    diff_amount -= fee;  // fee分を除外
+    diff_satoshi = diff_amount.GetSatoshiValue();
+
+    // optionで、超過額の設定がある場合、余剰分をfeeに設定。
+    if (dust_amount > diff_amount) {
+      // feeに残高をすべて設定
+      diff_satoshi = 0;
+      fee = utxo_amount - dest_amount;
+    }
+    info(CFD_LOG_SOURCE, "diff_amount={}", diff_satoshi);
+  }
+
+  // dustより小さい場合はTxOutには追加しない
+  // (fee計算ありの場合はチェック済だが、fee計算なしの場合は未チェックのため)
+  if ((diff_satoshi != 0) && (dust_amount < diff_amount)) {
+    txc->AddTxOut(addr_factory.GetAddress(reserve_txout_address), diff_amount);
+    info(CFD_LOG_SOURCE, "addTxOut. value={}", diff_amount.GetSatoshiValue());
+    if (append_txout_addresses) {
+      append_txout_addresses->push_back(reserve_txout_address);
+    }
+  }
+  if (estimate_fee) *estimate_fee = fee;
+
+  // SelectしたUTXOをTxInに設定
+  for (auto& utxo : selected_coins) {
+    memcpy(txid_bytes.data(), utxo.txid, txid_bytes.size());
+    txc->AddTxIn(Txid(ByteData256(txid_bytes)), utxo.vout);
+  }
+}
+
 // -----------------------------------------------------------------------------
 // TransactionApi
 // -----------------------------------------------------------------------------
@@ -206,43 +420,16 @@ Amount TransactionApi::EstimateFee(
     const std::string& tx_hex, const std::vector<UtxoData>& utxos,
     Amount* tx_fee, Amount* utxo_fee, double effective_fee_rate) const {
   TransactionController txc(tx_hex);
+  return EstimateFee(txc, utxos, tx_fee, utxo_fee, effective_fee_rate);
+}
 
+Amount TransactionApi::EstimateFee(
+    const TransactionController& txc, const std::vector<UtxoData>& utxos,
+    Amount* tx_fee, Amount* utxo_fee, double effective_fee_rate) const {
   uint32_t size;
   size = txc.GetSizeIgnoreTxIn();
   uint32_t tx_vsize = AbstractTransaction::GetVsizeFromSize(size, 0);
-
-  size = 0;
-  uint32_t witness_size = 0;
-  uint32_t wit_size = 0;
-  for (const auto& utxo : utxos) {
-    // check descriptor
-    AddressType addr_type = utxo.address.GetAddressType();
-    // TODO(k-matsuzawa): output descriptorの正式対応後に差し替え
-    if (utxo.address.GetAddress().empty()) {
-      if (utxo.descriptor.find("wpkh(") == 0) {
-        addr_type = AddressType::kP2wpkhAddress;
-      } else if (utxo.descriptor.find("wsh(") == 0) {
-        addr_type = AddressType::kP2wshAddress;
-      } else if (utxo.descriptor.find("pkh(") == 0) {
-        addr_type = AddressType::kP2pkhAddress;
-      } else if (utxo.descriptor.find("sh(") == 0) {
-        addr_type = AddressType::kP2shAddress;
-      }
-    }
-    if (utxo.descriptor.find("sh(wpkh(") == 0) {
-      addr_type = AddressType::kP2shP2wpkhAddress;
-    } else if (utxo.descriptor.find("sh(wsh(") == 0) {
-      addr_type = AddressType::kP2shP2wshAddress;
-    }
-
-    uint32_t txin_size =
-        TxIn::EstimateTxInSize(addr_type, utxo.redeem_script, &wit_size);
-    txin_size -= wit_size;
-    size += txin_size;
-    witness_size += wit_size;
-  }
-  uint32_t utxo_vsize =
-      AbstractTransaction::GetVsizeFromSize(size, witness_size);
+  uint32_t utxo_vsize = EstimateUtxoVsize(utxos);
 
   uint64_t fee_rate = static_cast<uint64_t>(floor(effective_fee_rate * 1000));
   FeeCalculator fee_calc(fee_rate);
@@ -269,156 +456,194 @@ TransactionController TransactionApi::FundRawTransaction(
     const CoinSelectionOption* option_params,
     std::vector<std::string>* append_txout_addresses, NetType net_type,
     const std::vector<AddressFormatData>* prefix_list) const {
-  // set option
-  CoinSelectionOption option;
-  UtxoFilter utxo_filter;
-  if (filter) utxo_filter = *filter;
-  if (option_params) {
-    option = *option_params;
-  } else {
-    option.InitializeTxSizeInfo();
-    option.SetEffectiveFeeBaserate(effective_fee_rate);
-    option.SetLongTermFeeBaserate(effective_fee_rate);
-  }
-
-  AddressFactory addr_factory(net_type);
-  if (prefix_list) {
-    addr_factory = AddressFactory(net_type, *prefix_list);
-  }
-
-  // txから設定済みTxIn/TxOutの額を収集
-  // (selected_txin_utxos指定分はtxid一致なら設定済みUTXO扱い)
   TransactionController txc(tx_hex);
-  const Transaction& tx = txc.GetTransaction();
-  Amount txin_amount;
-  Amount tx_amount;
-  for (const auto& txout : tx.GetTxOutList()) {
-    tx_amount += txout.GetValue();
+  FundRawTransaction(
+      &txc, utxos, target_value, selected_txin_utxos, reserve_txout_address,
+      effective_fee_rate, estimate_fee, filter, option_params,
+      append_txout_addresses, net_type, prefix_list);
+  return txc;
+}
+
+void TransactionApi::FundRawTransaction(
+    TransactionController* txc, const std::vector<UtxoData>& utxos,
+    const Amount& target_value,
+    const std::vector<UtxoData>& selected_txin_utxos,
+    const std::string& reserve_txout_address, double effective_fee_rate,
+    Amount* estimate_fee, const UtxoFilter* filter,
+    const CoinSelectionOption* option_params,
+    std::vector<std::string>* append_txout_addresses, NetType net_type,
+    const std::vector<AddressFormatData>* prefix_list) const {
+  if (txc == nullptr) {
+    warn(CFD_LOG_SOURCE, "Failed to FundRawTransaction. txc is null.");
+    throw CfdException(CfdError::kCfdIllegalArgumentError, "txc is null.");
   }
-  const auto& txin_list = tx.GetTxInList();
-  for (const auto& utxo : selected_txin_utxos) {
-    for (const auto& txin : txin_list) {
-      if ((txin.GetTxid().Equals(utxo.txid)) &&
-          (utxo.vout == txin.GetVout())) {
-        txin_amount += utxo.amount;
-        break;
+  CoinSelection coin_select;
+  auto select_coins = [&coin_select, &utxos](
+                          const Amount& target_amount,
+                          const UtxoFilter& utxo_filter,
+                          const CoinSelectionOption& option, const Amount& fee,
+                          Amount* select_value) {
+    CoinApi coin_api;
+    std::vector<Utxo> utxo_list = coin_api.ConvertToUtxo(utxos);
+    return coin_select.SelectCoins(
+        target_amount, utxo_list, utxo_filter, option, fee, select_value,
+        nullptr, nullptr);
+  };
+  // 選択したcoinからUTXO情報を引くための索引 (fee再計算時に利用)
+  const UtxoOutPointIndexMap utxo_positions = CreateOutPointIndexMap(utxos);
+  const FeeCalculator fee_calc(
+      static_cast<uint64_t>(floor(effective_fee_rate * 1000)));
+  auto estimate_utxo_fee = [&utxos, &utxo_positions, &selected_txin_utxos,
+                            &fee_calc](
+                               const std::vector<Utxo>& selected_coins) {
+    std::vector<UtxoData> new_selected_utxos = selected_txin_utxos;
+    new_selected_utxos.reserve(
+        selected_txin_utxos.size() + selected_coins.size());
+    for (const Utxo& coin : selected_coins) {
+      auto iter = utxo_positions.find(UtxoOutPoint::Create(coin));
+      if (iter != utxo_positions.end()) {
+        new_selected_utxos.push_back(utxos[iter->second]);
       }
     }
-  }
+    return fee_calc.GetFee(EstimateUtxoVsize(new_selected_utxos));
+  };
+  FundRawTransactionImpl(
+      txc, select_coins, estimate_utxo_fee, target_value,
+      selected_txin_utxos, reserve_txout_address, effective_fee_rate,
+      estimate_fee, filter, option_params, append_txout_addresses, net_type,
+      prefix_list);
+}
 
-  Amount fee;
-  if (option.GetEffectiveFeeBaserate() != 0) {
-    fee = EstimateFee(
-        tx_hex, selected_txin_utxos, nullptr, nullptr, effective_fee_rate);
-    info(CFD_LOG_SOURCE, "fee={}", fee.GetSatoshiValue());
-  }
+TransactionController TransactionApi::FundRawTransaction(
+    const std::string& tx_hex, UtxoIndex* utxo_index,
+    const Amount& target_value,
+    const std::vector<UtxoData>& selected_txin_utxos,
+    const std::string& reserve_txout_address, double effective_fee_rate,
+    Amount* estimate_fee, const UtxoFilter* filter,
+    const CoinSelectionOption* option_params,
+    std::vector<std::string>* append_txout_addresses, NetType net_type,
+    const std::vector<AddressFormatData>* prefix_list) const {
+  TransactionController txc(tx_hex);
+  FundRawTransaction(
+      &txc, utxo_index, target_value, selected_txin_utxos,
+      reserve_txout_address, effective_fee_rate, estimate_fee, filter,
+      option_params, append_txout_addresses, net_type, prefix_list);
+  return txc;
+}
 
-  // 探索対象額を設定。未設定時はTxOutの合計額を設定。
-  Amount target_amount = target_value;
-  if (target_amount.GetSatoshiValue() == 0) {
-    target_amount = tx_amount;
-  }
-  if (target_amount > txin_amount) {
-    target_amount -= txin_amount;
-  } else {
-    target_amount = Amount::CreateBySatoshiAmount(0);
+void TransactionApi::FundRawTransaction(
+    TransactionController* txc, UtxoIndex* utxo_index,
+    const Amount& target_value,
+    const std::vector<UtxoData>& selected_txin_utxos,
+    const std::string& reserve_txout_address, double effective_fee_rate,
+    Amount* estimate_fee, const UtxoFilter* filter,
+    const CoinSelectionOption* option_params,
+    std::vector<std::string>* append_txout_addresses, NetType net_type,
+    const std::vector<AddressFormatData>* prefix_list) const {
+  if (txc == nullptr) {
+    warn(CFD_LOG_SOURCE, "Failed to FundRawTransaction. txc is null.");
+    throw CfdException(CfdError::kCfdIllegalArgumentError, "txc is null.");
   }
-
-  std::vector<uint8_t> txid_bytes(cfd::core::kByteData256Length);
-  Amount dest_amount = tx_amount;
-  if (target_value > dest_amount) {
-    // txout設定額よりも大きな額を収集要求した
-    dest_amount = target_value;
+  if (utxo_index == nullptr) {
+    warn(CFD_LOG_SOURCE, "Failed to FundRawTransaction. utxo_index is null.");
+    throw CfdException(
+        CfdError::kCfdIllegalArgumentError, "utxo_index is null.");
   }
-
-  // execute coinselection
-  CoinApi coin_api;
   CoinSelection coin_select;
-  std::vector<Utxo> utxo_list = coin_api.ConvertToUtxo(utxos);
-  Amount utxo_amount = txin_amount;
-  std::vector<Utxo> selected_coins;
-  if (target_amount > 0) {
-    info(CFD_LOG_SOURCE, "target_amount={}", target_amount.GetSatoshiValue());
-    selected_coins = coin_select.SelectCoins(
-        target_amount, utxo_list, utxo_filter, option, fee, &utxo_amount,
+  auto select_coins = [&coin_select, utxo_index](
+                          const Amount& target_amount,
+                          const UtxoFilter& utxo_filter,
+                          const CoinSelectionOption& option, const Amount& fee,
+                          Amount* select_value) {
+    return coin_select.SelectCoins(
+        target_amount, utxo_index, utxo_filter, option, fee, select_value,
         nullptr, nullptr);
-    utxo_amount += txin_amount;
-    info(CFD_LOG_SOURCE, "utxo_amount={}", utxo_amount.GetSatoshiValue());
-    if (utxo_amount < dest_amount) {
-      warn(CFD_LOG_SOURCE, "Failed to FundRawTransaction. low BTC.");
-      throw CfdException(CfdError::kCfdIllegalArgumentError, "low BTC.");
+  };
+  // 選択したcoinはUTXOインデックスの変換済みサイズでfeeを算出する
+  // (CoinApiの変換値はEstimateUtxoSizeと同じ推定値を使用する)
+  const FeeCalculator fee_calc(
+      static_cast<uint64_t>(floor(effective_fee_rate * 1000)));
+  // (TxIn全体のサイズを合算し、feeは一括で算出する)
+  uint32_t txin_witness_size = 0;
+  const uint32_t txin_size =
+      EstimateUtxoSize(selected_txin_utxos, &txin_witness_size);
+  auto estimate_utxo_fee = [&fee_calc, txin_size, txin_witness_size](
+                               const std::vector<Utxo>& selected_coins) {
+    uint32_t size = txin_size;
+    uint32_t witness_size = txin_witness_size;
+    for (const Utxo& coin : selected_coins) {
+      size += static_cast<uint32_t>(TxIn::kMinimumTxInSize) +
+              coin.uscript_size_max;
+      witness_size += coin.witness_size_max;
     }
-  }
-
-  Amount diff_amount = utxo_amount;
-  diff_amount -= dest_amount;
-  int64_t diff_satoshi = diff_amount.GetSatoshiValue();
-  Address address = addr_factory.GetAddress(reserve_txout_address);
-  Amount dust_amount = option.GetDustFeeAmount(address);
-  info(CFD_LOG_SOURCE, "dust_amount={}", dust_amount.GetSatoshiValue());
+    return fee_calc.GetFee(
+        AbstractTransaction::GetVsizeFromSize(size, witness_size));
+  };
+  FundRawTransactionImpl(
+      txc, select_coins, estimate_utxo_fee, target_value,
+      selected_txin_utxos, reserve_txout_address, effective_fee_rate,
+      estimate_fee, filter, option_params, append_txout_addresses, net_type,
+      prefix_list);
+}
 
-  if (option.GetEffectiveFeeBaserate() > 0) {
-    Amount need_amount = dest_amount + fee;
-    Amount check_amount = utxo_amount - dust_amount;
-    if (check_amount > need_amount) {
-      // 必要額以上ある場合、TxOutが増えるのでfee再計算
-      // dummyのtx作成
-      TransactionController txc_dummy(tx_hex);
-      std::vector<UtxoData> new_selected_utxos = selected_txin_utxos;
-      Txid txid;
-      for (const Utxo& coin : selected_coins) {
-        memcpy(txid_bytes.data(), coin.txid, txid_bytes.size());
-        txid = Txid(ByteData256(txid_bytes));
-        for (const UtxoData& utxo : utxos) {
-          if (txid.Equals(utxo.txid) && (coin.vout == utxo.vout)) {
-            new_selected_utxos.push_back(utxo);
-            break;
-          }
-        }
+std::vector<TransactionController> TransactionApi::FundRawTransactions(
+    const std::vector<std::string>& tx_hex_list,
+    const std::vector<UtxoData>& utxos,
+    const std::string& reserve_txout_address, double effective_fee_rate,
+    std::vector<Amount>* estimate_fees, const UtxoFilter* filter,
+    const CoinSelectionOption* option_params,
+    std::vector<std::vector<std::string>>* append_txout_addresses,
+    NetType net_type, const std::vector<AddressFormatData>* prefix_list) const {
+  // UTXOの変換は全tx共通で一度だけ実施する
+  CoinApi coin_api;
+  std::vector<Utxo> utxo_list = coin_api.ConvertToUtxo(utxos);
+  UtxoIndex utxo_index;
+  for (const auto& utxo : utxo_list) {
+    utxo_index.Add(utxo);
+  }
+  const UtxoOutPointIndexMap positions = CreateOutPointIndexMap(utxos);
+
+  // 設定済みのTxInは各txの設定済みUTXOとし、収集対象から除外する
+  std::vector<TransactionController> result;
+  std::vector<std::vector<UtxoData>> txin_utxos_list(tx_hex_list.size());
+  result.reserve(tx_hex_list.size());
+  for (size_t tx_index = 0; tx_index < tx_hex_list.size(); ++tx_index) {
+    result.emplace_back(tx_hex_list[tx_index]);
+    for (const auto& txin : result.back().GetTransaction().GetTxInList()) {
+      auto iter =
+          positions.find(UtxoOutPoint::Create(txin.GetTxid(), txin.GetVout()));
+      if (iter == positions.end()) continue;
+      if (!utxo_index.Spend(txin.GetTxid(), txin.GetVout())) {
+        warn(
+            CFD_LOG_SOURCE,
+            "Failed to FundRawTransactions. utxo is already used.");
+        throw CfdException(
+            CfdError::kCfdIllegalArgumentError, "utxo is already used.");
       }
-      // ダミーへの追加のため額は無視
-      txc_dummy.AddTxOut(addr_factory.GetAddress(reserve_txout_address), fee);
-      fee = EstimateFee(
-          txc_dummy.GetHex(), new_selected_utxos, nullptr, nullptr,
-          effective_fee_rate);
-      info(CFD_LOG_SOURCE, "new_fee={}", fee.GetSatoshiValue());
-      need_amount = dest_amount + fee;
-    }
-
-    if (utxo_amount < need_amount) {
-      warn(CFD_LOG_SOURCE, "Failed to FundRawTransaction. low fee.");
-      throw CfdException(CfdError::kCfdIllegalArgumentError, "low fee.");
-    }
-    diff_amount -= fee;  // fee分を除外
-    diff_satoshi = diff_amount.GetSatoshiValue();
-
-    // optionで、超過額の設定がある場合、余剰分をfeeに設定。
-    if (dust_amount > diff_amount) {
-      // feeに残高をすべて設定
-      diff_satoshi = 0;
-      fee = utxo_amount - dest_amount;
+      txin_utxos_list[tx_index].push_back(utxos[iter->second]);
     }
-    info(CFD_LOG_SOURCE, "diff_amount={}", diff_satoshi);
   }
 
-  // dustより小さい場合はTxOutには追加しない
-  // (fee計算ありの場合はチェック済だが、fee計算なしの場合は未チェックのため)
-  if ((diff_satoshi != 0) && (dust_amount < diff_amount)) {
-    txc.AddTxOut(addr_factory.GetAddress(reserve_txout_address), diff_amount);
-    info(CFD_LOG_SOURCE, "addTxOut. value={}", diff_amount.GetSatoshiValue());
+  if (estimate_fees) estimate_fees->clear();
+  if (append_txout_addresses) append_txout_addresses->clear();
+  for (size_t tx_index = 0; tx_index < tx_hex_list.size(); ++tx_index) {
+    Amount fee;
+    std::vector<std::string> append_addresses;
+    FundRawTransaction(
+        &result[tx_index], &utxo_index, Amount(), txin_utxos_list[tx_index],
+        reserve_txout_address, effective_fee_rate, &fee, filter,
+        option_params, &append_addresses, net_type, prefix_list);
+
+    // 収集したUTXOを以降のtxの候補から除外する
+    for (const auto& txin : result[tx_index].GetTransaction().GetTxInList()) {
+      utxo_index.Spend(txin.GetTxid(), txin.GetVout());
+    }
+    if (estimate_fees) estimate_fees->push_back(fee);
     if (append_txout_addresses) {
-      append_txout_addresses->push_back(reserve_txout_address);
+      append_txout_addresses->push_back(append_addresses);
     }
   }
-  if (estimate_fee) *estimate_fee = fee;
-
-  // SelectしたUTXOをTxInに設定
-  for (auto& utxo : selected_coins) {
-    memcpy(txid_bytes.data(), utxo.txid, txid_bytes.size());
-    txc.AddTxIn(Txid(ByteData256(txid_bytes)), utxo.vout);
-  }
-
-  return txc;
+  return result;
 }
 
 }  // namespace api
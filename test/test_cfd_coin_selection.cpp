@@ -1,8 +1,14 @@
 #include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
 #include <vector>
 
 #include "cfd/cfd_common.h"
+#include "cfd/cfd_fee.h"
 #include "cfd/cfd_utxo.h"
+#include "cfd/cfdapi_coin.h"
 #include "cfdcore/cfdcore_address.h"
 #include "cfdcore/cfdcore_bytedata.h"
 #include "cfdcore/cfdcore_coin.h"
@@ -375,6 +381,66 @@ static const std::vector<TestUtxoCoinVector> kExtCoinSelectTestVector = {
   }
 };
 
+TEST(CoinSelectionRandom, Seed)
+{
+  cfd::CoinSelectionRandom random1(12345);
+  cfd::CoinSelectionRandom random2(12345);
+  cfd::CoinSelectionRandom random3(54321);
+  bool is_match = true;
+  bool is_match_other = true;
+  for (int count = 0; count < 100; ++count) {
+    uint64_t value = random1.GetRandom();
+    if (value != random2.GetRandom()) is_match = false;
+    if (value != random3.GetRandom()) is_match_other = false;
+    if (random1.GetRandomBool() != random2.GetRandomBool()) is_match = false;
+  }
+  EXPECT_TRUE(is_match);
+  EXPECT_FALSE(is_match_other);
+
+  // GetRandomBits is same as GetRandomBool sequence
+  cfd::CoinSelectionRandom random4(12345);
+  cfd::CoinSelectionRandom random5(12345);
+  bool is_match_bits = true;
+  for (uint32_t count : {1, 10, 63, 64, 64, 5, 33, 64}) {
+    uint64_t bits = random4.GetRandomBits(count);
+    for (uint32_t index = 0; index < count; ++index) {
+      if (((bits >> index) & 1) != (random5.GetRandomBool() ? 1 : 0)) {
+        is_match_bits = false;
+      }
+    }
+  }
+  EXPECT_TRUE(is_match_bits);
+}
+
+TEST(CoinSelection, SelectCoins_Simple_KnapsackSolver_random_seed)
+{
+  Amount target_amount = Amount::CreateBySatoshiAmount(220000000);
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+  CoinSelectionOption option = GetBitcoinOption();
+  option.SetRandomSeed(1);
+  EXPECT_TRUE(option.HasRandomSeed());
+  EXPECT_EQ(option.GetRandomSeed(), 1);
+
+  std::vector<Utxo> utxos = GetBitcoinUtxoList();
+  std::vector<Utxo> ret1;
+  std::vector<Utxo> ret2;
+  Amount select_value1;
+  Amount select_value2;
+  EXPECT_NO_THROW(ret1 = exp_selection.SelectCoins(
+      target_amount, utxos, exp_filter, option, tx_fee, &select_value1));
+  EXPECT_NO_THROW(ret2 = exp_selection.SelectCoins(
+      target_amount, utxos, exp_filter, option, tx_fee, &select_value2));
+
+  EXPECT_EQ(select_value1.GetSatoshiValue(), 234375000);
+  EXPECT_EQ(select_value1.GetSatoshiValue(), select_value2.GetSatoshiValue());
+  EXPECT_EQ(ret1.size(), ret2.size());
+  if (ret1.size() == ret2.size()) {
+    for (size_t index = 0; index < ret1.size(); ++index) {
+      EXPECT_EQ(ret1[index].amount, ret2[index].amount);
+    }
+  }
+}
+
 TEST(CoinSelection, SelectCoins_Simple_SelectCoinsBnB)
 {
   CoinSelection coin_select(true);
@@ -409,7 +475,7 @@ TEST(CoinSelection, SelectCoins_Simple_SelectCoinsBnB)
       exp_filter, option_params, tx_fee, &select_value, &fee_value, &use_bnb)));
   EXPECT_EQ(select_utxos.size(), 2);
   EXPECT_EQ(select_value.GetSatoshiValue(), static_cast<int64_t>(100001090));
-  EXPECT_EQ(fee_value.GetSatoshiValue(), static_cast<int64_t>(360));
+  EXPECT_EQ(fee_value.GetSatoshiValue(), static_cast<int64_t>(364));
   if (select_utxos.size() == 2) {
     EXPECT_EQ(select_utxos[0].amount, static_cast<int64_t>(85062500));
     EXPECT_EQ(select_utxos[1].amount, static_cast<int64_t>(14938590));
@@ -417,6 +483,573 @@ TEST(CoinSelection, SelectCoins_Simple_SelectCoinsBnB)
   EXPECT_TRUE(use_bnb);
 }
 
+TEST(CoinSelection, SelectCoins_Simple_SelectCoinsBnB_statistics)
+{
+  CoinSelection coin_select(true);
+
+  Amount target_value = Amount::CreateBySatoshiAmount(99998500);
+  std::vector<Utxo> utxos;
+  CoinSelectionOption option_params;
+  Amount select_value;
+  Amount fee_value;
+  std::vector<Utxo> select_utxos;
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+  bool use_bnb = false;
+  cfd::BnBSearchStatistics statistics;
+
+  utxos.resize(kExtCoinSelectTestVector.size());
+  std::vector<Utxo>::iterator ite = utxos.begin();
+  for (const auto& test_data : kExtCoinSelectTestVector) {
+    Txid txid;
+    if (!test_data.txid.empty()) {
+      txid = Txid(test_data.txid);
+    }
+    CoinSelection::ConvertToUtxo(
+        txid, test_data.vout, test_data.descriptor,
+        Amount::CreateBySatoshiAmount(test_data.amount), "", nullptr,
+        &(*ite));
+    ++ite;
+  }
+
+  option_params.InitializeTxSizeInfo();
+  option_params.SetEffectiveFeeBaserate(2);
+  EXPECT_EQ(option_params.GetBnBMaxTries(), 100000);
+  EXPECT_EQ(option_params.GetBnBTimeLimit(), 0);
+
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value, utxos,
+      exp_filter, option_params, tx_fee, &select_value, &fee_value, &use_bnb,
+      &statistics)));
+  EXPECT_EQ(select_value.GetSatoshiValue(), static_cast<int64_t>(100001090));
+  EXPECT_TRUE(use_bnb);
+  EXPECT_GT(statistics.tries, 0);
+  EXPECT_LT(statistics.tries, 100000);
+  EXPECT_GT(statistics.backtracks, 0);
+  EXPECT_GE(statistics.best_waste, 0);
+  EXPECT_FALSE(statistics.is_exhausted);
+  EXPECT_FALSE(statistics.is_timeout);
+
+  // budget exhausted. the changeless pair found first is used.
+  const int64_t best_waste = statistics.best_waste;
+  option_params.SetBnBMaxTries(1);
+  option_params.SetBnBTimeLimit(1000000);
+  EXPECT_EQ(option_params.GetBnBMaxTries(), 1);
+  EXPECT_EQ(option_params.GetBnBTimeLimit(), 1000000);
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value, utxos,
+      exp_filter, option_params, tx_fee, &select_value, &fee_value, &use_bnb,
+      &statistics)));
+  EXPECT_TRUE(use_bnb);
+  EXPECT_EQ(select_value.GetSatoshiValue(), static_cast<int64_t>(100001090));
+  EXPECT_EQ(statistics.tries, 1);
+  EXPECT_EQ(statistics.best_waste, best_waste);
+  EXPECT_TRUE(statistics.is_exhausted);
+  EXPECT_FALSE(statistics.is_timeout);
+}
+
+TEST(CoinSelection, SelectCoins_Simple_report)
+{
+  CoinSelection coin_select(true);
+  Amount target_value = Amount::CreateBySatoshiAmount(99998500);
+  std::vector<Utxo> utxos;
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+
+  utxos.resize(kExtCoinSelectTestVector.size());
+  std::vector<Utxo>::iterator ite = utxos.begin();
+  for (const auto& test_data : kExtCoinSelectTestVector) {
+    CoinSelection::ConvertToUtxo(
+        Txid(), test_data.vout, test_data.descriptor,
+        Amount::CreateBySatoshiAmount(test_data.amount), "", nullptr,
+        &(*ite));
+    ++ite;
+  }
+
+  CoinSelectionOption option_params;
+  option_params.InitializeTxSizeInfo();
+  option_params.SetEffectiveFeeBaserate(2);
+  option_params.SetRandomSeed(1);
+
+  // changeless (BnB)
+  Amount select_value;
+  Amount fee_value;
+  bool use_bnb = false;
+  cfd::BnBSearchStatistics statistics;
+  cfd::CoinSelectionReport report;
+  std::vector<Utxo> select_utxos;
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value, utxos,
+      exp_filter, option_params, tx_fee, &select_value, &fee_value, &use_bnb,
+      &statistics, &report)));
+  EXPECT_TRUE(use_bnb);
+  EXPECT_EQ(report.solver, cfd::kCoinSelectionSolverBnB);
+  EXPECT_EQ(report.input_count, 2);
+  EXPECT_EQ(report.target_value, 100000000);
+  EXPECT_EQ(report.selected_value, 100000726);
+  EXPECT_EQ(report.input_fee, 364);
+  EXPECT_FALSE(report.has_change);
+  EXPECT_EQ(report.change_value, 0);
+  EXPECT_EQ(report.waste, statistics.best_waste);
+  EXPECT_EQ(report.bnb_statistics.tries, statistics.tries);
+
+  // with change (KnapsackSolver)
+  option_params.SetAlgorithm(cfd::kCoinSelectionKnapsack);
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value, utxos,
+      exp_filter, option_params, tx_fee, &select_value, &fee_value, &use_bnb,
+      nullptr, &report)));
+  EXPECT_FALSE(use_bnb);
+  EXPECT_EQ(report.solver, cfd::kCoinSelectionSolverKnapsack);
+  EXPECT_EQ(report.input_count, 1);
+  EXPECT_EQ(report.selected_value, 155062318);
+  EXPECT_TRUE(report.has_change);
+  EXPECT_GT(report.cost_of_change, 0);
+  EXPECT_EQ(report.change_value, 55062256);
+  EXPECT_EQ(report.waste, static_cast<int64_t>(report.cost_of_change));
+}
+
+TEST(CoinSelection, SelectCoinsByFeeRates)
+{
+  CoinSelection coin_select(true);
+  Amount target_value = Amount::CreateBySatoshiAmount(99998500);
+  std::vector<Utxo> utxos;
+
+  utxos.resize(kExtCoinSelectTestVector.size());
+  std::vector<Utxo>::iterator ite = utxos.begin();
+  for (const auto& test_data : kExtCoinSelectTestVector) {
+    CoinSelection::ConvertToUtxo(
+        Txid(), test_data.vout, test_data.descriptor,
+        Amount::CreateBySatoshiAmount(test_data.amount), "", nullptr,
+        &(*ite));
+    ++ite;
+  }
+
+  CoinSelectionOption option_params;
+  option_params.InitializeTxSizeInfo();
+  option_params.SetRandomSeed(1);
+  const uint32_t tx_size = 750;
+  std::vector<double> fee_rates = {1, 2, 5, 20};
+  std::vector<cfd::CoinSelectionFeeRateResult> results;
+  EXPECT_NO_THROW((results = coin_select.SelectCoinsByFeeRates(target_value,
+      utxos, exp_filter, option_params, tx_size, fee_rates)));
+  ASSERT_EQ(results.size(), fee_rates.size());
+
+  // same as the result of each fee rate.
+  for (size_t index = 0; index < fee_rates.size(); ++index) {
+    const cfd::CoinSelectionFeeRateResult& result = results[index];
+    option_params.SetEffectiveFeeBaserate(fee_rates[index]);
+    Amount tx_fee = cfd::FeeCalculator(
+        option_params.GetEffectiveFeeBaserate()).GetFee(tx_size);
+    Amount select_value;
+    Amount fee_value;
+    cfd::CoinSelectionReport report;
+    std::vector<Utxo> select_utxos;
+    EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value,
+        utxos, exp_filter, option_params, tx_fee, &select_value, &fee_value,
+        nullptr, nullptr, &report)));
+    EXPECT_TRUE(result.is_success);
+    EXPECT_EQ(result.fee_rate, fee_rates[index]);
+    EXPECT_EQ(result.tx_fee.GetSatoshiValue(), tx_fee.GetSatoshiValue());
+    EXPECT_EQ(result.select_value.GetSatoshiValue(),
+        select_value.GetSatoshiValue());
+    EXPECT_EQ(result.utxo_fee.GetSatoshiValue(), fee_value.GetSatoshiValue());
+    EXPECT_EQ(result.report.solver, report.solver);
+    EXPECT_EQ(result.report.waste, report.waste);
+    EXPECT_EQ(result.report.change_value, report.change_value);
+    ASSERT_EQ(result.indexes.size(), select_utxos.size());
+    for (size_t utxo_index = 0; utxo_index < select_utxos.size();
+        ++utxo_index) {
+      EXPECT_EQ(utxos[result.indexes[utxo_index]].amount,
+          select_utxos[utxo_index].amount);
+    }
+  }
+  EXPECT_EQ(results[1].select_value.GetSatoshiValue(), 100001090);
+  EXPECT_EQ(results[1].report.solver, cfd::kCoinSelectionSolverBnB);
+
+  // insufficient funds
+  target_value = Amount::CreateBySatoshiAmount(1000000000);
+  EXPECT_NO_THROW((results = coin_select.SelectCoinsByFeeRates(target_value,
+      utxos, exp_filter, option_params, tx_size, fee_rates)));
+  ASSERT_EQ(results.size(), fee_rates.size());
+  for (const auto& result : results) {
+    EXPECT_FALSE(result.is_success);
+    EXPECT_TRUE(result.indexes.empty());
+  }
+}
+
+TEST(CoinSelection, SelectCoins_Simple_SelectCoinsBnB_same_denomination)
+{
+  CoinSelection coin_select(true);
+  std::vector<Utxo> utxos;
+  for (uint32_t index = 0; index < 40; ++index) {
+    Utxo utxo;
+    memset(&utxo, 0, sizeof(utxo));
+    utxo.vout = index;
+    utxo.amount = 100000 + (index % 8) * 10000;
+    utxo.witness_size_max = (index % 3 == 0) ? 108 : 300;
+    utxos.push_back(utxo);
+  }
+  CoinSelectionOption option_params;
+  option_params.InitializeTxSizeInfo();
+  option_params.SetEffectiveFeeBaserate(20);
+  option_params.SetLongTermFeeBaserate(10);
+  Amount target_value = Amount::CreateBySatoshiAmount(840000);
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+  Amount select_value;
+  Amount fee_value;
+  bool use_bnb = false;
+  cfd::BnBSearchStatistics statistics;
+  std::vector<Utxo> select_utxos;
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value, utxos,
+      exp_filter, option_params, tx_fee, &select_value, &fee_value, &use_bnb,
+      &statistics)));
+  EXPECT_TRUE(use_bnb);
+  EXPECT_EQ(select_value.GetSatoshiValue(), 850000);
+  EXPECT_EQ(statistics.best_waste, 4420);
+  EXPECT_FALSE(statistics.is_exhausted);
+  // pruned by the waste lower bound (without pruning: about 96000 tries)
+  EXPECT_LT(statistics.tries, 50000);
+}
+
+TEST(CoinSelection, SelectCoins_Simple_SelectCoinsBnB_changeless_pair)
+{
+  CoinSelection coin_select(true);
+  std::vector<Utxo> utxos;
+  const uint64_t amounts[] = {500000, 300000, 200000, 123456, 50000, 40000};
+  for (uint32_t index = 0; index < 6; ++index) {
+    Utxo utxo;
+    memset(&utxo, 0, sizeof(utxo));
+    utxo.vout = index;
+    utxo.amount = amounts[index];
+    utxo.witness_size_max = 108;
+    utxos.push_back(utxo);
+  }
+  CoinSelectionOption option_params;
+  option_params.InitializeTxSizeInfo();
+  option_params.SetEffectiveFeeBaserate(20);
+  option_params.SetLongTermFeeBaserate(10);
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+  Amount select_value;
+  Amount fee_value;
+  bool use_bnb = false;
+  cfd::BnBSearchStatistics statistics;
+  std::vector<Utxo> select_utxos;
+
+  // 300000 + 200000 is in the changeless range. (without depth first search)
+  Amount target_value = Amount::CreateBySatoshiAmount(495700);
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value, utxos,
+      exp_filter, option_params, tx_fee, &select_value, &fee_value, &use_bnb,
+      &statistics)));
+  EXPECT_TRUE(use_bnb);
+  EXPECT_EQ(select_value.GetSatoshiValue(), 500000);
+  EXPECT_EQ(select_utxos.size(), 2);
+  EXPECT_EQ(statistics.tries, 0);
+  EXPECT_FALSE(statistics.is_exhausted);
+  EXPECT_EQ(statistics.best_waste, 1440);
+  EXPECT_EQ(fee_value.GetSatoshiValue(), 2720);
+
+  // 50000 + 40000 needs the depth first search.
+  target_value = Amount::CreateBySatoshiAmount(85000);
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value, utxos,
+      exp_filter, option_params, tx_fee, &select_value, &fee_value, &use_bnb,
+      &statistics)));
+  EXPECT_TRUE(use_bnb);
+  EXPECT_EQ(select_value.GetSatoshiValue(), 90000);
+  EXPECT_EQ(select_utxos.size(), 2);
+  EXPECT_EQ(statistics.tries, 13);
+  EXPECT_EQ(statistics.best_waste, 2140);
+}
+
+/**
+ * @brief 全UTXOを選択するテスト用のアルゴリズム
+ */
+class AllUtxoStrategy : public cfd::CoinSelectionStrategy {
+ public:
+  std::vector<size_t> Select(
+      const cfd::CoinSelectionParameter& /* parameter */,
+      const cfd::UtxoPool& utxo_pool,
+      cfd::CoinSelectionRandom* /* random */) const override {
+    std::vector<size_t> result;
+    for (size_t index = 0; index < utxo_pool.GetSize(); ++index) {
+      result.push_back(index);
+    }
+    return result;
+  }
+};
+
+TEST(CoinSelection, SelectCoins_Simple_Strategy)
+{
+  CoinSelection coin_select(true);
+  Amount target_value = Amount::CreateBySatoshiAmount(99998500);
+  std::vector<Utxo> utxos;
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+
+  utxos.resize(kExtCoinSelectTestVector.size());
+  std::vector<Utxo>::iterator ite = utxos.begin();
+  for (const auto& test_data : kExtCoinSelectTestVector) {
+    CoinSelection::ConvertToUtxo(
+        Txid(), test_data.vout, test_data.descriptor,
+        Amount::CreateBySatoshiAmount(test_data.amount), "", nullptr,
+        &(*ite));
+    ++ite;
+  }
+
+  CoinSelectionOption option_params;
+  option_params.InitializeTxSizeInfo();
+  option_params.SetEffectiveFeeBaserate(2);
+  option_params.SetRandomSeed(1);
+  EXPECT_EQ(option_params.GetAlgorithm(), cfd::kCoinSelectionDefault);
+  EXPECT_EQ(option_params.GetStrategy(), nullptr);
+
+  struct {
+    cfd::CoinSelectionAlgorithm algorithm;
+    size_t count;
+    int64_t select_value;
+    int64_t fee_value;
+    int64_t first_amount;
+    bool use_bnb;
+  } exp_datas[] = {
+    {cfd::kCoinSelectionLowestWaste, 2, 100001090, 364, 85062500, true},
+    {cfd::kCoinSelectionLargestFirst, 1, 155062500, 182, 155062500, false},
+    {cfd::kCoinSelectionSmallestFirst, 4, 130738590, 728, 14938590, false},
+    {cfd::kCoinSelectionSingleRandomDraw, 4, 246738590, 728, 61062500, false},
+    {cfd::kCoinSelectionKnapsack, 1, 155062500, 182, 155062500, false},
+  };
+  for (const auto& exp_data : exp_datas) {
+    option_params.SetAlgorithm(exp_data.algorithm);
+    Amount select_value;
+    Amount fee_value;
+    bool use_bnb = !exp_data.use_bnb;
+    std::vector<Utxo> select_utxos;
+    EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value,
+        utxos, exp_filter, option_params, tx_fee, &select_value, &fee_value,
+        &use_bnb)));
+    EXPECT_EQ(select_utxos.size(), exp_data.count);
+    EXPECT_EQ(select_value.GetSatoshiValue(), exp_data.select_value);
+    EXPECT_EQ(fee_value.GetSatoshiValue(), exp_data.fee_value);
+    EXPECT_EQ(use_bnb, exp_data.use_bnb);
+    if (!select_utxos.empty()) {
+      EXPECT_EQ(select_utxos[0].amount, exp_data.first_amount);
+    }
+  }
+
+  AllUtxoStrategy strategy;
+  option_params.SetAlgorithm(cfd::kCoinSelectionDefault);
+  option_params.SetStrategy(&strategy);
+  EXPECT_EQ(option_params.GetStrategy(), &strategy);
+  Amount select_value;
+  std::vector<Utxo> select_utxos;
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value,
+      utxos, exp_filter, option_params, tx_fee, &select_value)));
+  EXPECT_EQ(select_utxos.size(), 6);
+  EXPECT_EQ(select_value.GetSatoshiValue(), 370863590);
+}
+
+TEST(CoinSelection, SelectCoins_Simple_input_limit)
+{
+  CoinSelection coin_select(true);
+  std::vector<Utxo> utxos;
+  // dust近傍の少額UTXOが大半を占めるwallet
+  for (uint32_t index = 0; index < 300; ++index) {
+    Utxo utxo;
+    memset(&utxo, 0, sizeof(utxo));
+    utxo.vout = index;
+    utxo.amount = 5000 + index;
+    utxo.witness_size_max = 108;
+    utxos.push_back(utxo);
+  }
+  const uint64_t large_amounts[] = {400000, 300000, 200000};
+  for (uint32_t index = 0; index < 3; ++index) {
+    Utxo utxo;
+    memset(&utxo, 0, sizeof(utxo));
+    utxo.vout = 300 + index;
+    utxo.amount = large_amounts[index];
+    utxo.witness_size_max = 108;
+    utxos.push_back(utxo);
+  }
+  const uint64_t weight = cfd::FeeCalculator::GetTxInWeight(utxos[0]);
+  CoinSelectionOption option_params;
+  option_params.InitializeTxSizeInfo();
+  option_params.SetEffectiveFeeBaserate(2);
+  option_params.SetRandomSeed(1);
+  EXPECT_EQ(option_params.GetMaxInputCount(), 0);
+  EXPECT_EQ(option_params.GetMaxWeight(), 0);
+  Amount target_value = Amount::CreateBySatoshiAmount(850000);
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+
+  struct {
+    bool use_bnb;
+    cfd::CoinSelectionAlgorithm algorithm;
+    uint32_t max_input_count;
+    uint64_t max_weight;
+    bool is_error;
+    size_t count;
+    int64_t select_value;
+  } exp_datas[] = {
+    {true, cfd::kCoinSelectionDefault, 0, 0, false, 71, 861156},
+    {true, cfd::kCoinSelectionDefault, 3, 0, false, 3, 900000},
+    {false, cfd::kCoinSelectionDefault, 3, 0, false, 3, 900000},
+    {true, cfd::kCoinSelectionDefault, 0, weight * 3, false, 3, 900000},
+    {false, cfd::kCoinSelectionDefault, 0, weight * 3, false, 3, 900000},
+    {true, cfd::kCoinSelectionLowestWaste, 3, 0, false, 3, 900000},
+    {true, cfd::kCoinSelectionLargestFirst, 3, 0, false, 3, 900000},
+    {true, cfd::kCoinSelectionSmallestFirst, 3, 0, true, 0, 0},
+    {true, cfd::kCoinSelectionDefault, 2, 0, true, 0, 0},
+    {false, cfd::kCoinSelectionDefault, 2, 0, true, 0, 0},
+    {true, cfd::kCoinSelectionDefault, 0, weight * 3 - 1, true, 0, 0},
+  };
+  for (const auto& exp_data : exp_datas) {
+    option_params.SetUseBnB(exp_data.use_bnb);
+    option_params.SetAlgorithm(exp_data.algorithm);
+    option_params.SetMaxInputCount(exp_data.max_input_count);
+    option_params.SetMaxWeight(exp_data.max_weight);
+    Amount select_value;
+    Amount fee_value;
+    std::vector<Utxo> select_utxos;
+    if (exp_data.is_error) {
+      EXPECT_THROW((select_utxos = coin_select.SelectCoins(target_value,
+          utxos, exp_filter, option_params, tx_fee, &select_value,
+          &fee_value)), CfdException);
+      continue;
+    }
+    EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value,
+        utxos, exp_filter, option_params, tx_fee, &select_value,
+        &fee_value)));
+    EXPECT_EQ(select_utxos.size(), exp_data.count);
+    EXPECT_EQ(select_value.GetSatoshiValue(), exp_data.select_value);
+  }
+}
+
+TEST(CoinSelection, SelectCoins_Simple_UtxoFilter)
+{
+  CoinSelection coin_select(true);
+  Amount target_value = Amount::CreateBySatoshiAmount(99998500);
+  std::vector<Utxo> utxos(kExtCoinSelectTestVector.size());
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+  for (size_t index = 0; index < utxos.size(); ++index) {
+    const auto& test_data = kExtCoinSelectTestVector[index];
+    CoinSelection::ConvertToUtxo(
+        Txid(), static_cast<uint32_t>(index), test_data.descriptor,
+        Amount::CreateBySatoshiAmount(test_data.amount), "", nullptr,
+        &utxos[index]);
+    utxos[index].block_height = 100 + index;
+  }
+
+  CoinSelectionOption option_params;
+  option_params.InitializeTxSizeInfo();
+  option_params.SetEffectiveFeeBaserate(2);
+  Amount select_value;
+  std::vector<Utxo> select_utxos;
+
+  // amount range
+  UtxoFilter filter;
+  filter.min_amount = 50000000;
+  filter.max_amount = 100000000;
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value,
+      utxos, filter, option_params, tx_fee, &select_value)));
+  EXPECT_FALSE(select_utxos.empty());
+  for (const auto& utxo : select_utxos) {
+    EXPECT_GE(utxo.amount, filter.min_amount);
+    EXPECT_LE(utxo.amount, filter.max_amount);
+  }
+
+  // excluded outpoint
+  filter = UtxoFilter();
+  cfd::UtxoOutPoint outpoint;
+  memset(&outpoint, 0, sizeof(outpoint));
+  outpoint.vout = 1;
+  filter.excluded_outpoints.insert(outpoint);
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value,
+      utxos, filter, option_params, tx_fee, &select_value)));
+  EXPECT_FALSE(select_utxos.empty());
+  for (const auto& utxo : select_utxos) {
+    EXPECT_NE(utxo.vout, 1);
+  }
+
+  // confirmations (tip:105, height:100-105)
+  filter = UtxoFilter();
+  filter.tip_block_height = 105;
+  filter.min_confirmations = 3;
+  filter.max_confirmations = 5;
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value,
+      utxos, filter, option_params, tx_fee, &select_value)));
+  EXPECT_FALSE(select_utxos.empty());
+  for (const auto& utxo : select_utxos) {
+    EXPECT_GE(utxo.block_height, 101);
+    EXPECT_LE(utxo.block_height, 103);
+  }
+
+  // address type
+  filter = UtxoFilter();
+  filter.address_types.push_back(AddressType::kP2shP2wpkhAddress);
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value,
+      utxos, filter, option_params, tx_fee, &select_value)));
+  EXPECT_FALSE(select_utxos.empty());
+
+  filter.address_types[0] = AddressType::kP2wpkhAddress;
+  EXPECT_THROW((select_utxos = coin_select.SelectCoins(target_value,
+      utxos, filter, option_params, tx_fee, &select_value)), CfdException);
+
+  // not enough amount after filtering
+  filter = UtxoFilter();
+  filter.max_amount = 60000000;
+  EXPECT_THROW((select_utxos = coin_select.SelectCoins(target_value,
+      utxos, filter, option_params, tx_fee, &select_value)), CfdException);
+}
+
+TEST(CoinSelection, SelectCoins_Simple_OutputGroup)
+{
+  const Script reuse_script("0014ef692e4bf0cba5f9ffb07bbb02c5e4f1b5f6f9d1");
+  const Script other_script("a914e37a3603a4d392f9ecb68b32eac6ba19adc4968f87");
+  CoinSelection coin_select(true);
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+  std::vector<Utxo> utxos(11);
+  for (size_t index = 0; index < 10; ++index) {
+    CoinSelection::ConvertToUtxo(
+        0, BlockHash(), Txid(), static_cast<uint32_t>(index), reuse_script,
+        "", Amount::CreateBySatoshiAmount(2000000), nullptr, &utxos[index]);
+  }
+  CoinSelection::ConvertToUtxo(
+      0, BlockHash(), Txid(), 10, other_script, "",
+      Amount::CreateBySatoshiAmount(30000000), nullptr, &utxos[10]);
+
+  CoinSelectionOption option_params;
+  option_params.InitializeTxSizeInfo();
+  option_params.SetEffectiveFeeBaserate(2);
+  EXPECT_FALSE(option_params.IsUseOutputGroup());
+  option_params.SetUseOutputGroup(true);
+  EXPECT_TRUE(option_params.IsUseOutputGroup());
+
+  Amount select_value;
+  Amount fee_value;
+  std::vector<Utxo> select_utxos;
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(
+      Amount::CreateBySatoshiAmount(15000000), utxos, exp_filter,
+      option_params, tx_fee, &select_value, &fee_value)));
+  uint64_t total = 0;
+  for (const auto& utxo : select_utxos) total += utxo.amount;
+  EXPECT_EQ(select_value.GetSatoshiValue(), static_cast<int64_t>(total));
+  if (select_utxos.size() == 1) {
+    EXPECT_EQ(select_utxos[0].vout, 10);
+  } else {
+    EXPECT_EQ(select_utxos.size(), 10);
+    EXPECT_EQ(select_value.GetSatoshiValue(), 20000000);
+  }
+
+  // group size limit (100 + 50)
+  utxos.resize(150);
+  for (size_t index = 0; index < utxos.size(); ++index) {
+    CoinSelection::ConvertToUtxo(
+        0, BlockHash(), Txid(), static_cast<uint32_t>(index), reuse_script,
+        "", Amount::CreateBySatoshiAmount(100000), nullptr, &utxos[index]);
+  }
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(
+      Amount::CreateBySatoshiAmount(12000000), utxos, exp_filter,
+      option_params, tx_fee, &select_value, &fee_value)));
+  EXPECT_EQ(select_utxos.size(), 150);
+  EXPECT_EQ(select_value.GetSatoshiValue(), 15000000);
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(
+      Amount::CreateBySatoshiAmount(6000000), utxos, exp_filter,
+      option_params, tx_fee, &select_value, &fee_value)));
+  EXPECT_EQ(select_utxos.size(), 100);
+  EXPECT_EQ(select_value.GetSatoshiValue(), 10000000);
+}
+
 TEST(CoinSelection, SelectCoins_Simple_SelectCoinsBnB_single)
 {
   CoinSelection coin_select(true);
@@ -451,7 +1084,7 @@ TEST(CoinSelection, SelectCoins_Simple_SelectCoinsBnB_single)
       exp_filter, option_params, tx_fee, &select_value, &fee_value, &use_bnb)));
   EXPECT_EQ(select_utxos.size(), 1);
   EXPECT_EQ(select_value.GetSatoshiValue(), static_cast<int64_t>(155062500));
-  EXPECT_EQ(fee_value.GetSatoshiValue(), static_cast<int64_t>(180));
+  EXPECT_EQ(fee_value.GetSatoshiValue(), static_cast<int64_t>(182));
   if (select_utxos.size() == 1) {
     EXPECT_EQ(select_utxos[0].amount, static_cast<int64_t>(155062500));
   }
@@ -493,7 +1126,7 @@ TEST(CoinSelection, SelectCoins_Simple_SelectCoinsBnB_empty)
       exp_filter, option_params, tx_fee, &select_value, &fee_value, &use_bnb)));
   EXPECT_EQ(select_utxos.size(), 3);
   EXPECT_EQ(select_value.GetSatoshiValue(), static_cast<int64_t>(115063590));
-  EXPECT_EQ(fee_value.GetSatoshiValue(), static_cast<int64_t>(270));
+  EXPECT_EQ(fee_value.GetSatoshiValue(), static_cast<int64_t>(273));
   if (select_utxos.size() == 3) {
     EXPECT_EQ(select_utxos[0].amount, static_cast<int64_t>(61062500));
     EXPECT_EQ(select_utxos[1].amount, static_cast<int64_t>(39062500));
@@ -502,6 +1135,50 @@ TEST(CoinSelection, SelectCoins_Simple_SelectCoinsBnB_empty)
   EXPECT_FALSE(use_bnb);
 }
 
+TEST(CoinSelection, SelectCoins_Simple_SelectCoinsBnB_index)
+{
+  CoinSelection coin_select(true);
+
+  Amount target_value = Amount::CreateBySatoshiAmount(99998500);
+  std::vector<Utxo> utxos;
+  CoinSelectionOption option_params;
+  Amount select_value;
+  Amount fee_value;
+  std::vector<size_t> indexes;
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+  bool use_bnb = false;
+  cfd::UtxoPool utxo_pool;
+
+  utxos.resize(kExtCoinSelectTestVector.size());
+  std::vector<Utxo>::iterator ite = utxos.begin();
+  for (const auto& test_data : kExtCoinSelectTestVector) {
+    CoinSelection::ConvertToUtxo(
+        Txid(), test_data.vout, test_data.descriptor,
+        Amount::CreateBySatoshiAmount(test_data.amount), "", nullptr,
+        &(*ite));
+    ++ite;
+  }
+
+  option_params.InitializeTxSizeInfo();
+  option_params.SetEffectiveFeeBaserate(2);
+
+  EXPECT_NO_THROW((indexes = coin_select.SelectCoins(target_value,
+      utxos.data(), utxos.size(), exp_filter, option_params, tx_fee,
+      &select_value, &fee_value, &use_bnb, &utxo_pool)));
+  EXPECT_EQ(indexes.size(), 2);
+  EXPECT_EQ(select_value.GetSatoshiValue(), static_cast<int64_t>(100001090));
+  EXPECT_EQ(fee_value.GetSatoshiValue(), static_cast<int64_t>(364));
+  if (indexes.size() == 2) {
+    EXPECT_EQ(indexes[0], 1);
+    EXPECT_EQ(indexes[1], 5);
+  }
+  EXPECT_TRUE(use_bnb);
+  // the input utxos are not updated
+  EXPECT_EQ(utxos[1].fee, static_cast<uint64_t>(0));
+  EXPECT_EQ(utxo_pool.GetSize(), utxos.size());
+  EXPECT_EQ(utxo_pool.GetFees()[1], static_cast<uint64_t>(182));
+}
+
 // SelectCoins ErrorCase -----------------------------------------------------------------
 
 TEST(CoinSelection, SelectCoins_Simple_Error_utxos_empty)
@@ -608,6 +1285,409 @@ TEST(CoinSelection, SelectCoins_Simple_Error_SelectCoinsBnB_effective_value_zero
       exp_filter, option_params, tx_fee, &select_value, &fee_value, &use_bnb)), CfdException);
 }
 
+// UtxoPool ---------------------------------------------------------------------
+TEST(UtxoPool, GetSortedByEffectiveValue)
+{
+  std::vector<Utxo> utxos = GetBitcoinUtxoList();
+  cfd::UtxoPool pool;
+  EXPECT_TRUE(pool.IsEmpty());
+  pool.Reserve(utxos.size());
+  for (const auto& utxo : utxos) {
+    pool.Add(&utxo, utxo.amount - 100, 100, 50);
+  }
+  EXPECT_EQ(pool.GetSize(), utxos.size());
+  EXPECT_THROW(pool.Add(nullptr, 0, 0, 0), CfdException);
+
+  cfd::UtxoPool sorted = pool.GetSortedByEffectiveValue();
+  ASSERT_EQ(sorted.GetSize(), utxos.size());
+  EXPECT_EQ(sorted.GetEffectiveValues()[0], static_cast<uint64_t>(4999999900));
+  EXPECT_EQ(sorted.GetAmounts()[0], static_cast<uint64_t>(5000000000));
+  EXPECT_EQ(sorted.GetUtxo(0), &utxos[6]);
+  for (size_t index = 1; index < sorted.GetSize(); ++index) {
+    EXPECT_GE(
+        sorted.GetEffectiveValues()[index - 1],
+        sorted.GetEffectiveValues()[index]);
+  }
+
+  Utxo utxo = sorted.CopyUtxo(0);
+  EXPECT_EQ(utxo.amount, static_cast<uint64_t>(5000000000));
+  EXPECT_EQ(utxo.effective_value, static_cast<uint64_t>(4999999900));
+  EXPECT_EQ(utxo.fee, static_cast<uint64_t>(100));
+  EXPECT_EQ(utxo.long_term_fee, static_cast<uint64_t>(50));
+  EXPECT_EQ(utxos[6].fee, static_cast<uint64_t>(0));
+
+  pool.Clear();
+  EXPECT_TRUE(pool.IsEmpty());
+}
+
+TEST(UtxoOutPoint, CreateOutPointIndexMap)
+{
+  std::vector<cfd::api::UtxoData> utxos(3);
+  utxos[0].txid = Txid("0034567890123456789012345678901234567890123456789012345678901456");
+  utxos[0].vout = 0;
+  utxos[1].txid = utxos[0].txid;
+  utxos[1].vout = 1;
+  // 同一のOutPointは先頭のindexを保持する
+  utxos[2].txid = utxos[0].txid;
+  utxos[2].vout = 0;
+
+  cfd::UtxoOutPointIndexMap positions = cfd::CreateOutPointIndexMap(utxos);
+  EXPECT_EQ(positions.size(), static_cast<size_t>(2));
+  auto iter = positions.find(cfd::UtxoOutPoint::Create(utxos[0].txid, 0));
+  ASSERT_TRUE(iter != positions.end());
+  EXPECT_EQ(iter->second, static_cast<size_t>(0));
+  iter = positions.find(cfd::UtxoOutPoint::Create(utxos[0].txid, 1));
+  ASSERT_TRUE(iter != positions.end());
+  EXPECT_EQ(iter->second, static_cast<size_t>(1));
+  EXPECT_TRUE(positions.find(cfd::UtxoOutPoint::Create(utxos[0].txid, 2)) ==
+      positions.end());
+}
+
+// UtxoIndex --------------------------------------------------------------------
+TEST(UtxoIndex, AddSpendUpdate)
+{
+  std::vector<Utxo> utxos = GetBitcoinUtxoList();
+  cfd::UtxoIndex utxo_index;
+  for (const auto& utxo : utxos) {
+    utxo_index.Add(utxo);
+  }
+  EXPECT_EQ(utxo_index.GetSize(), utxos.size());
+  EXPECT_THROW(utxo_index.Add(utxos[0]), CfdException);
+
+  std::vector<uint8_t> txid_bytes(std::begin(utxos[6].txid),
+      std::end(utxos[6].txid));
+  Txid txid = Txid(ByteData256(txid_bytes));
+  const Utxo* found = utxo_index.Find(txid, utxos[6].vout);
+  ASSERT_TRUE(found != nullptr);
+  EXPECT_EQ(found->amount, static_cast<uint64_t>(5000000000));
+  EXPECT_TRUE(utxo_index.Find(txid, 1) == nullptr);
+
+  // cache is updated with add/update/spend
+  const cfd::UtxoPool& pool = utxo_index.GetFeePool(20000, 20000);
+  EXPECT_EQ(pool.GetSize(), utxos.size());
+  EXPECT_EQ(pool.GetAmounts()[6], static_cast<uint64_t>(5000000000));
+
+  Utxo update_utxo = utxos[6];
+  update_utxo.amount = 4000000000;
+  EXPECT_NO_THROW(utxo_index.Update(update_utxo));
+  EXPECT_EQ(pool.GetAmounts()[6], static_cast<uint64_t>(4000000000));
+  update_utxo.vout = 1;
+  EXPECT_THROW(utxo_index.Update(update_utxo), CfdException);
+
+  txid_bytes.assign(std::begin(utxos[0].txid), std::end(utxos[0].txid));
+  EXPECT_TRUE(utxo_index.Spend(Txid(ByteData256(txid_bytes)), 0));
+  EXPECT_FALSE(utxo_index.Spend(Txid(ByteData256(txid_bytes)), 0));
+  EXPECT_EQ(utxo_index.GetSize(), utxos.size() - 1);
+  ASSERT_EQ(pool.GetSize(), utxos.size() - 1);
+  for (size_t index = 0; index < utxo_index.GetSize(); ++index) {
+    EXPECT_EQ(pool.GetUtxo(index), utxo_index.GetUtxo(index));
+    EXPECT_EQ(pool.GetAmounts()[index], utxo_index.GetUtxo(index)->amount);
+  }
+  found = utxo_index.Find(txid, utxos[6].vout);
+  ASSERT_TRUE(found != nullptr);
+  EXPECT_EQ(found->amount, static_cast<uint64_t>(4000000000));
+
+  utxo_index.Clear();
+  EXPECT_EQ(utxo_index.GetSize(), static_cast<size_t>(0));
+}
+
+TEST(UtxoIndex, GetFeePool_cache_limit)
+{
+  std::vector<Utxo> utxos = GetBitcoinUtxoList();
+  cfd::UtxoIndex utxo_index;
+  for (const auto& utxo : utxos) {
+    utxo_index.Add(utxo);
+  }
+
+  // キャッシュ上限(8件)まで取得する
+  const cfd::UtxoPool& first_pool = utxo_index.GetFeePool(1000, 1000);
+  const cfd::UtxoPool* pools[8] = {&first_pool};
+  for (uint64_t rate = 2; rate <= 8; ++rate) {
+    pools[rate - 1] = &utxo_index.GetFeePool(rate * 1000, 1000);
+  }
+  // 先頭のプールを再取得し、2番目を最も古いプールとする
+  EXPECT_EQ(&utxo_index.GetFeePool(1000, 1000), &first_pool);
+
+  // 上限を超える場合も、取得済みのプールは最古の1件のみ破棄されること
+  const cfd::UtxoPool& new_pool = utxo_index.GetFeePool(9000, 1000);
+  cfd::FeeCalculator fee_calc(9000);
+  ASSERT_EQ(new_pool.GetSize(), utxos.size());
+  EXPECT_EQ(new_pool.GetFees()[0],
+      static_cast<uint64_t>(fee_calc.GetFee(utxos[0]).GetSatoshiValue()));
+  EXPECT_EQ(first_pool.GetSize(), utxos.size());
+  for (size_t index = 2; index < 8; ++index) {
+    EXPECT_EQ(&utxo_index.GetFeePool((index + 1) * 1000, 1000), pools[index]);
+    EXPECT_EQ(pools[index]->GetSize(), utxos.size());
+  }
+  EXPECT_EQ(&utxo_index.GetFeePool(1000, 1000), &first_pool);
+}
+
+TEST(CoinSelection, SelectCoins_Simple_SelectCoinsBnB_utxo_index)
+{
+  CoinSelection coin_select(true);
+
+  Amount target_value = Amount::CreateBySatoshiAmount(99998500);
+  CoinSelectionOption option_params;
+  Amount select_value;
+  Amount fee_value;
+  std::vector<Utxo> select_utxos;
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+  bool use_bnb = false;
+  cfd::UtxoIndex utxo_index;
+
+  uint32_t vout = 0;
+  for (const auto& test_data : kExtCoinSelectTestVector) {
+    Utxo utxo;
+    memset(&utxo, 0, sizeof(utxo));
+    CoinSelection::ConvertToUtxo(
+        Txid(), vout, test_data.descriptor,
+        Amount::CreateBySatoshiAmount(test_data.amount), "", nullptr,
+        &utxo);
+    utxo_index.Add(utxo);
+    ++vout;
+  }
+
+  option_params.InitializeTxSizeInfo();
+  option_params.SetEffectiveFeeBaserate(2);
+
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value,
+      &utxo_index, exp_filter, option_params, tx_fee, &select_value,
+      &fee_value, &use_bnb)));
+  EXPECT_EQ(select_utxos.size(), 2);
+  EXPECT_EQ(select_value.GetSatoshiValue(), static_cast<int64_t>(100001090));
+  EXPECT_EQ(fee_value.GetSatoshiValue(), static_cast<int64_t>(364));
+  if (select_utxos.size() == 2) {
+    EXPECT_EQ(select_utxos[0].amount, static_cast<uint64_t>(85062500));
+    EXPECT_EQ(select_utxos[1].amount, static_cast<uint64_t>(14938590));
+  }
+  EXPECT_TRUE(use_bnb);
+
+  // spent utxo is not selected
+  EXPECT_TRUE(utxo_index.Spend(Txid(), 1));
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value,
+      &utxo_index, exp_filter, option_params, tx_fee, &select_value,
+      &fee_value, &use_bnb)));
+  for (const auto& utxo : select_utxos) {
+    EXPECT_NE(utxo.vout, static_cast<uint32_t>(1));
+  }
+  EXPECT_THROW((select_utxos = coin_select.SelectCoins(target_value,
+      static_cast<cfd::UtxoIndex*>(nullptr), exp_filter, option_params,
+      tx_fee, &select_value, &fee_value, &use_bnb)), CfdException);
+}
+
+TEST(UtxoReservationSet, ReserveReleaseCommit)
+{
+  std::vector<Utxo> utxos = GetBitcoinUtxoList();
+  cfd::UtxoReservationSet reservation_set(utxos);
+  EXPECT_EQ(reservation_set.GetSize(), utxos.size());
+  std::vector<Utxo> duplicate_utxos = {utxos[0], utxos[0]};
+  EXPECT_THROW(cfd::UtxoReservationSet duplicate_set(duplicate_utxos),
+      CfdException);
+
+  std::vector<uint8_t> txid_bytes(std::begin(utxos[6].txid),
+      std::end(utxos[6].txid));
+  Txid txid = Txid(ByteData256(txid_bytes));
+  size_t index = 0;
+  EXPECT_TRUE(reservation_set.Find(txid, utxos[6].vout, &index));
+  EXPECT_EQ(index, 6);
+  EXPECT_FALSE(reservation_set.Find(txid, 1, &index));
+
+  // conflict reservation is rolled back
+  cfd::UtxoReservation reservation1;
+  cfd::UtxoReservation reservation2;
+  EXPECT_TRUE(reservation_set.Reserve({0, 1}, 0, &reservation1));
+  EXPECT_NE(reservation1.id, 0);
+  EXPECT_EQ(reservation_set.GetState(0), cfd::kUtxoReservationReserved);
+  EXPECT_FALSE(reservation_set.Reserve({2, 1}, 0, &reservation2));
+  EXPECT_EQ(reservation_set.GetState(2), cfd::kUtxoReservationFree);
+  EXPECT_EQ(reservation_set.Release(reservation1), 2);
+  EXPECT_EQ(reservation_set.GetState(1), cfd::kUtxoReservationFree);
+
+  EXPECT_TRUE(reservation_set.Reserve({2, 1}, 0, &reservation2));
+  EXPECT_NE(reservation2.id, reservation1.id);
+  EXPECT_EQ(reservation_set.Release(reservation1), 0);
+  EXPECT_TRUE(reservation_set.Commit(reservation2));
+  EXPECT_EQ(reservation_set.GetState(1), cfd::kUtxoReservationSpent);
+  EXPECT_EQ(reservation_set.GetState(2), cfd::kUtxoReservationSpent);
+  EXPECT_EQ(reservation_set.Release(reservation2), 0);
+  EXPECT_FALSE(reservation_set.Reserve({1}, 0, &reservation1));
+
+  EXPECT_TRUE(reservation_set.MarkSpent(txid, utxos[6].vout));
+  EXPECT_EQ(reservation_set.GetState(6), cfd::kUtxoReservationSpent);
+  EXPECT_FALSE(reservation_set.MarkSpent(txid, 1));
+
+  // expired reservation can be reserved by another
+  EXPECT_TRUE(reservation_set.Reserve({3}, 1, &reservation1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(reservation_set.GetState(3), cfd::kUtxoReservationFree);
+  EXPECT_TRUE(reservation_set.Reserve({3}, 0, &reservation2));
+  EXPECT_FALSE(reservation_set.Commit(reservation1));
+  EXPECT_TRUE(reservation_set.Commit(reservation2));
+  EXPECT_THROW(reservation_set.Reserve({utxos.size()}, 0, &reservation1),
+      CfdException);
+}
+
+TEST(UtxoReservationSet, Commit_partial_expired)
+{
+  std::vector<Utxo> utxos = GetBitcoinUtxoList();
+  cfd::UtxoReservationSet reservation_set(utxos);
+
+  // 一部のUTXOの予約を他で取得された場合、全UTXOを変更しないこと
+  cfd::UtxoReservation reservation1;
+  cfd::UtxoReservation reservation2;
+  EXPECT_TRUE(reservation_set.Reserve({0, 1, 2}, 1, &reservation1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_TRUE(reservation_set.Reserve({2}, 0, &reservation2));
+  EXPECT_FALSE(reservation_set.Commit(reservation1));
+  EXPECT_NE(reservation_set.GetState(0), cfd::kUtxoReservationSpent);
+  EXPECT_NE(reservation_set.GetState(1), cfd::kUtxoReservationSpent);
+  EXPECT_EQ(reservation_set.GetState(2), cfd::kUtxoReservationReserved);
+
+  // 失敗したUTXOは解放・再予約できること
+  EXPECT_EQ(reservation_set.Release(reservation1), 2);
+  EXPECT_EQ(reservation_set.GetState(0), cfd::kUtxoReservationFree);
+  EXPECT_TRUE(reservation_set.Reserve({0, 1}, 0, &reservation1));
+  EXPECT_TRUE(reservation_set.Commit(reservation1));
+  EXPECT_TRUE(reservation_set.Commit(reservation2));
+  for (size_t index = 0; index < 3; ++index) {
+    EXPECT_EQ(reservation_set.GetState(index), cfd::kUtxoReservationSpent);
+  }
+}
+
+TEST(UtxoReservationSet, Reserve_duplicate_index)
+{
+  std::vector<Utxo> utxos = GetBitcoinUtxoList();
+  cfd::UtxoReservationSet reservation_set(utxos);
+
+  // 重複したindexは1件として予約すること
+  cfd::UtxoReservation reservation1;
+  cfd::UtxoReservation reservation2;
+  EXPECT_TRUE(reservation_set.Reserve({1, 0, 1}, 0, &reservation1));
+  EXPECT_EQ(reservation1.indexes, std::vector<size_t>({0, 1}));
+
+  // 予約IDは再利用せず、他の予約中のUTXOは予約できないこと
+  uint64_t last_id = reservation1.id;
+  for (size_t count = 0; count < 100; ++count) {
+    EXPECT_TRUE(reservation_set.Reserve({2, 2}, 0, &reservation2));
+    EXPECT_GT(reservation2.id, last_id);
+    last_id = reservation2.id;
+    EXPECT_EQ(reservation_set.Release(reservation2), 1);
+  }
+  EXPECT_FALSE(reservation_set.Reserve({3, 0, 3}, 0, &reservation2));
+  EXPECT_EQ(reservation_set.GetState(3), cfd::kUtxoReservationFree);
+  EXPECT_EQ(reservation_set.GetState(0), cfd::kUtxoReservationReserved);
+  EXPECT_EQ(reservation_set.Release(reservation1), 2);
+}
+
+TEST(UtxoReservationSet, GetFreeFeePool)
+{
+  std::vector<Utxo> utxos = GetBitcoinUtxoList();
+  cfd::UtxoReservationSet reservation_set(utxos);
+  cfd::UtxoReservation reservation;
+  EXPECT_TRUE(reservation_set.Reserve({0, 2}, 0, &reservation));
+
+  // 未予約のUTXOのみ、fee計算済みで取得すること
+  cfd::FeeCalculator effective_fee(20000);
+  cfd::FeeCalculator long_term_fee(1000);
+  cfd::UtxoPool fee_pool;
+  for (size_t count = 0; count < 2; ++count) {
+    reservation_set.GetFreeFeePool(20000, 1000, &fee_pool);
+    ASSERT_EQ(fee_pool.GetSize(), utxos.size() - 2);
+    for (size_t index = 0; index < fee_pool.GetSize(); ++index) {
+      const Utxo* utxo = fee_pool.GetUtxo(index);
+      EXPECT_NE(utxo, reservation_set.GetUtxo(0));
+      EXPECT_NE(utxo, reservation_set.GetUtxo(2));
+      EXPECT_EQ(fee_pool.GetFees()[index],
+          static_cast<uint64_t>(effective_fee.GetFee(*utxo).GetSatoshiValue()));
+      EXPECT_EQ(fee_pool.GetLongTermFees()[index],
+          static_cast<uint64_t>(long_term_fee.GetFee(*utxo).GetSatoshiValue()));
+    }
+  }
+  EXPECT_TRUE(reservation_set.Commit(reservation));
+  reservation_set.GetFreeFeePool(20000, 1000, &fee_pool);
+  EXPECT_EQ(fee_pool.GetSize(), utxos.size() - 2);
+  EXPECT_THROW(reservation_set.GetFreeFeePool(20000, 1000, nullptr),
+      CfdException);
+}
+
+TEST(CoinSelection, SelectCoins_Simple_reservation)
+{
+  CoinSelection coin_select(true);
+  std::vector<Utxo> utxos;
+  for (uint32_t index = 0; index < 400; ++index) {
+    Utxo utxo;
+    memset(&utxo, 0, sizeof(utxo));
+    utxo.vout = index;
+    utxo.amount = 2000000 + (index % 8) * 10000;
+    utxo.witness_size_max = 108;
+    utxos.push_back(utxo);
+  }
+  cfd::UtxoReservationSet reservation_set(utxos);
+  CoinSelectionOption option_params;
+  option_params.InitializeTxSizeInfo();
+  option_params.SetEffectiveFeeBaserate(20);
+  option_params.SetRandomSeed(1);
+  Amount target_value = Amount::CreateBySatoshiAmount(90000);
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+
+  // concurrent workers never select the same utxo.
+  const size_t worker_count = 8;
+  const size_t select_count = 10;
+  std::vector<std::vector<cfd::UtxoReservation>> results(worker_count);
+  std::vector<size_t> errors(worker_count);
+  std::vector<std::thread> threads;
+  for (size_t worker = 0; worker < worker_count; ++worker) {
+    threads.emplace_back([&, worker]() {
+      for (size_t count = 0; count < select_count; ++count) {
+        Amount select_value;
+        cfd::UtxoReservation reservation;
+        try {
+          coin_select.SelectCoins(target_value, &reservation_set, exp_filter,
+              option_params, tx_fee, 0, &select_value, &reservation);
+          results[worker].push_back(reservation);
+        } catch (const CfdException&) {
+          ++errors[worker];
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::set<size_t> reserved_indexes;
+  size_t reserved_count = 0;
+  for (size_t worker = 0; worker < worker_count; ++worker) {
+    EXPECT_EQ(errors[worker], 0);
+    EXPECT_EQ(results[worker].size(), select_count);
+    for (const auto& reservation : results[worker]) {
+      EXPECT_FALSE(reservation.indexes.empty());
+      for (size_t index : reservation.indexes) {
+        reserved_indexes.insert(index);
+        EXPECT_EQ(reservation_set.GetState(index),
+            cfd::kUtxoReservationReserved);
+      }
+      reserved_count += reservation.indexes.size();
+    }
+  }
+  EXPECT_EQ(reserved_indexes.size(), reserved_count);
+
+  // released utxos are selectable again.
+  for (const auto& reservation : results[0]) {
+    EXPECT_EQ(reservation_set.Release(reservation), reservation.indexes.size());
+  }
+  Amount select_value;
+  cfd::UtxoReservation reservation;
+  std::vector<Utxo> select_utxos;
+  EXPECT_NO_THROW((select_utxos = coin_select.SelectCoins(target_value,
+      &reservation_set, exp_filter, option_params, tx_fee, 1000,
+      &select_value, &reservation)));
+  EXPECT_EQ(select_utxos.size(), reservation.indexes.size());
+  EXPECT_GE(select_value.GetSatoshiValue(), 91500);
+  EXPECT_THROW((select_utxos = coin_select.SelectCoins(target_value,
+      static_cast<cfd::UtxoReservationSet*>(nullptr), exp_filter,
+      option_params, tx_fee, 0, &select_value, &reservation)), CfdException);
+}
+
 // CoinSelection Utility -----------------------------------------------------------------
 TEST(CoinSelection, Constructor)
 {
@@ -674,6 +1754,153 @@ TEST(CoinSelection, ConvertToUtxo)
 #endif                // CFD_DISABLE_ELEMENTS
 }
 
+TEST(CoinSelection, ConvertToUtxo_MultisigDescriptor)
+{
+  Txid txid("0034567890123456789012345678901234567890123456789012345678901456");
+  uint32_t vout = 1;
+  std::string output_descriptor(
+      "wsh(multi(2,"
+      "0214156e4ae9168289b4d0c034da94025121d33ad8643663454885032d77640e3d,"
+      "022c2409fbf657ba25d97bb3dab5426d20677b774d4fc7bd3bfac27ff96ada3dd1,"
+      "0231c043ae680664a2c5df38cf0d8eab29f1b61ce93855040c613b2f41f7c036af))");
+  Amount amount = Amount::CreateBySatoshiAmount(20000);
+  Utxo utxo = {};
+
+  EXPECT_NO_THROW((CoinSelection::ConvertToUtxo(
+    txid, vout, output_descriptor, amount, "", nullptr, &utxo)));
+  EXPECT_EQ(utxo.address_type, static_cast<uint16_t>(AddressType::kP2wshAddress));
+  // 2署名 + witness script(2-of-3)
+  EXPECT_EQ(utxo.witness_size_max, static_cast<uint16_t>(254));
+  EXPECT_EQ(utxo.uscript_size_max, static_cast<uint16_t>(0));
+  EXPECT_EQ(utxo.script_length, static_cast<uint16_t>(34));
+  EXPECT_EQ(utxo.amount, amount.GetSatoshiValue());
+}
+
+TEST(CoinApi, ConvertToUtxo_RangedDescriptor)
+{
+  // 引数を持つdescriptorは指定したlocking scriptを保持すること
+  cfd::api::UtxoData utxo_data;
+  utxo_data.block_height = 0;
+  utxo_data.txid = Txid("0034567890123456789012345678901234567890123456789012345678901456");
+  utxo_data.vout = 1;
+  utxo_data.locking_script = Script("0014ffffffffffffffffffffffffffffffffffffffff");
+  utxo_data.descriptor =
+      "wpkh(xpub661MyMwAqRbcFtXgS5sYJABqqG9YLmC4Q1Rdap9gSE8NqtwybGhePY2gZ29ESFjqJoCu1Rupje8YtGqsefD265TMg7usUDFdp6W1EGMcet8/0/*)";
+  utxo_data.amount = Amount::CreateBySatoshiAmount(20000);
+  utxo_data.binary_data = nullptr;
+  Utxo utxo = {};
+
+  cfd::api::CoinApi api;
+  EXPECT_NO_THROW(api.ConvertToUtxo(utxo_data, &utxo));
+  EXPECT_EQ(utxo.address_type, static_cast<uint16_t>(AddressType::kP2wpkhAddress));
+  EXPECT_EQ(utxo.witness_size_max, static_cast<uint16_t>(108));
+  ASSERT_EQ(utxo.script_length, static_cast<uint16_t>(22));
+  EXPECT_EQ(
+      ByteData(std::vector<uint8_t>(utxo.locking_script, utxo.locking_script + 22)).GetHex(),
+      utxo_data.locking_script.GetHex());
+}
+
+static cfd::api::UtxoData GetCoinApiUtxoData(
+    const std::string& descriptor, const Script& locking_script) {
+  cfd::api::UtxoData utxo_data;
+  utxo_data.block_height = 0;
+  utxo_data.txid = Txid("0034567890123456789012345678901234567890123456789012345678901456");
+  utxo_data.vout = 1;
+  utxo_data.locking_script = locking_script;
+  utxo_data.descriptor = descriptor;
+  utxo_data.amount = Amount::CreateBySatoshiAmount(20000);
+  utxo_data.binary_data = nullptr;
+  return utxo_data;
+}
+
+TEST(CoinApi, ConvertToUtxo_EstimateTxInSize)
+{
+  // 変換したサイズはfee算出用の推定サイズと一致すること
+  std::vector<cfd::api::UtxoData> utxo_list = {
+    GetCoinApiUtxoData(
+        "", Script("0014ffffffffffffffffffffffffffffffffffffffff")),
+    GetCoinApiUtxoData(
+        "sh(wpkh(022c2409fbf657ba25d97bb3dab5426d20677b774d4fc7bd3bfac27ff96ada3dd1))",
+        Script()),
+    GetCoinApiUtxoData(
+        "wsh(multi(2,"
+        "0214156e4ae9168289b4d0c034da94025121d33ad8643663454885032d77640e3d,"
+        "022c2409fbf657ba25d97bb3dab5426d20677b774d4fc7bd3bfac27ff96ada3dd1,"
+        "0231c043ae680664a2c5df38cf0d8eab29f1b61ce93855040c613b2f41f7c036af))",
+        Script()),
+  };
+  cfd::api::CoinApi api;
+  std::vector<Utxo> utxos = api.ConvertToUtxo(utxo_list);
+  ASSERT_EQ(utxos.size(), utxo_list.size());
+  for (size_t index = 0; index < utxos.size(); ++index) {
+    uint32_t witness_size = 0;
+    uint32_t size = api.EstimateTxInSize(utxo_list[index], &witness_size);
+    EXPECT_EQ(
+        static_cast<uint32_t>(cfd::core::TxIn::kMinimumTxInSize) +
+            utxos[index].uscript_size_max + utxos[index].witness_size_max,
+        size);
+    EXPECT_EQ(utxos[index].witness_size_max, witness_size);
+  }
+  // p2wpkhはunlocking scriptを持たない
+  EXPECT_EQ(utxos[0].uscript_size_max, static_cast<uint16_t>(0));
+  EXPECT_EQ(utxos[0].witness_size_max, static_cast<uint16_t>(108));
+  EXPECT_EQ(utxos[1].uscript_size_max, static_cast<uint16_t>(23));
+  EXPECT_EQ(utxos[1].witness_size_max, static_cast<uint16_t>(108));
+  EXPECT_EQ(utxos[2].uscript_size_max, static_cast<uint16_t>(0));
+  EXPECT_EQ(utxos[2].witness_size_max, static_cast<uint16_t>(254));
+
+#ifndef CFD_DISABLE_ELEMENTS
+  // asset付きのUTXOはConfidential TxInの推定サイズを使用する
+  cfd::api::UtxoData elements_utxo = utxo_list[1];
+  elements_utxo.asset = ConfidentialAssetId(
+      "aa00000000000000000000000000000000000000000000000000000000000000");
+  Utxo utxo = {};
+  api.ConvertToUtxo(elements_utxo, &utxo);
+  uint32_t witness_size = 0;
+  uint32_t size = api.EstimateConfidentialTxInSize(
+      elements_utxo, false, false, false, 0, Script(), &witness_size);
+  EXPECT_EQ(
+      static_cast<uint32_t>(cfd::core::TxIn::kMinimumTxInSize) +
+          utxo.uscript_size_max + utxo.witness_size_max,
+      size);
+  EXPECT_EQ(utxo.witness_size_max, witness_size);
+#endif  // CFD_DISABLE_ELEMENTS
+}
+
+TEST(CoinApi, AddUtxo_UpdateUtxo)
+{
+  cfd::api::UtxoData utxo_data = GetCoinApiUtxoData(
+      "", Script("0014ffffffffffffffffffffffffffffffffffffffff"));
+  cfd::api::CoinApi api;
+  Utxo expect_utxo = {};
+  api.ConvertToUtxo(utxo_data, &expect_utxo);
+
+  cfd::UtxoIndex utxo_index;
+  EXPECT_NO_THROW(api.AddUtxo(utxo_data, &utxo_index));
+  EXPECT_EQ(utxo_index.GetSize(), static_cast<size_t>(1));
+  const Utxo* utxo = utxo_index.Find(utxo_data.txid, utxo_data.vout);
+  ASSERT_NE(utxo, nullptr);
+  EXPECT_EQ(utxo->amount, static_cast<uint64_t>(20000));
+  EXPECT_EQ(utxo->uscript_size_max, expect_utxo.uscript_size_max);
+  EXPECT_EQ(utxo->witness_size_max, expect_utxo.witness_size_max);
+  EXPECT_EQ(utxo->address_type, expect_utxo.address_type);
+  // 同一OutPointの追加は不可
+  EXPECT_THROW(api.AddUtxo(utxo_data, &utxo_index), CfdException);
+
+  utxo_data.amount = Amount::CreateBySatoshiAmount(30000);
+  EXPECT_NO_THROW(api.UpdateUtxo(utxo_data, &utxo_index));
+  EXPECT_EQ(utxo_index.GetSize(), static_cast<size_t>(1));
+  utxo = utxo_index.Find(utxo_data.txid, utxo_data.vout);
+  ASSERT_NE(utxo, nullptr);
+  EXPECT_EQ(utxo->amount, static_cast<uint64_t>(30000));
+
+  // 未登録のOutPointは更新不可
+  utxo_data.vout = 2;
+  EXPECT_THROW(api.UpdateUtxo(utxo_data, &utxo_index), CfdException);
+  EXPECT_THROW(api.AddUtxo(utxo_data, nullptr), CfdException);
+  EXPECT_THROW(api.UpdateUtxo(utxo_data, nullptr), CfdException);
+}
+
 // SelectCoins(With Asset) =====================================================
 
 #ifndef CFD_DISABLE_ELEMENTS
@@ -872,6 +2099,57 @@ TEST(CoinSelection, SelectCoins_KnapsackSolver_match_utxo_with_asset)
   }
 }
 
+TEST(UtxoAssetBuckets, BuildAndGetPool)
+{
+  std::vector<Utxo> utxos = GetElementsUtxoList();
+  cfd::UtxoAssetBuckets buckets;
+  buckets.Build(utxos.data(), utxos.size(), GetElementsOption());
+
+  const cfd::UtxoPool* pool_a = buckets.GetPool(exp_dummy_asset_a);
+  const cfd::UtxoPool* pool_b = buckets.GetPool(exp_dummy_asset_b);
+  const cfd::UtxoPool* pool_c = buckets.GetPool(exp_dummy_asset_c);
+  ASSERT_NE(pool_a, nullptr);
+  ASSERT_NE(pool_b, nullptr);
+  ASSERT_NE(pool_c, nullptr);
+  EXPECT_EQ(pool_a->GetSize(), 6);
+  EXPECT_EQ(pool_b->GetSize(), 4);
+  EXPECT_EQ(pool_c->GetSize(), 2);
+  EXPECT_EQ(pool_a->GetUtxo(0), &utxos[0]);
+  EXPECT_EQ(pool_c->GetUtxo(1), &utxos[11]);
+  EXPECT_EQ(buckets.GetPool(ConfidentialAssetId(
+      "dd00000000000000000000000000000000000000000000000000000000000000")),
+      nullptr);
+
+  // rebuild without asset c
+  utxos.resize(10);
+  buckets.Build(utxos.data(), utxos.size(), GetElementsOption());
+  EXPECT_EQ(buckets.GetPool(exp_dummy_asset_c), nullptr);
+  ASSERT_NE(buckets.GetPool(exp_dummy_asset_b), nullptr);
+  EXPECT_EQ(buckets.GetPool(exp_dummy_asset_b)->GetSize(), 4);
+
+  CoinSelectionOption option = GetElementsOption();
+  option.SetFeeAsset(exp_dummy_asset_a);
+  AmountMap map_target_amount;
+  map_target_amount[exp_dummy_asset_a.GetHex()] = Amount::CreateBySatoshiAmount(39060180);
+  AmountMap map_select_value;
+  Amount fee;
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+  std::vector<Utxo> ret;
+  EXPECT_NO_THROW(ret = exp_selection.SelectCoins(
+      map_target_amount, buckets, exp_filter, option,
+      tx_fee, &map_select_value, &fee));
+  EXPECT_EQ(ret.size(), 1);
+  if (ret.size() == 1) {
+    EXPECT_EQ(ret[0].amount, static_cast<int64_t>(39062500));
+  }
+  EXPECT_EQ(fee.GetSatoshiValue(), 820);
+
+  map_target_amount[exp_dummy_asset_c.GetHex()] = Amount::CreateBySatoshiAmount(1000);
+  EXPECT_THROW(ret = exp_selection.SelectCoins(
+      map_target_amount, buckets, exp_filter, option,
+      tx_fee, &map_select_value, &fee), CfdException);
+}
+
 TEST(CoinSelection, SelectCoins_KnapsackSolver_ApproximateBestSubset_with_asset)
 {
   CoinSelectionOption option = GetElementsOption();
@@ -1041,7 +2319,7 @@ TEST(CoinSelection, SelectCoins_SelectCoinsBnB_with_asset)
   if (map_select_value.size() == 1) {
     EXPECT_EQ(map_select_value[exp_dummy_asset_a.GetHex()].GetSatoshiValue(), 100001090);
   }
-  EXPECT_EQ(fee.GetSatoshiValue(), 360);
+  EXPECT_EQ(fee.GetSatoshiValue(), 364);
   EXPECT_EQ(map_searched_bnb.size(), 1);
   if (map_searched_bnb.size() == 1) {
     EXPECT_TRUE(map_searched_bnb[exp_dummy_asset_a.GetHex()]);
@@ -1089,7 +2367,7 @@ TEST(CoinSelection, SelectCoins_SelectCoinsBnB_single_with_asset)
   if (map_select_value.size() == 1) {
     EXPECT_EQ(map_select_value[exp_dummy_asset_a.GetHex()].GetSatoshiValue(), 155062500);
   }
-  EXPECT_EQ(fee.GetSatoshiValue(), 180);
+  EXPECT_EQ(fee.GetSatoshiValue(), 182);
   EXPECT_EQ(map_searched_bnb.size(), 1);
   if (map_searched_bnb.size() == 1) {
     EXPECT_TRUE(map_searched_bnb[exp_dummy_asset_a.GetHex()]);
@@ -1139,7 +2417,7 @@ TEST(CoinSelection, SelectCoins_SelectCoinsBnB_empty_with_asset)
   if (map_select_value.size() == 1) {
     EXPECT_EQ(map_select_value[exp_dummy_asset_a.GetHex()].GetSatoshiValue(), 115063590);
   }
-  EXPECT_EQ(fee.GetSatoshiValue(), 270);
+  EXPECT_EQ(fee.GetSatoshiValue(), 273);
   EXPECT_EQ(map_searched_bnb.size(), 1);
   if (map_searched_bnb.size() == 1) {
     EXPECT_FALSE(map_searched_bnb[exp_dummy_asset_a.GetHex()]);
@@ -1229,7 +2507,7 @@ TEST(CoinSelection, SelectCoins_CoinSelectBnB_with_multiple_asset)
     EXPECT_EQ(map_select_value[exp_dummy_asset_a.GetHex()].GetSatoshiValue(), 100001090);
     EXPECT_EQ(map_select_value[exp_dummy_asset_b.GetHex()].GetSatoshiValue(), 347180050);
   }
-  EXPECT_EQ(fee.GetSatoshiValue(), 720);
+  EXPECT_EQ(fee.GetSatoshiValue(), 728);
   EXPECT_EQ(map_searched_bnb.size(), 2);
   if (map_searched_bnb.size() == 2) {
     EXPECT_TRUE(map_searched_bnb[exp_dummy_asset_a.GetHex()]);
@@ -1237,6 +2515,55 @@ TEST(CoinSelection, SelectCoins_CoinSelectBnB_with_multiple_asset)
   }
 }
 
+TEST(CoinSelection, SelectCoins_CoinSelectBnB_with_multiple_asset_report)
+{
+  CoinSelection coin_select(true);
+  // Same condition with "SelectCoins_SelectCoinsBnB"
+  AmountMap map_target_amount;
+  map_target_amount[exp_dummy_asset_a.GetHex()] = Amount::CreateBySatoshiAmount(99997900);
+  map_target_amount[exp_dummy_asset_b.GetHex()] = Amount::CreateBySatoshiAmount(346495050);
+  AmountMap map_select_value;
+  Amount fee;
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+  std::map<std::string, bool> map_searched_bnb;
+  CoinSelectionOption option = GetElementsOption();
+  option.SetEffectiveFeeBaserate(2);
+  option.SetFeeAsset(exp_dummy_asset_a);
+
+  std::vector<Utxo> utxos;
+  utxos.resize(kExtCoinSelectElementsTestVector.size());
+  std::vector<Utxo>::iterator ite = utxos.begin();
+  for (const auto& test_data : kExtCoinSelectElementsTestVector) {
+    Txid txid;
+    if (!test_data.txid.empty()) {
+      txid = Txid(test_data.txid);
+    }
+    CoinSelection::ConvertToUtxo(
+        txid, test_data.vout, test_data.descriptor,
+        Amount::CreateBySatoshiAmount(test_data.amount), test_data.asset, nullptr,
+        &(*ite));
+    ++ite;
+  }
+
+  std::vector<Utxo> ret;
+  std::map<std::string, cfd::CoinSelectionReport> map_report;
+  EXPECT_NO_THROW(ret = coin_select.SelectCoins(
+      map_target_amount, utxos, exp_filter, option,
+      tx_fee, &map_select_value, &fee, &map_searched_bnb, &map_report));
+
+  EXPECT_EQ(ret.size(), 4);
+  EXPECT_EQ(map_report.size(), 2);
+  if (map_report.size() == 2) {
+    EXPECT_EQ(map_report[exp_dummy_asset_a.GetHex()].solver,
+        cfd::kCoinSelectionSolverBnB);
+    EXPECT_EQ(map_report[exp_dummy_asset_a.GetHex()].input_count, 2);
+    EXPECT_FALSE(map_report[exp_dummy_asset_a.GetHex()].has_change);
+    EXPECT_EQ(map_report[exp_dummy_asset_b.GetHex()].solver,
+        cfd::kCoinSelectionSolverKnapsack);
+    EXPECT_EQ(map_report[exp_dummy_asset_b.GetHex()].input_count, 2);
+  }
+}
+
 TEST(CoinSelection, SelectCoins_with_multiple_asset_fee_only_target)
 {
   CoinSelection coin_select(true);
@@ -1355,6 +2682,148 @@ TEST(CoinSelection, SelectCoins_with_multiple_asset_not_consider_fee)
   }
 }
 
+TEST(CoinSelection, SelectCoins_with_multiple_asset_parallel)
+{
+  CoinSelection coin_select(true);
+  // Same condition with "SelectCoins_with_multiple_asset_not_consider_fee"
+  AmountMap map_target_amount;
+  map_target_amount[exp_dummy_asset_a.GetHex()] = Amount::CreateBySatoshiAmount(115800000);
+  map_target_amount[exp_dummy_asset_b.GetHex()] = Amount::CreateBySatoshiAmount(19226350);
+  map_target_amount[exp_dummy_asset_c.GetHex()] = Amount::CreateBySatoshiAmount(99060000);
+  AmountMap map_select_value;
+  Amount fee;
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+  std::map<std::string, bool> map_searched_bnb;
+  CoinSelectionOption option = GetElementsOption();
+  option.SetEffectiveFeeBaserate(0);
+  option.SetAssetSelectionThreadCount(3);
+  EXPECT_EQ(option.GetAssetSelectionThreadCount(), 3);
+
+  std::vector<Utxo> utxos;
+  utxos.resize(kExtCoinSelectElementsTestVector.size());
+  std::vector<Utxo>::iterator ite = utxos.begin();
+  for (const auto& test_data : kExtCoinSelectElementsTestVector) {
+    Txid txid;
+    if (!test_data.txid.empty()) {
+      txid = Txid(test_data.txid);
+    }
+    CoinSelection::ConvertToUtxo(
+        txid, test_data.vout, test_data.descriptor,
+        Amount::CreateBySatoshiAmount(test_data.amount), test_data.asset, nullptr,
+        &(*ite));
+    ++ite;
+  }
+
+  std::vector<Utxo> ret;
+  EXPECT_NO_THROW(ret = coin_select.SelectCoins(
+      map_target_amount, utxos, exp_filter, option,
+      tx_fee, &map_select_value, &fee, &map_searched_bnb));
+
+  EXPECT_EQ(ret.size(), 6);
+  if (ret.size() == 6) {
+    EXPECT_EQ(ret[0].amount, static_cast<int64_t>(61062500));
+    EXPECT_EQ(ret[1].amount, static_cast<int64_t>(39062500));
+    EXPECT_EQ(ret[2].amount, static_cast<int64_t>(15675000));
+    EXPECT_EQ(ret[3].amount, static_cast<int64_t>(18476350));
+    EXPECT_EQ(ret[4].amount, static_cast<int64_t>(750000));
+    EXPECT_EQ(ret[5].amount, static_cast<int64_t>(127030000));
+  }
+  EXPECT_EQ(map_select_value.size(), 3);
+  if (map_select_value.size() == 3) {
+    EXPECT_EQ(map_select_value[exp_dummy_asset_a.GetHex()].GetSatoshiValue(), 115800000);
+    EXPECT_EQ(map_select_value[exp_dummy_asset_b.GetHex()].GetSatoshiValue(), 19226350);
+    EXPECT_EQ(map_select_value[exp_dummy_asset_c.GetHex()].GetSatoshiValue(), 127030000);
+  }
+  EXPECT_EQ(fee.GetSatoshiValue(), 0);
+  EXPECT_EQ(map_searched_bnb.size(), 3);
+
+  // error on worker thread
+  map_target_amount[exp_dummy_asset_c.GetHex()] = Amount::CreateBySatoshiAmount(2100000000000000);
+  EXPECT_THROW(ret = coin_select.SelectCoins(
+      map_target_amount, utxos, exp_filter, option,
+      tx_fee, &map_select_value, &fee, &map_searched_bnb), CfdException);
+}
+
+TEST(CoinSelectionThreadPool, Run)
+{
+  cfd::CoinSelectionThreadPool pool(3);
+  EXPECT_EQ(pool.GetThreadCount(), static_cast<size_t>(3));
+  // 同一プールを繰り返し利用できること
+  for (size_t count = 0; count < 20; ++count) {
+    std::vector<std::atomic<uint32_t>> counts(16);
+    for (auto& value : counts) value.store(0);
+    pool.Run(counts.size(), [&counts](size_t index) {
+      counts[index].fetch_add(1);
+    }, (count % 4));
+    for (auto& value : counts) EXPECT_EQ(value.load(), static_cast<uint32_t>(1));
+  }
+
+  // 全タスクの完了後に例外を再送出すること
+  std::atomic<uint32_t> executed(0);
+  EXPECT_THROW(pool.Run(8, [&executed](size_t index) {
+    executed.fetch_add(1);
+    if (index == 2) {
+      throw CfdException(cfd::core::CfdError::kCfdIllegalStateError, "task error");
+    }
+  }), CfdException);
+  EXPECT_EQ(executed.load(), static_cast<uint32_t>(8));
+
+  // ワーカーなしの場合は呼び出し元スレッドで逐次実行すること
+  cfd::CoinSelectionThreadPool empty_pool(0);
+  EXPECT_EQ(empty_pool.GetThreadCount(), static_cast<size_t>(0));
+  std::vector<size_t> order;
+  empty_pool.Run(4, [&order](size_t index) { order.push_back(index); });
+  EXPECT_EQ(order, std::vector<size_t>({0, 1, 2, 3}));
+}
+
+TEST(CoinSelection, SelectCoins_with_multiple_asset_thread_pool)
+{
+  CoinSelection coin_select(true);
+  // Same condition with "SelectCoins_with_multiple_asset_parallel"
+  AmountMap map_target_amount;
+  map_target_amount[exp_dummy_asset_a.GetHex()] = Amount::CreateBySatoshiAmount(115800000);
+  map_target_amount[exp_dummy_asset_b.GetHex()] = Amount::CreateBySatoshiAmount(19226350);
+  map_target_amount[exp_dummy_asset_c.GetHex()] = Amount::CreateBySatoshiAmount(99060000);
+  AmountMap map_select_value;
+  Amount fee;
+  Amount tx_fee = Amount::CreateBySatoshiAmount(1500);
+  std::map<std::string, bool> map_searched_bnb;
+  cfd::CoinSelectionThreadPool pool(2);
+  CoinSelectionOption option = GetElementsOption();
+  option.SetEffectiveFeeBaserate(0);
+  option.SetAssetSelectionThreadCount(3);
+  EXPECT_EQ(option.GetThreadPool(), nullptr);
+  option.SetThreadPool(&pool);
+  EXPECT_EQ(option.GetThreadPool(), &pool);
+
+  std::vector<Utxo> utxos;
+  utxos.resize(kExtCoinSelectElementsTestVector.size());
+  std::vector<Utxo>::iterator ite = utxos.begin();
+  for (const auto& test_data : kExtCoinSelectElementsTestVector) {
+    Txid txid;
+    if (!test_data.txid.empty()) {
+      txid = Txid(test_data.txid);
+    }
+    CoinSelection::ConvertToUtxo(
+        txid, test_data.vout, test_data.descriptor,
+        Amount::CreateBySatoshiAmount(test_data.amount), test_data.asset, nullptr,
+        &(*ite));
+    ++ite;
+  }
+
+  // 同一プールで繰り返し選択しても結果が変わらないこと
+  for (size_t count = 0; count < 3; ++count) {
+    std::vector<Utxo> ret;
+    EXPECT_NO_THROW(ret = coin_select.SelectCoins(
+        map_target_amount, utxos, exp_filter, option,
+        tx_fee, &map_select_value, &fee, &map_searched_bnb));
+    ASSERT_EQ(ret.size(), 6);
+    EXPECT_EQ(ret[0].amount, static_cast<int64_t>(61062500));
+    EXPECT_EQ(ret[5].amount, static_cast<int64_t>(127030000));
+    EXPECT_EQ(map_select_value[exp_dummy_asset_c.GetHex()].GetSatoshiValue(), 127030000);
+  }
+}
+
 // SelectCoins ErrorCase -----------------------------------------------------------------
 TEST(CoinSelection, SelectCoins_Error_empty_target_value_map) {
   AmountMap map_target_amount;
@@ -1,12 +1,28 @@
 #include "gtest/gtest.h"
+#include <string>
 #include <vector>
 
 #include "cfdcore/cfdcore_amount.h"
+#include "cfdcore/cfdcore_exception.h"
+#include "cfdcore/cfdcore_transaction.h"
 #include "cfd/cfd_common.h"
 #include "cfd/cfd_fee.h"
 
+using cfd::core::AddressType;
 using cfd::core::Amount;
+using cfd::core::ByteData;
+using cfd::core::CfdException;
+using cfd::core::Script;
+using cfd::core::Transaction;
+using cfd::core::TxIn;
+using cfd::core::TxOut;
+using cfd::core::TxOutReference;
+using cfd::core::Txid;
+using cfd::DescriptorTxInSizeData;
 using cfd::FeeCalculator;
+using cfd::TxInSizeTable;
+using cfd::TxSizeModel;
+using cfd::Utxo;
 
 TEST(FeeCalculator, CalculateFeeTest)
 {
@@ -30,3 +46,282 @@ TEST(FeeCalculator, GetFeeTest)
   EXPECT_NO_THROW((amt = fee2.GetFee(size)));
   EXPECT_EQ(amt.GetSatoshiValue(), static_cast<int64_t>(60000));
 }
+
+TEST(TxSizeModel, UpdateTxInTxOutTest)
+{
+  TxSizeModel model;
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(10));
+  EXPECT_EQ(model.GetVsize(), static_cast<uint32_t>(10));
+
+  // p2wpkh txin
+  Utxo utxo = {};
+  utxo.witness_size_max = 108;
+  EXPECT_NO_THROW(model.AddTxIn(utxo));
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(161));
+  EXPECT_EQ(model.GetWitnessSize(), static_cast<uint32_t>(110));
+  EXPECT_EQ(model.GetVsize(), static_cast<uint32_t>(79));
+  EXPECT_EQ(model.GetTxInCount(), static_cast<uint32_t>(1));
+
+  TxOut txout(Amount(), Script("0014ffffffffffffffffffffffffffffffffffffffff"));
+  EXPECT_NO_THROW(model.AddTxOut(TxOutReference(txout)));
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(192));
+  EXPECT_EQ(model.GetVsize(), static_cast<uint32_t>(110));
+  EXPECT_EQ(model.GetTxOutCount(), static_cast<uint32_t>(1));
+
+  EXPECT_NO_THROW(model.RemoveTxOut(TxOutReference(txout)));
+  EXPECT_EQ(model.GetVsize(), static_cast<uint32_t>(79));
+  EXPECT_NO_THROW(model.RemoveTxIn(utxo));
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(10));
+  EXPECT_EQ(model.GetWitnessSize(), static_cast<uint32_t>(0));
+
+  EXPECT_THROW(model.RemoveTxOut(31), CfdException);
+  EXPECT_THROW(model.AddTxIn(10, 20), CfdException);
+}
+
+TEST(TxSizeModel, SegwitMarkerTest)
+{
+  TxSizeModel model;
+  // p2pkh txin (非segwit)
+  EXPECT_NO_THROW(model.AddTxIn(148));
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(158));
+  EXPECT_EQ(model.GetWitnessSize(), static_cast<uint32_t>(0));
+
+  // 最初のwitness txinでmarker/flagと既存txinの空witnessを加算
+  EXPECT_NO_THROW(model.AddTxIn(149, 108));
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(310));
+  EXPECT_EQ(model.GetWitnessSize(), static_cast<uint32_t>(111));
+
+  // segwit時の非witness txinは空witnessを含む
+  EXPECT_NO_THROW(model.AddTxIn(148));
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(459));
+  EXPECT_EQ(model.GetWitnessSize(), static_cast<uint32_t>(112));
+  EXPECT_NO_THROW(model.RemoveTxIn(148));
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(310));
+
+  // 最後のwitness txinの削除で非segwitに戻る
+  EXPECT_NO_THROW(model.RemoveTxIn(149, 108));
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(158));
+  EXPECT_EQ(model.GetWitnessSize(), static_cast<uint32_t>(0));
+}
+
+TEST(TxSizeModel, CompareTransactionVsizeTest)
+{
+  const std::string sig(72 * 2, '1');
+  const std::string pubkey = "02" + std::string(32 * 2, '2');
+  const Txid txid(
+      "1111111111111111111111111111111111111111111111111111111111111111");
+  Transaction tx(2, 0);
+  TxSizeModel model;
+
+  uint32_t witness_size = 0;
+  uint32_t size = 0;
+  TxOut txout(Amount(), Script("0014ffffffffffffffffffffffffffffffffffffffff"));
+  tx.AddTxOut(txout.GetValue(), txout.GetLockingScript());
+  model.AddTxOut(TxOutReference(txout));
+
+  // p2pkh
+  tx.AddTxIn(txid, 0, 0xffffffff);
+  tx.SetUnlockingScript(0, Script("48" + sig + "21" + pubkey));
+  size = TxInSizeTable::GetTxInSize(AddressType::kP2pkhAddress, &witness_size);
+  model.AddTxIn(size, witness_size);
+  EXPECT_EQ(model.GetVsize(), tx.GetVsize());
+
+  // p2wpkh
+  tx.AddTxIn(txid, 1, 0xffffffff);
+  tx.AddScriptWitnessStack(1, ByteData(sig));
+  tx.AddScriptWitnessStack(1, ByteData(pubkey));
+  size = TxInSizeTable::GetTxInSize(AddressType::kP2wpkhAddress, &witness_size);
+  model.AddTxIn(size, witness_size);
+  EXPECT_EQ(model.GetVsize(), tx.GetVsize());
+
+  // p2sh-p2wpkh
+  tx.AddTxIn(txid, 2, 0xffffffff);
+  tx.SetUnlockingScript(2, Script("160014" + std::string(20 * 2, '3')));
+  tx.AddScriptWitnessStack(2, ByteData(sig));
+  tx.AddScriptWitnessStack(2, ByteData(pubkey));
+  size = TxInSizeTable::GetTxInSize(
+      AddressType::kP2shP2wpkhAddress, &witness_size);
+  model.AddTxIn(size, witness_size);
+  EXPECT_EQ(model.GetVsize(), tx.GetVsize());
+
+  // p2pkh (segwit時は空witnessを含む)
+  tx.AddTxIn(txid, 3, 0xffffffff);
+  tx.SetUnlockingScript(3, Script("48" + sig + "21" + pubkey));
+  size = TxInSizeTable::GetTxInSize(AddressType::kP2pkhAddress, &witness_size);
+  model.AddTxIn(size, witness_size);
+  EXPECT_EQ(model.GetVsize(), tx.GetVsize());
+}
+
+#ifndef CFD_DISABLE_ELEMENTS
+TEST(TxSizeModel, ElementsTxInTest)
+{
+  TxSizeModel model(true);
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(11));
+
+  // elementsはsegwit marker/空witnessを加算しない
+  uint32_t witness_size = 0;
+  uint32_t size = TxInSizeTable::GetConfidentialTxInSize(
+      AddressType::kP2wpkhAddress, false, false, &witness_size);
+  Utxo utxo = {};
+  utxo.uscript_size_max = static_cast<uint16_t>(
+      size - witness_size - static_cast<uint32_t>(TxIn::kMinimumTxInSize));
+  utxo.witness_size_max = static_cast<uint16_t>(witness_size);
+  EXPECT_NO_THROW(model.AddTxIn(utxo));
+  EXPECT_EQ(model.GetSize(), 11 + size);
+  EXPECT_EQ(model.GetWitnessSize(), witness_size);
+  EXPECT_NO_THROW(model.AddTxIn(148));
+  EXPECT_EQ(model.GetSize(), 11 + size + 148);
+  EXPECT_NO_THROW(model.RemoveTxIn(148));
+
+  // issuance分を加算する
+  uint32_t issuance_witness_size = 0;
+  uint32_t issuance_size = TxInSizeTable::GetConfidentialTxInSize(
+      AddressType::kP2wpkhAddress, true, true, &issuance_witness_size);
+  EXPECT_NO_THROW(model.AddTxIn(utxo, true, true));
+  EXPECT_EQ(model.GetSize(), 11 + size + issuance_size);
+  EXPECT_EQ(model.GetWitnessSize(), witness_size + issuance_witness_size);
+  EXPECT_NO_THROW(model.RemoveTxIn(utxo, true, true));
+  EXPECT_NO_THROW(model.RemoveTxIn(utxo));
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(11));
+  EXPECT_EQ(model.GetWitnessSize(), static_cast<uint32_t>(0));
+}
+#endif  // CFD_DISABLE_ELEMENTS
+
+TEST(TxSizeModel, VarIntCountTest)
+{
+  TxSizeModel model;
+  for (uint32_t count = 0; count < 252; ++count) {
+    model.AddTxOut(31);
+  }
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(7822));
+
+  // 253件目でTxOut件数のvarintが3byteに拡張される
+  model.AddTxOut(31);
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(7855));
+  EXPECT_EQ(model.GetTxOutCount(), static_cast<uint32_t>(253));
+
+  model.RemoveTxOut(31);
+  EXPECT_EQ(model.GetSize(), static_cast<uint32_t>(7822));
+}
+
+TEST(TxInSizeTable, GetTxInSizeTest)
+{
+  std::vector<AddressType> addr_types = {
+    AddressType::kP2pkhAddress,
+    AddressType::kP2shAddress,
+    AddressType::kP2wpkhAddress,
+    AddressType::kP2wshAddress,
+    AddressType::kP2shP2wpkhAddress,
+    AddressType::kP2shP2wshAddress,
+  };
+  for (const auto& addr_type : addr_types) {
+    uint32_t witness_size = 0;
+    uint32_t expect_witness_size = 0;
+    uint32_t size = TxInSizeTable::GetTxInSize(addr_type, &witness_size);
+    uint32_t expect_size =
+        TxIn::EstimateTxInSize(addr_type, Script(), &expect_witness_size);
+    EXPECT_EQ(size, expect_size);
+    EXPECT_EQ(witness_size, expect_witness_size);
+    EXPECT_EQ(TxInSizeTable::GetTxInSize(addr_type), expect_size);
+  }
+}
+
+#ifndef CFD_DISABLE_ELEMENTS
+TEST(TxInSizeTable, GetConfidentialTxInSizeTest)
+{
+  using cfd::core::ConfidentialTxIn;
+  std::vector<AddressType> addr_types = {
+    AddressType::kP2pkhAddress,
+    AddressType::kP2wpkhAddress,
+    AddressType::kP2shP2wshAddress,
+  };
+  for (const auto& addr_type : addr_types) {
+    for (int pattern = 0; pattern < 4; ++pattern) {
+      bool is_issuance = (pattern & 0x01) != 0;
+      bool is_blind_issuance = (pattern & 0x02) != 0;
+      uint32_t witness_size = 0;
+      uint32_t expect_witness_size = 0;
+      uint32_t size = TxInSizeTable::GetConfidentialTxInSize(
+          addr_type, is_issuance, is_blind_issuance, &witness_size);
+      uint32_t expect_size = ConfidentialTxIn::EstimateTxInSize(
+          addr_type, Script(), 0, Script(), is_issuance, is_blind_issuance,
+          &expect_witness_size);
+      EXPECT_EQ(size, expect_size);
+      EXPECT_EQ(witness_size, expect_witness_size);
+    }
+  }
+}
+#endif  // CFD_DISABLE_ELEMENTS
+
+TEST(TxInSizeTable, GetDescriptorTxInSizeTest)
+{
+  const std::string key1 =
+      "0214156e4ae9168289b4d0c034da94025121d33ad8643663454885032d77640e3d";
+  const std::string key2 =
+      "022c2409fbf657ba25d97bb3dab5426d20677b774d4fc7bd3bfac27ff96ada3dd1";
+  const std::string key3 =
+      "0231c043ae680664a2c5df38cf0d8eab29f1b61ce93855040c613b2f41f7c036af";
+  TxInSizeTable::ClearDescriptorCache();
+
+  uint32_t size = 0;
+  uint32_t witness_size = 0;
+  uint32_t expect_witness_size = 0;
+  uint32_t expect_size = 0;
+
+  // 単一鍵はテーブル値と一致
+  EXPECT_TRUE(TxInSizeTable::GetDescriptorTxInSize(
+      "wpkh(" + key1 + ")", &size, &witness_size));
+  expect_size = TxInSizeTable::GetTxInSize(
+      AddressType::kP2wpkhAddress, &expect_witness_size);
+  EXPECT_EQ(size, expect_size);
+  EXPECT_EQ(witness_size, expect_witness_size);
+
+  // 2-of-3 p2wsh multisig
+  DescriptorTxInSizeData data;
+  std::string wsh_desc =
+      "wsh(multi(2," + key1 + "," + key2 + "," + key3 + "))";
+  EXPECT_TRUE(TxInSizeTable::GetDescriptorTxInSizeData(wsh_desc, &data));
+  EXPECT_EQ(data.address_type, AddressType::kP2wshAddress);
+  EXPECT_EQ(data.unlocking_script_size, static_cast<uint32_t>(0));
+  EXPECT_EQ(data.witness_size, static_cast<uint32_t>(254));
+  EXPECT_EQ(
+      data.locking_script.GetData().GetDataSize(), static_cast<size_t>(34));
+  EXPECT_TRUE(TxInSizeTable::GetDescriptorTxInSize(
+      wsh_desc, &size, &witness_size));
+  EXPECT_EQ(size, static_cast<uint32_t>(295));
+  EXPECT_EQ(witness_size, static_cast<uint32_t>(254));
+
+  // 2-of-2 p2sh multisig
+  EXPECT_TRUE(TxInSizeTable::GetDescriptorTxInSize(
+      "sh(multi(2," + key1 + "," + key2 + "))", &size, &witness_size));
+  EXPECT_EQ(size, static_cast<uint32_t>(260));
+  EXPECT_EQ(witness_size, static_cast<uint32_t>(0));
+
+  // 1-of-2 p2sh-p2wsh multisig
+  EXPECT_TRUE(TxInSizeTable::GetDescriptorTxInSize(
+      "sh(wsh(multi(1," + key1 + "," + key2 + ")))", &size, &witness_size));
+  EXPECT_EQ(size, static_cast<uint32_t>(223));
+  EXPECT_EQ(witness_size, static_cast<uint32_t>(147));
+
+  // p2sh-pkh / p2wsh-pkh は公開鍵のpushを含む
+  EXPECT_TRUE(TxInSizeTable::GetDescriptorTxInSize(
+      "sh(pkh(" + key1 + "))", &size, &witness_size));
+  EXPECT_EQ(size, static_cast<uint32_t>(174));
+  EXPECT_EQ(witness_size, static_cast<uint32_t>(0));
+  EXPECT_TRUE(TxInSizeTable::GetDescriptorTxInSize(
+      "wsh(pkh(" + key1 + "))", &size, &witness_size));
+  EXPECT_EQ(size, static_cast<uint32_t>(175));
+  EXPECT_EQ(witness_size, static_cast<uint32_t>(134));
+
+  // キャッシュ済みでも同じ結果を返す
+  EXPECT_TRUE(TxInSizeTable::GetDescriptorTxInSizeData(wsh_desc, &data));
+  EXPECT_EQ(data.witness_size, static_cast<uint32_t>(254));
+
+  // 解析不可・対象外
+  EXPECT_FALSE(TxInSizeTable::GetDescriptorTxInSize("", &size));
+  EXPECT_FALSE(TxInSizeTable::GetDescriptorTxInSize("unknown(00)", &size));
+  EXPECT_FALSE(TxInSizeTable::GetDescriptorTxInSize("unknown(00)", &size));
+  EXPECT_FALSE(
+      TxInSizeTable::GetDescriptorTxInSize("pk(" + key1 + ")", &size));
+  TxInSizeTable::ClearDescriptorCache();
+}
@@ -0,0 +1,644 @@
+#include "gtest/gtest.h"
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "cfd/cfd_address.h"
+#include "cfd/cfd_common.h"
+#include "cfd/cfd_elements_address.h"
+#include "cfd/cfd_elements_transaction.h"
+#include "cfd/cfd_transaction.h"
+#include "cfd/cfd_utxo.h"
+#include "cfd/cfdapi_coin.h"
+#include "cfd/cfdapi_elements_transaction.h"
+#include "cfd/cfdapi_transaction.h"
+#include "cfdcore/cfdcore_address.h"
+#include "cfdcore/cfdcore_amount.h"
+#include "cfdcore/cfdcore_bytedata.h"
+#include "cfdcore/cfdcore_exception.h"
+#include "cfdcore/cfdcore_key.h"
+
+using cfd::AddressFactory;
+using cfd::CoinSelectionOption;
+using cfd::TransactionController;
+using cfd::UtxoIndex;
+using cfd::api::CoinApi;
+using cfd::api::TransactionApi;
+using cfd::api::UtxoData;
+using cfd::core::Address;
+using cfd::core::Amount;
+using cfd::core::ByteData256;
+using cfd::core::CfdException;
+using cfd::core::NetType;
+using cfd::core::Pubkey;
+using cfd::core::Txid;
+
+static const std::string kFundPubkey =
+    "027592aab5d43618dda13fba71e3993cd7517a712d3da49664c06ee1bd3d1f70af";
+
+/**
+ * @brief FundRawTransactions用のUTXO一覧を作成する.
+ * @param[in] count     件数
+ * @param[in] amount    1件あたりのamount
+ * @return utxo list
+ */
+static std::vector<UtxoData> GetFundUtxoDataList(
+    uint32_t count, int64_t amount) {
+  Address address = AddressFactory(NetType::kRegtest).CreateP2wpkhAddress(
+      Pubkey(kFundPubkey));
+  std::vector<UtxoData> utxos(count);
+  for (uint32_t index = 0; index < count; ++index) {
+    std::vector<uint8_t> txid_bytes(32, static_cast<uint8_t>(index + 1));
+    utxos[index].block_height = 0;
+    utxos[index].txid = Txid(ByteData256(txid_bytes));
+    utxos[index].vout = index;
+    utxos[index].locking_script = address.GetLockingScript();
+    utxos[index].address = address;
+    utxos[index].descriptor = "wpkh(" + kFundPubkey + ")";
+    utxos[index].amount = Amount::CreateBySatoshiAmount(amount);
+    utxos[index].binary_data = nullptr;
+  }
+  return utxos;
+}
+
+/**
+ * @brief TxOutを1件持つtransactionを作成する.
+ * @param[in] amount    TxOutのamount
+ * @param[in] utxo      設定済みとするTxInのUTXO (nullptr可)
+ * @return tx hex
+ */
+/**
+ * @brief UTXO一覧の奇数番目をp2sh-p2wpkhに変更する.
+ * @param[in,out] utxos   utxo list
+ */
+static void SetFundP2shP2wpkhUtxo(std::vector<UtxoData>* utxos) {
+  AddressFactory factory(NetType::kRegtest);
+  Address wpkh_address = factory.CreateP2wpkhAddress(Pubkey(kFundPubkey));
+  Address address = factory.CreateP2shAddress(wpkh_address.GetLockingScript());
+  for (size_t index = 1; index < utxos->size(); index += 2) {
+    (*utxos)[index].locking_script = address.GetLockingScript();
+    (*utxos)[index].address = address;
+    (*utxos)[index].descriptor = "sh(wpkh(" + kFundPubkey + "))";
+  }
+}
+
+/**
+ * @brief FundRawTransaction用のオプションを作成する.
+ * @param[in] fee_rate    fee rate
+ * @return option
+ */
+static CoinSelectionOption GetFundOption(double fee_rate) {
+  CoinSelectionOption option;
+  option.InitializeTxSizeInfo();
+  option.SetEffectiveFeeBaserate(fee_rate);
+  option.SetLongTermFeeBaserate(fee_rate);
+  option.SetRandomSeed(1);
+  return option;
+}
+
+static std::string GetFundTxHex(
+    int64_t amount, const UtxoData* utxo = nullptr) {
+  Address address = AddressFactory(NetType::kRegtest).CreateP2wpkhAddress(
+      Pubkey(kFundPubkey));
+  TransactionController txc(2, 0);
+  if (utxo != nullptr) txc.AddTxIn(utxo->txid, utxo->vout);
+  txc.AddTxOut(address, Amount::CreateBySatoshiAmount(amount));
+  return txc.GetHex();
+}
+
+/**
+ * @brief 処理で発生した例外のエラー情報を取得する.
+ * @param[in] function    実行する処理
+ * @return "エラーコード:メッセージ" (例外が発生しない場合は空文字列)
+ */
+static std::string GetExceptionInfo(const std::function<void()>& function) {
+  try {
+    function();
+  } catch (const CfdException& except) {
+    return std::to_string(except.GetErrorCode()) + ":" + except.what();
+  }
+  return "";
+}
+
+TEST(TransactionApi, FundRawTransactions_disjoint_inputs)
+{
+  std::vector<UtxoData> utxos = GetFundUtxoDataList(6, 1000000);
+  std::string reserve_address = utxos[0].address.GetAddress();
+  std::vector<std::string> tx_hex_list = {
+      GetFundTxHex(1500000), GetFundTxHex(1500000)};
+
+  TransactionApi api;
+  std::vector<TransactionController> txs;
+  std::vector<Amount> fees;
+  EXPECT_NO_THROW((txs = api.FundRawTransactions(
+      tx_hex_list, utxos, reserve_address, 2.0, &fees, nullptr, nullptr,
+      nullptr, NetType::kRegtest)));
+  ASSERT_EQ(txs.size(), static_cast<size_t>(2));
+  ASSERT_EQ(fees.size(), static_cast<size_t>(2));
+
+  // 各txは共有UTXOから収集し、同一のUTXOを利用しないこと
+  std::set<std::string> outpoints;
+  size_t txin_count = 0;
+  for (size_t index = 0; index < txs.size(); ++index) {
+    EXPECT_GT(fees[index].GetSatoshiValue(), 0);
+    const auto& txin_list = txs[index].GetTransaction().GetTxInList();
+    EXPECT_GE(txin_list.size(), static_cast<size_t>(2));
+    for (const auto& txin : txin_list) {
+      outpoints.insert(
+          txin.GetTxid().GetHex() + ":" + std::to_string(txin.GetVout()));
+      ++txin_count;
+    }
+  }
+  EXPECT_EQ(outpoints.size(), txin_count);
+}
+
+TEST(TransactionApi, FundRawTransactions_preselected_txin)
+{
+  std::vector<UtxoData> utxos = GetFundUtxoDataList(4, 1000000);
+  std::string reserve_address = utxos[0].address.GetAddress();
+  // 1件目は共有UTXOに含まれるTxInを設定済み
+  std::vector<std::string> tx_hex_list = {
+      GetFundTxHex(500000, &utxos[0]), GetFundTxHex(1500000)};
+
+  TransactionApi api;
+  std::vector<TransactionController> txs;
+  std::vector<Amount> fees;
+  EXPECT_NO_THROW((txs = api.FundRawTransactions(
+      tx_hex_list, utxos, reserve_address, 2.0, &fees, nullptr, nullptr,
+      nullptr, NetType::kRegtest)));
+  ASSERT_EQ(txs.size(), static_cast<size_t>(2));
+  ASSERT_EQ(fees.size(), static_cast<size_t>(2));
+
+  // 設定済みTxInで足りるため追加収集せず、お釣りを設定すること
+  const auto& txin_list = txs[0].GetTransaction().GetTxInList();
+  ASSERT_EQ(txin_list.size(), static_cast<size_t>(1));
+  EXPECT_EQ(txin_list[0].GetTxid().GetHex(), utxos[0].txid.GetHex());
+  EXPECT_EQ(txs[0].GetTransaction().GetTxOutCount(), static_cast<uint32_t>(2));
+  EXPECT_GT(fees[0].GetSatoshiValue(), 0);
+
+  // 設定済みTxInのUTXOは他のtxで収集しないこと
+  EXPECT_GE(
+      txs[1].GetTransaction().GetTxInList().size(), static_cast<size_t>(2));
+  for (const auto& txin : txs[1].GetTransaction().GetTxInList()) {
+    EXPECT_FALSE(
+        (txin.GetTxid().GetHex() == utxos[0].txid.GetHex()) &&
+        (txin.GetVout() == utxos[0].vout));
+  }
+}
+
+TEST(TransactionApi, FundRawTransactions_duplicate_preselected_txin)
+{
+  std::vector<UtxoData> utxos = GetFundUtxoDataList(4, 1000000);
+  std::string reserve_address = utxos[0].address.GetAddress();
+  // 2件のtxに同一のUTXOを設定済み
+  std::vector<std::string> tx_hex_list = {
+      GetFundTxHex(500000, &utxos[1]), GetFundTxHex(500000, &utxos[1])};
+
+  TransactionApi api;
+  EXPECT_THROW(
+      api.FundRawTransactions(
+          tx_hex_list, utxos, reserve_address, 2.0, nullptr, nullptr,
+          nullptr, nullptr, NetType::kRegtest),
+      CfdException);
+}
+
+TEST(TransactionApi, FundRawTransactions_outpoint_already_used)
+{
+  std::vector<UtxoData> utxos = GetFundUtxoDataList(4, 1000000);
+  std::string reserve_address = utxos[0].address.GetAddress();
+  // 3件目のtxが、先行するtxで使用済みのOutPointを設定済み
+  std::vector<std::string> tx_hex_list = {
+      GetFundTxHex(500000, &utxos[2]), GetFundTxHex(1500000),
+      GetFundTxHex(300000, &utxos[2])};
+
+  TransactionApi api;
+  try {
+    api.FundRawTransactions(
+        tx_hex_list, utxos, reserve_address, 2.0, nullptr, nullptr, nullptr,
+        nullptr, NetType::kRegtest);
+    FAIL() << "Expected CfdException.";
+  } catch (const CfdException& except) {
+    EXPECT_EQ(
+        except.GetErrorCode(), cfd::core::CfdError::kCfdIllegalArgumentError);
+    EXPECT_STREQ(except.what(), "utxo is already used.");
+  }
+}
+
+TEST(TransactionApi, FundRawTransaction_utxo_index)
+{
+  std::vector<UtxoData> utxos = GetFundUtxoDataList(6, 400000);
+  SetFundP2shP2wpkhUtxo(&utxos);
+  std::string reserve_address = utxos[0].address.GetAddress();
+  CoinSelectionOption option = GetFundOption(20.0);
+  CoinApi coin_api;
+  UtxoIndex utxo_index;
+  for (const auto& utxo : utxos) coin_api.AddUtxo(utxo, &utxo_index);
+
+  // UTXO一覧とUTXOインデックスは同一のtx・feeとなること
+  TransactionApi api;
+  std::vector<std::string> tx_hex_list = {
+      GetFundTxHex(300000), GetFundTxHex(1000000)};
+  for (const auto& tx_hex : tx_hex_list) {
+    Amount fee;
+    Amount index_fee;
+    TransactionController txc = api.FundRawTransaction(
+        tx_hex, utxos, Amount(), {}, reserve_address, 20.0, &fee, nullptr,
+        &option, nullptr, NetType::kRegtest);
+    TransactionController index_txc = api.FundRawTransaction(
+        tx_hex, &utxo_index, Amount(), {}, reserve_address, 20.0,
+        &index_fee, nullptr, &option, nullptr, NetType::kRegtest);
+    EXPECT_EQ(txc.GetHex(), index_txc.GetHex());
+    EXPECT_EQ(fee.GetSatoshiValue(), index_fee.GetSatoshiValue());
+    EXPECT_GT(fee.GetSatoshiValue(), 0);
+  }
+
+  // 設定済みTxInがある場合も一致すること
+  std::vector<UtxoData> selected_utxos = {utxos[1]};
+  std::string tx_hex = GetFundTxHex(600000, &utxos[1]);
+  Amount fee;
+  Amount index_fee;
+  TransactionController txc = api.FundRawTransaction(
+      tx_hex, utxos, Amount(), selected_utxos, reserve_address, 20.0, &fee,
+      nullptr, &option, nullptr, NetType::kRegtest);
+  TransactionController index_txc = api.FundRawTransaction(
+      tx_hex, &utxo_index, Amount(), selected_utxos, reserve_address, 20.0,
+      &index_fee, nullptr, &option, nullptr, NetType::kRegtest);
+  EXPECT_EQ(txc.GetHex(), index_txc.GetHex());
+  EXPECT_EQ(fee.GetSatoshiValue(), index_fee.GetSatoshiValue());
+}
+
+TEST(TransactionApi, EstimateFee_controller)
+{
+  std::vector<UtxoData> utxos = GetFundUtxoDataList(4, 1000000);
+  SetFundP2shP2wpkhUtxo(&utxos);
+  std::string tx_hex = GetFundTxHex(1500000, &utxos[0]);
+  TransactionController txc(tx_hex);
+
+  // tx hexとcontrollerは同一のfeeとなること
+  TransactionApi api;
+  for (double fee_rate : {1.0, 2.0, 20.0}) {
+    Amount tx_fee;
+    Amount utxo_fee;
+    Amount txc_tx_fee;
+    Amount txc_utxo_fee;
+    Amount fee = api.EstimateFee(tx_hex, utxos, &tx_fee, &utxo_fee, fee_rate);
+    Amount txc_fee = api.EstimateFee(
+        txc, utxos, &txc_tx_fee, &txc_utxo_fee, fee_rate);
+    EXPECT_EQ(fee.GetSatoshiValue(), txc_fee.GetSatoshiValue());
+    EXPECT_EQ(tx_fee.GetSatoshiValue(), txc_tx_fee.GetSatoshiValue());
+    EXPECT_EQ(utxo_fee.GetSatoshiValue(), txc_utxo_fee.GetSatoshiValue());
+    EXPECT_GT(utxo_fee.GetSatoshiValue(), 0);
+  }
+  EXPECT_EQ(
+      api.EstimateFee(tx_hex, {}).GetSatoshiValue(),
+      api.EstimateFee(txc, {}).GetSatoshiValue());
+  // controllerは更新しないこと
+  EXPECT_EQ(txc.GetHex(), tx_hex);
+}
+
+TEST(TransactionApi, FundRawTransaction_controller)
+{
+  std::vector<UtxoData> utxos = GetFundUtxoDataList(6, 400000);
+  SetFundP2shP2wpkhUtxo(&utxos);
+  std::string reserve_address = utxos[0].address.GetAddress();
+  CoinSelectionOption option = GetFundOption(20.0);
+  CoinApi coin_api;
+  UtxoIndex utxo_index;
+  for (const auto& utxo : utxos) coin_api.AddUtxo(utxo, &utxo_index);
+
+  // tx hexとcontrollerは同一のtx・fee・追加アドレスとなること
+  TransactionApi api;
+  std::vector<UtxoData> selected_utxos = {utxos[1]};
+  std::vector<std::string> tx_hex_list = {
+      GetFundTxHex(300000), GetFundTxHex(1000000),
+      GetFundTxHex(600000, &utxos[1])};
+  for (const auto& tx_hex : tx_hex_list) {
+    Amount fee;
+    Amount txc_fee;
+    std::vector<std::string> addresses;
+    std::vector<std::string> txc_addresses;
+    TransactionController result_txc = api.FundRawTransaction(
+        tx_hex, utxos, Amount(), selected_utxos, reserve_address, 20.0, &fee,
+        nullptr, &option, &addresses, NetType::kRegtest);
+    TransactionController txc(tx_hex);
+    api.FundRawTransaction(
+        &txc, utxos, Amount(), selected_utxos, reserve_address, 20.0,
+        &txc_fee, nullptr, &option, &txc_addresses, NetType::kRegtest);
+    EXPECT_EQ(result_txc.GetHex(), txc.GetHex());
+    EXPECT_EQ(fee.GetSatoshiValue(), txc_fee.GetSatoshiValue());
+    EXPECT_EQ(addresses, txc_addresses);
+    EXPECT_GT(fee.GetSatoshiValue(), 0);
+
+    // UTXOインデックスを利用する場合も一致すること
+    Amount index_fee;
+    Amount index_txc_fee;
+    TransactionController index_result_txc = api.FundRawTransaction(
+        tx_hex, &utxo_index, Amount(), selected_utxos, reserve_address, 20.0,
+        &index_fee, nullptr, &option, nullptr, NetType::kRegtest);
+    TransactionController index_txc(tx_hex);
+    api.FundRawTransaction(
+        &index_txc, &utxo_index, Amount(), selected_utxos, reserve_address,
+        20.0, &index_txc_fee, nullptr, &option, nullptr, NetType::kRegtest);
+    EXPECT_EQ(index_result_txc.GetHex(), index_txc.GetHex());
+    EXPECT_EQ(index_fee.GetSatoshiValue(), index_txc_fee.GetSatoshiValue());
+  }
+}
+
+TEST(TransactionApi, FundRawTransaction_controller_error)
+{
+  std::vector<UtxoData> utxos = GetFundUtxoDataList(6, 400000);
+  std::string reserve_address = utxos[0].address.GetAddress();
+  CoinSelectionOption option = GetFundOption(20.0);
+  CoinApi coin_api;
+  UtxoIndex utxo_index;
+  for (const auto& utxo : utxos) coin_api.AddUtxo(utxo, &utxo_index);
+
+  // 収集額が不足する場合、tx hexとcontrollerは同一のエラーとなること
+  TransactionApi api;
+  std::string tx_hex = GetFundTxHex(10000000);
+  std::string error_info = GetExceptionInfo([&]() {
+    api.FundRawTransaction(
+        tx_hex, utxos, Amount(), {}, reserve_address, 20.0, nullptr, nullptr,
+        &option, nullptr, NetType::kRegtest);
+  });
+  EXPECT_FALSE(error_info.empty());
+  EXPECT_EQ(error_info, GetExceptionInfo([&]() {
+    TransactionController txc(tx_hex);
+    api.FundRawTransaction(
+        &txc, utxos, Amount(), {}, reserve_address, 20.0, nullptr, nullptr,
+        &option, nullptr, NetType::kRegtest);
+  }));
+  std::string index_error_info = GetExceptionInfo([&]() {
+    api.FundRawTransaction(
+        tx_hex, &utxo_index, Amount(), {}, reserve_address, 20.0, nullptr,
+        nullptr, &option, nullptr, NetType::kRegtest);
+  });
+  EXPECT_FALSE(index_error_info.empty());
+  EXPECT_EQ(index_error_info, GetExceptionInfo([&]() {
+    TransactionController txc(tx_hex);
+    api.FundRawTransaction(
+        &txc, &utxo_index, Amount(), {}, reserve_address, 20.0, nullptr,
+        nullptr, &option, nullptr, NetType::kRegtest);
+  }));
+
+  // UTXOインデックスの未指定は同一のエラーとなること
+  UtxoIndex* empty_index = nullptr;
+  index_error_info = GetExceptionInfo([&]() {
+    api.FundRawTransaction(
+        tx_hex, empty_index, Amount(), {}, reserve_address, 20.0, nullptr,
+        nullptr, &option, nullptr, NetType::kRegtest);
+  });
+  EXPECT_EQ(index_error_info, GetExceptionInfo([&]() {
+    TransactionController txc(tx_hex);
+    api.FundRawTransaction(
+        &txc, empty_index, Amount(), {}, reserve_address, 20.0, nullptr,
+        nullptr, &option, nullptr, NetType::kRegtest);
+  }));
+  EXPECT_EQ(
+      index_error_info,
+      std::to_string(cfd::core::CfdError::kCfdIllegalArgumentError) +
+          ":utxo_index is null.");
+
+  // controllerの未指定はエラーとなること
+  TransactionController* empty_txc = nullptr;
+  EXPECT_EQ(
+      GetExceptionInfo([&]() {
+        api.FundRawTransaction(
+            empty_txc, utxos, Amount(), {}, reserve_address, 20.0, nullptr,
+            nullptr, &option, nullptr, NetType::kRegtest);
+      }),
+      std::to_string(cfd::core::CfdError::kCfdIllegalArgumentError) +
+          ":txc is null.");
+  EXPECT_EQ(
+      GetExceptionInfo([&]() {
+        api.FundRawTransaction(
+            empty_txc, &utxo_index, Amount(), {}, reserve_address, 20.0,
+            nullptr, nullptr, &option, nullptr, NetType::kRegtest);
+      }),
+      std::to_string(cfd::core::CfdError::kCfdIllegalArgumentError) +
+          ":txc is null.");
+}
+
+#ifndef CFD_DISABLE_ELEMENTS
+TEST(ElementsTransactionApi, FundRawTransaction_utxo_index)
+{
+  using cfd::ConfidentialTransactionController;
+  using cfd::ElementsAddressFactory;
+  using cfd::api::ElementsTransactionApi;
+  using cfd::api::ElementsUtxoAndOption;
+  using cfd::core::ConfidentialAssetId;
+  const ConfidentialAssetId asset(
+      "aa00000000000000000000000000000000000000000000000000000000000000");
+  Address address = ElementsAddressFactory(NetType::kElementsRegtest)
+                        .CreateP2wpkhAddress(Pubkey(kFundPubkey));
+  std::vector<UtxoData> utxos = GetFundUtxoDataList(6, 400000);
+  SetFundP2shP2wpkhUtxo(&utxos);
+  for (auto& utxo : utxos) {
+    utxo.address = Address();
+    utxo.asset = asset;
+  }
+  std::map<std::string, std::string> reserve_address = {
+      {asset.GetHex(), address.GetAddress()}};
+  CoinSelectionOption option = GetFundOption(0.1);
+  option.InitializeConfidentialTxSizeInfo();
+  CoinApi coin_api;
+  UtxoIndex utxo_index;
+  for (const auto& utxo : utxos) coin_api.AddUtxo(utxo, &utxo_index);
+
+  // UTXO一覧とUTXOインデックスは同一のtx・feeとなること
+  ElementsTransactionApi api;
+  for (int64_t amount : {300000, 1000000}) {
+    ConfidentialTransactionController base_txc(2, 0);
+    base_txc.AddTxOut(address, Amount::CreateBySatoshiAmount(amount), asset);
+    std::string tx_hex = base_txc.GetHex();
+    Amount fee;
+    Amount index_fee;
+    ConfidentialTransactionController txc = api.FundRawTransaction(
+        tx_hex, utxos, {}, {}, reserve_address, asset, true, 0.1, &fee,
+        nullptr, &option, nullptr, NetType::kElementsRegtest);
+    ConfidentialTransactionController index_txc = api.FundRawTransaction(
+        tx_hex, &utxo_index, {}, {}, reserve_address, asset, true, 0.1,
+        &index_fee, nullptr, &option, nullptr, NetType::kElementsRegtest);
+    EXPECT_EQ(txc.GetHex(), index_txc.GetHex());
+    EXPECT_EQ(fee.GetSatoshiValue(), index_fee.GetSatoshiValue());
+    EXPECT_GT(fee.GetSatoshiValue(), 0);
+  }
+}
+
+TEST(ElementsTransactionApi, EstimateFee_controller)
+{
+  using cfd::ConfidentialTransactionController;
+  using cfd::ElementsAddressFactory;
+  using cfd::api::ElementsTransactionApi;
+  using cfd::api::ElementsUtxoAndOption;
+  using cfd::core::ConfidentialAssetId;
+  const ConfidentialAssetId asset(
+      "aa00000000000000000000000000000000000000000000000000000000000000");
+  Address address = ElementsAddressFactory(NetType::kElementsRegtest)
+                        .CreateP2wpkhAddress(Pubkey(kFundPubkey));
+  std::vector<UtxoData> utxo_list = GetFundUtxoDataList(4, 400000);
+  SetFundP2shP2wpkhUtxo(&utxo_list);
+  std::vector<ElementsUtxoAndOption> utxos;
+  for (auto& utxo : utxo_list) {
+    utxo.address = Address();
+    utxo.asset = asset;
+    ElementsUtxoAndOption utxo_data = {};
+    utxo_data.utxo = utxo;
+    utxos.push_back(utxo_data);
+  }
+  utxos[1].is_issuance = true;
+
+  // fee出力の有無に関わらず、tx hexとcontrollerは同一のfeeとなること
+  ConfidentialTransactionController base_txc(2, 0);
+  base_txc.AddTxIn(utxo_list[0].txid, utxo_list[0].vout);
+  base_txc.AddTxOut(address, Amount::CreateBySatoshiAmount(300000), asset);
+  ConfidentialTransactionController fee_txc(base_txc);
+  fee_txc.AddTxOutFee(Amount::CreateBySatoshiAmount(1000), asset);
+  ElementsTransactionApi api;
+  for (const auto* txc : {&base_txc, &fee_txc}) {
+    std::string tx_hex = txc->GetHex();
+    for (bool is_blind : {true, false}) {
+      Amount tx_fee;
+      Amount utxo_fee;
+      Amount txc_tx_fee;
+      Amount txc_utxo_fee;
+      Amount fee = api.EstimateFee(
+          tx_hex, utxos, asset, &tx_fee, &utxo_fee, is_blind, 0.15);
+      Amount txc_fee = api.EstimateFee(
+          *txc, utxos, asset, &txc_tx_fee, &txc_utxo_fee, is_blind, 0.15);
+      EXPECT_EQ(fee.GetSatoshiValue(), txc_fee.GetSatoshiValue());
+      EXPECT_EQ(tx_fee.GetSatoshiValue(), txc_tx_fee.GetSatoshiValue());
+      EXPECT_EQ(utxo_fee.GetSatoshiValue(), txc_utxo_fee.GetSatoshiValue());
+      EXPECT_GT(fee.GetSatoshiValue(), 0);
+
+      const uint64_t fee_rate = 150;
+      EXPECT_EQ(
+          api.EstimateFee(tx_hex, utxos, asset, nullptr, nullptr, is_blind,
+                          fee_rate).GetSatoshiValue(),
+          api.EstimateFee(*txc, utxos, asset, nullptr, nullptr, is_blind,
+                          fee_rate).GetSatoshiValue());
+    }
+    // controllerは更新しないこと
+    EXPECT_EQ(txc->GetHex(), tx_hex);
+  }
+
+  // fee assetの未指定は同一のエラーとなること
+  std::string tx_hex = base_txc.GetHex();
+  std::string error_info = GetExceptionInfo([&]() {
+    api.EstimateFee(
+        tx_hex, utxos, ConfidentialAssetId(), nullptr, nullptr, true, 0.15);
+  });
+  EXPECT_EQ(
+      error_info,
+      std::to_string(cfd::core::CfdError::kCfdIllegalArgumentError) +
+          ":Empty fee asset.");
+  EXPECT_EQ(error_info, GetExceptionInfo([&]() {
+    api.EstimateFee(
+        base_txc, utxos, ConfidentialAssetId(), nullptr, nullptr, true, 0.15);
+  }));
+}
+
+TEST(ElementsTransactionApi, FundRawTransaction_controller)
+{
+  using cfd::ConfidentialTransactionController;
+  using cfd::ElementsAddressFactory;
+  using cfd::api::ElementsTransactionApi;
+  using cfd::core::ConfidentialAssetId;
+  const ConfidentialAssetId asset(
+      "aa00000000000000000000000000000000000000000000000000000000000000");
+  Address address = ElementsAddressFactory(NetType::kElementsRegtest)
+                        .CreateP2wpkhAddress(Pubkey(kFundPubkey));
+  std::vector<UtxoData> utxos = GetFundUtxoDataList(6, 400000);
+  SetFundP2shP2wpkhUtxo(&utxos);
+  for (auto& utxo : utxos) {
+    utxo.address = Address();
+    utxo.asset = asset;
+  }
+  std::map<std::string, std::string> reserve_address = {
+      {asset.GetHex(), address.GetAddress()}};
+  CoinSelectionOption option = GetFundOption(0.1);
+  option.InitializeConfidentialTxSizeInfo();
+  CoinApi coin_api;
+  UtxoIndex utxo_index;
+  for (const auto& utxo : utxos) coin_api.AddUtxo(utxo, &utxo_index);
+
+  // tx hexとcontrollerは同一のtx・fee・追加アドレスとなること
+  ElementsTransactionApi api;
+  for (int64_t amount : {300000, 1000000}) {
+    ConfidentialTransactionController base_txc(2, 0);
+    base_txc.AddTxOut(address, Amount::CreateBySatoshiAmount(amount), asset);
+    std::string tx_hex = base_txc.GetHex();
+    Amount fee;
+    Amount txc_fee;
+    std::vector<std::string> addresses;
+    std::vector<std::string> txc_addresses;
+    ConfidentialTransactionController result_txc = api.FundRawTransaction(
+        tx_hex, utxos, {}, {}, reserve_address, asset, true, 0.1, &fee,
+        nullptr, &option, &addresses, NetType::kElementsRegtest);
+    ConfidentialTransactionController txc(tx_hex);
+    api.FundRawTransaction(
+        &txc, utxos, {}, {}, reserve_address, asset, true, 0.1, &txc_fee,
+        nullptr, &option, &txc_addresses, NetType::kElementsRegtest);
+    EXPECT_EQ(result_txc.GetHex(), txc.GetHex());
+    EXPECT_EQ(fee.GetSatoshiValue(), txc_fee.GetSatoshiValue());
+    EXPECT_EQ(addresses, txc_addresses);
+    EXPECT_GT(fee.GetSatoshiValue(), 0);
+
+    // UTXOインデックスを利用する場合も一致すること
+    Amount index_fee;
+    Amount index_txc_fee;
+    ConfidentialTransactionController index_result_txc =
+        api.FundRawTransaction(
+            tx_hex, &utxo_index, {}, {}, reserve_address, asset, true, 0.1,
+            &index_fee, nullptr, &option, nullptr, NetType::kElementsRegtest);
+    ConfidentialTransactionController index_txc(tx_hex);
+    api.FundRawTransaction(
+        &index_txc, &utxo_index, {}, {}, reserve_address, asset, true, 0.1,
+        &index_txc_fee, nullptr, &option, nullptr, NetType::kElementsRegtest);
+    EXPECT_EQ(index_result_txc.GetHex(), index_txc.GetHex());
+    EXPECT_EQ(index_fee.GetSatoshiValue(), index_txc_fee.GetSatoshiValue());
+  }
+
+  // 収集額が不足する場合、tx hexとcontrollerは同一のエラーとなること
+  ConfidentialTransactionController base_txc(2, 0);
+  base_txc.AddTxOut(address, Amount::CreateBySatoshiAmount(10000000), asset);
+  std::string tx_hex = base_txc.GetHex();
+  std::string error_info = GetExceptionInfo([&]() {
+    api.FundRawTransaction(
+        tx_hex, utxos, {}, {}, reserve_address, asset, true, 0.1, nullptr,
+        nullptr, &option, nullptr, NetType::kElementsRegtest);
+  });
+  EXPECT_FALSE(error_info.empty());
+  EXPECT_EQ(error_info, GetExceptionInfo([&]() {
+    ConfidentialTransactionController txc(tx_hex);
+    api.FundRawTransaction(
+        &txc, utxos, {}, {}, reserve_address, asset, true, 0.1, nullptr,
+        nullptr, &option, nullptr, NetType::kElementsRegtest);
+  }));
+  std::string index_error_info = GetExceptionInfo([&]() {
+    api.FundRawTransaction(
+        tx_hex, &utxo_index, {}, {}, reserve_address, asset, true, 0.1,
+        nullptr, nullptr, &option, nullptr, NetType::kElementsRegtest);
+  });
+  EXPECT_FALSE(index_error_info.empty());
+  EXPECT_EQ(index_error_info, GetExceptionInfo([&]() {
+    ConfidentialTransactionController txc(tx_hex);
+    api.FundRawTransaction(
+        &txc, &utxo_index, {}, {}, reserve_address, asset, true, 0.1, nullptr,
+        nullptr, &option, nullptr, NetType::kElementsRegtest);
+  }));
+
+  // controllerの未指定はエラーとなること
+  ConfidentialTransactionController* empty_txc = nullptr;
+  EXPECT_EQ(
+      GetExceptionInfo([&]() {
+        api.FundRawTransaction(
+            empty_txc, utxos, {}, {}, reserve_address, asset, true, 0.1,
+            nullptr, nullptr, &option, nullptr, NetType::kElementsRegtest);
+      }),
+      std::to_string(cfd::core::CfdError::kCfdIllegalArgumentError) +
+          ":ctxc is null.");
+}
+#endif  // CFD_DISABLE_ELEMENTS
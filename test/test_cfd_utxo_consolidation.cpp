@@ -0,0 +1,346 @@
+#include "gtest/gtest.h"
+#include <vector>
+
+#include "cfd/cfd_address.h"
+#include "cfd/cfd_common.h"
+#include "cfd/cfd_elements_transaction.h"
+#include "cfd/cfd_fee.h"
+#include "cfd/cfd_transaction.h"
+#include "cfd/cfd_utxo.h"
+#include "cfd/cfd_utxo_consolidation.h"
+#include "cfdcore/cfdcore_address.h"
+#include "cfdcore/cfdcore_amount.h"
+#include "cfdcore/cfdcore_bytedata.h"
+#include "cfdcore/cfdcore_key.h"
+#include "cfdcore/cfdcore_transaction_common.h"
+
+using cfd::AddressFactory;
+using cfd::CoinSelectionOption;
+using cfd::FeeCalculator;
+using cfd::TransactionController;
+using cfd::TxInSizeTable;
+using cfd::TxSizeModel;
+using cfd::Utxo;
+using cfd::UtxoConsolidationPlan;
+using cfd::UtxoConsolidationPlanner;
+using cfd::core::AbstractTransaction;
+using cfd::core::Address;
+using cfd::core::AddressType;
+using cfd::core::Amount;
+using cfd::core::ByteData;
+using cfd::core::ByteData256;
+using cfd::core::NetType;
+using cfd::core::Pubkey;
+using cfd::core::TxIn;
+using cfd::core::Txid;
+#ifndef CFD_DISABLE_ELEMENTS
+using cfd::ConfidentialTransactionController;
+using cfd::core::ConfidentialAssetId;
+#endif  // CFD_DISABLE_ELEMENTS
+
+/**
+ * @brief 集約テスト用のUTXOを作成する.
+ * @param[in] vout              vout
+ * @param[in] amount            amount
+ * @param[in] witness_size_max  witness size
+ * @return utxo
+ */
+static Utxo GetConsolidationUtxo(
+    uint32_t vout, uint64_t amount, uint16_t witness_size_max = 108) {
+  Utxo utxo;
+  memset(&utxo, 0, sizeof(utxo));
+  utxo.txid[0] = static_cast<uint8_t>(vout + 1);
+  utxo.vout = vout;
+  utxo.amount = amount;
+  utxo.witness_size_max = witness_size_max;
+  return utxo;
+}
+
+/**
+ * @brief 集約先addressを取得する.
+ * @return p2wpkh address
+ */
+static Address GetConsolidationAddress() {
+  return AddressFactory(NetType::kRegtest).CreateP2wpkhAddress(Pubkey(
+      "027592aab5d43618dda13fba71e3993cd7517a712d3da49664c06ee1bd3d1f70af"));
+}
+
+/**
+ * @brief UTXOのTxidを取得する.
+ * @param[in] utxo    utxo
+ * @return txid
+ */
+static Txid GetConsolidationTxid(const Utxo& utxo) {
+  return Txid(ByteData256(
+      std::vector<uint8_t>(utxo.txid, utxo.txid + sizeof(utxo.txid))));
+}
+
+/**
+ * @brief 集約transactionのvsize・feeが計画と一致することを確認する.
+ * @details 各TxInにUTXOの推定サイズと同じサイズのwitnessを設定して比較する。
+ * @param[in] plan      集約計画
+ * @param[in] txs       集約transaction一覧
+ * @param[in] baserate  fee baserate
+ */
+static void CheckConsolidationTransactions(
+    const UtxoConsolidationPlan& plan,
+    const std::vector<TransactionController>& txs, uint64_t baserate) {
+  FeeCalculator fee_calc(baserate);
+  ASSERT_EQ(plan.transactions.size(), txs.size());
+  for (size_t index = 0; index < txs.size(); ++index) {
+    const auto& tx = plan.transactions[index];
+    TransactionController txc = txs[index];
+    for (const auto& utxo : tx.utxos) {
+      // witness件数(1byte) + 要素のサイズ(1byte) + 要素
+      std::vector<ByteData> witness_stack = {
+          ByteData(std::vector<uint8_t>(utxo.witness_size_max - 2))};
+      txc.AddWitnessStack(
+          GetConsolidationTxid(utxo), utxo.vout, witness_stack);
+    }
+    EXPECT_EQ(txc.GetTransaction().GetVsize(), tx.vsize);
+    EXPECT_EQ(
+        static_cast<int64_t>(tx.fee),
+        fee_calc.GetFee(txc.GetTransaction().GetVsize()).GetSatoshiValue());
+    ASSERT_EQ(txc.GetTransaction().GetTxOutCount(), static_cast<uint32_t>(1));
+    EXPECT_EQ(
+        txc.GetTransaction().GetTxOut(0).GetValue().GetSatoshiValue(),
+        static_cast<int64_t>(tx.input_amount - tx.fee));
+  }
+}
+
+/**
+ * @brief 集約計画の整合性を確認する.
+ * @param[in] plan      集約計画
+ * @param[in] baserate  fee baserate
+ */
+static void CheckConsolidationPlan(
+    const UtxoConsolidationPlan& plan, uint64_t baserate) {
+  FeeCalculator fee_calc(baserate);
+  size_t removed_count = 0;
+  uint64_t total_fee = 0;
+  for (const auto& tx : plan.transactions) {
+    EXPECT_GE(tx.utxos.size(), static_cast<size_t>(2));
+    uint64_t input_amount = 0;
+    for (const auto& utxo : tx.utxos) {
+      input_amount += utxo.amount;
+    }
+    EXPECT_EQ(tx.input_amount, input_amount);
+    EXPECT_EQ(tx.output_amount + tx.fee, tx.input_amount);
+    EXPECT_EQ(
+        static_cast<int64_t>(tx.fee),
+        fee_calc.GetFee(tx.vsize).GetSatoshiValue());
+    removed_count += tx.utxos.size() - 1;
+    total_fee += tx.fee;
+  }
+  EXPECT_EQ(plan.removed_count, removed_count);
+  EXPECT_EQ(plan.total_fee, total_fee);
+}
+
+TEST(UtxoConsolidationPlanner, Plan)
+{
+  std::vector<Utxo> utxos;
+  for (uint32_t index = 0; index < 16; ++index) {
+    utxos.push_back(GetConsolidationUtxo(index, 20000 - index * 100));
+  }
+  // weightの大きいUTXO
+  for (uint32_t index = 16; index < 20; ++index) {
+    utxos.push_back(GetConsolidationUtxo(index, 1000, 250));
+  }
+  // feeを下回るUTXO
+  utxos.push_back(GetConsolidationUtxo(20, 50));
+
+  CoinSelectionOption option;
+  option.InitializeTxSizeInfo();
+  option.SetEffectiveFeeBaserate(1);
+  option.SetMaxInputCount(5);
+  UtxoConsolidationPlanner planner(option);
+
+  UtxoConsolidationPlan plan = planner.Plan(utxos, 11);
+  CheckConsolidationPlan(plan, option.GetEffectiveFeeBaserate());
+  ASSERT_EQ(plan.transactions.size(), static_cast<size_t>(3));
+  EXPECT_EQ(plan.transactions[0].utxos.size(), static_cast<size_t>(5));
+  EXPECT_EQ(plan.transactions[1].utxos.size(), static_cast<size_t>(5));
+  EXPECT_EQ(plan.transactions[2].utxos.size(), static_cast<size_t>(3));
+  EXPECT_EQ(plan.removed_count, static_cast<size_t>(10));
+  EXPECT_EQ(plan.remaining_pool_size, static_cast<size_t>(11));
+  // weightの小さいUTXOを少額から順に集約する
+  EXPECT_EQ(plan.transactions[0].utxos[0].amount, static_cast<uint64_t>(18500));
+  for (const auto& tx : plan.transactions) {
+    for (const auto& utxo : tx.utxos) {
+      EXPECT_EQ(utxo.witness_size_max, 108);
+    }
+  }
+
+  // 作成したtransactionのvsize・feeと一致すること
+  CheckConsolidationTransactions(
+      plan, planner.CreateTransactions(plan, GetConsolidationAddress()),
+      option.GetEffectiveFeeBaserate());
+
+  // 目標値を満たしている場合は集約しない
+  plan = planner.Plan(utxos, utxos.size());
+  EXPECT_TRUE(plan.transactions.empty());
+  EXPECT_EQ(plan.removed_count, static_cast<size_t>(0));
+  EXPECT_EQ(plan.remaining_pool_size, utxos.size());
+
+  // 対象UTXOが不足する場合は可能な範囲で集約する
+  option.SetMaxInputCount(0);
+  plan = UtxoConsolidationPlanner(option).Plan(utxos, 0);
+  CheckConsolidationPlan(plan, option.GetEffectiveFeeBaserate());
+  ASSERT_EQ(plan.transactions.size(), static_cast<size_t>(1));
+  EXPECT_EQ(plan.transactions[0].utxos.size(), static_cast<size_t>(20));
+  EXPECT_EQ(plan.remaining_pool_size, static_cast<size_t>(2));
+  CheckConsolidationTransactions(
+      plan, planner.CreateTransactions(plan, GetConsolidationAddress()),
+      option.GetEffectiveFeeBaserate());
+
+  // 集約先TxOutがdustとなる場合は集約しない
+  plan = UtxoConsolidationPlanner(option).Plan(
+      std::vector<Utxo>(utxos.begin() + 16, utxos.end()), 0,
+      Amount::CreateBySatoshiAmount(5000));
+  EXPECT_TRUE(plan.transactions.empty());
+  EXPECT_EQ(plan.remaining_pool_size, static_cast<size_t>(5));
+}
+
+TEST(UtxoConsolidationPlanner, Plan_max_tx_weight)
+{
+  std::vector<Utxo> utxos;
+  for (uint32_t index = 0; index < 10; ++index) {
+    utxos.push_back(GetConsolidationUtxo(index, 10000));
+  }
+  CoinSelectionOption option;
+  option.InitializeTxSizeInfo();
+  option.SetEffectiveFeeBaserate(2);
+
+  // TxIn 3件分のweight
+  TxSizeModel model;
+  model.AddTxOut(static_cast<uint32_t>(option.GetChangeOutputSize()));
+  for (uint32_t index = 0; index < 3; ++index) {
+    model.AddTxIn(utxos[index]);
+  }
+  uint64_t max_weight = ((model.GetSize() - model.GetWitnessSize()) * 4) +
+                        model.GetWitnessSize();
+
+  UtxoConsolidationPlanner planner(option, max_weight);
+  UtxoConsolidationPlan plan = planner.Plan(utxos, 4);
+  CheckConsolidationPlan(plan, option.GetEffectiveFeeBaserate());
+  ASSERT_EQ(plan.transactions.size(), static_cast<size_t>(3));
+  for (const auto& tx : plan.transactions) {
+    EXPECT_EQ(tx.utxos.size(), static_cast<size_t>(3));
+    EXPECT_EQ(tx.weight, max_weight);
+  }
+  EXPECT_EQ(plan.removed_count, static_cast<size_t>(6));
+  EXPECT_EQ(plan.remaining_pool_size, static_cast<size_t>(4));
+  CheckConsolidationTransactions(
+      plan, planner.CreateTransactions(plan, GetConsolidationAddress()),
+      option.GetEffectiveFeeBaserate());
+
+  // 最後のtransactionは目標値に必要な件数のみ集約する
+  plan = planner.Plan(utxos, 5);
+  CheckConsolidationPlan(plan, option.GetEffectiveFeeBaserate());
+  ASSERT_EQ(plan.transactions.size(), static_cast<size_t>(3));
+  EXPECT_EQ(plan.transactions[2].utxos.size(), static_cast<size_t>(2));
+  EXPECT_LT(plan.transactions[2].weight, max_weight);
+  EXPECT_EQ(plan.removed_count, static_cast<size_t>(5));
+  EXPECT_EQ(plan.remaining_pool_size, static_cast<size_t>(5));
+
+  // TxIn 1件も収まらない場合は集約しない
+  plan = UtxoConsolidationPlanner(option, 100).Plan(utxos, 1);
+  EXPECT_TRUE(plan.transactions.empty());
+  EXPECT_EQ(plan.remaining_pool_size, utxos.size());
+}
+
+TEST(UtxoConsolidationPlanner, CreateTransactions)
+{
+  std::vector<Utxo> utxos;
+  for (uint32_t index = 0; index < 6; ++index) {
+    utxos.push_back(GetConsolidationUtxo(index, 30000));
+  }
+  CoinSelectionOption option;
+  option.InitializeTxSizeInfo();
+  option.SetEffectiveFeeBaserate(1);
+  option.SetMaxInputCount(3);
+  Address address = GetConsolidationAddress();
+
+  UtxoConsolidationPlanner planner(option);
+  UtxoConsolidationPlan plan;
+  std::vector<TransactionController> txs;
+  EXPECT_NO_THROW((txs = planner.CreateTransactions(utxos, 2, address, &plan)));
+  CheckConsolidationPlan(plan, option.GetEffectiveFeeBaserate());
+  ASSERT_EQ(txs.size(), static_cast<size_t>(2));
+  ASSERT_EQ(plan.transactions.size(), txs.size());
+  for (size_t index = 0; index < txs.size(); ++index) {
+    EXPECT_EQ(
+        txs[index].GetTransaction().GetTxInCount(), static_cast<uint32_t>(3));
+    ASSERT_EQ(
+        txs[index].GetTransaction().GetTxOutCount(), static_cast<uint32_t>(1));
+    EXPECT_EQ(
+        txs[index].GetTransaction().GetTxOut(0).GetValue().GetSatoshiValue(),
+        static_cast<int64_t>(plan.transactions[index].output_amount));
+  }
+  EXPECT_EQ(plan.remaining_pool_size, static_cast<size_t>(2));
+  CheckConsolidationTransactions(
+      plan, txs, option.GetEffectiveFeeBaserate());
+}
+
+#ifndef CFD_DISABLE_ELEMENTS
+TEST(UtxoConsolidationPlanner, Plan_with_asset)
+{
+  ConfidentialAssetId fee_asset(
+      "aa00000000000000000000000000000000000000000000000000000000000000");
+  ConfidentialAssetId other_asset(
+      "bb00000000000000000000000000000000000000000000000000000000000000");
+  // elementsのp2wpkh txinの推定サイズ
+  uint32_t txin_witness_size = 0;
+  uint32_t txin_size = TxInSizeTable::GetConfidentialTxInSize(
+      AddressType::kP2wpkhAddress, false, false, &txin_witness_size);
+  std::vector<Utxo> utxos;
+  for (uint32_t index = 0; index < 8; ++index) {
+    Utxo utxo = GetConsolidationUtxo(
+        index, 10000, static_cast<uint16_t>(txin_witness_size));
+    utxo.uscript_size_max = static_cast<uint16_t>(
+        txin_size - txin_witness_size -
+        static_cast<uint32_t>(TxIn::kMinimumTxInSize));
+    const ConfidentialAssetId& asset =
+        ((index % 2) == 0) ? fee_asset : other_asset;
+    memcpy(
+        utxo.asset, asset.GetData().GetBytes().data(), sizeof(utxo.asset));
+    utxos.push_back(utxo);
+  }
+  CoinSelectionOption option;
+  option.InitializeConfidentialTxSizeInfo();
+  option.SetEffectiveFeeBaserate(0.1);
+  option.SetFeeAsset(fee_asset);
+
+  UtxoConsolidationPlanner planner(option);
+  UtxoConsolidationPlan plan;
+  std::vector<ConfidentialTransactionController> txs;
+  EXPECT_NO_THROW((txs = planner.CreateConfidentialTransactions(
+                       utxos, 0, GetConsolidationAddress(), &plan)));
+  CheckConsolidationPlan(plan, option.GetEffectiveFeeBaserate());
+  ASSERT_EQ(plan.transactions.size(), static_cast<size_t>(1));
+  ASSERT_EQ(txs.size(), static_cast<size_t>(1));
+  EXPECT_EQ(plan.transactions[0].utxos.size(), static_cast<size_t>(4));
+  for (const auto& utxo : plan.transactions[0].utxos) {
+    EXPECT_EQ(utxo.vout % 2, static_cast<uint32_t>(0));
+  }
+  EXPECT_EQ(plan.removed_count, static_cast<size_t>(3));
+  EXPECT_EQ(plan.remaining_pool_size, static_cast<size_t>(5));
+
+  // blind後のtransactionの推定サイズと一致すること。
+  // 集約先TxOutはvsize(切り上げ)で計上するため、最大1byte大きくなる。
+  EXPECT_EQ(
+      txs[0].GetTransaction().GetTxInCount(), static_cast<uint32_t>(4));
+  EXPECT_EQ(
+      txs[0].GetTransaction().GetTxOutCount(), static_cast<uint32_t>(2));
+  uint32_t witness_size = 0;
+  uint32_t size = txs[0].GetSizeIgnoreTxIn(true, &witness_size);
+  for (size_t index = 0; index < plan.transactions[0].utxos.size(); ++index) {
+    size += txin_size;
+    witness_size += txin_witness_size;
+  }
+  uint32_t vsize =
+      AbstractTransaction::GetVsizeFromSize(size - witness_size, witness_size);
+  EXPECT_GE(plan.transactions[0].vsize, vsize);
+  EXPECT_LE(plan.transactions[0].vsize, vsize + 1);
+}
+#endif  // CFD_DISABLE_ELEMENTS